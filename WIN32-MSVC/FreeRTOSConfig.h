@@ -102,6 +102,7 @@
 #define configUSE_ALTERNATIVE_API				1
 #define configUSE_QUEUE_SETS					1
 #define configUSE_TASK_NOTIFICATIONS			1
+#define configNUM_THREAD_LOCAL_STORAGE_POINTERS	1 /* Slot 0: per task CSPRNG buffer, see payrange_csprng.h. */
 
 /* Software timer related configuration options. */
 #define configUSE_TIMERS						1
@@ -143,6 +144,7 @@ functions anyway. */
 #define INCLUDE_xTimerGetTimerDaemonTaskHandle	1
 #define INCLUDE_xTaskGetIdleTaskHandle			1
 #define INCLUDE_pcTaskGetTaskName				1
+#define INCLUDE_xTaskGetCurrentTaskHandle		1 /* The sampling profiler, see payrange_profile.c. */
 #define INCLUDE_eTaskGetState					1
 #define INCLUDE_xSemaphoreGetMutexHolder		1
 #define INCLUDE_xTimerPendFunctionCall			1
@@ -157,4 +159,19 @@ extern void vAssertCalled( unsigned long ulLine, const char * const pcFileName )
 #define TRACE_EXIT_CRITICAL_SECTION() portEXIT_CRITICAL()
 #include "trcKernelPort.h"
 
+/* Per-task heap accounting, see payrange_heap.c.  The hooks are chained after
+the trace recorder's own memory events, so both keep working. */
+#include <stddef.h>
+void heapAccountMalloc( void *pvAddress, size_t xSize );
+void heapAccountFree( void *pvAddress, size_t xSize );
+#undef traceMALLOC
+#undef traceFREE
+#if ( INCLUDE_MEMMANG_EVENTS == 1 )
+	#define traceMALLOC( pvAddress, uiSize ) { if( ( pvAddress ) != 0 ) vTraceStoreMemMangEvent( MEM_MALLOC_SIZE, ( uint32_t ) ( pvAddress ), ( int32_t ) ( uiSize ) ); heapAccountMalloc( ( pvAddress ), ( uiSize ) ); }
+	#define traceFREE( pvAddress, uiSize ) { vTraceStoreMemMangEvent( MEM_FREE_SIZE, ( uint32_t ) ( pvAddress ), ( int32_t ) ( -( int32_t ) ( uiSize ) ) ); heapAccountFree( ( pvAddress ), ( uiSize ) ); }
+#else
+	#define traceMALLOC( pvAddress, uiSize ) heapAccountMalloc( ( pvAddress ), ( uiSize ) )
+	#define traceFREE( pvAddress, uiSize ) heapAccountFree( ( pvAddress ), ( uiSize ) )
+#endif
+
 #endif /* FREERTOS_CONFIG_H */
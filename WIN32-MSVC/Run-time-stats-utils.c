@@ -85,50 +85,42 @@
 /* FreeRTOS+Trace includes. */
 #include "trcUser.h"
 
+/* Timestamp source, the TSC where the host has a usable one. */
+#include "payrange_tsc.h"
+
 /* Variables used in the creation of the run time stats time base.  Run time 
 stats record how much time each task spends in the Running state. */
-static long long llInitialRunTimeCounterValue = 0LL, llTicksPerHundedthMillisecond = 0LL;
+static uint64_t ullInitialRunTimeCounterValue = 0ULL;
+static tscScale_t xHundredthMillisecondScale;
+static volatile BaseType_t xRunTimeCounterConfigured = pdFALSE;
 
 /*-----------------------------------------------------------*/
 
 void vConfigureTimerForRunTimeStats( void )
 {
-LARGE_INTEGER liPerformanceCounterFrequency, liInitialRunTimeValue;
-
 	/* Initialise the variables used to create the run time stats time base.
 	Run time stats record how much time each task spends in the Running 
-	state. */
-
-	if( QueryPerformanceFrequency( &liPerformanceCounterFrequency ) == 0 )
-	{
-		llTicksPerHundedthMillisecond = 1;
-	}
-	else
-	{
-		/* How many times does the performance counter increment in 1/100th
-		millisecond. */
-		llTicksPerHundedthMillisecond = liPerformanceCounterFrequency.QuadPart / 100000LL;
-
-		/* What is the performance counter value now, this will be subtracted
-		from readings taken at run time. */
-		QueryPerformanceCounter( &liInitialRunTimeValue );
-		llInitialRunTimeCounterValue = liInitialRunTimeValue.QuadPart;
-	}
+	state.  The counter is read on every context switch, so it is the TSC
+	(calibrated once here) rather than QueryPerformanceCounter, and it is
+	scaled with a multiply and shift rather than a 64-bit division. */
+	tscInit();
+	tscMakeScale( &xHundredthMillisecondScale, 100000ULL );
+
+	/* What is the counter value now, this will be subtracted from readings
+	taken at run time. */
+	ullInitialRunTimeCounterValue = tscNow();
+	xRunTimeCounterConfigured = pdTRUE;
 }
 /*-----------------------------------------------------------*/
 
 unsigned long ulGetRunTimeCounterValue( void )
 {
-LARGE_INTEGER liCurrentCount;
 unsigned long ulReturn;
 
-	/* What is the performance counter value now? */
-	QueryPerformanceCounter( &liCurrentCount );
-
-	/* Subtract the performance counter value reading taken when the 
-	application started to get a count from that reference point, then
-	scale to (simulated) 1/100ths of a millisecond. */
-	if( llTicksPerHundedthMillisecond == 0 )
+	/* Subtract the counter value reading taken when the application started
+	to get a count from that reference point, then scale to (simulated)
+	1/100ths of a millisecond. */
+	if( xRunTimeCounterConfigured == pdFALSE )
 	{
 		/* The trace macros are probably calling this function before the
 		scheduler has been started. */
@@ -136,7 +128,7 @@ unsigned long ulReturn;
 	}
 	else
 	{
-		ulReturn = ( unsigned long ) ( ( liCurrentCount.QuadPart - llInitialRunTimeCounterValue ) / llTicksPerHundedthMillisecond );
+		ulReturn = ( unsigned long ) tscScale( tscNow() - ullInitialRunTimeCounterValue, &xHundredthMillisecondScale );
 	}
 
 	return ulReturn;
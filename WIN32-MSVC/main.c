@@ -103,6 +103,10 @@
 #include "FreeRTOS.h"
 #include "task.h"
 
+/* PayRange offline tools. */
+#include "payrange_tools.h"
+#include "payrange_heap.h"
+
 /* This project provides two demo applications.  A simple blinky style project,
 and a more comprehensive test and demo application.  The
 mainCREATE_SIMPLE_BLINKY_DEMO_ONLY setting is used to select between the two.
@@ -170,8 +174,18 @@ static portBASE_TYPE xTraceRunning = pdTRUE;
 
 /*-----------------------------------------------------------*/
 
-int main( void )
+int main( int argc, char *argv[] )
 {
+int iToolResult;
+
+	/* The PayRange offline tools (E log verifier etc.) are selected on the
+	command line and run instead of the scheduler. */
+	iToolResult = payrangeRunTool( argc, argv );
+	if( iToolResult != PAYRANGE_NO_TOOL )
+	{
+		return iToolResult;
+	}
+
 	/* This demo uses heap_5.c, so start by defining some heap regions.  This
 	is only done to provide an example as this demo could easily create one
 	large heap region instead of multiple smaller heap regions - in which case
@@ -219,7 +233,9 @@ void vApplicationMallocFailedHook( void )
 	heap available to pvPortMalloc() is defined by configTOTAL_HEAP_SIZE in
 	FreeRTOSConfig.h, and the xPortGetFreeHeapSize() API function can be used
 	to query the size of free heap space that remains (although it does not
-	provide information on how the remaining heap might be fragmented). */
+	provide information on how the remaining heap might be fragmented).  The
+	per-task accounts show which task the heap went to. */
+	heapPrintAccounts();
 	vAssertCalled( __LINE__, __FILE__ );
 }
 /*-----------------------------------------------------------*/
@@ -0,0 +1,70 @@
+///-----------------------------------------------------------------------------
+/// \file payrange.h
+///-----------------------------------------------------------------------------
+///
+/// \brief Shared configuration and data types of the PayRange Challenge 1
+///        subsystems (A, B, D, E and list F)
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_H
+#define PAYRANGE_H
+
+/// Standard includes
+#include <stdint.h>
+
+/// Kernel includes
+#include <FreeRTOS.h>
+
+/// Project Configurable defines; the periods and list sizes are the defaults
+/// of the runtime configuration (payrange_config.h)
+#define TASK_A_RUNTIME_IN_MS			( 250 )
+#define TASK_B_RUNTIME_IN_MS			( 5000 )
+#define KEYBOARD_TASK_DELAY_IN_MS       ( 5 )
+#define NUMBER_OF_ALPHANUMERIC_DIGITS   ( 8 )
+#define SIZE_OF_THE_TASK_B_ARRAY		( 5 )
+/// The B list can be resized at runtime up to this many slots
+#define MAX_SIZE_OF_THE_TASK_B_ARRAY    ( 32 )
+#define SIZE_OF_VALUE_E_STRUCTURE       ( 7 )
+/// List F can be resized at runtime up to this many slots (payrange_listf.h)
+#define MAX_SIZE_OF_VALUE_E_STRUCTURE   ( 1024 )
+/// Captures waiting to be paired into E records, and how many are paired per batch
+#define CAPTURE_QUEUE_LENGTH            ( 128 )
+#define CAPTURE_BATCH_SIZE              ( 32 )
+/// Capture source of the local console (C key); remote terminals use their id
+#define CAPTURE_SOURCE_CONSOLE          ( 0 )
+/// Sources with this bit set belong to the request gateway's clients
+/// (payrange_rpc.h); terminal ids with it set are refused, like 0
+#define CAPTURE_SOURCE_GATEWAY          ( 0x80000000u )
+
+/// Structure for Task B array of alphanumerics and time
+typedef struct
+{
+	TickType_t stringTime;
+	char stringPlacer[NUMBER_OF_ALPHANUMERIC_DIGITS + 1];
+	/// stringTime in UTC, nanoseconds since 1970 (payrange_time.h)
+	uint64_t stringTimeUtcNs;
+}taskBStructure_t;
+/// Structure for D (Value A + Time)
+typedef struct
+{
+	TickType_t randomNumberTime;
+	int64_t    randomNumber;
+	/// randomNumberTime in UTC, nanoseconds since 1970 (payrange_time.h)
+	uint64_t   randomNumberTimeUtcNs;
+}valueD_t;
+/// Structure for E (Value B + Value D)
+typedef struct
+{
+	taskBStructure_t randomValueB;
+	valueD_t         currentValueD;
+}valueE_t;
+/// C capture on its way to the E pipeline: stamped D plus its origin
+typedef struct
+{
+	uint32_t source;
+	uint32_t sequence;
+	valueD_t valueD;
+}captureRequest_t;
+
+#endif /// PAYRANGE_H
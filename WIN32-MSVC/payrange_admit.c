@@ -0,0 +1,323 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_admit.c
+///-----------------------------------------------------------------------------
+///
+/// \brief Capture admission control
+///
+/// Every capture source (the console and each remote terminal) has a token
+/// bucket that refills at the source's sustained rate and holds at most its
+/// burst size. A capture that finds a token is admitted. One that does not
+/// is deferred: the caller keeps it and asks again, so a short burst above
+/// the rate only adds latency. A capture still without a token after
+/// ADMIT_MAX_DEFER_MS is shed, and from then on the source is shedding:
+/// captures without a token are dropped at once instead of queueing up
+/// behind each other, until the bucket has refilled to half its burst.
+/// Under sustained overload a source therefore gets exactly its rate
+/// through, with bounded latency, and the excess is counted and dropped.
+///
+/// Tokens are kept in 1/configTICK_RATE_HZ units, so a tick adds exactly
+/// ratePerSecond units and the arithmetic stays integral.
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+
+/// Standard includes
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+/// Kernel includes
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "payrange_admit.h"
+#include "payrange_critical.h"
+
+/// Token cost of one capture
+#define ADMIT_TOKEN                     ( (uint64_t)configTICK_RATE_HZ )
+/// Source id reported for the shared overflow bucket
+#define ADMIT_OVERFLOW_SOURCE           ( 0xFFFFFFFFu )
+
+/// Token bucket of one source
+typedef struct
+{
+	uint32_t     source;
+	int          inUse;
+	uint32_t     ratePerSecond;
+	uint32_t     burst;
+	/// Available tokens, in ADMIT_TOKEN units
+	uint64_t     tokens;
+	TickType_t   refilledAt;
+	/// Set by a shed, captures without a token are shed without waiting
+	int          shedding;
+	admitStats_t stats;
+}admitBucket_t;
+
+/// Buckets hashed by source, with linear probing; the last one is shared
+/// by all sources that found the table full
+static admitBucket_t admitBuckets[ADMIT_MAX_SOURCES + 1];
+
+///-----------------------------------------------------------
+/// \brief Sets the limits of a bucket and fills it
+///
+/// @param1 admitBucket_t *bucket - bucket
+/// @param2 uint32_t ratePerSecond - sustained rate
+/// @param3 uint32_t burst - bucket size, at least 1
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void admitResetBucket(admitBucket_t *bucket, uint32_t ratePerSecond, uint32_t burst)
+{
+	bucket->ratePerSecond = ratePerSecond;
+	bucket->burst = (burst > 0) ? burst : 1;
+	bucket->tokens = (uint64_t)bucket->burst * ADMIT_TOKEN;
+	bucket->refilledAt = xTaskGetTickCount();
+	bucket->shedding = 0;
+}
+
+///-----------------------------------------------------------
+/// \brief Finds the bucket of a source, claiming a free one
+///        with the default limits on first use. Called inside
+///        a critical section.
+///
+/// @param1 uint32_t source - capture source
+///
+/// @return admitBucket_t * - bucket, never NULL
+///-----------------------------------------------------------
+static admitBucket_t *admitFindBucket(uint32_t source)
+{
+	uint32_t slot = source % ADMIT_MAX_SOURCES;
+	admitBucket_t *overflow = &admitBuckets[ADMIT_MAX_SOURCES];
+
+	for (int probe = 0; probe < ADMIT_MAX_SOURCES; probe++)
+	{
+		admitBucket_t *bucket = &admitBuckets[slot];
+		if (!bucket->inUse)
+		{
+			bucket->inUse = 1;
+			bucket->source = source;
+			if (source == CAPTURE_SOURCE_CONSOLE)
+			{
+				admitResetBucket(bucket, ADMIT_CONSOLE_RATE, ADMIT_CONSOLE_BURST);
+			}
+			else
+			{
+				admitResetBucket(bucket, ADMIT_TERMINAL_RATE, ADMIT_TERMINAL_BURST);
+			}
+			return bucket;
+		}
+		if (bucket->source == source)
+		{
+			return bucket;
+		}
+		slot = (slot + 1) % ADMIT_MAX_SOURCES;
+	}
+
+	if (!overflow->inUse)
+	{
+		overflow->inUse = 1;
+		overflow->source = ADMIT_OVERFLOW_SOURCE;
+		admitResetBucket(overflow, ADMIT_TERMINAL_RATE, ADMIT_TERMINAL_BURST);
+	}
+	return overflow;
+}
+
+///-----------------------------------------------------------
+/// \brief Adds the tokens earned since the last refill
+///
+/// @param1 admitBucket_t *bucket - bucket
+/// @param2 TickType_t now - current tick
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void admitRefill(admitBucket_t *bucket, TickType_t now)
+{
+	const uint64_t capacity = (uint64_t)bucket->burst * ADMIT_TOKEN;
+	const TickType_t elapsed = (TickType_t)(now - bucket->refilledAt);
+
+	bucket->refilledAt = now;
+	bucket->tokens += (uint64_t)elapsed * bucket->ratePerSecond;
+	if (bucket->tokens > capacity)
+	{
+		bucket->tokens = capacity;
+	}
+	/// The source has slowed down below its rate, let it defer again
+	if (bucket->shedding && (bucket->tokens * 2 >= capacity))
+	{
+		bucket->shedding = 0;
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Sets the sustained rate and burst of a source
+///
+/// @param1 uint32_t source - capture source
+/// @param2 uint32_t ratePerSecond - sustained captures per second
+/// @param3 uint32_t burst - captures admitted back to back
+///
+/// @return N/A
+///-----------------------------------------------------------
+void admitSetLimits(uint32_t source, uint32_t ratePerSecond, uint32_t burst)
+{
+	PAYRANGE_ENTER_CRITICAL();
+	admitResetBucket(admitFindBucket(source), ratePerSecond, burst);
+	PAYRANGE_EXIT_CRITICAL();
+}
+
+///-----------------------------------------------------------
+/// \brief Decides on one capture of a source
+///
+/// @param1 uint32_t source - capture source
+/// @param2 const TickType_t *deferredSince - tick of the first
+///         attempt of a deferred capture, NULL on the first one
+///
+/// @return admitOutcome_t - ADMIT_ADMIT, ADMIT_DEFER or ADMIT_SHED
+///-----------------------------------------------------------
+admitOutcome_t admitRequest(uint32_t source, const TickType_t *deferredSince)
+{
+	const TickType_t xMaxDefer = ADMIT_MAX_DEFER_MS / portTICK_PERIOD_MS;
+	const TickType_t now = xTaskGetTickCount();
+	admitOutcome_t outcome;
+	admitBucket_t *bucket;
+
+	PAYRANGE_ENTER_CRITICAL();
+	bucket = admitFindBucket(source);
+	admitRefill(bucket, now);
+	if (bucket->tokens >= ADMIT_TOKEN)
+	{
+		bucket->tokens -= ADMIT_TOKEN;
+		bucket->stats.admitted++;
+		if (deferredSince != NULL)
+		{
+			const uint32_t waited = (uint32_t)(TickType_t)(now - *deferredSince);
+			if (waited > bucket->stats.maxDeferTicks)
+			{
+				bucket->stats.maxDeferTicks = waited;
+			}
+		}
+		outcome = ADMIT_ADMIT;
+	}
+	else if (bucket->shedding || ((deferredSince != NULL) && ((TickType_t)(now - *deferredSince) >= xMaxDefer)))
+	{
+		bucket->shedding = 1;
+		bucket->stats.shed++;
+		outcome = ADMIT_SHED;
+	}
+	else
+	{
+		if (deferredSince == NULL)
+		{
+			bucket->stats.deferred++;
+		}
+		outcome = ADMIT_DEFER;
+	}
+	PAYRANGE_EXIT_CRITICAL();
+	return outcome;
+}
+
+///-----------------------------------------------------------
+/// \brief Counts a capture dropped by the caller as shed
+///
+/// @param1 uint32_t source - capture source
+///
+/// @return N/A
+///-----------------------------------------------------------
+void admitShed(uint32_t source)
+{
+	PAYRANGE_ENTER_CRITICAL();
+	admitFindBucket(source)->stats.shed++;
+	PAYRANGE_EXIT_CRITICAL();
+}
+
+///-----------------------------------------------------------
+/// \brief Copies the counters of one source
+///
+/// @param1 uint32_t source - capture source
+/// @param2 admitStats_t *stats - output
+///
+/// @return int - 1 if the source has a bucket of its own
+///-----------------------------------------------------------
+int admitGetStats(uint32_t source, admitStats_t *stats)
+{
+	int found = 0;
+
+	memset(stats, 0, sizeof(*stats));
+	PAYRANGE_ENTER_CRITICAL();
+	for (int i = 0; i < ADMIT_MAX_SOURCES; i++)
+	{
+		if (admitBuckets[i].inUse && (admitBuckets[i].source == source))
+		{
+			*stats = admitBuckets[i].stats;
+			found = 1;
+			break;
+		}
+	}
+	PAYRANGE_EXIT_CRITICAL();
+	return found;
+}
+
+///-----------------------------------------------------------
+/// \brief Sums the counters of all sources
+///
+/// @param1 admitStats_t *stats - output
+///
+/// @return N/A
+///-----------------------------------------------------------
+void admitGetTotals(admitStats_t *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+	PAYRANGE_ENTER_CRITICAL();
+	for (int i = 0; i <= ADMIT_MAX_SOURCES; i++)
+	{
+		const admitStats_t *source = &admitBuckets[i].stats;
+		stats->admitted += source->admitted;
+		stats->deferred += source->deferred;
+		stats->shed += source->shed;
+		if (source->maxDeferTicks > stats->maxDeferTicks)
+		{
+			stats->maxDeferTicks = source->maxDeferTicks;
+		}
+	}
+	PAYRANGE_EXIT_CRITICAL();
+}
+
+///-----------------------------------------------------------
+/// \brief Prints the totals and the counters of every source
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+void admitPrintStats(void)
+{
+	admitBucket_t buckets[ADMIT_MAX_SOURCES + 1];
+	admitStats_t totals;
+
+	admitGetTotals(&totals);
+	PAYRANGE_ENTER_CRITICAL();
+	memcpy(buckets, admitBuckets, sizeof(buckets));
+	PAYRANGE_EXIT_CRITICAL();
+
+	printf("Admission: %" PRIu64 " admitted, %" PRIu64 " deferred, %" PRIu64 " shed, longest wait %u ms\n",
+		totals.admitted, totals.deferred, totals.shed,
+		(unsigned int)(totals.maxDeferTicks * portTICK_PERIOD_MS));
+	for (int i = 0; i <= ADMIT_MAX_SOURCES; i++)
+	{
+		const admitBucket_t *bucket = &buckets[i];
+		if (!bucket->inUse)
+		{
+			continue;
+		}
+		if (bucket->source == ADMIT_OVERFLOW_SOURCE)
+		{
+			printf("  other sources ");
+		}
+		else
+		{
+			printf("  source %-8u", (unsigned int)bucket->source);
+		}
+		printf(" %u/s burst %u%s: %" PRIu64 " admitted, %" PRIu64 " deferred, %" PRIu64 " shed\n",
+			(unsigned int)bucket->ratePerSecond, (unsigned int)bucket->burst, bucket->shedding ? " (shedding)" : "",
+			bucket->stats.admitted, bucket->stats.deferred, bucket->stats.shed);
+	}
+}
@@ -0,0 +1,67 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_admit.h
+///-----------------------------------------------------------------------------
+///
+/// \brief Capture admission control: one token bucket per capture source in
+///        front of the E pipeline, with admit, defer and shed outcomes
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_ADMIT_H
+#define PAYRANGE_ADMIT_H
+
+#include "payrange.h"
+
+/// Admission configurable defines
+/// Sustained captures per second and burst size of the local console (C key)
+#define ADMIT_CONSOLE_RATE              ( 20 )
+#define ADMIT_CONSOLE_BURST             ( 10 )
+/// Sustained captures per second and burst size of each remote terminal
+#define ADMIT_TERMINAL_RATE             ( 2000 )
+#define ADMIT_TERMINAL_BURST            ( 256 )
+/// Longest a capture may wait for a token before it is shed
+#define ADMIT_MAX_DEFER_MS              ( 200 )
+/// Sources with their own bucket; further sources share the overflow bucket
+#define ADMIT_MAX_SOURCES               ( 32 )
+/// Console captures held back while the console is over its rate
+#define ADMIT_CONSOLE_DEFER_DEPTH       ( 8 )
+
+/// Admission decision for one capture
+typedef enum
+{
+	/// A token was taken, queue the capture now
+	ADMIT_ADMIT = 0,
+	/// No token yet, keep the capture and ask again later
+	ADMIT_DEFER,
+	/// Waited ADMIT_MAX_DEFER_MS without a token, drop the capture
+	ADMIT_SHED
+}admitOutcome_t;
+
+/// Admission counters of one source (or of all of them)
+typedef struct
+{
+	uint64_t admitted;
+	/// Captures that had to wait at least once (admitted or shed later)
+	uint64_t deferred;
+	uint64_t shed;
+	/// Longest wait of an admitted capture, in ticks
+	uint32_t maxDeferTicks;
+}admitStats_t;
+
+/// Sets the sustained rate (captures per second) and burst of a source;
+/// sources that were never set use the console or terminal defaults
+void admitSetLimits(uint32_t source, uint32_t ratePerSecond, uint32_t burst);
+/// Decides on one capture of a source. deferredSince is NULL on the first
+/// attempt; a deferred capture is retried with the tick of that attempt.
+admitOutcome_t admitRequest(uint32_t source, const TickType_t *deferredSince);
+/// Counts a capture the caller had to drop on its own (e.g. its defer
+/// queue was full) as shed
+void admitShed(uint32_t source);
+/// Copies the counters of one source; returns 0 if the source is unknown
+int admitGetStats(uint32_t source, admitStats_t *stats);
+/// Copies the counters summed over all sources
+void admitGetTotals(admitStats_t *stats);
+/// Prints the totals and the counters of every source to stdout
+void admitPrintStats(void);
+
+#endif /// PAYRANGE_ADMIT_H
@@ -0,0 +1,701 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_aead.c
+///-----------------------------------------------------------------------------
+///
+/// \brief Authenticated encryption: AES-256-GCM (NIST SP 800-38D) using
+///        AES-NI and carry-less multiplication, and ChaCha20-Poly1305
+///        (RFC 8439) in portable C for hosts without AES-NI
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+
+/// Standard includes
+#include <string.h>
+
+/// Compiler includes
+#include <immintrin.h>
+
+#include "payrange_cpu.h"
+#include "payrange_chacha20.h"
+#include "payrange_aead.h"
+
+/// AES-GCM processes this many counter blocks per loop to keep the AES units busy
+#define AES_GCM_PARALLEL_BLOCKS         ( 4 )
+
+///-----------------------------------------------------------
+/// \brief Little-endian load/store helpers
+///-----------------------------------------------------------
+static uint32_t aeadLoadLe32(const uint8_t *bytes)
+{
+	return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static void aeadStoreLe32(uint8_t *bytes, uint32_t value)
+{
+	bytes[0] = (uint8_t)value;
+	bytes[1] = (uint8_t)(value >> 8);
+	bytes[2] = (uint8_t)(value >> 16);
+	bytes[3] = (uint8_t)(value >> 24);
+}
+
+static void aeadStoreLe64(uint8_t *bytes, uint64_t value)
+{
+	aeadStoreLe32(bytes, (uint32_t)value);
+	aeadStoreLe32(bytes + 4, (uint32_t)(value >> 32));
+}
+
+///-----------------------------------------------------------
+/// \brief Constant time tag comparison
+///
+/// @param1 const uint8_t *a - first tag
+/// @param2 const uint8_t *b - second tag
+///
+/// @return int - 1 if equal
+///-----------------------------------------------------------
+static int aeadTagsEqual(const uint8_t *a, const uint8_t *b)
+{
+	uint8_t difference = 0;
+
+	for (int i = 0; i < AEAD_TAG_SIZE; i++)
+	{
+		difference |= (uint8_t)(a[i] ^ b[i]);
+	}
+	return (difference == 0);
+}
+
+///===========================================================
+/// AES-256-GCM
+///===========================================================
+
+///-----------------------------------------------------------
+/// \brief AES-256 key schedule helpers
+///-----------------------------------------------------------
+PAYRANGE_TARGET("aes,sse4.1")
+static __m128i aesExpandEven(__m128i key, __m128i assist)
+{
+	assist = _mm_shuffle_epi32(assist, 0xFF);
+	key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+	key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+	key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+	return _mm_xor_si128(key, assist);
+}
+
+PAYRANGE_TARGET("aes,sse4.1")
+static __m128i aesExpandOdd(__m128i key, __m128i previous)
+{
+	__m128i assist = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(previous, 0x00), 0xAA);
+	key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+	key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+	key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+	return _mm_xor_si128(key, assist);
+}
+
+///-----------------------------------------------------------
+/// \brief Carry-less multiplication in GF(2^128) with the
+///        GCM polynomial, on byte reflected operands
+///
+/// @param1 __m128i a - first factor
+/// @param2 __m128i b - second factor
+///
+/// @return __m128i - product
+///-----------------------------------------------------------
+PAYRANGE_TARGET("pclmul,sse4.1")
+static __m128i gcmMultiply(__m128i a, __m128i b)
+{
+	__m128i low, middle, middle2, high, carryLow, carryHigh, carryCross, reduce, reduceHigh, fold;
+
+	/// 256-bit Karatsuba-free schoolbook product
+	low = _mm_clmulepi64_si128(a, b, 0x00);
+	middle = _mm_clmulepi64_si128(a, b, 0x10);
+	middle2 = _mm_clmulepi64_si128(a, b, 0x01);
+	high = _mm_clmulepi64_si128(a, b, 0x11);
+	middle = _mm_xor_si128(middle, middle2);
+	low = _mm_xor_si128(low, _mm_slli_si128(middle, 8));
+	high = _mm_xor_si128(high, _mm_srli_si128(middle, 8));
+
+	/// Shift the product left by one bit (operands are bit reflected)
+	carryLow = _mm_srli_epi32(low, 31);
+	carryHigh = _mm_srli_epi32(high, 31);
+	low = _mm_slli_epi32(low, 1);
+	high = _mm_slli_epi32(high, 1);
+	carryCross = _mm_srli_si128(carryLow, 12);
+	carryHigh = _mm_slli_si128(carryHigh, 4);
+	carryLow = _mm_slli_si128(carryLow, 4);
+	low = _mm_or_si128(low, carryLow);
+	high = _mm_or_si128(high, carryHigh);
+	high = _mm_or_si128(high, carryCross);
+
+	/// Reduce modulo x^128 + x^7 + x^2 + x + 1
+	reduce = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(low, 31), _mm_slli_epi32(low, 30)), _mm_slli_epi32(low, 25));
+	reduceHigh = _mm_srli_si128(reduce, 4);
+	reduce = _mm_slli_si128(reduce, 12);
+	low = _mm_xor_si128(low, reduce);
+	fold = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(low, 1), _mm_srli_epi32(low, 2)), _mm_srli_epi32(low, 7));
+	fold = _mm_xor_si128(fold, reduceHigh);
+	low = _mm_xor_si128(low, fold);
+	return _mm_xor_si128(high, low);
+}
+
+///-----------------------------------------------------------
+/// \brief Expands the key and derives the GHASH key
+///
+/// @param1 aeadContext_t *context - context with the key set
+///
+/// @return N/A
+///-----------------------------------------------------------
+PAYRANGE_TARGET("aes,pclmul,sse4.1,ssse3")
+static void aesGcmInit(aeadContext_t *context)
+{
+	const __m128i byteReverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	__m128i roundKeys[15];
+	__m128i hashKey;
+
+	roundKeys[0] = _mm_loadu_si128((const __m128i *)context->key);
+	roundKeys[1] = _mm_loadu_si128((const __m128i *)(context->key + 16));
+	/// The round constant must be an immediate, hence the unrolled schedule
+	roundKeys[2] = aesExpandEven(roundKeys[0], _mm_aeskeygenassist_si128(roundKeys[1], 0x01));
+	roundKeys[3] = aesExpandOdd(roundKeys[1], roundKeys[2]);
+	roundKeys[4] = aesExpandEven(roundKeys[2], _mm_aeskeygenassist_si128(roundKeys[3], 0x02));
+	roundKeys[5] = aesExpandOdd(roundKeys[3], roundKeys[4]);
+	roundKeys[6] = aesExpandEven(roundKeys[4], _mm_aeskeygenassist_si128(roundKeys[5], 0x04));
+	roundKeys[7] = aesExpandOdd(roundKeys[5], roundKeys[6]);
+	roundKeys[8] = aesExpandEven(roundKeys[6], _mm_aeskeygenassist_si128(roundKeys[7], 0x08));
+	roundKeys[9] = aesExpandOdd(roundKeys[7], roundKeys[8]);
+	roundKeys[10] = aesExpandEven(roundKeys[8], _mm_aeskeygenassist_si128(roundKeys[9], 0x10));
+	roundKeys[11] = aesExpandOdd(roundKeys[9], roundKeys[10]);
+	roundKeys[12] = aesExpandEven(roundKeys[10], _mm_aeskeygenassist_si128(roundKeys[11], 0x20));
+	roundKeys[13] = aesExpandOdd(roundKeys[11], roundKeys[12]);
+	roundKeys[14] = aesExpandEven(roundKeys[12], _mm_aeskeygenassist_si128(roundKeys[13], 0x40));
+
+	/// H = E(K, 0^128)
+	hashKey = _mm_xor_si128(_mm_setzero_si128(), roundKeys[0]);
+	for (int round = 1; round < 14; round++)
+	{
+		hashKey = _mm_aesenc_si128(hashKey, roundKeys[round]);
+	}
+	hashKey = _mm_aesenclast_si128(hashKey, roundKeys[14]);
+	hashKey = _mm_shuffle_epi8(hashKey, byteReverse);
+
+	for (int round = 0; round < 15; round++)
+	{
+		_mm_storeu_si128((__m128i *)context->roundKeys[round], roundKeys[round]);
+	}
+	_mm_storeu_si128((__m128i *)context->hashKey, hashKey);
+}
+
+///-----------------------------------------------------------
+/// \brief Absorbs data into GHASH, zero padding the last
+///        partial block
+///
+/// @param1 __m128i hash - running hash (byte reflected)
+/// @param2 __m128i hashKey - H (byte reflected)
+/// @param3 const uint8_t *data - data
+/// @param4 size_t length - number of bytes
+///
+/// @return __m128i - updated hash
+///-----------------------------------------------------------
+PAYRANGE_TARGET("pclmul,sse4.1,ssse3")
+static __m128i gcmHash(__m128i hash, __m128i hashKey, const uint8_t *data, size_t length)
+{
+	const __m128i byteReverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	uint8_t lastBlock[16];
+
+	while (length >= 16)
+	{
+		__m128i block = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)data), byteReverse);
+		hash = gcmMultiply(_mm_xor_si128(hash, block), hashKey);
+		data += 16;
+		length -= 16;
+	}
+	if (length > 0)
+	{
+		memset(lastBlock, 0, sizeof(lastBlock));
+		memcpy(lastBlock, data, length);
+		hash = gcmMultiply(_mm_xor_si128(hash, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)lastBlock), byteReverse)), hashKey);
+	}
+	return hash;
+}
+
+///-----------------------------------------------------------
+/// \brief Counter block J0 + counter for a 96-bit nonce
+///-----------------------------------------------------------
+PAYRANGE_TARGET("sse4.1")
+static __m128i gcmCounterBlock(__m128i nonceBlock, uint32_t counter)
+{
+	/// The counter word is big-endian
+	uint32_t bigEndian = ((counter & 0xFF) << 24) | ((counter & 0xFF00) << 8) | ((counter >> 8) & 0xFF00) | (counter >> 24);
+	return _mm_insert_epi32(nonceBlock, (int)bigEndian, 3);
+}
+
+///-----------------------------------------------------------
+/// \brief AES-GCM core: CTR encryption/decryption and GHASH
+///        of aad and ciphertext
+///
+/// @param1 const aeadContext_t *context - keyed context
+/// @param2 const uint8_t nonce[12] - nonce
+/// @param3 const uint8_t *aad - additional data
+/// @param4 size_t aadLength - additional data length
+/// @param5 const uint8_t *input - plaintext or ciphertext
+/// @param6 size_t length - number of bytes
+/// @param7 uint8_t *output - ciphertext or plaintext
+/// @param8 int encrypting - 1 to hash the output, 0 the input
+/// @param9 uint8_t tag[16] - computed tag
+///
+/// @return N/A
+///-----------------------------------------------------------
+PAYRANGE_TARGET("aes,pclmul,sse4.1,ssse3")
+static void aesGcmCrypt(const aeadContext_t *context, const uint8_t nonce[AEAD_NONCE_SIZE],
+	const uint8_t *aad, size_t aadLength, const uint8_t *input, size_t length,
+	uint8_t *output, int encrypting, uint8_t tag[AEAD_TAG_SIZE])
+{
+	const __m128i byteReverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	__m128i roundKeys[15];
+	__m128i hashKey, hash, nonceBlock, lengths, tagMask;
+	uint8_t nonceBytes[16];
+	uint8_t lengthBytes[16];
+	uint32_t counter = 2;
+	size_t remaining = length;
+	const uint8_t *in = input;
+	uint8_t *out = output;
+
+	for (int round = 0; round < 15; round++)
+	{
+		roundKeys[round] = _mm_loadu_si128((const __m128i *)context->roundKeys[round]);
+	}
+	hashKey = _mm_loadu_si128((const __m128i *)context->hashKey);
+
+	memcpy(nonceBytes, nonce, AEAD_NONCE_SIZE);
+	memset(nonceBytes + AEAD_NONCE_SIZE, 0, 4);
+	nonceBlock = _mm_loadu_si128((const __m128i *)nonceBytes);
+
+	hash = gcmHash(_mm_setzero_si128(), hashKey, aad, aadLength);
+
+	/// Bulk: several counter blocks in flight, then hash the ciphertext
+	while (remaining >= AES_GCM_PARALLEL_BLOCKS * 16)
+	{
+		__m128i blocks[AES_GCM_PARALLEL_BLOCKS];
+		for (int i = 0; i < AES_GCM_PARALLEL_BLOCKS; i++)
+		{
+			blocks[i] = _mm_xor_si128(gcmCounterBlock(nonceBlock, counter + (uint32_t)i), roundKeys[0]);
+		}
+		for (int round = 1; round < 14; round++)
+		{
+			for (int i = 0; i < AES_GCM_PARALLEL_BLOCKS; i++)
+			{
+				blocks[i] = _mm_aesenc_si128(blocks[i], roundKeys[round]);
+			}
+		}
+		for (int i = 0; i < AES_GCM_PARALLEL_BLOCKS; i++)
+		{
+			__m128i data = _mm_loadu_si128((const __m128i *)(in + 16 * i));
+			__m128i result = _mm_xor_si128(_mm_aesenclast_si128(blocks[i], roundKeys[14]), data);
+			_mm_storeu_si128((__m128i *)(out + 16 * i), result);
+			hash = gcmMultiply(_mm_xor_si128(hash, _mm_shuffle_epi8(encrypting ? result : data, byteReverse)), hashKey);
+		}
+		counter += AES_GCM_PARALLEL_BLOCKS;
+		in += AES_GCM_PARALLEL_BLOCKS * 16;
+		out += AES_GCM_PARALLEL_BLOCKS * 16;
+		remaining -= AES_GCM_PARALLEL_BLOCKS * 16;
+	}
+
+	/// Tail, one block (possibly partial) at a time
+	while (remaining > 0)
+	{
+		uint8_t keystream[16];
+		size_t chunk = (remaining < 16) ? remaining : 16;
+		__m128i block = _mm_xor_si128(gcmCounterBlock(nonceBlock, counter), roundKeys[0]);
+		for (int round = 1; round < 14; round++)
+		{
+			block = _mm_aesenc_si128(block, roundKeys[round]);
+		}
+		_mm_storeu_si128((__m128i *)keystream, _mm_aesenclast_si128(block, roundKeys[14]));
+		if (!encrypting)
+		{
+			hash = gcmHash(hash, hashKey, in, chunk);
+		}
+		for (size_t i = 0; i < chunk; i++)
+		{
+			out[i] = (uint8_t)(in[i] ^ keystream[i]);
+		}
+		if (encrypting)
+		{
+			hash = gcmHash(hash, hashKey, out, chunk);
+		}
+		counter++;
+		in += chunk;
+		out += chunk;
+		remaining -= chunk;
+	}
+
+	/// len(A) || len(C) in bits, big-endian
+	for (int i = 0; i < 8; i++)
+	{
+		lengthBytes[i] = (uint8_t)(((uint64_t)aadLength * 8) >> (56 - 8 * i));
+		lengthBytes[8 + i] = (uint8_t)(((uint64_t)length * 8) >> (56 - 8 * i));
+	}
+	lengths = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)lengthBytes), byteReverse);
+	hash = gcmMultiply(_mm_xor_si128(hash, lengths), hashKey);
+
+	/// T = E(K, J0) xor GHASH
+	tagMask = _mm_xor_si128(gcmCounterBlock(nonceBlock, 1), roundKeys[0]);
+	for (int round = 1; round < 14; round++)
+	{
+		tagMask = _mm_aesenc_si128(tagMask, roundKeys[round]);
+	}
+	tagMask = _mm_aesenclast_si128(tagMask, roundKeys[14]);
+	_mm_storeu_si128((__m128i *)tag, _mm_xor_si128(tagMask, _mm_shuffle_epi8(hash, byteReverse)));
+}
+
+///===========================================================
+/// ChaCha20-Poly1305
+///===========================================================
+
+/// Poly1305 state, 26-bit limbs (fits 32-bit hosts)
+typedef struct
+{
+	uint32_t r[5];
+	uint32_t h[5];
+	uint32_t pad[4];
+}poly1305State_t;
+
+///-----------------------------------------------------------
+/// \brief Clamps r and stores the final pad
+///
+/// @param1 poly1305State_t *state - state to initialize
+/// @param2 const uint8_t key[32] - one-time key
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void poly1305Init(poly1305State_t *state, const uint8_t key[32])
+{
+	state->r[0] = (aeadLoadLe32(key + 0)) & 0x3ffffff;
+	state->r[1] = (aeadLoadLe32(key + 3) >> 2) & 0x3ffff03;
+	state->r[2] = (aeadLoadLe32(key + 6) >> 4) & 0x3ffc0ff;
+	state->r[3] = (aeadLoadLe32(key + 9) >> 6) & 0x3f03fff;
+	state->r[4] = (aeadLoadLe32(key + 12) >> 8) & 0x00fffff;
+	memset(state->h, 0, sizeof(state->h));
+	for (int i = 0; i < 4; i++)
+	{
+		state->pad[i] = aeadLoadLe32(key + 16 + 4 * i);
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Absorbs data, zero padded to 16 bytes (the RFC 8439
+///        AEAD construction pads aad and ciphertext anyway)
+///
+/// @param1 poly1305State_t *state - running MAC
+/// @param2 const uint8_t *data - data
+/// @param3 size_t length - number of bytes
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void poly1305UpdatePadded(poly1305State_t *state, const uint8_t *data, size_t length)
+{
+	const uint32_t r0 = state->r[0], r1 = state->r[1], r2 = state->r[2], r3 = state->r[3], r4 = state->r[4];
+	const uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+	uint32_t h0 = state->h[0], h1 = state->h[1], h2 = state->h[2], h3 = state->h[3], h4 = state->h[4];
+	uint8_t lastBlock[16];
+
+	while (length > 0)
+	{
+		const uint8_t *block = data;
+		uint64_t d0, d1, d2, d3, d4;
+		uint32_t carry;
+
+		if (length < 16)
+		{
+			memset(lastBlock, 0, sizeof(lastBlock));
+			memcpy(lastBlock, data, length);
+			block = lastBlock;
+			length = 16;
+		}
+
+		h0 += (aeadLoadLe32(block + 0)) & 0x3ffffff;
+		h1 += (aeadLoadLe32(block + 3) >> 2) & 0x3ffffff;
+		h2 += (aeadLoadLe32(block + 6) >> 4) & 0x3ffffff;
+		h3 += (aeadLoadLe32(block + 9) >> 6) & 0x3ffffff;
+		h4 += (aeadLoadLe32(block + 12) >> 8) | (1UL << 24);
+
+		d0 = (uint64_t)h0 * r0 + (uint64_t)h1 * s4 + (uint64_t)h2 * s3 + (uint64_t)h3 * s2 + (uint64_t)h4 * s1;
+		d1 = (uint64_t)h0 * r1 + (uint64_t)h1 * r0 + (uint64_t)h2 * s4 + (uint64_t)h3 * s3 + (uint64_t)h4 * s2;
+		d2 = (uint64_t)h0 * r2 + (uint64_t)h1 * r1 + (uint64_t)h2 * r0 + (uint64_t)h3 * s4 + (uint64_t)h4 * s3;
+		d3 = (uint64_t)h0 * r3 + (uint64_t)h1 * r2 + (uint64_t)h2 * r1 + (uint64_t)h3 * r0 + (uint64_t)h4 * s4;
+		d4 = (uint64_t)h0 * r4 + (uint64_t)h1 * r3 + (uint64_t)h2 * r2 + (uint64_t)h3 * r1 + (uint64_t)h4 * r0;
+
+		carry = (uint32_t)(d0 >> 26); h0 = (uint32_t)d0 & 0x3ffffff;
+		d1 += carry; carry = (uint32_t)(d1 >> 26); h1 = (uint32_t)d1 & 0x3ffffff;
+		d2 += carry; carry = (uint32_t)(d2 >> 26); h2 = (uint32_t)d2 & 0x3ffffff;
+		d3 += carry; carry = (uint32_t)(d3 >> 26); h3 = (uint32_t)d3 & 0x3ffffff;
+		d4 += carry; carry = (uint32_t)(d4 >> 26); h4 = (uint32_t)d4 & 0x3ffffff;
+		h0 += carry * 5; carry = h0 >> 26; h0 &= 0x3ffffff;
+		h1 += carry;
+
+		data += 16;
+		length -= 16;
+	}
+
+	state->h[0] = h0; state->h[1] = h1; state->h[2] = h2; state->h[3] = h3; state->h[4] = h4;
+}
+
+///-----------------------------------------------------------
+/// \brief Final reduction, adds the pad and outputs the tag
+///
+/// @param1 poly1305State_t *state - running MAC
+/// @param2 uint8_t tag[16] - output
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void poly1305Finish(poly1305State_t *state, uint8_t tag[AEAD_TAG_SIZE])
+{
+	uint32_t h0 = state->h[0], h1 = state->h[1], h2 = state->h[2], h3 = state->h[3], h4 = state->h[4];
+	uint32_t g0, g1, g2, g3, g4, carry, mask;
+	uint64_t f;
+
+	/// Fully carry h
+	carry = h1 >> 26; h1 &= 0x3ffffff;
+	h2 += carry; carry = h2 >> 26; h2 &= 0x3ffffff;
+	h3 += carry; carry = h3 >> 26; h3 &= 0x3ffffff;
+	h4 += carry; carry = h4 >> 26; h4 &= 0x3ffffff;
+	h0 += carry * 5; carry = h0 >> 26; h0 &= 0x3ffffff;
+	h1 += carry;
+
+	/// g = h - p, select h or g without branches
+	g0 = h0 + 5; carry = g0 >> 26; g0 &= 0x3ffffff;
+	g1 = h1 + carry; carry = g1 >> 26; g1 &= 0x3ffffff;
+	g2 = h2 + carry; carry = g2 >> 26; g2 &= 0x3ffffff;
+	g3 = h3 + carry; carry = g3 >> 26; g3 &= 0x3ffffff;
+	g4 = h4 + carry - (1UL << 26);
+	mask = (g4 >> 31) - 1;
+	g0 &= mask; g1 &= mask; g2 &= mask; g3 &= mask; g4 &= mask;
+	mask = ~mask;
+	h0 = (h0 & mask) | g0;
+	h1 = (h1 & mask) | g1;
+	h2 = (h2 & mask) | g2;
+	h3 = (h3 & mask) | g3;
+	h4 = (h4 & mask) | g4;
+
+	/// h = (h + pad) mod 2^128
+	h0 = h0 | (h1 << 26);
+	h1 = (h1 >> 6) | (h2 << 20);
+	h2 = (h2 >> 12) | (h3 << 14);
+	h3 = (h3 >> 18) | (h4 << 8);
+	f = (uint64_t)h0 + state->pad[0]; h0 = (uint32_t)f;
+	f = (uint64_t)h1 + state->pad[1] + (f >> 32); h1 = (uint32_t)f;
+	f = (uint64_t)h2 + state->pad[2] + (f >> 32); h2 = (uint32_t)f;
+	f = (uint64_t)h3 + state->pad[3] + (f >> 32); h3 = (uint32_t)f;
+
+	aeadStoreLe32(tag + 0, h0);
+	aeadStoreLe32(tag + 4, h1);
+	aeadStoreLe32(tag + 8, h2);
+	aeadStoreLe32(tag + 12, h3);
+}
+
+///-----------------------------------------------------------
+/// \brief Poly1305 tag of the RFC 8439 AEAD construction
+///        over aad and ciphertext
+///-----------------------------------------------------------
+static void chachaPolyTag(const uint8_t polyKey[32], const uint8_t *aad, size_t aadLength,
+	const uint8_t *ciphertext, size_t length, uint8_t tag[AEAD_TAG_SIZE])
+{
+	poly1305State_t state;
+	uint8_t lengths[16];
+
+	poly1305Init(&state, polyKey);
+	poly1305UpdatePadded(&state, aad, aadLength);
+	poly1305UpdatePadded(&state, ciphertext, length);
+	aeadStoreLe64(lengths, (uint64_t)aadLength);
+	aeadStoreLe64(lengths + 8, (uint64_t)length);
+	poly1305UpdatePadded(&state, lengths, sizeof(lengths));
+	poly1305Finish(&state, tag);
+}
+
+///-----------------------------------------------------------
+/// \brief Derives the one-time Poly1305 key (block 0) and
+///        leaves the cipher positioned at block 1
+///-----------------------------------------------------------
+static void chachaPolySetup(const aeadContext_t *context, const uint8_t nonce[AEAD_NONCE_SIZE],
+	chacha20Context_t *cipher, uint8_t polyKey[32])
+{
+	uint8_t block0[CHACHA20_BLOCK_SIZE];
+
+	chacha20Init(cipher, context->key, nonce, 0);
+	chacha20Keystream(cipher, block0, 1);
+	memcpy(polyKey, block0, 32);
+	memset(block0, 0, sizeof(block0));
+}
+
+///===========================================================
+/// Public interface
+///===========================================================
+
+///-----------------------------------------------------------
+/// \brief Fastest cipher available on this host
+///
+/// @param N/A
+///
+/// @return aeadCipher_t - preferred cipher
+///-----------------------------------------------------------
+aeadCipher_t aeadPreferredCipher(void)
+{
+	const cpuFeatures_t *features = cpuGetFeatures();
+
+	if (features->hasAesNi && features->hasPclmul && features->hasSsse3)
+	{
+		return AEAD_CIPHER_AES256_GCM;
+	}
+	return AEAD_CIPHER_CHACHA20_POLY1305;
+}
+
+///-----------------------------------------------------------
+/// \brief Printable cipher name
+///
+/// @param1 aeadCipher_t cipher - cipher
+///
+/// @return const char * - name
+///-----------------------------------------------------------
+const char *aeadCipherName(aeadCipher_t cipher)
+{
+	switch (cipher)
+	{
+		case AEAD_CIPHER_AES256_GCM:
+			return "AES-256-GCM";
+		case AEAD_CIPHER_CHACHA20_POLY1305:
+			return "ChaCha20-Poly1305";
+		default:
+			return "none";
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Keys a context
+///
+/// @param1 aeadContext_t *context - context to initialize
+/// @param2 aeadCipher_t cipher - cipher
+/// @param3 const uint8_t key[32] - key
+///
+/// @return int - 1 on success, 0 if the cipher can't run here
+///-----------------------------------------------------------
+int aeadInit(aeadContext_t *context, aeadCipher_t cipher, const uint8_t key[AEAD_KEY_SIZE])
+{
+	memset(context, 0, sizeof(*context));
+	if ((cipher == AEAD_CIPHER_AES256_GCM) && (aeadPreferredCipher() != AEAD_CIPHER_AES256_GCM))
+	{
+		/// No software AES, the whole point is to stay off the logger's critical path
+		return 0;
+	}
+	if ((cipher != AEAD_CIPHER_AES256_GCM) && (cipher != AEAD_CIPHER_CHACHA20_POLY1305))
+	{
+		return 0;
+	}
+
+	context->cipher = cipher;
+	memcpy(context->key, key, AEAD_KEY_SIZE);
+	if (cipher == AEAD_CIPHER_AES256_GCM)
+	{
+		aesGcmInit(context);
+	}
+	return 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Encrypts and authenticates
+///
+/// @param1 const aeadContext_t *context - keyed context
+/// @param2 const uint8_t nonce[12] - unique per key and message
+/// @param3 const uint8_t *aad - additional authenticated data
+/// @param4 size_t aadLength - aad length
+/// @param5 const uint8_t *input - plaintext
+/// @param6 size_t length - plaintext length
+/// @param7 uint8_t *output - ciphertext (same length)
+/// @param8 uint8_t tag[16] - authentication tag
+///
+/// @return N/A
+///-----------------------------------------------------------
+void aeadSeal(const aeadContext_t *context, const uint8_t nonce[AEAD_NONCE_SIZE],
+	const uint8_t *aad, size_t aadLength, const uint8_t *input, size_t length,
+	uint8_t *output, uint8_t tag[AEAD_TAG_SIZE])
+{
+	if (context->cipher == AEAD_CIPHER_AES256_GCM)
+	{
+		aesGcmCrypt(context, nonce, aad, aadLength, input, length, output, 1, tag);
+	}
+	else
+	{
+		chacha20Context_t cipher;
+		uint8_t polyKey[32];
+		chachaPolySetup(context, nonce, &cipher, polyKey);
+		chacha20Xor(&cipher, output, input, length);
+		chachaPolyTag(polyKey, aad, aadLength, output, length, tag);
+		memset(polyKey, 0, sizeof(polyKey));
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Authenticates and decrypts
+///
+/// @param1 const aeadContext_t *context - keyed context
+/// @param2 const uint8_t nonce[12] - nonce used to seal
+/// @param3 const uint8_t *aad - additional authenticated data
+/// @param4 size_t aadLength - aad length
+/// @param5 const uint8_t *input - ciphertext
+/// @param6 size_t length - ciphertext length
+/// @param7 const uint8_t tag[16] - tag to check
+/// @param8 uint8_t *output - plaintext (same length)
+///
+/// @return int - 1 if authentic, 0 otherwise
+///-----------------------------------------------------------
+int aeadOpen(const aeadContext_t *context, const uint8_t nonce[AEAD_NONCE_SIZE],
+	const uint8_t *aad, size_t aadLength, const uint8_t *input, size_t length,
+	const uint8_t tag[AEAD_TAG_SIZE], uint8_t *output)
+{
+	uint8_t expectedTag[AEAD_TAG_SIZE];
+
+	if (context->cipher == AEAD_CIPHER_AES256_GCM)
+	{
+		aesGcmCrypt(context, nonce, aad, aadLength, input, length, output, 0, expectedTag);
+	}
+	else if (context->cipher == AEAD_CIPHER_CHACHA20_POLY1305)
+	{
+		chacha20Context_t cipher;
+		uint8_t polyKey[32];
+		chachaPolySetup(context, nonce, &cipher, polyKey);
+		/// Authenticate before decrypting
+		chachaPolyTag(polyKey, aad, aadLength, input, length, expectedTag);
+		memset(polyKey, 0, sizeof(polyKey));
+		if (!aeadTagsEqual(expectedTag, tag))
+		{
+			return 0;
+		}
+		chacha20Xor(&cipher, output, input, length);
+		return 1;
+	}
+	else
+	{
+		return 0;
+	}
+
+	if (!aeadTagsEqual(expectedTag, tag))
+	{
+		memset(output, 0, length);
+		return 0;
+	}
+	return 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Wipes the key material
+///
+/// @param1 aeadContext_t *context - context to clear
+///
+/// @return N/A
+///-----------------------------------------------------------
+void aeadClear(aeadContext_t *context)
+{
+	volatile uint8_t *bytes = (volatile uint8_t *)context;
+
+	for (size_t i = 0; i < sizeof(*context); i++)
+	{
+		bytes[i] = 0;
+	}
+}
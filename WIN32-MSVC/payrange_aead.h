@@ -0,0 +1,57 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_aead.h
+///-----------------------------------------------------------------------------
+///
+/// \brief Authenticated encryption: AES-256-GCM (AES-NI + PCLMULQDQ) with a
+///        portable ChaCha20-Poly1305 fallback
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_AEAD_H
+#define PAYRANGE_AEAD_H
+
+/// Standard includes
+#include <stddef.h>
+#include <stdint.h>
+
+#define AEAD_KEY_SIZE                   ( 32 )
+#define AEAD_NONCE_SIZE                 ( 12 )
+#define AEAD_TAG_SIZE                   ( 16 )
+
+/// Cipher identifiers, as stored in encrypted files
+typedef enum
+{
+	AEAD_CIPHER_NONE = 0,
+	AEAD_CIPHER_AES256_GCM = 1,
+	AEAD_CIPHER_CHACHA20_POLY1305 = 2
+}aeadCipher_t;
+
+/// Keyed context
+typedef struct
+{
+	aeadCipher_t cipher;
+	uint8_t      key[AEAD_KEY_SIZE];
+	/// AES-256 round keys and the GHASH key (byte reflected), AES-GCM only
+	uint8_t      roundKeys[15][16];
+	uint8_t      hashKey[16];
+}aeadContext_t;
+
+/// Fastest cipher on this host: AES-256-GCM with AES-NI, ChaCha20-Poly1305 otherwise
+aeadCipher_t aeadPreferredCipher(void);
+/// Printable cipher name
+const char *aeadCipherName(aeadCipher_t cipher);
+/// Keys a context; returns 0 when the cipher can't run on this host
+int aeadInit(aeadContext_t *context, aeadCipher_t cipher, const uint8_t key[AEAD_KEY_SIZE]);
+/// Encrypts length bytes and computes the tag over aad and ciphertext
+void aeadSeal(const aeadContext_t *context, const uint8_t nonce[AEAD_NONCE_SIZE],
+	const uint8_t *aad, size_t aadLength, const uint8_t *input, size_t length,
+	uint8_t *output, uint8_t tag[AEAD_TAG_SIZE]);
+/// Checks the tag and decrypts, in place if output is input; returns 1 if
+/// authentic, 0 otherwise (output undefined)
+int aeadOpen(const aeadContext_t *context, const uint8_t nonce[AEAD_NONCE_SIZE],
+	const uint8_t *aad, size_t aadLength, const uint8_t *input, size_t length,
+	const uint8_t tag[AEAD_TAG_SIZE], uint8_t *output);
+/// Wipes the key material
+void aeadClear(aeadContext_t *context);
+
+#endif /// PAYRANGE_AEAD_H
@@ -0,0 +1,222 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_ahistory.c
+///-----------------------------------------------------------------------------
+///
+/// \brief A history ring
+///
+/// Task A writes each new value into the next slot of a small ring and then
+/// publishes the new count. Every slot has its own sequence lock, so a
+/// reader never blocks Task A and never returns a half written slot; a slot
+/// that was reused while it was being looked up is detected through the
+/// push number stored with it.
+///
+/// A values are pushed every configured Task A period, so the slot current
+/// at a given tick is found by stepping back (newest tick - tick) / period
+/// slots from the newest one, then correcting by a slot or two for jitter,
+/// pauses and period changes: constant time however long the ring is.
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+
+/// Kernel includes
+#include <FreeRTOS.h>
+
+#include "payrange_atomic.h"
+#include "payrange_ahistory.h"
+#include "payrange_config.h"
+
+/// Slot index of a push number
+#define AHISTORY_MASK                   ( AHISTORY_LENGTH - 1 )
+/// Lookups that keep colliding with Task A give up after this many tries
+#define AHISTORY_MAX_ATTEMPTS           ( 4 )
+/// Wrap safe "tick a is not later than tick b"
+#define AHISTORY_NOT_AFTER(a, b)        ( (TickType_t)((b) - (a)) <= (portMAX_DELAY >> 1) )
+
+/// One recorded A
+typedef struct
+{
+	seqlock_t  lock;
+	/// Push number, tells a reused slot apart
+	uint32_t   number;
+	TickType_t tick;
+	int64_t    value;
+}aHistoryEntry_t;
+
+static aHistoryEntry_t aHistoryRing[AHISTORY_LENGTH];
+/// Values pushed so far; the newest is number aHistoryCount - 1
+static volatile uint32_t aHistoryCount = 0;
+
+///-----------------------------------------------------------
+/// \brief Records a new A value. Only Task A calls this.
+///
+/// @param1 int64_t value - A
+/// @param2 TickType_t tick - tick at which it was shown
+///
+/// @return N/A
+///-----------------------------------------------------------
+void aHistoryPush(int64_t value, TickType_t tick)
+{
+	const uint32_t number = aHistoryCount;
+	aHistoryEntry_t *entry = &aHistoryRing[number & AHISTORY_MASK];
+
+	seqlockWriteBegin(&entry->lock);
+	entry->number = number;
+	entry->tick = tick;
+	entry->value = value;
+	seqlockWriteEnd(&entry->lock);
+	/// Readers that see the new count see the whole slot
+	PAYRANGE_COMPILER_BARRIER();
+	aHistoryCount = number + 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Copies one slot
+///
+/// @param1 uint32_t number - push number wanted
+/// @param2 aHistoryEntry_t *copy - output
+///
+/// @return int - 0 if the slot already holds a newer value
+///-----------------------------------------------------------
+static int aHistoryRead(uint32_t number, aHistoryEntry_t *copy)
+{
+	const aHistoryEntry_t *entry = &aHistoryRing[number & AHISTORY_MASK];
+	uint32_t sequence;
+
+	do
+	{
+		sequence = seqlockReadBegin(&entry->lock);
+		copy->number = entry->number;
+		copy->tick = entry->tick;
+		copy->value = entry->value;
+	} while (seqlockReadRetry(&entry->lock, sequence));
+	return (copy->number == number);
+}
+
+///-----------------------------------------------------------
+/// \brief Finds the A that was current at a tick
+///
+/// @param1 TickType_t tick - tick of the event
+/// @param2 int64_t *value - output A
+/// @param3 TickType_t *generatedAt - output tick of A, or NULL
+///
+/// @return int - 1 if found
+///-----------------------------------------------------------
+int aHistoryLookup(TickType_t tick, int64_t *value, TickType_t *generatedAt)
+{
+	payrangeConfig_t config;
+	TickType_t xPeriod;
+
+	/// The period of the newest A, older ones may have had another
+	configGet(&config);
+	xPeriod = config.taskAPeriodMs / portTICK_PERIOD_MS;
+	if (xPeriod == 0)
+	{
+		xPeriod = 1;
+	}
+
+	for (int attempt = 0; attempt < AHISTORY_MAX_ATTEMPTS; attempt++)
+	{
+		aHistoryEntry_t entry, next;
+		uint32_t count, newest, oldest, number, back;
+		int torn = 0;
+
+		count = aHistoryCount;
+		PAYRANGE_COMPILER_BARRIER();
+		if (count == 0)
+		{
+			return 0;
+		}
+		newest = count - 1;
+		oldest = (count > AHISTORY_LENGTH) ? (count - AHISTORY_LENGTH) : 0;
+		if (!aHistoryRead(newest, &entry))
+		{
+			continue;
+		}
+
+		/// Common case: the event is after the newest A
+		number = newest;
+		if (!AHISTORY_NOT_AFTER(entry.tick, tick))
+		{
+			/// Guess the slot from the period, then step to the right one
+			back = (uint32_t)((TickType_t)(entry.tick - tick) / xPeriod) + 1;
+			number = ((newest - oldest) < back) ? oldest : (newest - back);
+			if (!aHistoryRead(number, &entry))
+			{
+				continue;
+			}
+			while (!AHISTORY_NOT_AFTER(entry.tick, tick))
+			{
+				if (number == oldest)
+				{
+					/// Older than anything kept
+					return 0;
+				}
+				number--;
+				if (!aHistoryRead(number, &entry))
+				{
+					torn = 1;
+					break;
+				}
+			}
+			while (!torn && (number < newest))
+			{
+				if (!aHistoryRead(number + 1, &next))
+				{
+					torn = 1;
+				}
+				else if (AHISTORY_NOT_AFTER(next.tick, tick))
+				{
+					number++;
+					entry = next;
+				}
+				else
+				{
+					break;
+				}
+			}
+			if (torn)
+			{
+				continue;
+			}
+		}
+
+		*value = entry.value;
+		if (generatedAt != NULL)
+		{
+			*generatedAt = entry.tick;
+		}
+		return 1;
+	}
+	return 0;
+}
+
+///-----------------------------------------------------------
+/// \brief Returns the newest A
+///
+/// @param1 int64_t *value - output A
+/// @param2 TickType_t *generatedAt - output tick of A, or NULL
+///
+/// @return int - 1 if a value was recorded
+///-----------------------------------------------------------
+int aHistoryLatest(int64_t *value, TickType_t *generatedAt)
+{
+	aHistoryEntry_t entry;
+	uint32_t count;
+
+	do
+	{
+		count = aHistoryCount;
+		PAYRANGE_COMPILER_BARRIER();
+		if (count == 0)
+		{
+			return 0;
+		}
+	} while (!aHistoryRead(count - 1, &entry));
+
+	*value = entry.value;
+	if (generatedAt != NULL)
+	{
+		*generatedAt = entry.tick;
+	}
+	return 1;
+}
@@ -0,0 +1,28 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_ahistory.h
+///-----------------------------------------------------------------------------
+///
+/// \brief A history: the last AHISTORY_LENGTH A values with the tick at
+///        which each was shown, so a capture resolves to the A that was on
+///        screen when the key was pressed
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_AHISTORY_H
+#define PAYRANGE_AHISTORY_H
+
+#include "payrange.h"
+
+/// A history configurable defines
+/// Values kept, a power of two; 16 covers 4 s at TASK_A_RUNTIME_IN_MS
+#define AHISTORY_LENGTH                 ( 16 )
+
+/// Records a new A value, shown at tick. Task A is the only writer.
+void aHistoryPush(int64_t value, TickType_t tick);
+/// Finds the A that was current at tick. Returns 0 if tick is older than
+/// the history (or nothing was recorded yet); generatedAt may be NULL.
+int aHistoryLookup(TickType_t tick, int64_t *value, TickType_t *generatedAt);
+/// Returns the newest A; 0 if nothing was recorded yet
+int aHistoryLatest(int64_t *value, TickType_t *generatedAt);
+
+#endif /// PAYRANGE_AHISTORY_H
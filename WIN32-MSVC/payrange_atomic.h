@@ -0,0 +1,96 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_atomic.h
+///-----------------------------------------------------------------------------
+///
+/// \brief Barriers and a sequence lock for data shared between tasks without
+///        a critical section
+///
+/// Only x86/x64 hosts are supported. Their stores are not reordered with
+/// other stores and loads not with other loads, so a compiler barrier is
+/// enough to order them; the full barrier is only needed to order a store
+/// before a later load.
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_ATOMIC_H
+#define PAYRANGE_ATOMIC_H
+
+/// Standard includes
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define PAYRANGE_INLINE                 static __inline
+/// Keeps the compiler from moving memory accesses across it
+#define PAYRANGE_COMPILER_BARRIER()     _ReadWriteBarrier()
+/// Orders every earlier memory access before every later one
+#define PAYRANGE_MEMORY_BARRIER()       _mm_mfence()
+#else
+#define PAYRANGE_INLINE                 static inline
+#define PAYRANGE_COMPILER_BARRIER()     __asm__ __volatile__("" ::: "memory")
+#define PAYRANGE_MEMORY_BARRIER()       __sync_synchronize()
+#endif
+
+/// Sequence lock: one writer, any number of readers that never block it.
+/// The sequence is odd while a write is in progress; a reader that saw it
+/// odd, or saw it change during its copy, copies again.
+typedef struct
+{
+	volatile uint32_t sequence;
+}seqlock_t;
+
+///-----------------------------------------------------------
+/// \brief Starts a write, readers retry until it ends
+///
+/// @param1 seqlock_t *lock - lock
+///
+/// @return N/A
+///-----------------------------------------------------------
+PAYRANGE_INLINE void seqlockWriteBegin(seqlock_t *lock)
+{
+	lock->sequence++;
+	PAYRANGE_COMPILER_BARRIER();
+}
+
+///-----------------------------------------------------------
+/// \brief Ends a write
+///
+/// @param1 seqlock_t *lock - lock
+///
+/// @return N/A
+///-----------------------------------------------------------
+PAYRANGE_INLINE void seqlockWriteEnd(seqlock_t *lock)
+{
+	PAYRANGE_COMPILER_BARRIER();
+	lock->sequence++;
+}
+
+///-----------------------------------------------------------
+/// \brief Starts a read
+///
+/// @param1 const seqlock_t *lock - lock
+///
+/// @return uint32_t - sequence to hand to seqlockReadRetry()
+///-----------------------------------------------------------
+PAYRANGE_INLINE uint32_t seqlockReadBegin(const seqlock_t *lock)
+{
+	const uint32_t sequence = lock->sequence;
+	PAYRANGE_COMPILER_BARRIER();
+	return sequence;
+}
+
+///-----------------------------------------------------------
+/// \brief Ends a read
+///
+/// @param1 const seqlock_t *lock - lock
+/// @param2 uint32_t sequence - value from seqlockReadBegin()
+///
+/// @return int - 1 if the copy may be torn and must be redone
+///-----------------------------------------------------------
+PAYRANGE_INLINE int seqlockReadRetry(const seqlock_t *lock, uint32_t sequence)
+{
+	PAYRANGE_COMPILER_BARRIER();
+	return (sequence & 1) || (lock->sequence != sequence);
+}
+
+#endif /// PAYRANGE_ATOMIC_H
@@ -0,0 +1,307 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_cdc.c
+///-----------------------------------------------------------------------------
+///
+/// \brief Change data capture of the B list and List F
+///
+/// Task B and the E writer publish each slot change with one interlocked
+/// add, which gives the event its offset and ring entry, and a copy under
+/// the entry's sequence lock; neither ever waits for a consumer. Consumers
+/// keep their own offset: an entry holding that offset is copied, one with
+/// an older offset has not been written yet and ends the batch, and one with
+/// a newer offset was overwritten, so the consumer skips to the oldest event
+/// still in the ring and is told how many it lost. Saving the offset and
+/// reading again from it resumes a consumer exactly where it stopped.
+///
+/// The next offset lives in the state file, so a restart does not hand out
+/// offsets a consumer has already seen. The ring itself is not saved: the
+/// events of earlier runs count as lost to a consumer that had not read them.
+///
+/// Two producers can only collide on an entry if one of them is stalled in
+/// the middle of a copy for a whole lap of the ring.
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+
+/// Standard includes
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+/// Kernel includes
+#include <FreeRTOS.h>
+
+#include "payrange_cdc.h"
+#include "payrange_atomic.h"
+#include "payrange_time.h"
+
+/// Ring entry of an offset
+#define CDC_RING_MASK                   ( CDC_RING_LENGTH - 1 )
+
+/// One ring entry
+typedef struct
+{
+	seqlock_t  lock;
+	/// Offset of the event plus one, 0 until the entry is first written
+	uint64_t   published;
+	cdcEvent_t event;
+}cdcEntry_t;
+
+static cdcEntry_t cdcRing[CDC_RING_LENGTH];
+/// Offsets handed out so far; in RAM until cdcAttachState() moves it into
+/// the persistent state file
+static volatile LONGLONG cdcLocalHead = 0;
+static volatile LONGLONG *cdcHead = &cdcLocalHead;
+/// First offset of this run, the older ones were not kept
+static uint64_t cdcFirstOffset = 0;
+/// Next event for the console (M key)
+static uint64_t cdcConsoleOffset = 0;
+
+///-----------------------------------------------------------
+/// \brief Continues the offsets of the previous run. Called
+///        once at start-up, before any event is published.
+///
+/// @param1 volatile int64_t *nextOffset - next offset in the
+///         state file, 0 on a cold start
+///
+/// @return N/A
+///-----------------------------------------------------------
+void cdcAttachState(volatile int64_t *nextOffset)
+{
+	configASSERT(cdcLocalHead == 0);
+	if (*nextOffset < 0)
+	{
+		/// Not written by this code, start over
+		*nextOffset = 0;
+	}
+	cdcHead = (volatile LONGLONG *)nextOffset;
+	cdcFirstOffset = (uint64_t)*nextOffset;
+	/// The console has seen nothing of this run yet, and nothing older is left
+	cdcConsoleOffset = cdcFirstOffset;
+}
+
+///-----------------------------------------------------------
+/// \brief Publishes one slot change
+///
+/// @param1 uint8_t list - CDC_LIST_B or CDC_LIST_F
+/// @param2 uint32_t slot - slot
+/// @param3 const void *oldValue - old value, NULL if empty
+/// @param4 const void *newValue - new value, NULL if empty
+/// @param5 size_t size - value size
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void cdcEmit(uint8_t list, uint32_t slot, const void *oldValue, const void *newValue, size_t size)
+{
+	const uint64_t offset = (uint64_t)InterlockedExchangeAdd64(cdcHead, 1);
+	cdcEntry_t *entry = &cdcRing[offset & CDC_RING_MASK];
+
+	seqlockWriteBegin(&entry->lock);
+	entry->published = offset + 1;
+	memset(&entry->event, 0, sizeof(entry->event));
+	entry->event.offset = offset;
+	entry->event.tick = timeNowTick64();
+	entry->event.list = list;
+	entry->event.slot = (uint16_t)slot;
+	if (oldValue != NULL)
+	{
+		entry->event.flags |= CDC_OLD_PRESENT;
+		memcpy(&entry->event.oldValue, oldValue, size);
+	}
+	if (newValue != NULL)
+	{
+		entry->event.flags |= CDC_NEW_PRESENT;
+		memcpy(&entry->event.newValue, newValue, size);
+	}
+	seqlockWriteEnd(&entry->lock);
+}
+
+///-----------------------------------------------------------
+/// \brief Publishes a B slot change. Task B only.
+///
+/// @param1 uint32_t slot - B list slot
+/// @param2 const taskBStructure_t *oldValue - NULL if it was empty
+/// @param3 const taskBStructure_t *newValue - NULL if it is emptied
+///
+/// @return N/A
+///-----------------------------------------------------------
+void cdcEmitB(uint32_t slot, const taskBStructure_t *oldValue, const taskBStructure_t *newValue)
+{
+	cdcEmit(CDC_LIST_B, slot, oldValue, newValue, sizeof(taskBStructure_t));
+}
+
+///-----------------------------------------------------------
+/// \brief Publishes a List F slot change. E writer only.
+///
+/// @param1 uint32_t slot - List F slot
+/// @param2 const valueE_t *oldValue - NULL if it was empty
+/// @param3 const valueE_t *newValue - NULL if it is dropped
+///
+/// @return N/A
+///-----------------------------------------------------------
+void cdcEmitF(uint32_t slot, const valueE_t *oldValue, const valueE_t *newValue)
+{
+	cdcEmit(CDC_LIST_F, slot, oldValue, newValue, sizeof(valueE_t));
+}
+
+///-----------------------------------------------------------
+/// \brief Offset the next event will get
+///
+/// @param N/A
+///
+/// @return uint64_t - offset
+///-----------------------------------------------------------
+uint64_t cdcNextOffset(void)
+{
+	/// A 64-bit read that cannot tear on x86
+	return (uint64_t)InterlockedCompareExchange64(cdcHead, 0, 0);
+}
+
+///-----------------------------------------------------------
+/// \brief Offset of the oldest event still in the ring
+///
+/// @param N/A
+///
+/// @return uint64_t - offset
+///-----------------------------------------------------------
+uint64_t cdcOldestOffset(void)
+{
+	const uint64_t next = cdcNextOffset();
+	const uint64_t oldest = (next > CDC_RING_LENGTH) ? (next - CDC_RING_LENGTH) : 0;
+
+	return (oldest > cdcFirstOffset) ? oldest : cdcFirstOffset;
+}
+
+///-----------------------------------------------------------
+/// \brief Copies a batch of events from an offset on
+///
+/// @param1 uint64_t *offset - in: first event wanted, out: next one
+/// @param2 cdcEvent_t *events - output
+/// @param3 int maxEvents - capacity of events
+/// @param4 uint64_t *lost - output, events overwritten before read
+///
+/// @return int - events copied
+///-----------------------------------------------------------
+int cdcRead(uint64_t *offset, cdcEvent_t *events, int maxEvents, uint64_t *lost)
+{
+	int count = 0;
+
+	*lost = 0;
+	while (count < maxEvents)
+	{
+		const cdcEntry_t *entry = &cdcRing[*offset & CDC_RING_MASK];
+		const uint64_t oldest = cdcOldestOffset();
+		uint32_t sequence;
+		uint64_t stored;
+
+		if (*offset < oldest)
+		{
+			*lost += oldest - *offset;
+			*offset = oldest;
+			continue;
+		}
+		do
+		{
+			sequence = seqlockReadBegin(&entry->lock);
+			events[count] = entry->event;
+			stored = entry->published;
+		} while (seqlockReadRetry(&entry->lock, sequence));
+
+		if (stored != *offset + 1)
+		{
+			/// Not written yet; a newer offset means it was overwritten
+			/// and the next pass skips to the oldest one
+			if (stored < *offset + 1)
+			{
+				break;
+			}
+			continue;
+		}
+		(*offset)++;
+		count++;
+	}
+	return count;
+}
+
+///-----------------------------------------------------------
+/// \brief Encodes an event: the header in host byte order,
+///        then only the values present, each at its list's
+///        value size
+///
+/// @param1 const cdcEvent_t *event - event
+/// @param2 uint8_t *buffer - output, CDC_MAX_ENCODED_BYTES
+///
+/// @return size_t - bytes written
+///-----------------------------------------------------------
+size_t cdcEncode(const cdcEvent_t *event, uint8_t *buffer)
+{
+	const size_t size = (event->list == CDC_LIST_B) ? sizeof(taskBStructure_t) : sizeof(valueE_t);
+	size_t length = 0;
+
+	memcpy(buffer + length, &event->offset, sizeof(event->offset));
+	length += sizeof(event->offset);
+	memcpy(buffer + length, &event->tick, sizeof(event->tick));
+	length += sizeof(event->tick);
+	buffer[length++] = event->list;
+	buffer[length++] = event->flags;
+	memcpy(buffer + length, &event->slot, sizeof(event->slot));
+	length += sizeof(event->slot);
+	if (event->flags & CDC_OLD_PRESENT)
+	{
+		memcpy(buffer + length, &event->oldValue, size);
+		length += size;
+	}
+	if (event->flags & CDC_NEW_PRESENT)
+	{
+		memcpy(buffer + length, &event->newValue, size);
+		length += size;
+	}
+	return length;
+}
+
+///-----------------------------------------------------------
+/// \brief Prints the events the console has not seen yet, up
+///        to CDC_CONSOLE_BATCH of them
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+void cdcPrintConsole(void)
+{
+	static cdcEvent_t events[CDC_CONSOLE_BATCH];
+	static uint8_t encoded[CDC_MAX_ENCODED_BYTES];
+	size_t bytes = 0;
+	uint64_t lost;
+	int count;
+
+	count = cdcRead(&cdcConsoleOffset, events, CDC_CONSOLE_BATCH, &lost);
+	if (lost > 0)
+	{
+		printf("CDC: %" PRIu64 " events were overwritten before the console read them\n", lost);
+	}
+	for (int i = 0; i < count; i++)
+	{
+		const cdcEvent_t *event = &events[i];
+		const char *oldText = "(empty)";
+		const char *newText = "(empty)";
+
+		if (event->list == CDC_LIST_B)
+		{
+			oldText = (event->flags & CDC_OLD_PRESENT) ? event->oldValue.b.stringPlacer : oldText;
+			newText = (event->flags & CDC_NEW_PRESENT) ? event->newValue.b.stringPlacer : newText;
+			printf("  #%" PRIu64 " tick %" PRIu64 " B[%u]: %s -> %s\n", event->offset, event->tick,
+				(unsigned int)event->slot, oldText, newText);
+		}
+		else
+		{
+			printf("  #%" PRIu64 " tick %" PRIu64 " F[%u]: A %" PRId64 " -> A %" PRId64 " (B %s)\n", event->offset,
+				event->tick, (unsigned int)event->slot, event->oldValue.e.currentValueD.randomNumber,
+				event->newValue.e.currentValueD.randomNumber,
+				(event->flags & CDC_NEW_PRESENT) ? event->newValue.e.randomValueB.stringPlacer : newText);
+		}
+		bytes += cdcEncode(event, encoded);
+	}
+	printf("CDC: %d events (%u bytes encoded), next offset %" PRIu64 ", %" PRIu64 " events in the ring\n", count,
+		(unsigned int)bytes, cdcConsoleOffset, cdcNextOffset() - cdcOldestOffset());
+}
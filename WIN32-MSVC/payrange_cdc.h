@@ -0,0 +1,83 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_cdc.h
+///-----------------------------------------------------------------------------
+///
+/// \brief Change data capture: every B list and List F slot change as an
+///        event in a bounded ring, read in batches from a resumable offset
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_CDC_H
+#define PAYRANGE_CDC_H
+
+/// Standard includes
+#include <stddef.h>
+#include <stdint.h>
+
+/// Kernel includes
+#include <FreeRTOS.h>
+
+#include "payrange.h"
+
+/// Change data capture configurable defines
+/// Events kept, a power of two; a consumer more than this many events
+/// behind loses the oldest ones and is told how many
+#define CDC_RING_LENGTH                 ( 1024 )
+/// Events listed by the console (M key) per press
+#define CDC_CONSOLE_BATCH               ( 16 )
+
+/// Lists an event belongs to
+#define CDC_LIST_B                      ( 0 )
+#define CDC_LIST_F                      ( 1 )
+
+/// Event flags: which of the old and new values the slot had
+#define CDC_OLD_PRESENT                 ( 0x01 )
+#define CDC_NEW_PRESENT                 ( 0x02 )
+
+/// Encoded event: offset, tick, list, flags, slot, then the values present
+#define CDC_HEADER_BYTES                ( 20 )
+#define CDC_MAX_ENCODED_BYTES           ( CDC_HEADER_BYTES + 2 * sizeof(valueE_t) )
+
+/// Value of a B list or List F slot
+typedef union
+{
+	taskBStructure_t b;
+	valueE_t         e;
+}cdcValue_t;
+
+/// One slot change
+typedef struct
+{
+	/// Position in the stream, from 0 on a cold start of the state file
+	uint64_t   offset;
+	/// Extended tick of the change (payrange_time.h)
+	uint64_t   tick;
+	uint8_t    list;
+	uint8_t    flags;
+	uint16_t   slot;
+	/// Zeroed when not present
+	cdcValue_t oldValue;
+	cdcValue_t newValue;
+}cdcEvent_t;
+
+/// Continues the offsets from the state file; events of earlier runs are
+/// not kept, a consumer still behind them is told they were lost
+void cdcAttachState(volatile int64_t *nextOffset);
+/// Task B: publishes a B slot change; NULL for an empty slot
+void cdcEmitB(uint32_t slot, const taskBStructure_t *oldValue, const taskBStructure_t *newValue);
+/// E writer: publishes a List F slot change; NULL for an empty slot
+void cdcEmitF(uint32_t slot, const valueE_t *oldValue, const valueE_t *newValue);
+/// Offset of the oldest event still in the ring
+uint64_t cdcOldestOffset(void);
+/// Offset the next event will get
+uint64_t cdcNextOffset(void);
+/// Copies up to maxEvents events from *offset on and moves *offset past
+/// them; *lost is set to the events that were overwritten before they were
+/// read. Returns the number of events copied.
+int cdcRead(uint64_t *offset, cdcEvent_t *events, int maxEvents, uint64_t *lost);
+/// Encodes an event in at most CDC_MAX_ENCODED_BYTES; returns the size
+size_t cdcEncode(const cdcEvent_t *event, uint8_t *buffer);
+/// Prints the events the console has not seen yet, a batch at a time
+void cdcPrintConsole(void);
+
+#endif /// PAYRANGE_CDC_H
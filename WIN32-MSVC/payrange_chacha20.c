@@ -0,0 +1,302 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_chacha20.c
+///-----------------------------------------------------------------------------
+///
+/// \brief ChaCha20 stream cipher (RFC 8439)
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+
+/// Standard includes
+#include <string.h>
+
+/// Compiler includes
+#include <immintrin.h>
+
+#include "payrange_cpu.h"
+#include "payrange_chacha20.h"
+
+#define ROTL32(x, n)                    ( ((x) << (n)) | ((x) >> (32 - (n))) )
+
+#define CHACHA20_QUARTER_ROUND(a, b, c, d) \
+	a += b; d ^= a; d = ROTL32(d, 16); \
+	c += d; b ^= c; b = ROTL32(b, 12); \
+	a += b; d ^= a; d = ROTL32(d, 8);  \
+	c += d; b ^= c; b = ROTL32(b, 7)
+
+/// Quarter round on vectors holding the same state word of 4 (SSE2) or
+/// 8 (AVX2) independent blocks
+#define CHACHA20_ROTL_SSE2(x, n)        _mm_or_si128(_mm_slli_epi32((x), (n)), _mm_srli_epi32((x), 32 - (n)))
+#define CHACHA20_QUARTER_ROUND_SSE2(a, b, c, d) \
+	a = _mm_add_epi32(a, b); d = CHACHA20_ROTL_SSE2(_mm_xor_si128(d, a), 16); \
+	c = _mm_add_epi32(c, d); b = CHACHA20_ROTL_SSE2(_mm_xor_si128(b, c), 12); \
+	a = _mm_add_epi32(a, b); d = CHACHA20_ROTL_SSE2(_mm_xor_si128(d, a), 8);  \
+	c = _mm_add_epi32(c, d); b = CHACHA20_ROTL_SSE2(_mm_xor_si128(b, c), 7)
+#define CHACHA20_ROTL_AVX2(x, n)        _mm256_or_si256(_mm256_slli_epi32((x), (n)), _mm256_srli_epi32((x), 32 - (n)))
+#define CHACHA20_QUARTER_ROUND_AVX2(a, b, c, d) \
+	a = _mm256_add_epi32(a, b); d = CHACHA20_ROTL_AVX2(_mm256_xor_si256(d, a), 16); \
+	c = _mm256_add_epi32(c, d); b = CHACHA20_ROTL_AVX2(_mm256_xor_si256(b, c), 12); \
+	a = _mm256_add_epi32(a, b); d = CHACHA20_ROTL_AVX2(_mm256_xor_si256(d, a), 8);  \
+	c = _mm256_add_epi32(c, d); b = CHACHA20_ROTL_AVX2(_mm256_xor_si256(b, c), 7)
+
+/// Blocks computed per call by the vector paths
+#define CHACHA20_SSE2_BLOCKS            ( 4 )
+#define CHACHA20_AVX2_BLOCKS            ( 8 )
+
+///-----------------------------------------------------------
+/// \brief Little-endian 32-bit load/store helpers
+///-----------------------------------------------------------
+static uint32_t chacha20LoadLe32(const uint8_t *bytes)
+{
+	return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static void chacha20StoreLe32(uint8_t *bytes, uint32_t value)
+{
+	bytes[0] = (uint8_t)value;
+	bytes[1] = (uint8_t)(value >> 8);
+	bytes[2] = (uint8_t)(value >> 16);
+	bytes[3] = (uint8_t)(value >> 24);
+}
+
+///-----------------------------------------------------------
+/// \brief Sets up the cipher state
+///
+/// @param1 chacha20Context_t *context - state to initialize
+/// @param2 const uint8_t key[32] - key
+/// @param3 const uint8_t nonce[12] - nonce
+/// @param4 uint32_t counter - counter of the first block
+///
+/// @return N/A
+///-----------------------------------------------------------
+void chacha20Init(chacha20Context_t *context, const uint8_t key[CHACHA20_KEY_SIZE],
+	const uint8_t nonce[CHACHA20_NONCE_SIZE], uint32_t counter)
+{
+	/// "expand 32-byte k"
+	context->state[0] = 0x61707865;
+	context->state[1] = 0x3320646e;
+	context->state[2] = 0x79622d32;
+	context->state[3] = 0x6b206574;
+	for (int i = 0; i < 8; i++)
+	{
+		context->state[4 + i] = chacha20LoadLe32(key + 4 * i);
+	}
+	context->state[12] = counter;
+	for (int i = 0; i < 3; i++)
+	{
+		context->state[13 + i] = chacha20LoadLe32(nonce + 4 * i);
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Computes one 64 byte keystream block
+///
+/// @param1 const uint32_t input[16] - cipher state
+/// @param2 uint8_t output[64] - keystream block
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void chacha20Block(const uint32_t input[16], uint8_t output[CHACHA20_BLOCK_SIZE])
+{
+	uint32_t x[16];
+
+	memcpy(x, input, sizeof(x));
+	for (int round = 0; round < 10; round++)
+	{
+		/// Column round
+		CHACHA20_QUARTER_ROUND(x[0], x[4], x[8], x[12]);
+		CHACHA20_QUARTER_ROUND(x[1], x[5], x[9], x[13]);
+		CHACHA20_QUARTER_ROUND(x[2], x[6], x[10], x[14]);
+		CHACHA20_QUARTER_ROUND(x[3], x[7], x[11], x[15]);
+		/// Diagonal round
+		CHACHA20_QUARTER_ROUND(x[0], x[5], x[10], x[15]);
+		CHACHA20_QUARTER_ROUND(x[1], x[6], x[11], x[12]);
+		CHACHA20_QUARTER_ROUND(x[2], x[7], x[8], x[13]);
+		CHACHA20_QUARTER_ROUND(x[3], x[4], x[9], x[14]);
+	}
+	for (int i = 0; i < 16; i++)
+	{
+		chacha20StoreLe32(output + 4 * i, x[i] + input[i]);
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Computes 4 consecutive keystream blocks with SSE2,
+///        one block per 32-bit lane
+///
+/// @param1 const uint32_t input[16] - cipher state of the first block
+/// @param2 uint8_t output[256] - keystream blocks
+///
+/// @return N/A
+///-----------------------------------------------------------
+PAYRANGE_TARGET("sse2")
+static void chacha20Block4Sse2(const uint32_t input[16], uint8_t *output)
+{
+	__m128i x[16], start[16];
+
+	for (int i = 0; i < 16; i++)
+	{
+		start[i] = _mm_set1_epi32((int)input[i]);
+	}
+	start[12] = _mm_add_epi32(start[12], _mm_set_epi32(3, 2, 1, 0));
+	memcpy(x, start, sizeof(x));
+
+	for (int round = 0; round < 10; round++)
+	{
+		CHACHA20_QUARTER_ROUND_SSE2(x[0], x[4], x[8], x[12]);
+		CHACHA20_QUARTER_ROUND_SSE2(x[1], x[5], x[9], x[13]);
+		CHACHA20_QUARTER_ROUND_SSE2(x[2], x[6], x[10], x[14]);
+		CHACHA20_QUARTER_ROUND_SSE2(x[3], x[7], x[11], x[15]);
+		CHACHA20_QUARTER_ROUND_SSE2(x[0], x[5], x[10], x[15]);
+		CHACHA20_QUARTER_ROUND_SSE2(x[1], x[6], x[11], x[12]);
+		CHACHA20_QUARTER_ROUND_SSE2(x[2], x[7], x[8], x[13]);
+		CHACHA20_QUARTER_ROUND_SSE2(x[3], x[4], x[9], x[14]);
+	}
+
+	/// Transpose each group of 4 words so every vector holds 16 bytes of one block
+	for (int group = 0; group < 4; group++)
+	{
+		__m128i a = _mm_add_epi32(x[4 * group], start[4 * group]);
+		__m128i b = _mm_add_epi32(x[4 * group + 1], start[4 * group + 1]);
+		__m128i c = _mm_add_epi32(x[4 * group + 2], start[4 * group + 2]);
+		__m128i d = _mm_add_epi32(x[4 * group + 3], start[4 * group + 3]);
+		__m128i ab0 = _mm_unpacklo_epi32(a, b), ab1 = _mm_unpackhi_epi32(a, b);
+		__m128i cd0 = _mm_unpacklo_epi32(c, d), cd1 = _mm_unpackhi_epi32(c, d);
+		_mm_storeu_si128((__m128i *)(output + 0 * CHACHA20_BLOCK_SIZE + 16 * group), _mm_unpacklo_epi64(ab0, cd0));
+		_mm_storeu_si128((__m128i *)(output + 1 * CHACHA20_BLOCK_SIZE + 16 * group), _mm_unpackhi_epi64(ab0, cd0));
+		_mm_storeu_si128((__m128i *)(output + 2 * CHACHA20_BLOCK_SIZE + 16 * group), _mm_unpacklo_epi64(ab1, cd1));
+		_mm_storeu_si128((__m128i *)(output + 3 * CHACHA20_BLOCK_SIZE + 16 * group), _mm_unpackhi_epi64(ab1, cd1));
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Computes 8 consecutive keystream blocks with AVX2.
+///        Lanes 0-3 and 4-7 sit in the two 128-bit halves, so
+///        the SSE2 transpose yields blocks n and n + 4 at once.
+///
+/// @param1 const uint32_t input[16] - cipher state of the first block
+/// @param2 uint8_t output[512] - keystream blocks
+///
+/// @return N/A
+///-----------------------------------------------------------
+PAYRANGE_TARGET("avx2")
+static void chacha20Block8Avx2(const uint32_t input[16], uint8_t *output)
+{
+	__m256i x[16], start[16];
+
+	for (int i = 0; i < 16; i++)
+	{
+		start[i] = _mm256_set1_epi32((int)input[i]);
+	}
+	start[12] = _mm256_add_epi32(start[12], _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+	memcpy(x, start, sizeof(x));
+
+	for (int round = 0; round < 10; round++)
+	{
+		CHACHA20_QUARTER_ROUND_AVX2(x[0], x[4], x[8], x[12]);
+		CHACHA20_QUARTER_ROUND_AVX2(x[1], x[5], x[9], x[13]);
+		CHACHA20_QUARTER_ROUND_AVX2(x[2], x[6], x[10], x[14]);
+		CHACHA20_QUARTER_ROUND_AVX2(x[3], x[7], x[11], x[15]);
+		CHACHA20_QUARTER_ROUND_AVX2(x[0], x[5], x[10], x[15]);
+		CHACHA20_QUARTER_ROUND_AVX2(x[1], x[6], x[11], x[12]);
+		CHACHA20_QUARTER_ROUND_AVX2(x[2], x[7], x[8], x[13]);
+		CHACHA20_QUARTER_ROUND_AVX2(x[3], x[4], x[9], x[14]);
+	}
+
+	for (int group = 0; group < 4; group++)
+	{
+		__m256i a = _mm256_add_epi32(x[4 * group], start[4 * group]);
+		__m256i b = _mm256_add_epi32(x[4 * group + 1], start[4 * group + 1]);
+		__m256i c = _mm256_add_epi32(x[4 * group + 2], start[4 * group + 2]);
+		__m256i d = _mm256_add_epi32(x[4 * group + 3], start[4 * group + 3]);
+		__m256i ab0 = _mm256_unpacklo_epi32(a, b), ab1 = _mm256_unpackhi_epi32(a, b);
+		__m256i cd0 = _mm256_unpacklo_epi32(c, d), cd1 = _mm256_unpackhi_epi32(c, d);
+		__m256i rows[4];
+		rows[0] = _mm256_unpacklo_epi64(ab0, cd0);
+		rows[1] = _mm256_unpackhi_epi64(ab0, cd0);
+		rows[2] = _mm256_unpacklo_epi64(ab1, cd1);
+		rows[3] = _mm256_unpackhi_epi64(ab1, cd1);
+		for (int lane = 0; lane < 4; lane++)
+		{
+			_mm_storeu_si128((__m128i *)(output + lane * CHACHA20_BLOCK_SIZE + 16 * group),
+				_mm256_castsi256_si128(rows[lane]));
+			_mm_storeu_si128((__m128i *)(output + (lane + 4) * CHACHA20_BLOCK_SIZE + 16 * group),
+				_mm256_extracti128_si256(rows[lane], 1));
+		}
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Writes whole keystream blocks, 8 or 4 at a time on
+///        the vector units while enough are left
+///
+/// @param1 chacha20Context_t *context - cipher state
+/// @param2 uint8_t *output - blocks * 64 bytes
+/// @param3 size_t blocks - number of blocks
+///
+/// @return N/A
+///-----------------------------------------------------------
+void chacha20Keystream(chacha20Context_t *context, uint8_t *output, size_t blocks)
+{
+	if (cpuGetFeatures()->hasAvx2)
+	{
+		while (blocks >= CHACHA20_AVX2_BLOCKS)
+		{
+			chacha20Block8Avx2(context->state, output);
+			context->state[12] += CHACHA20_AVX2_BLOCKS;
+			output += CHACHA20_AVX2_BLOCKS * CHACHA20_BLOCK_SIZE;
+			blocks -= CHACHA20_AVX2_BLOCKS;
+		}
+	}
+	while (blocks >= CHACHA20_SSE2_BLOCKS)
+	{
+		chacha20Block4Sse2(context->state, output);
+		context->state[12] += CHACHA20_SSE2_BLOCKS;
+		output += CHACHA20_SSE2_BLOCKS * CHACHA20_BLOCK_SIZE;
+		blocks -= CHACHA20_SSE2_BLOCKS;
+	}
+	while (blocks--)
+	{
+		chacha20Block(context->state, output);
+		context->state[12]++;
+		output += CHACHA20_BLOCK_SIZE;
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Encrypts/decrypts by XOR with the keystream
+///
+/// @param1 chacha20Context_t *context - cipher state
+/// @param2 uint8_t *output - output (may equal input)
+/// @param3 const uint8_t *input - input
+/// @param4 size_t length - number of bytes
+///
+/// @return N/A
+///-----------------------------------------------------------
+void chacha20Xor(chacha20Context_t *context, uint8_t *output, const uint8_t *input, size_t length)
+{
+	uint8_t keystream[CHACHA20_AVX2_BLOCKS * CHACHA20_BLOCK_SIZE];
+
+	while (length > 0)
+	{
+		size_t blocks = (length + CHACHA20_BLOCK_SIZE - 1) / CHACHA20_BLOCK_SIZE;
+		size_t chunk;
+		if (blocks > CHACHA20_AVX2_BLOCKS)
+		{
+			blocks = CHACHA20_AVX2_BLOCKS;
+		}
+		chacha20Keystream(context, keystream, blocks);
+		chunk = blocks * CHACHA20_BLOCK_SIZE;
+		if (chunk > length)
+		{
+			chunk = length;
+		}
+		for (size_t i = 0; i < chunk; i++)
+		{
+			output[i] = input[i] ^ keystream[i];
+		}
+		input += chunk;
+		output += chunk;
+		length -= chunk;
+	}
+}
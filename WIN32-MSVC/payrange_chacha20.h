@@ -0,0 +1,34 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_chacha20.h
+///-----------------------------------------------------------------------------
+///
+/// \brief ChaCha20 stream cipher (RFC 8439)
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_CHACHA20_H
+#define PAYRANGE_CHACHA20_H
+
+/// Standard includes
+#include <stddef.h>
+#include <stdint.h>
+
+#define CHACHA20_KEY_SIZE               ( 32 )
+#define CHACHA20_NONCE_SIZE             ( 12 )
+#define CHACHA20_BLOCK_SIZE             ( 64 )
+
+/// Cipher state: constants, key, 32-bit block counter and nonce
+typedef struct
+{
+	uint32_t state[16];
+}chacha20Context_t;
+
+/// Sets key, nonce and the counter of the first block
+void chacha20Init(chacha20Context_t *context, const uint8_t key[CHACHA20_KEY_SIZE],
+	const uint8_t nonce[CHACHA20_NONCE_SIZE], uint32_t counter);
+/// Writes whole keystream blocks and advances the counter
+void chacha20Keystream(chacha20Context_t *context, uint8_t *output, size_t blocks);
+/// XORs the keystream into length bytes; the counter ends on the next whole block
+void chacha20Xor(chacha20Context_t *context, uint8_t *output, const uint8_t *input, size_t length);
+
+#endif /// PAYRANGE_CHACHA20_H
@@ -0,0 +1,357 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_config.c
+///-----------------------------------------------------------------------------
+///
+/// \brief Runtime configuration
+///
+/// The file holds "key = value" lines, '#' starts a comment:
+///
+///     task_a_period_ms = 250
+///     task_b_period_ms = 5000
+///     keyboard_delay_ms = 5
+///     task_b_slots = 5
+///     list_f_slots = 7
+///     repl_sync = 0
+///
+/// Every load starts from the compiled-in defaults, so a key removed from
+/// the file goes back to its default. list_f_slots has none: without it the
+/// capacity of List F (which is kept in the state file and can also be set
+/// with the R key) is left alone. A file with an unknown key or a value out
+/// of range is rejected as a whole and the running configuration is kept.
+///
+/// The config task polls a directory change notification and reloads when
+/// the file's write time or size moved. The configuration is published
+/// under a sequence lock: the config task is the only writer, and a task
+/// copying it never waits and never sees half of an update.
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+
+/// Standard includes
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// Kernel includes
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "payrange.h"
+#include "payrange_atomic.h"
+#include "payrange_config.h"
+#include "payrange_listf.h"
+
+/// One key of the file
+typedef struct
+{
+	const char *name;
+	/// Offset of the field in payrangeConfig_t
+	size_t      offset;
+	uint32_t    minimum;
+	uint32_t    maximum;
+}configKey_t;
+
+static const configKey_t configKeys[] =
+{
+	{ "task_a_period_ms",  offsetof(payrangeConfig_t, taskAPeriodMs),   CONFIG_MIN_PERIOD_MS, CONFIG_MAX_PERIOD_MS },
+	{ "task_b_period_ms",  offsetof(payrangeConfig_t, taskBPeriodMs),   CONFIG_MIN_PERIOD_MS, CONFIG_MAX_PERIOD_MS },
+	{ "keyboard_delay_ms", offsetof(payrangeConfig_t, keyboardDelayMs), CONFIG_MIN_PERIOD_MS, CONFIG_MAX_PERIOD_MS },
+	{ "task_b_slots",      offsetof(payrangeConfig_t, taskBSlots),      1, MAX_SIZE_OF_THE_TASK_B_ARRAY },
+	{ "list_f_slots",      offsetof(payrangeConfig_t, valueESlots),     1, MAX_SIZE_OF_VALUE_E_STRUCTURE },
+	{ "repl_sync",         offsetof(payrangeConfig_t, replSync),        0, 1 },
+};
+
+static seqlock_t configLock;
+static payrangeConfig_t configCurrent;
+/// Write time and size of the file at the last load, 0 while it is missing
+static uint64_t configFileStamp = 0;
+
+///-----------------------------------------------------------
+/// \brief Fills a configuration with the compiled-in defaults
+///
+/// @param1 payrangeConfig_t *config - output
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void configDefaults(payrangeConfig_t *config)
+{
+	memset(config, 0, sizeof(*config));
+	config->taskAPeriodMs = TASK_A_RUNTIME_IN_MS;
+	config->taskBPeriodMs = TASK_B_RUNTIME_IN_MS;
+	config->keyboardDelayMs = KEYBOARD_TASK_DELAY_IN_MS;
+	config->taskBSlots = SIZE_OF_THE_TASK_B_ARRAY;
+	/// 0: keep the List F capacity as it is
+	config->valueESlots = 0;
+	/// Replication acknowledged in the background
+	config->replSync = 0;
+}
+
+///-----------------------------------------------------------
+/// \brief Reads the write time and size of the file
+///
+/// @param N/A
+///
+/// @return uint64_t - stamp that moves when the file changes,
+///                    0 if there is no file
+///-----------------------------------------------------------
+static uint64_t configReadStamp(void)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	ULARGE_INTEGER writeTime;
+
+	if (!GetFileAttributesExA(CONFIG_FILE_NAME, GetFileExInfoStandard, &attributes))
+	{
+		return 0;
+	}
+	writeTime.LowPart = attributes.ftLastWriteTime.dwLowDateTime;
+	writeTime.HighPart = attributes.ftLastWriteTime.dwHighDateTime;
+	return (writeTime.QuadPart ^ ((uint64_t)attributes.nFileSizeLow << 40)) | 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Removes leading and trailing blanks in place
+///
+/// @param1 char *text - string
+///
+/// @return char * - first non-blank character
+///-----------------------------------------------------------
+static char *configTrim(char *text)
+{
+	char *end;
+
+	while ((*text == ' ') || (*text == '\t'))
+	{
+		text++;
+	}
+	end = text + strlen(text);
+	while ((end > text) && ((end[-1] == ' ') || (end[-1] == '\t') || (end[-1] == '\r') || (end[-1] == '\n')))
+	{
+		end--;
+	}
+	*end = '\0';
+	return text;
+}
+
+///-----------------------------------------------------------
+/// \brief Parses the file over the compiled-in defaults
+///
+/// @param1 payrangeConfig_t *config - output
+///
+/// @return int - 1 if the file is missing or valid
+///-----------------------------------------------------------
+static int configParse(payrangeConfig_t *config)
+{
+	char line[CONFIG_MAX_LINE];
+	int lineNumber = 0;
+	int valid = 1;
+	FILE *file;
+
+	configDefaults(config);
+	file = fopen(CONFIG_FILE_NAME, "r");
+	if (file == NULL)
+	{
+		return 1;
+	}
+	while (valid && (fgets(line, sizeof(line), file) != NULL))
+	{
+		char *comment = strchr(line, '#');
+		char *separator;
+		char *name;
+		char *value;
+		char *end;
+		unsigned long number;
+		int key;
+
+		lineNumber++;
+		if (comment != NULL)
+		{
+			*comment = '\0';
+		}
+		name = configTrim(line);
+		if (*name == '\0')
+		{
+			continue;
+		}
+		separator = strchr(name, '=');
+		if (separator == NULL)
+		{
+			printf("Config %s line %d: expected key = value\n", CONFIG_FILE_NAME, lineNumber);
+			valid = 0;
+			break;
+		}
+		*separator = '\0';
+		name = configTrim(name);
+		value = configTrim(separator + 1);
+
+		for (key = 0; key < (int)(sizeof(configKeys) / sizeof(configKeys[0])); key++)
+		{
+			if (strcmp(name, configKeys[key].name) == 0)
+			{
+				break;
+			}
+		}
+		if (key == (int)(sizeof(configKeys) / sizeof(configKeys[0])))
+		{
+			printf("Config %s line %d: unknown key %s\n", CONFIG_FILE_NAME, lineNumber, name);
+			valid = 0;
+			break;
+		}
+		number = strtoul(value, &end, 10);
+		if ((*value == '\0') || (*end != '\0') || (number < configKeys[key].minimum) || (number > configKeys[key].maximum))
+		{
+			printf("Config %s line %d: %s must be %u to %u\n", CONFIG_FILE_NAME, lineNumber, name,
+				(unsigned int)configKeys[key].minimum, (unsigned int)configKeys[key].maximum);
+			valid = 0;
+			break;
+		}
+		*(uint32_t *)((char *)config + configKeys[key].offset) = (uint32_t)number;
+	}
+	fclose(file);
+	return valid;
+}
+
+///-----------------------------------------------------------
+/// \brief Reloads the file and publishes it if it changed.
+///        Only called before the scheduler starts and by the
+///        config task, the single writer.
+///
+/// @param N/A
+///
+/// @return int - 1 if the file was missing or valid
+///-----------------------------------------------------------
+static int configReload(void)
+{
+	payrangeConfig_t loaded;
+
+	configFileStamp = configReadStamp();
+	if (!configParse(&loaded))
+	{
+		printf("Config %s rejected, the running configuration is kept\n", CONFIG_FILE_NAME);
+		return 0;
+	}
+	loaded.generation = configCurrent.generation;
+	if (memcmp(&loaded, &configCurrent, sizeof(loaded)) == 0)
+	{
+		return 1;
+	}
+
+	/// List F changes size through its writer, only when the file asks for
+	/// a new capacity
+	if ((loaded.valueESlots != 0) && (loaded.valueESlots != configCurrent.valueESlots) &&
+		(loaded.valueESlots != listFCapacity()))
+	{
+		listFRequestResize(loaded.valueESlots);
+	}
+	loaded.generation++;
+	seqlockWriteBegin(&configLock);
+	configCurrent = loaded;
+	seqlockWriteEnd(&configLock);
+	configPrint();
+	return 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Loads the configuration, before the scheduler starts
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+void configInit(void)
+{
+	configDefaults(&configCurrent);
+	configReload();
+}
+
+///-----------------------------------------------------------
+/// \brief Copies the current configuration
+///
+/// @param1 payrangeConfig_t *config - output
+///
+/// @return N/A
+///-----------------------------------------------------------
+void configGet(payrangeConfig_t *config)
+{
+	uint32_t sequence;
+
+	do
+	{
+		sequence = seqlockReadBegin(&configLock);
+		*config = configCurrent;
+	} while (seqlockReadRetry(&configLock, sequence));
+}
+
+///-----------------------------------------------------------
+/// \brief Prints the current configuration
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+void configPrint(void)
+{
+	payrangeConfig_t config;
+
+	configGet(&config);
+	printf("Config %u: A every %u ms, B every %u ms, keyboard every %u ms, %u B slots, %u F slots, %s replication\n",
+		(unsigned int)config.generation, (unsigned int)config.taskAPeriodMs, (unsigned int)config.taskBPeriodMs,
+		(unsigned int)config.keyboardDelayMs, (unsigned int)config.taskBSlots,
+		(unsigned int)((config.valueESlots != 0) ? config.valueESlots : listFCapacity()),
+		config.replSync ? "sync" : "async");
+}
+
+///-----------------------------------------------------------
+/// \brief Config task: reloads the file when the directory
+///        reports a change that moved the file's stamp. The
+///        notification is polled, a FreeRTOS task must not
+///        block in a Windows wait.
+///
+/// @param 1 void *pvParameters - placeholder for FreeRTOS
+///                               Task parameters
+///
+/// @return None - Task always runs without a return
+///-----------------------------------------------------------
+static void configTask(void *pvParameters)
+{
+	const TickType_t xPollInterval = CONFIG_POLL_INTERVAL_MS / portTICK_PERIOD_MS;
+	/// The directory also holds E.txt and the state file, most changes are theirs
+	HANDLE change = FindFirstChangeNotificationA(".", FALSE,
+		FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE);
+
+	/// Just to remove compiler warnings
+	(void)pvParameters;
+
+	if (change == INVALID_HANDLE_VALUE)
+	{
+		printf("Config: no change notification, checking %s every poll\n", CONFIG_FILE_NAME);
+	}
+	for (;;)
+	{
+		vTaskDelay(xPollInterval);
+		if (change != INVALID_HANDLE_VALUE)
+		{
+			if (WaitForSingleObject(change, 0) != WAIT_OBJECT_0)
+			{
+				continue;
+			}
+			FindNextChangeNotification(change);
+		}
+		if (configReadStamp() != configFileStamp)
+		{
+			configReload();
+		}
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Creates the config task
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+void configCreateTask(void)
+{
+	xTaskCreate(configTask, "Config", configMINIMAL_STACK_SIZE, NULL, CONFIG_TASK_PRIORITY, NULL);
+}
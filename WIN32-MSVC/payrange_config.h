@@ -0,0 +1,61 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_config.h
+///-----------------------------------------------------------------------------
+///
+/// \brief Runtime configuration: task periods and list sizes loaded from a
+///        watched file and applied to the running tasks without a restart
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_CONFIG_H
+#define PAYRANGE_CONFIG_H
+
+/// Standard includes
+#include <stdint.h>
+
+/// Kernel includes
+#include <FreeRTOS.h>
+
+/// Runtime configuration configurable defines
+/// Read at start-up and again whenever it changes; missing keys keep the
+/// compiled-in defaults of payrange.h
+#define CONFIG_FILE_NAME                "payrange.cfg"
+/// How often the config task checks the change notification
+#define CONFIG_POLL_INTERVAL_MS         ( 250 )
+#define CONFIG_TASK_PRIORITY            ( tskIDLE_PRIORITY + 1 )
+/// Longest accepted line of the file
+#define CONFIG_MAX_LINE                 ( 128 )
+/// Accepted period range of tasks A, B and the keyboard
+#define CONFIG_MIN_PERIOD_MS            ( 1 )
+#define CONFIG_MAX_PERIOD_MS            ( 60000 )
+
+/// Runtime configuration. A task takes a copy at each release, so a change
+/// applies from its next period on and every field of a copy comes from
+/// the same version of the file.
+typedef struct
+{
+	/// Bumped on every change that was applied
+	uint32_t generation;
+	uint32_t taskAPeriodMs;
+	uint32_t taskBPeriodMs;
+	uint32_t keyboardDelayMs;
+	/// B list slots in use, at most MAX_SIZE_OF_THE_TASK_B_ARRAY
+	uint32_t taskBSlots;
+	/// List F slots, at most MAX_SIZE_OF_VALUE_E_STRUCTURE
+	uint32_t valueESlots;
+	/// 1: the E writer waits for the standby to acknowledge every batch
+	/// (payrange_repl.h), 0: records are shipped in the background
+	uint32_t replSync;
+}payrangeConfig_t;
+
+/// Loads CONFIG_FILE_NAME over the compiled-in defaults; call once after
+/// listFInit() and before the scheduler starts
+void configInit(void);
+/// Creates the low priority task that watches the file and applies changes
+void configCreateTask(void);
+/// Copies the current configuration
+void configGet(payrangeConfig_t *config);
+/// Prints the current configuration
+void configPrint(void);
+
+#endif /// PAYRANGE_CONFIG_H
@@ -0,0 +1,107 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_cpu.c
+///-----------------------------------------------------------------------------
+///
+/// \brief Host CPU feature detection for the accelerated code paths
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+
+/// Compiler includes
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+#include "payrange_cpu.h"
+
+/// Detected features, filled in on the first call
+static cpuFeatures_t cpuFeatures;
+static int cpuFeaturesDetected = 0;
+
+///-----------------------------------------------------------
+/// \brief Executes CPUID for the given leaf/subleaf
+///
+/// @param1 unsigned int leaf - CPUID leaf (EAX)
+/// @param2 unsigned int subleaf - CPUID subleaf (ECX)
+/// @param3 unsigned int regs[4] - EAX, EBX, ECX, EDX on return
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void cpuid(unsigned int leaf, unsigned int subleaf, unsigned int regs[4])
+{
+#if defined(_MSC_VER)
+	int msvcRegs[4];
+	__cpuidex(msvcRegs, (int)leaf, (int)subleaf);
+	regs[0] = (unsigned int)msvcRegs[0];
+	regs[1] = (unsigned int)msvcRegs[1];
+	regs[2] = (unsigned int)msvcRegs[2];
+	regs[3] = (unsigned int)msvcRegs[3];
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+///-----------------------------------------------------------
+/// \brief Reads the XCR0 register to check which register
+///        states the OS saves on context switch
+///
+/// @param N/A
+///
+/// @return unsigned int - low 32 bits of XCR0
+///-----------------------------------------------------------
+static unsigned int cpuReadXcr0(void)
+{
+#if defined(_MSC_VER)
+	return (unsigned int)_xgetbv(0);
+#else
+	unsigned int eax, edx;
+	__asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return eax;
+#endif
+}
+
+///-----------------------------------------------------------
+/// \brief Returns the host CPU features, detecting them on
+///        the first call
+///
+/// @param N/A
+///
+/// @return const cpuFeatures_t * - detected features
+///-----------------------------------------------------------
+const cpuFeatures_t *cpuGetFeatures(void)
+{
+	unsigned int regs[4];
+	unsigned int maxLeaf;
+	int osSavesYmm = 0;
+
+	if (cpuFeaturesDetected)
+	{
+		return &cpuFeatures;
+	}
+
+	cpuid(0, 0, regs);
+	maxLeaf = regs[0];
+
+	cpuid(1, 0, regs);
+	cpuFeatures.hasSsse3 = (regs[2] >> 9) & 1;
+	cpuFeatures.hasSse41 = (regs[2] >> 19) & 1;
+	cpuFeatures.hasPclmul = (regs[2] >> 1) & 1;
+	cpuFeatures.hasAesNi = cpuFeatures.hasSse41 && ((regs[2] >> 25) & 1);
+	/// AVX state must be enabled by the OS (OSXSAVE + XMM/YMM in XCR0)
+	if ((regs[2] >> 27) & 1)
+	{
+		osSavesYmm = ((cpuReadXcr0() & 0x6) == 0x6);
+	}
+
+	if (maxLeaf >= 7)
+	{
+		cpuid(7, 0, regs);
+		cpuFeatures.hasAvx2 = osSavesYmm && ((regs[1] >> 5) & 1);
+		cpuFeatures.hasShaNi = cpuFeatures.hasSse41 && cpuFeatures.hasSsse3 && ((regs[1] >> 29) & 1);
+	}
+
+	cpuFeaturesDetected = 1;
+	return &cpuFeatures;
+}
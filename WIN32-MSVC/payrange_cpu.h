@@ -0,0 +1,34 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_cpu.h
+///-----------------------------------------------------------------------------
+///
+/// \brief Host CPU feature detection for the accelerated code paths
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_CPU_H
+#define PAYRANGE_CPU_H
+
+/// Functions that use instruction set extensions are tagged with the target
+/// features on GCC/MingW. MSVC accepts the intrinsics without any tagging.
+#if defined(__GNUC__)
+#define PAYRANGE_TARGET(features)       __attribute__((target(features)))
+#else
+#define PAYRANGE_TARGET(features)
+#endif
+
+/// Instruction set extensions present on the host and enabled by the OS
+typedef struct
+{
+	int hasSsse3;
+	int hasSse41;
+	int hasAvx2;
+	int hasShaNi;
+	int hasAesNi;
+	int hasPclmul;
+}cpuFeatures_t;
+
+/// Returns the (lazily detected) host features
+const cpuFeatures_t *cpuGetFeatures(void);
+
+#endif /// PAYRANGE_CPU_H
@@ -0,0 +1,326 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_critical.c
+///-----------------------------------------------------------------------------
+///
+/// \brief Critical-section profiler
+///
+/// In the Win32 port a critical section holds the mutex that the simulated
+/// interrupts also take, so while one is held no tick is processed and any
+/// other thread that enters a critical section waits for it.
+///
+/// Only the outermost section of a nest is timed. The site table and the
+/// holder are only written by the thread that holds the section, so they
+/// need no lock of their own. A thread that finds a holder when it arrives
+/// charges its wait to the holder's site once it gets in. Ticks have no
+/// hook of their own; the ticks that fell due during a hold are counted
+/// from the tick period, and each is charged the time from when it was due
+/// to the end of the hold.
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+
+/// Standard includes
+#include <stdio.h>
+#include <string.h>
+
+/// Kernel includes
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "payrange_critical.h"
+#include "payrange_tsc.h"
+
+#if CRITICAL_PROFILE
+
+#define CRITICAL_NS_PER_TICK            ( 1000000000ULL / configTICK_RATE_HZ )
+/// Upper bound of histogram bucket 0
+#define CRITICAL_HISTOGRAM_BASE_NS      ( 256ULL )
+
+static criticalSite_t criticalSites[CRITICAL_MAX_SITES];
+/// Sections entered from sites that found the table full
+static uint32_t criticalUntimed = 0;
+/// Site of the section being held, NULL while none is
+static criticalSite_t *volatile criticalHolder = NULL;
+/// Thread holding the section and its nesting depth
+static volatile DWORD criticalOwner = 0;
+static uint32_t criticalDepth = 0;
+static uint64_t criticalAcquiredAt = 0;
+/// Counter value the tick phase is measured from
+static uint64_t criticalOrigin = 0;
+
+///-----------------------------------------------------------
+/// \brief Finds or adds the site of a call. Called while
+///        holding the section.
+///
+/// @param1 const char *file - __FILE__ of the call
+/// @param2 int line - __LINE__ of the call
+///
+/// @return criticalSite_t * - site, NULL if the table is full
+///-----------------------------------------------------------
+static criticalSite_t *criticalFindSite(const char *file, int line)
+{
+	uint32_t slot = ((uint32_t)(uintptr_t)file ^ ((uint32_t)line * 2654435761u)) % CRITICAL_MAX_SITES;
+
+	for (int probe = 0; probe < CRITICAL_MAX_SITES; probe++)
+	{
+		criticalSite_t *site = &criticalSites[slot];
+		if ((site->file == file) && (site->line == line))
+		{
+			return site;
+		}
+		if (site->file == NULL)
+		{
+			site->file = file;
+			site->line = line;
+			return site;
+		}
+		slot = (slot + 1) % CRITICAL_MAX_SITES;
+	}
+	return NULL;
+}
+
+///-----------------------------------------------------------
+/// \brief Histogram bucket of a hold time
+///
+/// @param1 uint64_t holdNs - hold time
+///
+/// @return int - bucket
+///-----------------------------------------------------------
+static int criticalBucket(uint64_t holdNs)
+{
+	int bucket = 0;
+
+	for (uint64_t bound = CRITICAL_HISTOGRAM_BASE_NS; (holdNs >= bound) && (bucket < CRITICAL_HISTOGRAM_BUCKETS - 1); bound <<= 1)
+	{
+		bucket++;
+	}
+	return bucket;
+}
+
+///-----------------------------------------------------------
+/// \brief Enters the critical section and starts timing it
+///
+/// @param1 const char *file - __FILE__ of the call
+/// @param2 int line - __LINE__ of the call
+///
+/// @return N/A
+///-----------------------------------------------------------
+void criticalEnter(const char *file, int line)
+{
+	const DWORD thread = GetCurrentThreadId();
+	criticalSite_t *holder;
+	uint64_t requestedAt;
+
+	/// Nested: the outer section is already being timed
+	if (criticalOwner == thread)
+	{
+		portENTER_CRITICAL();
+		criticalDepth++;
+		return;
+	}
+
+	/// The holder clears criticalHolder before it leaves, so a holder seen
+	/// here is one this thread is about to wait for
+	holder = criticalHolder;
+	requestedAt = tscNow();
+	portENTER_CRITICAL();
+	criticalAcquiredAt = tscNow();
+	criticalOwner = thread;
+	criticalDepth = 1;
+	if (criticalOrigin == 0)
+	{
+		criticalOrigin = criticalAcquiredAt;
+	}
+
+	if (holder != NULL)
+	{
+		holder->tasksDelayed++;
+		holder->taskBlockedNs += tscToNs(criticalAcquiredAt - requestedAt);
+	}
+	criticalHolder = criticalFindSite(file, line);
+	if (criticalHolder == NULL)
+	{
+		criticalUntimed++;
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Charges the hold to its site and leaves the
+///        critical section
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+void criticalExit(void)
+{
+	criticalSite_t *site = criticalHolder;
+
+	if (--criticalDepth == 0)
+	{
+		const uint64_t releasedAt = tscNow();
+		const uint64_t acquiredNs = tscToNs(criticalAcquiredAt - criticalOrigin);
+		const uint64_t releasedNs = tscToNs(releasedAt - criticalOrigin);
+		const uint64_t holdNs = releasedNs - acquiredNs;
+
+		if (site != NULL)
+		{
+			/// Ticks due at multiples of the period inside the hold
+			const uint64_t firstTick = acquiredNs / CRITICAL_NS_PER_TICK + 1;
+			const uint64_t lastTick = (releasedNs - 1) / CRITICAL_NS_PER_TICK;
+
+			site->entries++;
+			site->holdNs += holdNs;
+			if (holdNs > site->maxHoldNs)
+			{
+				site->maxHoldNs = holdNs;
+			}
+			site->histogram[criticalBucket(holdNs)]++;
+			if ((releasedNs > 0) && (lastTick >= firstTick))
+			{
+				const uint64_t ticks = lastTick - firstTick + 1;
+				site->ticksDelayed += (uint32_t)ticks;
+				/// The last tick waited releasedNs - lastTick * period, each
+				/// earlier one a period more
+				site->tickBlockedNs += ticks * (releasedNs - lastTick * CRITICAL_NS_PER_TICK) +
+					ticks * (ticks - 1) / 2 * CRITICAL_NS_PER_TICK;
+			}
+		}
+		criticalHolder = NULL;
+		criticalOwner = 0;
+	}
+	portEXIT_CRITICAL();
+}
+
+///-----------------------------------------------------------
+/// \brief Copies the sites ranked by the time tasks and ticks
+///        were held off by them
+///
+/// @param1 criticalSite_t *sites - output
+/// @param2 int maxSites - room in sites
+///
+/// @return int - sites copied
+///-----------------------------------------------------------
+int criticalGetSites(criticalSite_t *sites, int maxSites)
+{
+	static criticalSite_t copy[CRITICAL_MAX_SITES];
+	int count = 0;
+
+	/// Not PAYRANGE_ENTER_CRITICAL(): the report is not profiled
+	portENTER_CRITICAL();
+	for (int i = 0; i < CRITICAL_MAX_SITES; i++)
+	{
+		if (criticalSites[i].file != NULL)
+		{
+			copy[count++] = criticalSites[i];
+		}
+	}
+	portEXIT_CRITICAL();
+
+	/// Insertion sort, most blocked first
+	for (int i = 1; i < count; i++)
+	{
+		const criticalSite_t site = copy[i];
+		const uint64_t blockedNs = site.taskBlockedNs + site.tickBlockedNs;
+		int position = i;
+
+		while ((position > 0) && (copy[position - 1].taskBlockedNs + copy[position - 1].tickBlockedNs < blockedNs))
+		{
+			copy[position] = copy[position - 1];
+			position--;
+		}
+		copy[position] = site;
+	}
+
+	if (count > maxSites)
+	{
+		count = maxSites;
+	}
+	memcpy(sites, copy, (size_t)count * sizeof(criticalSite_t));
+	return count;
+}
+
+///-----------------------------------------------------------
+/// \brief Prints the sites ranked by total blocked time, with
+///        the non-empty buckets of their hold time histogram
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+void criticalPrintReport(void)
+{
+	static criticalSite_t sites[CRITICAL_MAX_SITES];
+	const int count = criticalGetSites(sites, CRITICAL_MAX_SITES);
+
+	printf("Critical sections: %d sites, %u untimed entries\n", count, (unsigned int)criticalUntimed);
+	printf("  %-28s %8s %10s %9s %6s %10s %6s %10s\n",
+		"site", "entries", "hold us", "max us", "tasks", "blocked us", "ticks", "late us");
+	for (int i = 0; i < count; i++)
+	{
+		const char *file = sites[i].file;
+		const char *name = strrchr(file, '\\');
+		uint64_t bound = CRITICAL_HISTOGRAM_BASE_NS;
+
+		if (name == NULL)
+		{
+			name = strrchr(file, '/');
+		}
+		name = (name == NULL) ? file : name + 1;
+
+		printf("  %-22.22s:%-5d %8u %10u %9u %6u %10u %6u %10u\n   ", name, sites[i].line,
+			(unsigned int)sites[i].entries, (unsigned int)(sites[i].holdNs / 1000),
+			(unsigned int)(sites[i].maxHoldNs / 1000), (unsigned int)sites[i].tasksDelayed,
+			(unsigned int)(sites[i].taskBlockedNs / 1000), (unsigned int)sites[i].ticksDelayed,
+			(unsigned int)(sites[i].tickBlockedNs / 1000));
+		for (int bucket = 0; bucket < CRITICAL_HISTOGRAM_BUCKETS; bucket++, bound <<= 1)
+		{
+			const char *relation = (bucket < CRITICAL_HISTOGRAM_BUCKETS - 1) ? "<" : ">=";
+			const uint64_t shown = (bucket < CRITICAL_HISTOGRAM_BUCKETS - 1) ? bound : bound >> 1;
+
+			if (sites[i].histogram[bucket] == 0)
+			{
+				continue;
+			}
+			if (shown < 1000)
+			{
+				printf(" %s%uns:%u", relation, (unsigned int)shown, (unsigned int)sites[i].histogram[bucket]);
+			}
+			else if (shown < 1000000)
+			{
+				printf(" %s%uus:%u", relation, (unsigned int)(shown / 1000), (unsigned int)sites[i].histogram[bucket]);
+			}
+			else
+			{
+				printf(" %s%ums:%u", relation, (unsigned int)(shown / 1000000), (unsigned int)sites[i].histogram[bucket]);
+			}
+		}
+		printf("\n");
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Clears every site
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+void criticalReset(void)
+{
+	portENTER_CRITICAL();
+	for (int i = 0; i < CRITICAL_MAX_SITES; i++)
+	{
+		/// Keep the site of a section being held, it is closed later
+		const char *file = criticalSites[i].file;
+		const int line = criticalSites[i].line;
+
+		memset(&criticalSites[i], 0, sizeof(criticalSites[i]));
+		criticalSites[i].file = file;
+		criticalSites[i].line = line;
+	}
+	criticalUntimed = 0;
+	portEXIT_CRITICAL();
+}
+
+#endif /// CRITICAL_PROFILE
@@ -0,0 +1,71 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_critical.h
+///-----------------------------------------------------------------------------
+///
+/// \brief Critical-section profiler: hold times and the tasks and ticks held
+///        off, per call site of PAYRANGE_ENTER_CRITICAL()
+///
+/// Include after FreeRTOS.h. With CRITICAL_PROFILE set to 0 the macros are
+/// plain portENTER_CRITICAL()/portEXIT_CRITICAL() and nothing else is built.
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_CRITICAL_H
+#define PAYRANGE_CRITICAL_H
+
+/// Critical-section profiler configurable defines
+#ifndef CRITICAL_PROFILE
+#define CRITICAL_PROFILE                ( 1 )
+#endif
+/// Call sites told apart; sections entered from further sites are not timed
+#define CRITICAL_MAX_SITES              ( 64 )
+/// Hold time histogram: bucket 0 is under 256 ns, each next one doubles, the
+/// last one takes everything longer
+#define CRITICAL_HISTOGRAM_BUCKETS      ( 16 )
+
+#if CRITICAL_PROFILE
+
+/// Standard includes
+#include <stdint.h>
+
+/// Counters of one call site
+typedef struct
+{
+	const char *file;
+	int         line;
+	uint32_t    entries;
+	uint64_t    holdNs;
+	uint64_t    maxHoldNs;
+	uint32_t    histogram[CRITICAL_HISTOGRAM_BUCKETS];
+	/// Tasks (and host threads) that waited to enter while this site held
+	uint32_t    tasksDelayed;
+	uint64_t    taskBlockedNs;
+	/// Ticks that fell due while this site held, and how late they ran
+	uint32_t    ticksDelayed;
+	uint64_t    tickBlockedNs;
+}criticalSite_t;
+
+#define PAYRANGE_ENTER_CRITICAL()       criticalEnter(__FILE__, __LINE__)
+#define PAYRANGE_EXIT_CRITICAL()        criticalExit()
+
+/// portENTER_CRITICAL() that times the section for the call site
+void criticalEnter(const char *file, int line);
+/// portEXIT_CRITICAL() that closes the timing of criticalEnter()
+void criticalExit(void);
+/// Copies up to maxSites sites ranked by total blocked time; returns the number copied
+int criticalGetSites(criticalSite_t *sites, int maxSites);
+/// Prints the sites ranked by total blocked time
+void criticalPrintReport(void);
+/// Clears every site
+void criticalReset(void);
+
+#else
+
+#define PAYRANGE_ENTER_CRITICAL()       portENTER_CRITICAL()
+#define PAYRANGE_EXIT_CRITICAL()        portEXIT_CRITICAL()
+#define criticalPrintReport()           ((void)0)
+#define criticalReset()                 ((void)0)
+
+#endif /// CRITICAL_PROFILE
+
+#endif /// PAYRANGE_CRITICAL_H
@@ -0,0 +1,353 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_csprng.c
+///-----------------------------------------------------------------------------
+///
+/// \brief Buffered cryptographic random generator
+///
+/// Each context holds a 32 byte ChaCha20 key. A refill expands the key into
+/// CSPRNG_BUFFER_SIZE bytes of keystream (vectorized, see chacha20Keystream),
+/// immediately replaces the key with the first 32 of them and serves the
+/// rest, wiping every byte as it is handed out. A captured context therefore
+/// reveals nothing about earlier output ("fast key erasure"), and most calls
+/// are a memcpy out of the buffer.
+///
+/// Every task that asks for random bytes gets its own context through its
+/// FreeRTOS thread local storage slot, so tasks never wait on each other.
+/// Before the scheduler runs, and once the context pool is used up, callers
+/// share one context under a critical section.
+///
+/// Contexts are reseeded from the OS generator after CSPRNG_RESEED_BYTES or
+/// CSPRNG_RESEED_INTERVAL_MS, and whenever the generation counter moves:
+/// csprngInvalidate() bumps it, and so does a change of process id, which is
+/// how a copy of the process (a restored snapshot, or a fork under a POSIX
+/// layer) shows up. Two copies never continue the same keystream.
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+
+/// rand_s() is only declared when this is set before stdlib.h
+#define _CRT_RAND_S
+
+/// Standard includes
+#include <stdlib.h>
+#include <string.h>
+
+/// Kernel includes
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "payrange_chacha20.h"
+#include "payrange_csprng.h"
+#include "payrange_critical.h"
+
+/// One generator
+typedef struct
+{
+	uint8_t    buffer[CSPRNG_BUFFER_SIZE];
+	uint8_t    key[CHACHA20_KEY_SIZE];
+	/// Next unused byte of buffer
+	uint32_t   position;
+	/// Value of csprngGeneration at the last reseed
+	uint32_t   generation;
+	uint32_t   bytesSinceReseed;
+	TickType_t reseededAt;
+	int        inUse;
+}csprngContext_t;
+
+/// Per task contexts, claimed on first use and kept for the task's lifetime
+static csprngContext_t csprngTaskContexts[CSPRNG_MAX_TASK_CONTEXTS];
+/// Shared context, only used inside a critical section
+static csprngContext_t csprngSharedContext;
+/// Contexts reseeded under an older generation reseed before their next output
+static volatile uint32_t csprngGeneration = 1;
+/// Process that the current generation belongs to
+static volatile DWORD csprngProcessId = 0;
+
+///-----------------------------------------------------------
+/// \brief Fills a buffer from the OS cryptographic generator
+///
+/// @param1 void *buffer - output
+/// @param2 size_t length - bytes wanted
+///
+/// @return int - 1 on success
+///-----------------------------------------------------------
+int csprngOsEntropy(void *buffer, size_t length)
+{
+	uint8_t *output = (uint8_t *)buffer;
+
+	while (length > 0)
+	{
+		unsigned int value;
+		size_t chunk = (length < sizeof(value)) ? length : sizeof(value);
+		if (rand_s(&value) != 0)
+		{
+			return 0;
+		}
+		memcpy(output, &value, chunk);
+		output += chunk;
+		length -= chunk;
+	}
+	return 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Expands the key into a new buffer of keystream and
+///        replaces the key with its first 32 bytes
+///
+/// @param1 csprngContext_t *context - generator
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void csprngRefill(csprngContext_t *context)
+{
+	static const uint8_t nonce[CHACHA20_NONCE_SIZE] = { 0 };
+	chacha20Context_t cipher;
+
+	/// Every key is used for exactly one buffer, so a fixed nonce is safe
+	chacha20Init(&cipher, context->key, nonce, 0);
+	chacha20Keystream(&cipher, context->buffer, CSPRNG_BUFFER_SIZE / CHACHA20_BLOCK_SIZE);
+	memcpy(context->key, context->buffer, CHACHA20_KEY_SIZE);
+	memset(context->buffer, 0, CHACHA20_KEY_SIZE);
+	memset(&cipher, 0, sizeof(cipher));
+	context->position = CHACHA20_KEY_SIZE;
+}
+
+///-----------------------------------------------------------
+/// \brief Mixes fresh OS entropy into the key and discards
+///        whatever was still buffered
+///
+/// @param1 csprngContext_t *context - generator
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void csprngReseed(csprngContext_t *context)
+{
+	uint8_t entropy[CHACHA20_KEY_SIZE];
+	const int haveEntropy = csprngOsEntropy(entropy, sizeof(entropy));
+
+	configASSERT(haveEntropy);
+	/// Without assertions a failed read leaves the key as it is; the
+	/// refill below still moves it on
+	if (haveEntropy)
+	{
+		for (int i = 0; i < CHACHA20_KEY_SIZE; i++)
+		{
+			context->key[i] ^= entropy[i];
+		}
+	}
+	memset(entropy, 0, sizeof(entropy));
+
+	context->generation = csprngGeneration;
+	context->bytesSinceReseed = 0;
+	context->reseededAt = xTaskGetTickCount();
+	csprngRefill(context);
+}
+
+///-----------------------------------------------------------
+/// \brief Copies random bytes out of a context, reseeding and
+///        refilling it as needed
+///
+/// @param1 csprngContext_t *context - generator
+/// @param2 uint8_t *output - output
+/// @param3 size_t length - bytes wanted
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void csprngFill(csprngContext_t *context, uint8_t *output, size_t length)
+{
+	const TickType_t xReseedInterval = CSPRNG_RESEED_INTERVAL_MS / portTICK_PERIOD_MS;
+
+	if ((context->generation != csprngGeneration) || (context->bytesSinceReseed >= CSPRNG_RESEED_BYTES) ||
+		((TickType_t)(xTaskGetTickCount() - context->reseededAt) >= xReseedInterval))
+	{
+		csprngReseed(context);
+	}
+
+	context->bytesSinceReseed += (uint32_t)length;
+	while (length > 0)
+	{
+		size_t chunk = CSPRNG_BUFFER_SIZE - context->position;
+		if (chunk == 0)
+		{
+			csprngRefill(context);
+			chunk = CSPRNG_BUFFER_SIZE - context->position;
+		}
+		if (chunk > length)
+		{
+			chunk = length;
+		}
+		memcpy(output, context->buffer + context->position, chunk);
+		/// Served bytes must not stay behind in the buffer
+		memset(context->buffer + context->position, 0, chunk);
+		context->position += (uint32_t)chunk;
+		output += chunk;
+		length -= chunk;
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Finds the calling task's context, claiming a free
+///        one from the pool on its first call
+///
+/// @param N/A
+///
+/// @return csprngContext_t * - task context, or the shared one
+///-----------------------------------------------------------
+static csprngContext_t *csprngTaskContext(void)
+{
+	csprngContext_t *context;
+
+	if (xTaskGetSchedulerState() != taskSCHEDULER_RUNNING)
+	{
+		return &csprngSharedContext;
+	}
+	context = (csprngContext_t *)pvTaskGetThreadLocalStoragePointer(NULL, CSPRNG_TLS_INDEX);
+	if (context != NULL)
+	{
+		return context;
+	}
+
+	/// First call from this task; a full pool parks it on the shared context
+	context = &csprngSharedContext;
+	PAYRANGE_ENTER_CRITICAL();
+	for (int i = 0; i < CSPRNG_MAX_TASK_CONTEXTS; i++)
+	{
+		if (!csprngTaskContexts[i].inUse)
+		{
+			csprngTaskContexts[i].inUse = 1;
+			context = &csprngTaskContexts[i];
+			break;
+		}
+	}
+	PAYRANGE_EXIT_CRITICAL();
+	vTaskSetThreadLocalStoragePointer(NULL, CSPRNG_TLS_INDEX, context);
+	return context;
+}
+
+///-----------------------------------------------------------
+/// \brief Fills a buffer with random bytes
+///
+/// @param1 void *buffer - output
+/// @param2 size_t length - bytes wanted
+///
+/// @return N/A
+///-----------------------------------------------------------
+void csprngBytes(void *buffer, size_t length)
+{
+	const DWORD processId = GetCurrentProcessId();
+	csprngContext_t *context;
+
+	if (processId != csprngProcessId)
+	{
+		csprngProcessId = processId;
+		csprngGeneration++;
+	}
+
+	context = csprngTaskContext();
+	if (context == &csprngSharedContext)
+	{
+		PAYRANGE_ENTER_CRITICAL();
+		csprngFill(context, (uint8_t *)buffer, length);
+		PAYRANGE_EXIT_CRITICAL();
+	}
+	else
+	{
+		csprngFill(context, (uint8_t *)buffer, length);
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Returns a uniform value in [0, bound). Values below
+///        2^32 mod bound are redrawn, so no result is favoured.
+///
+/// @param1 uint32_t bound - exclusive upper limit, > 0
+///
+/// @return uint32_t - random value
+///-----------------------------------------------------------
+uint32_t csprngUniform(uint32_t bound)
+{
+	uint32_t threshold;
+	uint32_t value;
+
+	configASSERT(bound > 0);
+	threshold = (uint32_t)(0 - bound) % bound;
+	do
+	{
+		csprngBytes(&value, sizeof(value));
+	} while (value < threshold);
+	return value % bound;
+}
+
+///-----------------------------------------------------------
+/// \brief Returns a uniform 64-bit value in [0, bound)
+///
+/// @param1 uint64_t bound - exclusive upper limit, > 0
+///
+/// @return uint64_t - random value
+///-----------------------------------------------------------
+uint64_t csprngUniform64(uint64_t bound)
+{
+	uint64_t threshold;
+	uint64_t value;
+
+	configASSERT(bound > 0);
+	threshold = (uint64_t)(0 - bound) % bound;
+	do
+	{
+		csprngBytes(&value, sizeof(value));
+	} while (value < threshold);
+	return value % bound;
+}
+
+///-----------------------------------------------------------
+/// \brief Generates a random string. Bytes are drawn in one
+///        batch and those that would bias the result (at or
+///        above the largest multiple of the charset length)
+///        are skipped.
+///
+/// @param1 char *output - length + 1 bytes
+/// @param2 int length - characters wanted
+/// @param3 const char *charset - allowed characters
+/// @param4 int charsetLength - number of characters, 1..256
+///
+/// @return N/A
+///-----------------------------------------------------------
+void csprngString(char *output, int length, const char *charset, int charsetLength)
+{
+	const int limit = 256 - (256 % charsetLength);
+	uint8_t bytes[64];
+	int produced = 0;
+
+	configASSERT((charsetLength > 0) && (charsetLength <= 256));
+	while (produced < length)
+	{
+		/// A few spare bytes cover the rejected ones in almost every call
+		size_t wanted = (size_t)(length - produced) + 8;
+		if (wanted > sizeof(bytes))
+		{
+			wanted = sizeof(bytes);
+		}
+		csprngBytes(bytes, wanted);
+		for (size_t i = 0; (i < wanted) && (produced < length); i++)
+		{
+			if (bytes[i] < limit)
+			{
+				output[produced++] = charset[bytes[i] % charsetLength];
+			}
+		}
+	}
+	output[length] = '\0';
+	memset(bytes, 0, sizeof(bytes));
+}
+
+///-----------------------------------------------------------
+/// \brief Makes every context reseed before its next output
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+void csprngInvalidate(void)
+{
+	csprngGeneration++;
+}
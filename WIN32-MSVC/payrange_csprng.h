@@ -0,0 +1,42 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_csprng.h
+///-----------------------------------------------------------------------------
+///
+/// \brief Buffered cryptographic random generator: ChaCha20 keystream with
+///        fast key erasure, one buffer per task
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_CSPRNG_H
+#define PAYRANGE_CSPRNG_H
+
+/// Standard includes
+#include <stddef.h>
+#include <stdint.h>
+
+/// CSPRNG configurable defines
+/// Keystream generated per refill; the first 32 bytes become the next key
+#define CSPRNG_BUFFER_SIZE              ( 4096 )
+/// Fresh OS entropy is mixed in after this many bytes or this long
+#define CSPRNG_RESEED_BYTES             ( 1024 * 1024 )
+#define CSPRNG_RESEED_INTERVAL_MS       ( 60 * 1000 )
+/// Tasks that get their own buffer, the rest share one under a critical section
+#define CSPRNG_MAX_TASK_CONTEXTS        ( 8 )
+/// FreeRTOS thread local storage slot holding the task's context
+#define CSPRNG_TLS_INDEX                ( 0 )
+
+/// Fills a buffer from the OS generator (RtlGenRandom); returns 1 on success
+int csprngOsEntropy(void *buffer, size_t length);
+/// Fills a buffer with random bytes
+void csprngBytes(void *buffer, size_t length);
+/// Uniform value in [0, bound), without modulo bias; bound must be > 0
+uint32_t csprngUniform(uint32_t bound);
+/// Uniform 64-bit value in [0, bound); bound must be > 0
+uint64_t csprngUniform64(uint64_t bound);
+/// Random string of length characters from charset, NUL terminated
+void csprngString(char *output, int length, const char *charset, int charsetLength);
+/// Forces every context to reseed before its next output, e.g. after the
+/// process state was restored from a snapshot
+void csprngInvalidate(void);
+
+#endif /// PAYRANGE_CSPRNG_H
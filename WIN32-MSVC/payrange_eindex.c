@@ -0,0 +1,1229 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_eindex.c
+///-----------------------------------------------------------------------------
+///
+/// \brief Persistent A to E index
+///
+/// The E log writer adds every record to the active memtable, which lives in
+/// the state file. When it is full the writer switches to the other one and
+/// the index task writes the full memtable as a sorted run, a file that never
+/// changes afterwards:
+///
+///     eIndexRunHeader_t | entries sorted by A, then line | perfect hash |
+///     fingerprints | first A of every EINDEX_PAGE_ENTRIES page
+///
+/// New runs are level 0. Once a level holds EINDEX_FANOUT runs, the index
+/// task merges the oldest of them into one run of the next level, so the
+/// number of runs grows with the logarithm of the history. The manifest
+/// E.idx lists the live runs; it is rewritten to a temporary file and moved
+/// over the old one, so a crash leaves either the old or the new list. A run
+/// file or a memtable that was being written when the simulator stopped is
+/// written again on the next flush, and a record indexed twice is dropped by
+/// the lookup and the next merge.
+///
+/// A run is sealed when it is written: the index task then builds a minimal
+/// perfect hash of its distinct A codes (payrange_mph.h) and stores an 8-bit
+/// fingerprint of each code in the code's slot. One probe of the hash and a
+/// fingerprint compare tell whether a run holds a code (1 in 256 false
+/// positives) at about 12 bits of RAM per code, so the filters of every run
+/// stay in RAM however many runs there are.
+///
+/// Lookups scan the memtables and take a reference on every run whose key
+/// range and filter admit the code while holding the index mutex, then read
+/// one page from each (its position comes from the page fences held in RAM)
+/// without it. A run replaced by a merge is deleted when its
+/// last reader lets it go.
+///
+/// The index follows the E log: a new E.txt or E.enc (a fresh state) starts
+/// a new index, a continued one keeps it.
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+
+/// Standard includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+/// Kernel includes
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+
+#include "payrange_atomic.h"
+#include "payrange_eindex.h"
+#include "payrange_mph.h"
+#include "payrange_state.h"
+
+/// 64-bit file positions, runs of a long history outgrow 2 GB
+#ifdef _WIN32
+#define eIndexSeek( file, offset )      _fseeki64( ( file ), ( offset ), SEEK_SET )
+#else
+#define eIndexSeek( file, offset )      fseeko( ( file ), ( off_t )( offset ), SEEK_SET )
+#endif
+
+/// Longest run file name
+#define EINDEX_MAX_FILE_NAME            ( 32 )
+
+/// Manifest header, one eIndexManifestRun_t per live run follows
+typedef struct
+{
+	char     magic[8];
+	uint32_t version;
+	uint32_t nextRunId;
+	uint32_t runCount;
+	uint32_t reserved;
+}eIndexManifestHeader_t;
+
+/// Manifest entry
+typedef struct
+{
+	uint32_t id;
+	uint32_t level;
+	uint32_t count;
+	uint32_t reserved;
+}eIndexManifestRun_t;
+
+/// A run in RAM: its key range, perfect hash, fingerprints and page fences
+typedef struct
+{
+	/// Slot in use
+	int      used;
+	/// Listed in the manifest; 0 once merged away or dropped by a reset
+	int      live;
+	/// Input of the merge in progress
+	int      merging;
+	/// Lookups (and the merge) reading the file
+	uint32_t readers;
+	uint32_t id;
+	uint32_t level;
+	uint32_t count;
+	int64_t  minA;
+	int64_t  maxA;
+	uint32_t pages;
+	int64_t *fences;
+	/// Distinct A codes, each with its slot in mph and fingerprints
+	uint32_t keys;
+	mph_t    mph;
+	uint8_t *fingerprints;
+}eIndexRun_t;
+
+/// Run being written
+typedef struct
+{
+	FILE             *file;
+	eIndexRunHeader_t header;
+	eIndexEntry_t     last;
+	uint32_t          maxCount;
+	int64_t          *fences;
+	/// Distinct A codes, in order
+	int64_t          *keys;
+	mph_t             mph;
+	uint8_t          *fingerprints;
+}eIndexRunWriter_t;
+
+/// Serialises memtable and run list changes and manifest writes. A mutex with
+/// priority inheritance: the E writer takes it to switch memtables and
+/// must not wait behind a low priority task any longer than needed.
+static SemaphoreHandle_t eIndexMutex = NULL;
+/// One flush at a time: held while a memtable is sorted and written, which
+/// the index mutex is not, so the E writer waits here for the index task's
+static SemaphoreHandle_t eIndexFlushMutex = NULL;
+static eIndexRun_t eIndexRuns[EINDEX_MAX_RUNS];
+/// Memtables; in RAM until eIndexInit() moves them into the state file
+static eIndexMemtables_t eIndexLocalMemtables;
+static eIndexMemtables_t *eIndexMemtables = &eIndexLocalMemtables;
+static uint32_t eIndexNextRunId = 0;
+/// Bumped by a reset, a merge that started before it is thrown away
+static uint32_t eIndexGeneration = 0;
+static eIndexStats_t eIndexCounters;
+
+///-----------------------------------------------------------
+/// \brief Builds the file name of a run
+///
+/// @param1 uint32_t id - run id
+/// @param2 char *name - output, EINDEX_MAX_FILE_NAME bytes
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void eIndexRunFileName(uint32_t id, char *name)
+{
+	snprintf(name, EINDEX_MAX_FILE_NAME, EINDEX_RUN_FILE_FORMAT, (unsigned int)id);
+}
+
+///-----------------------------------------------------------
+/// \brief qsort comparator of entries: by A, then line
+///-----------------------------------------------------------
+static int eIndexCompareEntries(const void *left, const void *right)
+{
+	const eIndexEntry_t *a = (const eIndexEntry_t *)left;
+	const eIndexEntry_t *b = (const eIndexEntry_t *)right;
+
+	if (a->a != b->a)
+	{
+		return (a->a < b->a) ? -1 : 1;
+	}
+	return (a->line < b->line) ? -1 : (a->line > b->line);
+}
+
+///-----------------------------------------------------------
+/// \brief qsort comparator of entries: by line
+///-----------------------------------------------------------
+static int eIndexCompareLines(const void *left, const void *right)
+{
+	const eIndexEntry_t *a = (const eIndexEntry_t *)left;
+	const eIndexEntry_t *b = (const eIndexEntry_t *)right;
+
+	return (a->line < b->line) ? -1 : (a->line > b->line);
+}
+
+///-----------------------------------------------------------
+/// \brief Fingerprint of an A code, stored in the perfect hash
+///        slot of every code of a run to tell other codes apart
+///
+/// @param1 int64_t a - A code
+///
+/// @return uint8_t - fingerprint
+///-----------------------------------------------------------
+static uint8_t eIndexFingerprint(int64_t a)
+{
+	uint64_t hash = (uint64_t)a + 0x9E3779B97F4A7C15ULL;
+
+	hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBULL;
+	return (uint8_t)((hash ^ (hash >> 31)) >> 56);
+}
+
+///-----------------------------------------------------------
+/// \brief Checks with one perfect hash probe whether a run may
+///        hold an A code
+///
+/// @param1 const eIndexRun_t *run - run
+/// @param2 int64_t a - A code
+///
+/// @return int - 1 unless the code is certainly not in the run
+///-----------------------------------------------------------
+static int eIndexMayHold(const eIndexRun_t *run, int64_t a)
+{
+	uint32_t slot;
+
+	if ((a < run->minA) || (a > run->maxA))
+	{
+		return 0;
+	}
+	slot = mphLookup(&run->mph, a);
+	return (slot < run->keys) && (run->fingerprints[slot] == eIndexFingerprint(a));
+}
+
+///-----------------------------------------------------------
+/// \brief Starts writing a run
+///
+/// @param1 eIndexRunWriter_t *writer - writer
+/// @param2 uint32_t id - run id
+/// @param3 uint32_t level - run level
+/// @param4 uint32_t maxCount - entries at most
+///
+/// @return int - 1 on success
+///-----------------------------------------------------------
+static int eIndexRunBegin(eIndexRunWriter_t *writer, uint32_t id, uint32_t level, uint32_t maxCount)
+{
+	char name[EINDEX_MAX_FILE_NAME];
+	const uint32_t pages = (maxCount + EINDEX_PAGE_ENTRIES - 1) / EINDEX_PAGE_ENTRIES;
+
+	memset(writer, 0, sizeof(*writer));
+	memcpy(writer->header.magic, EINDEX_RUN_MAGIC, sizeof(writer->header.magic));
+	writer->header.version = EINDEX_VERSION;
+	writer->header.level = level;
+	writer->header.pageEntries = EINDEX_PAGE_ENTRIES;
+	writer->maxCount = maxCount;
+	writer->fences = (int64_t *)malloc(((size_t)pages + 1) * sizeof(int64_t));
+	writer->keys = (int64_t *)malloc(((size_t)maxCount + 1) * sizeof(int64_t));
+
+	eIndexRunFileName(id, name);
+	writer->file = fopen(name, "wb");
+	if ((writer->fences == NULL) || (writer->keys == NULL) || (writer->file == NULL))
+	{
+		printf("E index: cannot write %s\n", name);
+		return 0;
+	}
+	setvbuf(writer->file, NULL, _IOFBF, EINDEX_MERGE_BUFFER);
+	/// The header is written again once the count is known
+	fwrite(&writer->header, sizeof(writer->header), 1, writer->file);
+	return 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Appends an entry to a run, in (A, line) order. An
+///        entry equal to the previous one is dropped.
+///
+/// @param1 eIndexRunWriter_t *writer - writer
+/// @param2 const eIndexEntry_t *entry - entry
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void eIndexRunPut(eIndexRunWriter_t *writer, const eIndexEntry_t *entry)
+{
+	const uint32_t count = writer->header.count;
+
+	if ((count > 0) && (entry->a == writer->last.a) && (entry->line == writer->last.line))
+	{
+		return;
+	}
+	configASSERT(count < writer->maxCount);
+	if (count == 0)
+	{
+		writer->header.minA = entry->a;
+	}
+	writer->header.maxA = entry->a;
+	if ((count % EINDEX_PAGE_ENTRIES) == 0)
+	{
+		writer->fences[count / EINDEX_PAGE_ENTRIES] = entry->a;
+	}
+	if ((count == 0) || (entry->a != writer->last.a))
+	{
+		writer->keys[writer->header.keys++] = entry->a;
+	}
+	fwrite(entry, sizeof(*entry), 1, writer->file);
+	writer->last = *entry;
+	writer->header.count++;
+}
+
+///-----------------------------------------------------------
+/// \brief Finishes a run: builds the perfect hash of its A
+///        codes, writes it with the fingerprints, the fences
+///        and the final header, and hands them to the run
+///
+/// @param1 eIndexRunWriter_t *writer - writer
+/// @param2 eIndexRun_t *run - output, unused slot
+/// @param3 uint32_t id - run id
+///
+/// @return int - 1 on success
+///-----------------------------------------------------------
+static int eIndexRunEnd(eIndexRunWriter_t *writer, eIndexRun_t *run, uint32_t id)
+{
+	const uint32_t pages = (writer->header.count + EINDEX_PAGE_ENTRIES - 1) / EINDEX_PAGE_ENTRIES;
+	const uint32_t keys = writer->header.keys;
+	int written;
+
+	if (!mphBuild(&writer->mph, writer->keys, keys))
+	{
+		return 0;
+	}
+	writer->fingerprints = (uint8_t *)malloc((size_t)keys + 1);
+	if (writer->fingerprints == NULL)
+	{
+		return 0;
+	}
+	for (uint32_t i = 0; i < keys; i++)
+	{
+		writer->fingerprints[mphLookup(&writer->mph, writer->keys[i])] = eIndexFingerprint(writer->keys[i]);
+	}
+	free(writer->keys);
+	writer->keys = NULL;
+
+	mphWrite(&writer->mph, writer->file);
+	fwrite(writer->fingerprints, 1, keys, writer->file);
+	fwrite(writer->fences, sizeof(int64_t), pages, writer->file);
+	written = (fseek(writer->file, 0, SEEK_SET) == 0) &&
+		(fwrite(&writer->header, sizeof(writer->header), 1, writer->file) == 1) && !ferror(writer->file);
+	written = (fclose(writer->file) == 0) && written;
+	writer->file = NULL;
+	if (!written)
+	{
+		return 0;
+	}
+
+	memset(run, 0, sizeof(*run));
+	run->used = 1;
+	run->id = id;
+	run->level = writer->header.level;
+	run->count = writer->header.count;
+	run->minA = writer->header.minA;
+	run->maxA = writer->header.maxA;
+	run->pages = pages;
+	run->fences = writer->fences;
+	run->keys = keys;
+	run->mph = writer->mph;
+	run->fingerprints = writer->fingerprints;
+	writer->fences = NULL;
+	writer->fingerprints = NULL;
+	memset(&writer->mph, 0, sizeof(writer->mph));
+	return 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Abandons a run being written and removes its file
+///
+/// @param1 eIndexRunWriter_t *writer - writer
+/// @param2 uint32_t id - run id
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void eIndexRunAbort(eIndexRunWriter_t *writer, uint32_t id)
+{
+	char name[EINDEX_MAX_FILE_NAME];
+
+	if (writer->file != NULL)
+	{
+		fclose(writer->file);
+	}
+	free(writer->fences);
+	free(writer->keys);
+	free(writer->fingerprints);
+	mphFree(&writer->mph);
+	eIndexRunFileName(id, name);
+	remove(name);
+}
+
+///-----------------------------------------------------------
+/// \brief Loads the perfect hash, fingerprints and fences of
+///        a run listed in the manifest
+///
+/// @param1 eIndexRun_t *run - output, unused slot
+/// @param2 const eIndexManifestRun_t *listed - manifest entry
+///
+/// @return int - 1 on success
+///-----------------------------------------------------------
+static int eIndexRunLoad(eIndexRun_t *run, const eIndexManifestRun_t *listed)
+{
+	char name[EINDEX_MAX_FILE_NAME];
+	eIndexRunHeader_t header;
+	int loaded = 0;
+	FILE *file;
+
+	memset(run, 0, sizeof(*run));
+	eIndexRunFileName(listed->id, name);
+	file = fopen(name, "rb");
+	if (file == NULL)
+	{
+		return 0;
+	}
+	if ((fread(&header, sizeof(header), 1, file) == 1) &&
+		(memcmp(header.magic, EINDEX_RUN_MAGIC, sizeof(header.magic)) == 0) && (header.version == EINDEX_VERSION) &&
+		(header.count == listed->count) && (header.pageEntries == EINDEX_PAGE_ENTRIES) && (header.keys <= header.count))
+	{
+		run->pages = (header.count + EINDEX_PAGE_ENTRIES - 1) / EINDEX_PAGE_ENTRIES;
+		run->fences = (int64_t *)malloc(((size_t)run->pages + 1) * sizeof(int64_t));
+		run->fingerprints = (uint8_t *)malloc((size_t)header.keys + 1);
+		loaded = (run->fences != NULL) && (run->fingerprints != NULL) &&
+			(eIndexSeek(file, sizeof(header) + (uint64_t)header.count * sizeof(eIndexEntry_t)) == 0) &&
+			mphRead(&run->mph, file) && (run->mph.keys == header.keys) &&
+			(fread(run->fingerprints, 1, header.keys, file) == header.keys) &&
+			(fread(run->fences, sizeof(int64_t), run->pages, file) == run->pages);
+	}
+	fclose(file);
+	if (!loaded)
+	{
+		free(run->fences);
+		free(run->fingerprints);
+		mphFree(&run->mph);
+		memset(run, 0, sizeof(*run));
+		return 0;
+	}
+
+	run->used = 1;
+	run->live = 1;
+	run->id = listed->id;
+	run->level = header.level;
+	run->count = header.count;
+	run->minA = header.minA;
+	run->maxA = header.maxA;
+	run->keys = header.keys;
+	return 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Finds an unused run slot, leaving some unused
+///
+/// @param1 int spare - unused slots that must remain
+///
+/// @return eIndexRun_t * - slot, NULL if too few are unused
+///-----------------------------------------------------------
+static eIndexRun_t *eIndexAllocRun(int spare)
+{
+	eIndexRun_t *found = NULL;
+
+	for (int i = 0; i < EINDEX_MAX_RUNS; i++)
+	{
+		if (!eIndexRuns[i].used)
+		{
+			if (found != NULL)
+			{
+				spare--;
+			}
+			else
+			{
+				found = &eIndexRuns[i];
+			}
+			if (spare == 0)
+			{
+				return found;
+			}
+		}
+	}
+	return (spare <= 0) ? found : NULL;
+}
+
+///-----------------------------------------------------------
+/// \brief Frees a run that is no longer live once nothing
+///        reads it, and deletes its file. Caller holds the
+///        index mutex.
+///
+/// @param1 eIndexRun_t *run - run
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void eIndexCollectRun(eIndexRun_t *run)
+{
+	char name[EINDEX_MAX_FILE_NAME];
+
+	if (!run->used || run->live || (run->readers > 0))
+	{
+		return;
+	}
+	eIndexRunFileName(run->id, name);
+	remove(name);
+	free(run->fences);
+	free(run->fingerprints);
+	mphFree(&run->mph);
+	memset(run, 0, sizeof(*run));
+}
+
+///-----------------------------------------------------------
+/// \brief Writes the list of live runs to the manifest.
+///        Caller holds the index mutex.
+///
+/// @param N/A
+///
+/// @return int - 1 on success
+///-----------------------------------------------------------
+static int eIndexWriteManifest(void)
+{
+	eIndexManifestHeader_t header;
+	int written;
+	FILE *file;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, EINDEX_MANIFEST_MAGIC, sizeof(header.magic));
+	header.version = EINDEX_VERSION;
+	header.nextRunId = eIndexNextRunId;
+	for (int i = 0; i < EINDEX_MAX_RUNS; i++)
+	{
+		header.runCount += (uint32_t)(eIndexRuns[i].used && eIndexRuns[i].live);
+	}
+
+	file = fopen(EINDEX_MANIFEST_TEMP_FILE_NAME, "wb");
+	if (file == NULL)
+	{
+		return 0;
+	}
+	fwrite(&header, sizeof(header), 1, file);
+	for (int i = 0; i < EINDEX_MAX_RUNS; i++)
+	{
+		if (eIndexRuns[i].used && eIndexRuns[i].live)
+		{
+			eIndexManifestRun_t listed;
+
+			memset(&listed, 0, sizeof(listed));
+			listed.id = eIndexRuns[i].id;
+			listed.level = eIndexRuns[i].level;
+			listed.count = eIndexRuns[i].count;
+			fwrite(&listed, sizeof(listed), 1, file);
+		}
+	}
+	written = !ferror(file);
+	written = (fclose(file) == 0) && written;
+	return written && MoveFileExA(EINDEX_MANIFEST_TEMP_FILE_NAME, EINDEX_MANIFEST_FILE_NAME,
+		MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+}
+
+///-----------------------------------------------------------
+/// \brief Writes the full memtable as a level 0 run and
+///        empties it. Called by the index task, and by the E
+///        writer when it needs the memtable back first. The
+///        index mutex is only held to copy the memtable and to
+///        publish the run; the sort and the run file are done
+///        without it. On a failure the partial run is removed
+///        and the memtable kept for the next flush.
+///
+/// @param N/A
+///
+/// @return int - 1 if the memtable is empty now
+///-----------------------------------------------------------
+static int eIndexFlush(void)
+{
+	static eIndexEntry_t sorted[EINDEX_MEMTABLE_ENTRIES];
+	eIndexRunWriter_t writer;
+	eIndexRun_t finished;
+	eIndexRun_t *run = NULL;
+	uint32_t generation;
+	uint32_t full;
+	uint32_t count;
+	uint32_t id;
+	int written;
+	int emptied;
+
+	xSemaphoreTake(eIndexFlushMutex, portMAX_DELAY);
+	xSemaphoreTake(eIndexMutex, portMAX_DELAY);
+	full = eIndexMemtables->active ^ 1;
+	count = eIndexMemtables->count[full];
+	if (count == 0)
+	{
+		xSemaphoreGive(eIndexMutex);
+		xSemaphoreGive(eIndexFlushMutex);
+		return 1;
+	}
+	/// The full memtable only changes again once it is empty, but a reset
+	/// empties it at any time; the copy is what gets written
+	memcpy(sorted, eIndexMemtables->entries[full], count * sizeof(eIndexEntry_t));
+	generation = eIndexGeneration;
+	id = eIndexNextRunId++;
+	xSemaphoreGive(eIndexMutex);
+
+	qsort(sorted, count, sizeof(eIndexEntry_t), eIndexCompareEntries);
+	written = eIndexRunBegin(&writer, id, 0, count);
+	for (uint32_t i = 0; written && (i < count); i++)
+	{
+		eIndexRunPut(&writer, &sorted[i]);
+	}
+	written = written && eIndexRunEnd(&writer, &finished, id);
+	if (!written)
+	{
+		printf("E index: flush into run %u failed\n", (unsigned int)id);
+		eIndexRunAbort(&writer, id);
+	}
+
+	xSemaphoreTake(eIndexMutex, portMAX_DELAY);
+	if (written && (generation == eIndexGeneration))
+	{
+		/// The last slot is kept for a merge, the only way to free slots;
+		/// until one is done the memtable stays full
+		run = eIndexAllocRun(1);
+	}
+	if (run != NULL)
+	{
+		*run = finished;
+		run->live = 1;
+		if (!eIndexWriteManifest())
+		{
+			/// The old manifest does not list the run, drop it
+			printf("E index: %s could not be written, run %u dropped\n", EINDEX_MANIFEST_FILE_NAME, (unsigned int)id);
+			run->live = 0;
+			eIndexCollectRun(run);
+			run = NULL;
+		}
+	}
+	else if (written)
+	{
+		/// Reset while it was written, or no slot: the finished run is not
+		/// listed anywhere
+		finished.live = 0;
+		eIndexCollectRun(&finished);
+	}
+
+	/// A reset emptied the memtable as well
+	emptied = (run != NULL) || (generation != eIndexGeneration);
+	if (run != NULL)
+	{
+		/// Listed in a run now; a crash before this line indexes them twice
+		eIndexMemtables->count[full] = 0;
+		stateMarkDirty();
+		eIndexCounters.flushes++;
+	}
+	else if (!emptied)
+	{
+		eIndexCounters.failedFlushes++;
+	}
+	xSemaphoreGive(eIndexMutex);
+	xSemaphoreGive(eIndexFlushMutex);
+	return emptied;
+}
+
+///-----------------------------------------------------------
+/// \brief Picks the oldest live runs of a level that are not
+///        being merged. Caller holds the index mutex.
+///
+/// @param1 uint32_t level - level
+/// @param2 eIndexRun_t **inputs - output, EINDEX_FANOUT runs
+///
+/// @return int - runs picked, at most EINDEX_FANOUT
+///-----------------------------------------------------------
+static int eIndexOldestRuns(uint32_t level, eIndexRun_t **inputs)
+{
+	int count = 0;
+
+	for (int i = 0; i < EINDEX_MAX_RUNS; i++)
+	{
+		eIndexRun_t *run = &eIndexRuns[i];
+		int position;
+
+		if (!run->used || !run->live || run->merging || (run->level != level))
+		{
+			continue;
+		}
+		/// Insertion into the list kept in id order, ids grow with time
+		position = (count < EINDEX_FANOUT) ? count++ : EINDEX_FANOUT;
+		while ((position > 0) && (inputs[position - 1]->id > run->id))
+		{
+			if (position < EINDEX_FANOUT)
+			{
+				inputs[position] = inputs[position - 1];
+			}
+			position--;
+		}
+		if (position < EINDEX_FANOUT)
+		{
+			inputs[position] = run;
+		}
+	}
+	return count;
+}
+
+///-----------------------------------------------------------
+/// \brief Merges the oldest EINDEX_FANOUT runs of the lowest
+///        level that has that many into one run of the next
+///        level. Only the index task merges.
+///
+/// @param N/A
+///
+/// @return int - 1 if a merge was done
+///-----------------------------------------------------------
+static int eIndexCompact(void)
+{
+	eIndexRun_t *inputs[EINDEX_FANOUT];
+	FILE *files[EINDEX_FANOUT];
+	eIndexEntry_t heads[EINDEX_FANOUT];
+	uint32_t remaining[EINDEX_FANOUT];
+	eIndexRunWriter_t writer;
+	eIndexRun_t completed;
+	eIndexRun_t *output = NULL;
+	uint32_t generation;
+	uint32_t total = 0;
+	uint32_t level;
+	uint32_t id;
+	int finished;
+	int merged;
+
+	xSemaphoreTake(eIndexMutex, portMAX_DELAY);
+	for (level = 0; level < EINDEX_MAX_LEVELS - 1; level++)
+	{
+		if (eIndexOldestRuns(level, inputs) == EINDEX_FANOUT)
+		{
+			break;
+		}
+	}
+	if (level == EINDEX_MAX_LEVELS - 1)
+	{
+		xSemaphoreGive(eIndexMutex);
+		return 0;
+	}
+	for (int k = 0; k < EINDEX_FANOUT; k++)
+	{
+		inputs[k]->merging = 1;
+		inputs[k]->readers++;
+		total += inputs[k]->count;
+	}
+	generation = eIndexGeneration;
+	id = eIndexNextRunId++;
+	xSemaphoreGive(eIndexMutex);
+
+	/// Streaming k-way merge, one buffered reader per input
+	merged = eIndexRunBegin(&writer, id, level + 1, total);
+	for (int k = 0; k < EINDEX_FANOUT; k++)
+	{
+		char name[EINDEX_MAX_FILE_NAME];
+
+		eIndexRunFileName(inputs[k]->id, name);
+		files[k] = fopen(name, "rb");
+		remaining[k] = inputs[k]->count;
+		if (files[k] == NULL)
+		{
+			merged = 0;
+			remaining[k] = 0;
+			continue;
+		}
+		setvbuf(files[k], NULL, _IOFBF, EINDEX_MERGE_BUFFER);
+		if ((fseek(files[k], sizeof(eIndexRunHeader_t), SEEK_SET) != 0) ||
+			((remaining[k] > 0) && (fread(&heads[k], sizeof(eIndexEntry_t), 1, files[k]) != 1)))
+		{
+			merged = 0;
+			remaining[k] = 0;
+		}
+	}
+	while (merged)
+	{
+		int smallest = -1;
+
+		for (int k = 0; k < EINDEX_FANOUT; k++)
+		{
+			if ((remaining[k] > 0) && ((smallest < 0) || (eIndexCompareEntries(&heads[k], &heads[smallest]) < 0)))
+			{
+				smallest = k;
+			}
+		}
+		if (smallest < 0)
+		{
+			break;
+		}
+		eIndexRunPut(&writer, &heads[smallest]);
+		if ((--remaining[smallest] > 0) && (fread(&heads[smallest], sizeof(eIndexEntry_t), 1, files[smallest]) != 1))
+		{
+			merged = 0;
+		}
+	}
+	for (int k = 0; k < EINDEX_FANOUT; k++)
+	{
+		if (files[k] != NULL)
+		{
+			fclose(files[k]);
+		}
+	}
+
+	/// The perfect hash and the last writes are done without the mutex too
+	finished = merged && eIndexRunEnd(&writer, &completed, id);
+	if (!finished)
+	{
+		eIndexRunAbort(&writer, id);
+	}
+
+	xSemaphoreTake(eIndexMutex, portMAX_DELAY);
+	output = (finished && (generation == eIndexGeneration)) ? eIndexAllocRun(0) : NULL;
+	if (output != NULL)
+	{
+		*output = completed;
+		output->live = 1;
+		for (int k = 0; k < EINDEX_FANOUT; k++)
+		{
+			inputs[k]->live = 0;
+		}
+		if (!eIndexWriteManifest())
+		{
+			/// The old manifest still lists the inputs, keep serving them
+			for (int k = 0; k < EINDEX_FANOUT; k++)
+			{
+				inputs[k]->live = 1;
+			}
+			output->live = 0;
+			eIndexCollectRun(output);
+			merged = 0;
+		}
+	}
+	else
+	{
+		if (merged && (generation == eIndexGeneration))
+		{
+			printf("E index: merge into run %u failed\n", (unsigned int)id);
+		}
+		if (finished)
+		{
+			/// Not listed anywhere, only the file and the filter to free
+			eIndexCollectRun(&completed);
+		}
+		merged = 0;
+	}
+	for (int k = 0; k < EINDEX_FANOUT; k++)
+	{
+		inputs[k]->merging = 0;
+		inputs[k]->readers--;
+		eIndexCollectRun(inputs[k]);
+	}
+	eIndexCounters.compactions += (uint32_t)merged;
+	xSemaphoreGive(eIndexMutex);
+	return merged;
+}
+
+///-----------------------------------------------------------
+/// \brief Reads the pages of a run that can hold an A code
+///
+/// @param1 const eIndexRun_t *run - run, referenced
+/// @param2 int64_t a - A code
+/// @param3 eIndexEntry_t *results - output
+/// @param4 int maxResults - room in results
+///
+/// @return int - entries found
+///-----------------------------------------------------------
+static int eIndexProbeRun(const eIndexRun_t *run, int64_t a, eIndexEntry_t *results, int maxResults)
+{
+	char name[EINDEX_MAX_FILE_NAME];
+	eIndexEntry_t page[EINDEX_PAGE_ENTRIES];
+	uint32_t low = 0;
+	uint32_t high = run->pages;
+	int found = 0;
+	int done = 0;
+	FILE *file;
+
+	/// Last page starting below a: equal codes may begin on it
+	while (high - low > 1)
+	{
+		const uint32_t middle = low + (high - low) / 2;
+
+		if (run->fences[middle] < a)
+		{
+			low = middle;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	eIndexRunFileName(run->id, name);
+	file = fopen(name, "rb");
+	if (file == NULL)
+	{
+		return 0;
+	}
+	for (uint32_t p = low; (p < run->pages) && !done && (found < maxResults); p++)
+	{
+		const uint32_t first = p * EINDEX_PAGE_ENTRIES;
+		const uint32_t entries = ((run->count - first) < EINDEX_PAGE_ENTRIES) ? (run->count - first) : EINDEX_PAGE_ENTRIES;
+
+		if ((eIndexSeek(file, sizeof(eIndexRunHeader_t) + (uint64_t)first * sizeof(eIndexEntry_t)) != 0) ||
+			(fread(page, sizeof(eIndexEntry_t), entries, file) != entries))
+		{
+			break;
+		}
+		for (uint32_t i = 0; (i < entries) && (found < maxResults); i++)
+		{
+			if (page[i].a == a)
+			{
+				results[found++] = page[i];
+			}
+			else if (page[i].a > a)
+			{
+				done = 1;
+				break;
+			}
+		}
+	}
+	fclose(file);
+	return found;
+}
+
+///-----------------------------------------------------------
+/// \brief Index task: flushes full memtables and merges runs
+///
+/// @param 1 void *pvParameters - placeholder for FreeRTOS
+///                               Task parameters
+///
+/// @return None - Task always runs without a return
+///-----------------------------------------------------------
+static void eIndexTask(void *pvParameters)
+{
+	const TickType_t xPollInterval = EINDEX_POLL_INTERVAL_MS / portTICK_PERIOD_MS;
+
+	/// Just to remove compiler warnings
+	(void)pvParameters;
+
+	for (;;)
+	{
+		vTaskDelay(xPollInterval);
+		eIndexFlush();
+		/// A long merge cascade still flushes in between
+		while (eIndexCompact())
+		{
+			eIndexFlush();
+		}
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Loads the manifest and the runs, and attaches the
+///        persistent memtables
+///
+/// @param1 eIndexMemtables_t *memtables - memtables, zeroed on
+///                                        a cold start
+///
+/// @return N/A
+///-----------------------------------------------------------
+void eIndexInit(eIndexMemtables_t *memtables)
+{
+	eIndexManifestHeader_t header;
+	FILE *file;
+
+	if ((memtables->active > 1) || (memtables->count[0] > EINDEX_MEMTABLE_ENTRIES) ||
+		(memtables->count[1] > EINDEX_MEMTABLE_ENTRIES))
+	{
+		/// Not written by this code, start over
+		memset(memtables, 0, sizeof(*memtables));
+	}
+	eIndexMemtables = memtables;
+	eIndexMutex = xSemaphoreCreateMutex();
+	eIndexFlushMutex = xSemaphoreCreateMutex();
+	configASSERT((eIndexMutex != NULL) && (eIndexFlushMutex != NULL));
+
+	file = fopen(EINDEX_MANIFEST_FILE_NAME, "rb");
+	if (file == NULL)
+	{
+		return;
+	}
+	if ((fread(&header, sizeof(header), 1, file) == 1) &&
+		(memcmp(header.magic, EINDEX_MANIFEST_MAGIC, sizeof(header.magic)) == 0) && (header.version == EINDEX_VERSION))
+	{
+		eIndexNextRunId = header.nextRunId;
+		for (uint32_t i = 0; i < header.runCount; i++)
+		{
+			eIndexManifestRun_t listed;
+			eIndexRun_t *run = eIndexAllocRun(0);
+
+			if ((run == NULL) || (fread(&listed, sizeof(listed), 1, file) != 1))
+			{
+				printf("E index: %s is truncated\n", EINDEX_MANIFEST_FILE_NAME);
+				break;
+			}
+			if (!eIndexRunLoad(run, &listed))
+			{
+				printf("E index: run %u is unreadable, its records are not indexed\n", (unsigned int)listed.id);
+			}
+		}
+	}
+	else if ((memcmp(header.magic, EINDEX_MANIFEST_MAGIC, sizeof(header.magic)) == 0) && (header.version < EINDEX_VERSION))
+	{
+		/// Runs of an older format: drop them, later records are indexed anew
+		eIndexManifestRun_t listed;
+		char name[EINDEX_MAX_FILE_NAME];
+
+		eIndexNextRunId = header.nextRunId;
+		for (uint32_t i = 0; (i < header.runCount) && (fread(&listed, sizeof(listed), 1, file) == 1); i++)
+		{
+			eIndexRunFileName(listed.id, name);
+			remove(name);
+		}
+		printf("E index: dropped the runs of index version %u, earlier records are not indexed\n",
+			(unsigned int)header.version);
+	}
+	fclose(file);
+}
+
+///-----------------------------------------------------------
+/// \brief Creates the index task
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+void eIndexCreateTask(void)
+{
+	xTaskCreate(eIndexTask, "EIndex", configMINIMAL_STACK_SIZE, NULL, EINDEX_TASK_PRIORITY, NULL);
+}
+
+///-----------------------------------------------------------
+/// \brief Indexes one E record. Called by the E log writer
+///        only; lookups may read the memtable at any time, so
+///        the entry is complete before the count covers it.
+///
+/// @param1 int64_t a - A code of the record
+/// @param2 uint32_t line - line number
+/// @param3 uint32_t block - E log block of the line
+///
+/// @return N/A
+///-----------------------------------------------------------
+void eIndexAdd(int64_t a, uint32_t line, uint32_t block)
+{
+	uint32_t active;
+	eIndexEntry_t *entry;
+
+	if (eIndexMutex == NULL)
+	{
+		return;
+	}
+	active = eIndexMemtables->active;
+	if (eIndexMemtables->count[active] == EINDEX_MEMTABLE_ENTRIES)
+	{
+		/// The other memtable takes over once it is in a run
+		if (eIndexMemtables->count[active ^ 1] != 0)
+		{
+			eIndexCounters.writerFlushes++;
+			/// No room for the entry until the other memtable is in a
+			/// run; the E writer waits, as it would for a full disk
+			while (!eIndexFlush())
+			{
+				vTaskDelay(EINDEX_POLL_INTERVAL_MS / portTICK_PERIOD_MS);
+			}
+		}
+		xSemaphoreTake(eIndexMutex, portMAX_DELAY);
+		active ^= 1;
+		eIndexMemtables->active = active;
+		xSemaphoreGive(eIndexMutex);
+	}
+
+	entry = &eIndexMemtables->entries[active][eIndexMemtables->count[active]];
+	entry->a = a;
+	entry->line = line;
+	entry->block = block;
+	PAYRANGE_COMPILER_BARRIER();
+	eIndexMemtables->count[active]++;
+}
+
+///-----------------------------------------------------------
+/// \brief Drops every run and both memtables. Called by the E
+///        log writer when it starts a new file.
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+void eIndexReset(void)
+{
+	if (eIndexMutex == NULL)
+	{
+		return;
+	}
+	xSemaphoreTake(eIndexMutex, portMAX_DELAY);
+	eIndexGeneration++;
+	for (int i = 0; i < EINDEX_MAX_RUNS; i++)
+	{
+		eIndexRuns[i].live = 0;
+		eIndexCollectRun(&eIndexRuns[i]);
+	}
+	eIndexMemtables->count[0] = 0;
+	eIndexMemtables->count[1] = 0;
+	if (!eIndexWriteManifest())
+	{
+		/// The next flush writes it; until then a restart finds the runs
+		/// gone and reports them unreadable, which leaves the same index
+		printf("E index: %s could not be written\n", EINDEX_MANIFEST_FILE_NAME);
+	}
+	xSemaphoreGive(eIndexMutex);
+}
+
+///-----------------------------------------------------------
+/// \brief Finds the E records of an A code
+///
+/// @param1 int64_t a - A code
+/// @param2 eIndexEntry_t *results - output, in line order
+/// @param3 int maxResults - room in results
+///
+/// @return int - records found
+///-----------------------------------------------------------
+int eIndexLookup(int64_t a, eIndexEntry_t *results, int maxResults)
+{
+	eIndexRun_t *candidates[EINDEX_MAX_RUNS];
+	int candidateCount = 0;
+	int found = 0;
+	int unique = 0;
+
+	if (eIndexMutex == NULL)
+	{
+		return 0;
+	}
+	xSemaphoreTake(eIndexMutex, portMAX_DELAY);
+	eIndexCounters.lookups++;
+	for (int table = 0; table < 2; table++)
+	{
+		const uint32_t count = eIndexMemtables->count[table];
+
+		PAYRANGE_COMPILER_BARRIER();
+		for (uint32_t i = 0; (i < count) && (found < maxResults); i++)
+		{
+			if (eIndexMemtables->entries[table][i].a == a)
+			{
+				results[found++] = eIndexMemtables->entries[table][i];
+			}
+		}
+	}
+	for (int i = 0; i < EINDEX_MAX_RUNS; i++)
+	{
+		eIndexRun_t *run = &eIndexRuns[i];
+
+		if (!run->used || !run->live)
+		{
+			continue;
+		}
+		if (!eIndexMayHold(run, a))
+		{
+			eIndexCounters.runsSkipped++;
+			continue;
+		}
+		run->readers++;
+		candidates[candidateCount++] = run;
+	}
+	xSemaphoreGive(eIndexMutex);
+
+	/// Run files never change, they are read without the mutex
+	for (int i = 0; i < candidateCount; i++)
+	{
+		found += eIndexProbeRun(candidates[i], a, results + found, maxResults - found);
+	}
+
+	xSemaphoreTake(eIndexMutex, portMAX_DELAY);
+	eIndexCounters.runsRead += (uint32_t)candidateCount;
+	for (int i = 0; i < candidateCount; i++)
+	{
+		candidates[i]->readers--;
+		eIndexCollectRun(candidates[i]);
+	}
+	xSemaphoreGive(eIndexMutex);
+
+	/// A record in a memtable and in the run it was flushed to is listed once
+	qsort(results, (size_t)found, sizeof(eIndexEntry_t), eIndexCompareLines);
+	for (int i = 0; i < found; i++)
+	{
+		if ((unique == 0) || (results[i].line != results[unique - 1].line))
+		{
+			results[unique++] = results[i];
+		}
+	}
+	return unique;
+}
+
+///-----------------------------------------------------------
+/// \brief Copies the counters
+///
+/// @param1 eIndexStats_t *stats - output
+///
+/// @return N/A
+///-----------------------------------------------------------
+void eIndexGetStats(eIndexStats_t *stats)
+{
+	xSemaphoreTake(eIndexMutex, portMAX_DELAY);
+	*stats = eIndexCounters;
+	stats->runs = 0;
+	stats->levels = 0;
+	stats->runEntries = 0;
+	stats->runKeys = 0;
+	stats->filterBytes = 0;
+	for (int i = 0; i < EINDEX_MAX_RUNS; i++)
+	{
+		if (eIndexRuns[i].used && eIndexRuns[i].live)
+		{
+			stats->runs++;
+			stats->runEntries += eIndexRuns[i].count;
+			stats->runKeys += eIndexRuns[i].keys;
+			stats->filterBytes += mphSizeBytes(&eIndexRuns[i].mph) + eIndexRuns[i].keys +
+				((uint64_t)eIndexRuns[i].pages + 1) * sizeof(int64_t);
+			if (eIndexRuns[i].level + 1 > stats->levels)
+			{
+				stats->levels = eIndexRuns[i].level + 1;
+			}
+		}
+	}
+	stats->memtableEntries = eIndexMemtables->count[0] + eIndexMemtables->count[1];
+	xSemaphoreGive(eIndexMutex);
+}
+
+///-----------------------------------------------------------
+/// \brief Prints the counters
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+void eIndexPrintStats(void)
+{
+	eIndexStats_t stats;
+
+	eIndexGetStats(&stats);
+	printf("E index: %u runs in %u levels, %" PRIu64 " + %u entries, %u flushes (%u by the writer, %u failed), %u merges\n",
+		(unsigned int)stats.runs, (unsigned int)stats.levels, stats.runEntries, (unsigned int)stats.memtableEntries,
+		(unsigned int)stats.flushes, (unsigned int)stats.writerFlushes, (unsigned int)stats.failedFlushes,
+		(unsigned int)stats.compactions);
+	printf("E index: %u lookups read %u runs, %u runs ruled out\n", (unsigned int)stats.lookups,
+		(unsigned int)stats.runsRead, (unsigned int)stats.runsSkipped);
+	if (stats.runKeys > 0)
+	{
+		printf("E index: %" PRIu64 " codes in runs, filters and fences take %" PRIu64 " bytes (%.1f bits per code)\n",
+			stats.runKeys, stats.filterBytes, (double)stats.filterBytes * 8 / (double)stats.runKeys);
+	}
+}
@@ -0,0 +1,123 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_eindex.h
+///-----------------------------------------------------------------------------
+///
+/// \brief Persistent A to E index: a log-structured merge index from A code
+///        to the line and block of every E record, maintained by the E log
+///        writer and compacted by a low priority task
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_EINDEX_H
+#define PAYRANGE_EINDEX_H
+
+/// Standard includes
+#include <stdint.h>
+
+/// Kernel includes
+#include <FreeRTOS.h>
+
+/// E index configurable defines
+/// Manifest listing the runs; run N is stored in E.idx.<N>
+#define EINDEX_MANIFEST_FILE_NAME       "E.idx"
+#define EINDEX_MANIFEST_TEMP_FILE_NAME  "E.idx.tmp"
+#define EINDEX_RUN_FILE_FORMAT          "E.idx.%08u"
+/// Entries per memtable; two of them live in the state file
+#define EINDEX_MEMTABLE_ENTRIES         ( 512 )
+/// Runs of one level merged into a run of the next level
+#define EINDEX_FANOUT                   ( 4 )
+#define EINDEX_MAX_LEVELS               ( 16 )
+/// Live runs plus runs that were compacted away but are still being read
+#define EINDEX_MAX_RUNS                 ( 2 * EINDEX_FANOUT * EINDEX_MAX_LEVELS )
+/// Entries per page, the unit a lookup reads from a run
+#define EINDEX_PAGE_ENTRIES             ( 128 )
+/// How often the index task looks for a memtable to flush or runs to merge
+#define EINDEX_POLL_INTERVAL_MS         ( 250 )
+#define EINDEX_TASK_PRIORITY            ( tskIDLE_PRIORITY + 1 )
+/// Merge input and output buffers
+#define EINDEX_MERGE_BUFFER             ( 256 * 1024 )
+/// History records listed by a console lookup (G key)
+#define EINDEX_LOOKUP_MAX_RESULTS       ( 64 )
+
+/// Run and manifest format identification
+#define EINDEX_RUN_MAGIC                "PRIDXRN1"
+#define EINDEX_MANIFEST_MAGIC           "PRIDXMF1"
+#define EINDEX_VERSION                  ( 2 )
+
+/// One indexed E record
+typedef struct
+{
+	int64_t  a;
+	uint32_t line;
+	/// E log block holding the line (payrange_elog.h)
+	uint32_t block;
+}eIndexEntry_t;
+
+/// The two memtables, kept in the state file so that records not yet in a
+/// run survive a restart. One takes new entries, the other is full and
+/// waits for the index task to write it as a run (or is empty).
+typedef struct
+{
+	uint32_t      active;
+	uint32_t      count[2];
+	eIndexEntry_t entries[2][EINDEX_MEMTABLE_ENTRIES];
+}eIndexMemtables_t;
+
+/// Header of a run file: the sorted entries follow, then the perfect hash
+/// of the distinct A codes, a fingerprint per code and the first A of every
+/// page
+typedef struct
+{
+	char     magic[8];
+	uint32_t version;
+	uint32_t level;
+	uint32_t count;
+	uint32_t pageEntries;
+	/// Distinct A codes
+	uint32_t keys;
+	uint32_t reserved0;
+	int64_t  minA;
+	int64_t  maxA;
+	uint8_t  reserved[16];
+}eIndexRunHeader_t;
+
+/// E index counters
+typedef struct
+{
+	uint32_t runs;
+	uint32_t levels;
+	uint64_t runEntries;
+	/// Distinct codes of the runs and RAM held by their filters and fences
+	uint64_t runKeys;
+	uint64_t filterBytes;
+	uint32_t memtableEntries;
+	uint32_t flushes;
+	/// Flushes that could not write their run or the manifest, retried later
+	uint32_t failedFlushes;
+	uint32_t compactions;
+	/// Times the E writer flushed a memtable itself, the index task being late
+	uint32_t writerFlushes;
+	uint32_t lookups;
+	/// Runs read by lookups, and runs their filter or key range ruled out
+	uint32_t runsRead;
+	uint32_t runsSkipped;
+}eIndexStats_t;
+
+/// Loads the manifest and the runs, and keeps the memtables in persistent
+/// memory (zeroed on a cold start); call before the E log is written
+void eIndexInit(eIndexMemtables_t *memtables);
+/// Creates the low priority task that flushes memtables and merges runs
+void eIndexCreateTask(void);
+/// E log writer: indexes one record
+void eIndexAdd(int64_t a, uint32_t line, uint32_t block);
+/// E log writer: drops the whole index, the E log starts over
+void eIndexReset(void);
+/// Copies up to maxResults records holding A code a, in line order;
+/// returns the number found
+int eIndexLookup(int64_t a, eIndexEntry_t *results, int maxResults);
+/// Copies the counters
+void eIndexGetStats(eIndexStats_t *stats);
+/// Prints the counters
+void eIndexPrintStats(void);
+
+#endif /// PAYRANGE_EINDEX_H
@@ -0,0 +1,1501 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_elog.c
+///-----------------------------------------------------------------------------
+///
+/// \brief Tamper-evident E log
+///
+/// Every E record is still written to E.txt as its own "Line" as soon as it
+/// is generated, but hashing is deferred: records are collected into blocks of
+/// up to ELOG_RECORDS_PER_BLOCK lines. When a block is full (or has been open
+/// for ELOG_SEAL_INTERVAL_MS) its lines are hashed as Merkle leaves in one
+/// multi-buffer batch and a trailer line is appended:
+///
+///     Seal <block>: <first line> <record count> <merkle root> <chain>
+///
+/// where chain = SHA-256(0x02 || previous chain || root || block || first line
+/// || count), and the chain of block 0 starts from 32 zero bytes. Leaves are
+/// SHA-256(0x00 || line text) and interior nodes SHA-256(0x01 || left ||
+/// right); an unpaired node is carried up to the next level unchanged.
+///
+/// With ELOG_ENCRYPT_AT_REST the records of a block are kept in RAM until the
+/// seal and the block text (lines and trailer) is written to E.enc as one AEAD
+/// record behind a segment header:
+///
+///     elogSegmentHeader_t, then per block:
+///     elogRecordHeader_t | ciphertext | 16 byte tag
+///
+/// The nonce is the segment's random salt followed by the little-endian block
+/// index and the AAD is the segment header followed by the record header, so
+/// records can't be reordered, moved between segments or truncated unnoticed.
+/// Every session appends a new segment (header with a fresh salt) to E.enc;
+/// block indexes and the chain carry on across segments, so a block index
+/// written again after a torn tail never reuses a nonce.
+/// In both modes E.blk gets one elogBlockEntry_t per sealed block, which lets
+/// a reader fetch (and authenticate) any block without scanning the file.
+/// Every record is also added to the A to E index (payrange_eindex.h) with
+/// the block it goes into, and a new file starts a new index.
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+/// Standard includes
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+/// Kernel includes
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+
+#include "payrange_elog.h"
+#include "payrange_csprng.h"
+#include "payrange_eindex.h"
+
+/// Size of one verifier read, large sequential reads keep it at disk speed
+#define ELOG_VERIFY_READ_SIZE           ( 1024 * 1024 )
+/// Longest partial line carried over between two reads
+#define ELOG_VERIFY_MAX_CARRY           ( 256 )
+
+/// 64-bit file positions, E logs outgrow 2 GB long before the demo stops
+#ifdef _WIN32
+#define elogTell( file )                _ftelli64( file )
+#define elogSeek( file, offset )        _fseeki64( ( file ), ( offset ), SEEK_SET )
+#define elogTruncate( file, size )      _chsize_s( _fileno( file ), ( size ) )
+#else
+#define elogTell( file )                ftello( file )
+#define elogSeek( file, offset )        fseeko( ( file ), ( off_t )( offset ), SEEK_SET )
+#define elogTruncate( file, size )      ftruncate( fileno( file ), ( off_t )( size ) )
+#endif
+
+/// Verifier working state for the block being collected
+typedef struct
+{
+	uint8_t  chainHead[SHA256_DIGEST_SIZE];
+	uint32_t blockIndex;
+	uint32_t firstLine;
+	uint32_t recordCount;
+	uint16_t lineLength[ELOG_RECORDS_PER_BLOCK];
+	char     lines[ELOG_RECORDS_PER_BLOCK][ELOG_MAX_LINE_LENGTH];
+}elogVerifyState_t;
+
+/// Serialises the writer (records, seals, poll) between tasks. A mutex with
+/// priority inheritance rather than a critical section: file operations run
+/// under it, and tasks that don't write the log must not wait for them.
+static SemaphoreHandle_t elogMutex = NULL;
+/// Open E log handle (E.txt or E.enc), kept open between records
+static FILE *elogFile = NULL;
+/// Open E.blk handle
+static FILE *elogBlockTable = NULL;
+/// Open block and chain head of the writer; in RAM until elogAttachState()
+/// moves them into the persistent state file
+static elogBlockState_t elogLocalState;
+static elogBlockState_t *elogState = &elogLocalState;
+/// Encrypted writer: segment header, keyed cipher and the first block of
+/// the session's segment
+static elogSegmentHeader_t elogHeader;
+static aeadContext_t elogCipher;
+static uint32_t elogSegmentFirstBlock;
+/// Encrypted writer: block text and ciphertext of the block being sealed
+static char elogBlockText[ELOG_MAX_BLOCK_TEXT];
+static uint8_t elogCipherText[ELOG_MAX_BLOCK_RECORD];
+
+///-----------------------------------------------------------
+/// \brief Converts a digest to lower-case hex
+///
+/// @param1 const uint8_t digest[32] - digest
+/// @param2 char hex[65] - output, NUL terminated
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void elogDigestToHex(const uint8_t digest[SHA256_DIGEST_SIZE], char hex[2 * SHA256_DIGEST_SIZE + 1])
+{
+	static const char hexDigits[] = "0123456789abcdef";
+
+	for (int i = 0; i < SHA256_DIGEST_SIZE; i++)
+	{
+		hex[2 * i] = hexDigits[digest[i] >> 4];
+		hex[2 * i + 1] = hexDigits[digest[i] & 0x0F];
+	}
+	hex[2 * SHA256_DIGEST_SIZE] = '\0';
+}
+
+///-----------------------------------------------------------
+/// \brief Parses 64 hex characters into a digest
+///
+/// @param1 const char *hex - hex text
+/// @param2 uint8_t digest[32] - output
+///
+/// @return int - 1 on success, 0 on malformed input
+///-----------------------------------------------------------
+static int elogHexToDigest(const char *hex, uint8_t digest[SHA256_DIGEST_SIZE])
+{
+	for (int i = 0; i < 2 * SHA256_DIGEST_SIZE; i++)
+	{
+		int nibble;
+		char c = hex[i];
+		if ((c >= '0') && (c <= '9'))
+		{
+			nibble = c - '0';
+		}
+		else if ((c >= 'a') && (c <= 'f'))
+		{
+			nibble = c - 'a' + 10;
+		}
+		else
+		{
+			return 0;
+		}
+		if (i & 1)
+		{
+			digest[i / 2] = (uint8_t)(digest[i / 2] | nibble);
+		}
+		else
+		{
+			digest[i / 2] = (uint8_t)(nibble << 4);
+		}
+	}
+	return (hex[2 * SHA256_DIGEST_SIZE] == '\0');
+}
+
+///-----------------------------------------------------------
+/// \brief Computes the Merkle root of a block of lines. All
+///        hashes of one tree level go through a single
+///        multi-buffer batch.
+///
+/// @param1 const uint8_t *const *lines - leaf texts
+/// @param2 const size_t *lengths - leaf lengths
+/// @param3 int count - number of leaves (1..ELOG_RECORDS_PER_BLOCK)
+/// @param4 uint8_t root[32] - output
+///
+/// @return N/A
+///-----------------------------------------------------------
+void elogMerkleRoot(const uint8_t *const *lines, const size_t *lengths, int count, uint8_t root[SHA256_DIGEST_SIZE])
+{
+	uint8_t level[ELOG_RECORDS_PER_BLOCK][SHA256_DIGEST_SIZE];
+	uint8_t parents[ELOG_RECORDS_PER_BLOCK / 2][SHA256_DIGEST_SIZE];
+	const uint8_t *pairs[ELOG_RECORDS_PER_BLOCK / 2];
+	size_t pairLengths[ELOG_RECORDS_PER_BLOCK / 2];
+
+	configASSERT((count > 0) && (count <= ELOG_RECORDS_PER_BLOCK));
+
+	sha256ManyPrefixed(ELOG_LEAF_PREFIX, lines, lengths, level, count);
+	while (count > 1)
+	{
+		int pairCount = count / 2;
+		/// Sibling digests are adjacent, so each pair is one 64 byte message
+		for (int i = 0; i < pairCount; i++)
+		{
+			pairs[i] = level[2 * i];
+			pairLengths[i] = 2 * SHA256_DIGEST_SIZE;
+		}
+		sha256ManyPrefixed(ELOG_NODE_PREFIX, pairs, pairLengths, parents, pairCount);
+		memcpy(level, parents, (size_t)pairCount * SHA256_DIGEST_SIZE);
+		if (count & 1)
+		{
+			memcpy(level[pairCount], level[count - 1], SHA256_DIGEST_SIZE);
+		}
+		count = pairCount + (count & 1);
+	}
+	memcpy(root, level[0], SHA256_DIGEST_SIZE);
+}
+
+///-----------------------------------------------------------
+/// \brief Links a block root into the hash chain
+///
+/// @param1 const uint8_t previous[32] - chain value of the previous block
+/// @param2 const uint8_t root[32] - Merkle root of this block
+/// @param3 uint32_t blockIndex - index of this block
+/// @param4 uint32_t firstLine - line number of the first record
+/// @param5 uint32_t recordCount - records in the block
+/// @param6 uint8_t next[32] - chain value of this block
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void elogChainLink(const uint8_t previous[SHA256_DIGEST_SIZE], const uint8_t root[SHA256_DIGEST_SIZE],
+	uint32_t blockIndex, uint32_t firstLine, uint32_t recordCount, uint8_t next[SHA256_DIGEST_SIZE])
+{
+	const uint8_t prefix = ELOG_CHAIN_PREFIX;
+	const uint32_t fields[3] = { blockIndex, firstLine, recordCount };
+	uint8_t encoded[sizeof(fields)];
+	sha256Context_t context;
+
+	/// Fixed little-endian encoding, independent of the host
+	for (int i = 0; i < 3; i++)
+	{
+		encoded[4 * i] = (uint8_t)fields[i];
+		encoded[4 * i + 1] = (uint8_t)(fields[i] >> 8);
+		encoded[4 * i + 2] = (uint8_t)(fields[i] >> 16);
+		encoded[4 * i + 3] = (uint8_t)(fields[i] >> 24);
+	}
+	sha256Init(&context);
+	sha256Update(&context, &prefix, 1);
+	sha256Update(&context, previous, SHA256_DIGEST_SIZE);
+	sha256Update(&context, root, SHA256_DIGEST_SIZE);
+	sha256Update(&context, encoded, sizeof(encoded));
+	sha256Final(&context, next);
+}
+
+///-----------------------------------------------------------
+/// \brief Links a block into the hash chain and formats its
+///        seal trailer
+///
+/// @param1 uint8_t chainHead[32] - chain of the previous block,
+///                                 replaced by this block's
+/// @param2 const uint8_t root[32] - Merkle root of the block
+/// @param3 uint32_t blockIndex - index of the block
+/// @param4 uint32_t firstLine - line number of the first record
+/// @param5 uint32_t recordCount - records in the block
+/// @param6 char *text - trailer output, newline terminated
+/// @param7 size_t capacity - size of text
+///
+/// @return size_t - length of the trailer
+///-----------------------------------------------------------
+size_t elogFormatSeal(uint8_t chainHead[SHA256_DIGEST_SIZE], const uint8_t root[SHA256_DIGEST_SIZE],
+	uint32_t blockIndex, uint32_t firstLine, uint32_t recordCount, char *text, size_t capacity)
+{
+	char rootHex[2 * SHA256_DIGEST_SIZE + 1];
+	char chainHex[2 * SHA256_DIGEST_SIZE + 1];
+	int length;
+
+	elogChainLink(chainHead, root, blockIndex, firstLine, recordCount, chainHead);
+	elogDigestToHex(root, rootHex);
+	elogDigestToHex(chainHead, chainHex);
+	length = snprintf(text, capacity, "Seal %u: %u %u %s %s\n", (unsigned int)blockIndex, (unsigned int)firstLine,
+		(unsigned int)recordCount, rootHex, chainHex);
+	configASSERT((length > 0) && ((size_t)length < capacity));
+	return (size_t)length;
+}
+
+///-----------------------------------------------------------
+/// \brief Formats an E record as its E log line
+///
+/// @param1 int lineNumber - line number of the record
+/// @param2 const valueE_t *valueE - record
+/// @param3 char line[] - output, without the newline
+///
+/// @return int - length of the line
+///-----------------------------------------------------------
+int elogFormatRecord(int lineNumber, const valueE_t *valueE, char line[ELOG_MAX_LINE_LENGTH])
+{
+	int lineLength;
+
+	///No Specific order has been listed for Value E, so writing the contents in structure order
+	lineLength = snprintf(line, ELOG_MAX_LINE_LENGTH, "Line %d: %d %s %"PRIu64" %d %"PRIu64" %"PRIu64, lineNumber,
+		valueE->randomValueB.stringTime,
+		valueE->randomValueB.stringPlacer,
+		valueE->randomValueB.stringTimeUtcNs,
+		valueE->currentValueD.randomNumberTime,
+		valueE->currentValueD.randomNumber,
+		valueE->currentValueD.randomNumberTimeUtcNs);
+	configASSERT((lineLength > 0) && (lineLength < ELOG_MAX_LINE_LENGTH));
+	return lineLength;
+}
+
+///-----------------------------------------------------------
+/// \brief Loads a raw 32 byte key file and derives its id
+///
+/// @param1 const char *path - key file
+/// @param2 uint8_t key[32] - key output
+/// @param3 uint8_t keyId[8] - first bytes of SHA-256(key)
+///
+/// @return int - 1 on success, 0 if missing or not 32 bytes
+///-----------------------------------------------------------
+static int elogLoadKey(const char *path, uint8_t key[AEAD_KEY_SIZE], uint8_t keyId[8])
+{
+	uint8_t digest[SHA256_DIGEST_SIZE];
+	uint8_t extra;
+	size_t keyLength;
+	FILE *file = fopen(path, "rb");
+
+	if (file == NULL)
+	{
+		return 0;
+	}
+	keyLength = fread(key, 1, AEAD_KEY_SIZE, file);
+	/// Anything but exactly one key is a wrong file, not a longer key
+	if ((keyLength != AEAD_KEY_SIZE) || (fread(&extra, 1, 1, file) != 0))
+	{
+		fclose(file);
+		memset(key, 0, AEAD_KEY_SIZE);
+		return 0;
+	}
+	fclose(file);
+
+	sha256(key, AEAD_KEY_SIZE, digest);
+	memcpy(keyId, digest, 8);
+	return 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Builds the nonce and AAD of one encrypted block
+///
+/// @param1 const elogSegmentHeader_t *header - segment header
+/// @param2 const elogRecordHeader_t *record - record header
+/// @param3 uint8_t nonce[12] - salt || LE32(block index)
+/// @param4 uint8_t aad[] - segment header || record header
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void elogBlockNonce(const elogSegmentHeader_t *header, const elogRecordHeader_t *record,
+	uint8_t nonce[AEAD_NONCE_SIZE], uint8_t aad[sizeof(elogSegmentHeader_t) + sizeof(elogRecordHeader_t)])
+{
+	memcpy(nonce, header->nonceSalt, sizeof(header->nonceSalt));
+	nonce[8] = (uint8_t)record->blockIndex;
+	nonce[9] = (uint8_t)(record->blockIndex >> 8);
+	nonce[10] = (uint8_t)(record->blockIndex >> 16);
+	nonce[11] = (uint8_t)(record->blockIndex >> 24);
+	memcpy(aad, header, sizeof(*header));
+	memcpy(aad + sizeof(*header), record, sizeof(*record));
+}
+
+///-----------------------------------------------------------
+/// \brief Starts a new encrypted segment: keys the cipher and
+///        fills in the header with a fresh nonce salt
+///
+/// @param1 const char *keyPath - key file
+/// @param2 elogSegmentHeader_t *header - header to write first
+/// @param3 aeadContext_t *cipher - keyed cipher output
+///
+/// @return int - 1 on success, 0 if the key file is not valid
+///         or no nonce salt or keyed cipher could be made
+///-----------------------------------------------------------
+int elogCreateSegment(const char *keyPath, elogSegmentHeader_t *header, aeadContext_t *cipher)
+{
+	uint8_t key[AEAD_KEY_SIZE];
+	int created;
+
+	memset(header, 0, sizeof(*header));
+	if (!elogLoadKey(keyPath, key, header->keyId))
+	{
+		return 0;
+	}
+	memcpy(header->magic, ELOG_SEGMENT_MAGIC, sizeof(header->magic));
+	header->version = ELOG_SEGMENT_VERSION;
+	header->cipher = (uint32_t)aeadPreferredCipher();
+	created = csprngOsEntropy(header->nonceSalt, sizeof(header->nonceSalt)) &&
+		aeadInit(cipher, (aeadCipher_t)header->cipher, key);
+	memset(key, 0, sizeof(key));
+	return created;
+}
+
+///-----------------------------------------------------------
+/// \brief Encrypts a block text into one segment record
+///
+/// @param1 const elogSegmentHeader_t *header - segment header
+/// @param2 const aeadContext_t *cipher - keyed cipher
+/// @param3 uint32_t blockIndex - index of the block
+/// @param4 const char *text - block text (lines and trailer)
+/// @param5 size_t length - bytes in text
+/// @param6 uint8_t *record - output, ELOG_MAX_BLOCK_RECORD bytes
+///
+/// @return uint32_t - size of the record
+///-----------------------------------------------------------
+uint32_t elogEncryptBlock(const elogSegmentHeader_t *header, const aeadContext_t *cipher, uint32_t blockIndex,
+	const char *text, size_t length, uint8_t *record)
+{
+	elogRecordHeader_t recordHeader;
+	uint8_t nonce[AEAD_NONCE_SIZE];
+	uint8_t aad[sizeof(elogSegmentHeader_t) + sizeof(elogRecordHeader_t)];
+
+	configASSERT(length <= ELOG_MAX_BLOCK_TEXT);
+	recordHeader.blockIndex = blockIndex;
+	recordHeader.length = (uint32_t)length;
+	elogBlockNonce(header, &recordHeader, nonce, aad);
+	memcpy(record, &recordHeader, sizeof(recordHeader));
+	aeadSeal(cipher, nonce, aad, sizeof(aad), (const uint8_t *)text, length, record + sizeof(recordHeader),
+		record + sizeof(recordHeader) + length);
+	return (uint32_t)(sizeof(recordHeader) + length + AEAD_TAG_SIZE);
+}
+
+///-----------------------------------------------------------
+/// \brief Opens an existing file for update, or creates it
+///
+/// @param1 const char *path - file
+///
+/// @return FILE * - the file, NULL on failure
+///-----------------------------------------------------------
+static FILE *elogOpenForUpdate(const char *path)
+{
+	FILE *file = fopen(path, "r+b");
+
+	return (file != NULL) ? file : fopen(path, "w+b");
+}
+
+///-----------------------------------------------------------
+/// \brief Opens the encrypted log and the block table for a
+///        new session. A continued log is cut back to the
+///        blocks the state knows (dropping a block or table
+///        row torn by a crash) and gets a new segment header,
+///        so the session's nonces come from a fresh salt.
+///
+/// @param1 int append - 1 if the state continues the log
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void elogOpenEncrypted(int append)
+{
+	elogBlockEntry_t last;
+	uint64_t end = 0;
+
+	if (!elogCreateSegment(ELOG_KEY_FILE_NAME, &elogHeader, &elogCipher))
+	{
+		printf("E log: no segment could be started with the key in %s (--genkey creates one)\n", ELOG_KEY_FILE_NAME);
+		configASSERT(0);
+	}
+	if (append && (elogState->blockIndex > 0))
+	{
+		if (!elogReadBlockEntry(elogState->blockIndex - 1, &last))
+		{
+			printf("E log: %s is shorter than the state, the earlier blocks are not readable\n",
+				ELOG_BLOCK_TABLE_FILE_NAME);
+			configASSERT(0);
+		}
+		end = last.offset + last.length;
+	}
+
+	elogFile = append ? elogOpenForUpdate(ELOG_ENCRYPTED_FILE_NAME) : fopen(ELOG_ENCRYPTED_FILE_NAME, "w+b");
+	configASSERT(elogFile != NULL);
+	elogBlockTable = append ? elogOpenForUpdate(ELOG_BLOCK_TABLE_FILE_NAME) : fopen(ELOG_BLOCK_TABLE_FILE_NAME, "w+b");
+	configASSERT(elogBlockTable != NULL);
+	if (append)
+	{
+		elogTruncate(elogFile, end);
+		elogTruncate(elogBlockTable, (uint64_t)elogState->blockIndex * sizeof(elogBlockEntry_t));
+	}
+	elogSeek(elogFile, end);
+	elogSeek(elogBlockTable, (uint64_t)elogState->blockIndex * sizeof(elogBlockEntry_t));
+
+	fwrite(&elogHeader, sizeof(elogHeader), 1, elogFile);
+	fflush(elogFile);
+	elogSegmentFirstBlock = elogState->blockIndex;
+	elogState->blockOffset = end + sizeof(elogHeader);
+}
+
+///-----------------------------------------------------------
+/// \brief Opens the plain log and the block table for a new
+///        session. A continued log is cut back to the blocks
+///        the state knows, dropping a trailer or table row the
+///        state never counted because of a crash, and the open
+///        block's lines are written again from the state.
+///
+/// @param1 int append - 1 if the state continues the log
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void elogOpenPlain(int append)
+{
+	elogBlockEntry_t last;
+	uint64_t end = 0;
+
+	if (append && (elogState->blockIndex > 0))
+	{
+		if (!elogReadBlockEntry(elogState->blockIndex - 1, &last))
+		{
+			printf("E log: %s is shorter than the state, the earlier blocks are not readable\n",
+				ELOG_BLOCK_TABLE_FILE_NAME);
+			configASSERT(0);
+		}
+		end = last.offset + last.length;
+	}
+
+	/// Text mode like a new log, so the rewritten lines end the same way
+	elogFile = append ? fopen(ELOG_FILE_NAME, "r+") : NULL;
+	if (elogFile == NULL)
+	{
+		elogFile = fopen(ELOG_FILE_NAME, "w+");
+	}
+	configASSERT(elogFile != NULL);
+	elogBlockTable = append ? elogOpenForUpdate(ELOG_BLOCK_TABLE_FILE_NAME) : fopen(ELOG_BLOCK_TABLE_FILE_NAME, "w+b");
+	configASSERT(elogBlockTable != NULL);
+	if (append)
+	{
+		elogTruncate(elogFile, end);
+		elogTruncate(elogBlockTable, (uint64_t)elogState->blockIndex * sizeof(elogBlockEntry_t));
+	}
+	elogSeek(elogFile, end);
+	elogSeek(elogBlockTable, (uint64_t)elogState->blockIndex * sizeof(elogBlockEntry_t));
+
+	elogState->blockOffset = end;
+	for (uint32_t i = 0; i < elogState->recordCount; i++)
+	{
+		fprintf(elogFile, "%s\n", elogState->lines[i]);
+	}
+	fflush(elogFile);
+}
+
+///-----------------------------------------------------------
+/// \brief Opens the E log and the block table on the first
+///        record of the session
+///
+/// @param1 int lineNumber - line number of the first record
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void elogOpenFiles(int lineNumber)
+{
+	/// A new session starts a new file, a reopened one appends
+	const int append = (lineNumber != 0);
+
+	if (ELOG_ENCRYPT_AT_REST)
+	{
+		elogOpenEncrypted(append);
+	}
+	else
+	{
+		elogOpenPlain(append);
+	}
+	if (!append)
+	{
+		eIndexReset();
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Encrypts the block text and appends it as one AEAD
+///        record to E.enc
+///
+/// @param1 size_t textLength - bytes in elogBlockText
+///
+/// @return uint32_t - bytes written to the file
+///-----------------------------------------------------------
+static uint32_t elogWriteEncryptedBlock(size_t textLength)
+{
+	const uint32_t recordLength = elogEncryptBlock(&elogHeader, &elogCipher, elogState->blockIndex, elogBlockText,
+		textLength, elogCipherText);
+
+	fwrite(elogCipherText, 1, recordLength, elogFile);
+	return recordLength;
+}
+
+///-----------------------------------------------------------
+/// \brief Hashes the open block and writes its trailer (and,
+///        when encrypting, the whole block). Caller holds the
+///        elog mutex.
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void elogSealOpenBlock(void)
+{
+	const uint8_t *lines[ELOG_RECORDS_PER_BLOCK];
+	size_t lengths[ELOG_RECORDS_PER_BLOCK];
+	uint8_t root[SHA256_DIGEST_SIZE];
+	uint8_t chainHead[SHA256_DIGEST_SIZE];
+	char seal[ELOG_MAX_SEAL_LENGTH];
+	elogBlockEntry_t entry;
+
+	if ((elogState->recordCount == 0) || (elogFile == NULL))
+	{
+		return;
+	}
+
+	for (uint32_t i = 0; i < elogState->recordCount; i++)
+	{
+		lines[i] = (const uint8_t *)elogState->lines[i];
+		lengths[i] = elogState->lineLength[i];
+	}
+	elogMerkleRoot(lines, lengths, (int)elogState->recordCount, root);
+
+	/// The state moves to the next block only once the block and its row are
+	/// written, a crash before that seals the same block again on restart
+	memcpy(chainHead, elogState->chainHead, sizeof(chainHead));
+	memset(&entry, 0, sizeof(entry));
+	entry.offset = elogState->blockOffset;
+	entry.firstLine = elogState->firstLine;
+	entry.recordCount = elogState->recordCount;
+	if (ELOG_ENCRYPT_AT_REST)
+	{
+		size_t textLength = 0;
+		for (uint32_t i = 0; i < elogState->recordCount; i++)
+		{
+			memcpy(elogBlockText + textLength, elogState->lines[i], elogState->lineLength[i]);
+			textLength += elogState->lineLength[i];
+			elogBlockText[textLength++] = '\n';
+		}
+		textLength += elogFormatSeal(chainHead, root, elogState->blockIndex, elogState->firstLine,
+			elogState->recordCount, elogBlockText + textLength, sizeof(elogBlockText) - textLength);
+		entry.length = elogWriteEncryptedBlock(textLength);
+		entry.segmentFirstBlock = elogSegmentFirstBlock;
+		elogState->blockOffset += entry.length;
+	}
+	else
+	{
+		elogFormatSeal(chainHead, root, elogState->blockIndex, elogState->firstLine,
+			elogState->recordCount, seal, sizeof(seal));
+		fputs(seal, elogFile);
+		entry.length = (uint32_t)((uint64_t)elogTell(elogFile) - elogState->blockOffset);
+	}
+	fflush(elogFile);
+	fwrite(&entry, sizeof(entry), 1, elogBlockTable);
+	fflush(elogBlockTable);
+
+	memcpy(elogState->chainHead, chainHead, sizeof(chainHead));
+	elogState->blockIndex++;
+	elogState->recordCount = 0;
+}
+
+///-----------------------------------------------------------
+/// \brief Adds one E record to the open block and, in plain
+///        mode, writes it to E.txt (not flushed). The file is
+///        created on the first record of the session and kept
+///        open afterwards. Caller holds the elog mutex.
+///
+/// @param1 int lineNumber - line number of the record
+/// @param2 const valueE_t *valueE - record to write
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void elogAddRecord(int lineNumber, const valueE_t *valueE)
+{
+	char *line;
+
+	if (elogFile == NULL)
+	{
+		elogOpenFiles(lineNumber);
+		/// A block filled just before a crash is sealed before it takes another record
+		if (elogState->recordCount == ELOG_RECORDS_PER_BLOCK)
+		{
+			elogSealOpenBlock();
+		}
+	}
+
+	if (elogState->recordCount == 0)
+	{
+		elogState->firstLine = (uint32_t)lineNumber;
+		elogState->openedAt = xTaskGetTickCount();
+		if (!ELOG_ENCRYPT_AT_REST)
+		{
+			elogState->blockOffset = (uint64_t)elogTell(elogFile);
+		}
+	}
+
+	line = elogState->lines[elogState->recordCount];
+	elogState->lineLength[elogState->recordCount] = (uint16_t)elogFormatRecord(lineNumber, valueE, line);
+	elogState->recordCount++;
+	eIndexAdd(valueE->currentValueD.randomNumber, (uint32_t)lineNumber, elogState->blockIndex);
+
+	if (!ELOG_ENCRYPT_AT_REST)
+	{
+		fprintf(elogFile, "%s\n", line);
+	}
+
+	if (elogState->recordCount == ELOG_RECORDS_PER_BLOCK)
+	{
+		elogSealOpenBlock();
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Writes one E record and flushes it
+///
+/// @param1 int lineNumber - line number of the record
+/// @param2 const valueE_t *valueE - record to write
+///
+/// @return N/A
+///-----------------------------------------------------------
+void elogAppendRecord(int lineNumber, const valueE_t *valueE)
+{
+	xSemaphoreTake(elogMutex, portMAX_DELAY);
+	elogAddRecord(lineNumber, valueE);
+	fflush(elogFile);
+	xSemaphoreGive(elogMutex);
+}
+
+///-----------------------------------------------------------
+/// \brief Writes consecutive E records with a single flush
+///
+/// @param1 int firstLineNumber - line number of records[0]
+/// @param2 const valueE_t *records - records to write
+/// @param3 int count - number of records
+///
+/// @return N/A
+///-----------------------------------------------------------
+void elogAppendBatch(int firstLineNumber, const valueE_t *records, int count)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+	xSemaphoreTake(elogMutex, portMAX_DELAY);
+	for (int i = 0; i < count; i++)
+	{
+		elogAddRecord(firstLineNumber + i, &records[i]);
+	}
+	fflush(elogFile);
+	xSemaphoreGive(elogMutex);
+}
+
+///-----------------------------------------------------------
+/// \brief Makes the writer keep its block and chain state in
+///        caller provided (persistent) memory, so a restarted
+///        simulator continues the chain and the open block.
+///        Must be called before the first record.
+///
+/// @param1 elogBlockState_t *state - state, zeroed on a cold start
+///
+/// @return N/A
+///-----------------------------------------------------------
+void elogAttachState(elogBlockState_t *state)
+{
+	configASSERT(elogFile == NULL);
+	if (state->recordCount > ELOG_RECORDS_PER_BLOCK)
+	{
+		/// Not written by this code, start over
+		memset(state, 0, sizeof(*state));
+	}
+	/// Ticks restart from zero, a restored open block is sealed on the first poll
+	state->openedAt = 0;
+	elogState = state;
+	elogMutex = xSemaphoreCreateMutex();
+	configASSERT(elogMutex != NULL);
+}
+
+///-----------------------------------------------------------
+/// \brief Seals the open block now
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+void elogSealBlock(void)
+{
+	xSemaphoreTake(elogMutex, portMAX_DELAY);
+	elogSealOpenBlock();
+	xSemaphoreGive(elogMutex);
+}
+
+///-----------------------------------------------------------
+/// \brief Seals a partially filled block that has been open
+///        for longer than ELOG_SEAL_INTERVAL_MS, so quiet
+///        periods don't leave records unprotected
+///
+/// @param1 TickType_t currentTickTime - current tick
+///
+/// @return N/A
+///-----------------------------------------------------------
+void elogPoll(TickType_t currentTickTime)
+{
+	const TickType_t xSealInterval = ELOG_SEAL_INTERVAL_MS / portTICK_PERIOD_MS;
+
+	/// The count and age are read under the mutex too, a block that the E
+	/// writer is filling or has just sealed is never sealed again
+	xSemaphoreTake(elogMutex, portMAX_DELAY);
+	if ((elogState->recordCount > 0) && ((TickType_t)(currentTickTime - elogState->openedAt) >= xSealInterval))
+	{
+		elogSealOpenBlock();
+	}
+	xSemaphoreGive(elogMutex);
+}
+
+///-----------------------------------------------------------
+/// \brief Checks one "Seal" trailer against the collected
+///        block and advances the chain
+///
+/// @param1 elogVerifyState_t *state - verifier state
+/// @param2 const char *text - trailer line, NUL terminated
+///
+/// @return elogVerifyResult_t - ELOG_VERIFY_OK when the seal matches
+///-----------------------------------------------------------
+static elogVerifyResult_t elogVerifySeal(elogVerifyState_t *state, const char *text)
+{
+	unsigned int blockIndex, firstLine, recordCount;
+	char rootHex[2 * SHA256_DIGEST_SIZE + 1];
+	char chainHex[2 * SHA256_DIGEST_SIZE + 1];
+	uint8_t sealedRoot[SHA256_DIGEST_SIZE], sealedChain[SHA256_DIGEST_SIZE];
+	uint8_t root[SHA256_DIGEST_SIZE], chain[SHA256_DIGEST_SIZE];
+	const uint8_t *lines[ELOG_RECORDS_PER_BLOCK];
+	size_t lengths[ELOG_RECORDS_PER_BLOCK];
+
+	if ((sscanf(text, "Seal %u: %u %u %64s %64s", &blockIndex, &firstLine, &recordCount, rootHex, chainHex) != 5) ||
+		!elogHexToDigest(rootHex, sealedRoot) || !elogHexToDigest(chainHex, sealedChain))
+	{
+		return ELOG_VERIFY_MALFORMED;
+	}
+	/// The trailer must describe exactly the lines collected since the previous one
+	if ((blockIndex != state->blockIndex) || (recordCount != state->recordCount) ||
+		(recordCount == 0) || (firstLine != state->firstLine))
+	{
+		return ELOG_VERIFY_MALFORMED;
+	}
+
+	for (uint32_t i = 0; i < state->recordCount; i++)
+	{
+		lines[i] = (const uint8_t *)state->lines[i];
+		lengths[i] = state->lineLength[i];
+	}
+	elogMerkleRoot(lines, lengths, (int)state->recordCount, root);
+	if (memcmp(root, sealedRoot, SHA256_DIGEST_SIZE) != 0)
+	{
+		return ELOG_VERIFY_ROOT_MISMATCH;
+	}
+	elogChainLink(state->chainHead, root, blockIndex, firstLine, recordCount, chain);
+	if (memcmp(chain, sealedChain, SHA256_DIGEST_SIZE) != 0)
+	{
+		return ELOG_VERIFY_CHAIN_MISMATCH;
+	}
+
+	memcpy(state->chainHead, chain, SHA256_DIGEST_SIZE);
+	state->blockIndex++;
+	state->recordCount = 0;
+	return ELOG_VERIFY_OK;
+}
+
+///-----------------------------------------------------------
+/// \brief Handles one line of the E log during verification
+///
+/// @param1 elogVerifyState_t *state - verifier state
+/// @param2 elogVerifyReport_t *report - running report
+/// @param3 const char *text - line without terminator
+/// @param4 size_t length - line length
+///
+/// @return elogVerifyResult_t - ELOG_VERIFY_OK to continue
+///-----------------------------------------------------------
+static elogVerifyResult_t elogVerifyLine(elogVerifyState_t *state, elogVerifyReport_t *report, const char *text, size_t length)
+{
+	char trailer[ELOG_VERIFY_MAX_CARRY];
+	elogVerifyResult_t result;
+
+	if (length == 0)
+	{
+		return ELOG_VERIFY_OK;
+	}
+
+	if (strncmp(text, "Line ", 5) == 0)
+	{
+		/// A full block must be followed by its trailer
+		if ((state->recordCount == ELOG_RECORDS_PER_BLOCK) || (length >= ELOG_MAX_LINE_LENGTH))
+		{
+			return ELOG_VERIFY_MALFORMED;
+		}
+		if (state->recordCount == 0)
+		{
+			state->firstLine = (uint32_t)strtoul(text + 5, NULL, 10);
+		}
+		memcpy(state->lines[state->recordCount], text, length);
+		state->lineLength[state->recordCount] = (uint16_t)length;
+		state->recordCount++;
+		return ELOG_VERIFY_OK;
+	}
+
+	if ((strncmp(text, "Seal ", 5) == 0) && (length < sizeof(trailer)))
+	{
+		const uint32_t recordCount = state->recordCount;
+		memcpy(trailer, text, length);
+		trailer[length] = '\0';
+		result = elogVerifySeal(state, trailer);
+		if (result == ELOG_VERIFY_OK)
+		{
+			report->blocksVerified++;
+			report->recordsVerified += recordCount;
+		}
+		return result;
+	}
+
+	return ELOG_VERIFY_MALFORMED;
+}
+
+///-----------------------------------------------------------
+/// \brief Runs every complete line of a text buffer through
+///        the verifier
+///
+/// @param1 elogVerifyState_t *state - verifier state
+/// @param2 elogVerifyReport_t *report - running report
+/// @param3 char *text - buffer start
+/// @param4 size_t length - bytes in the buffer
+/// @param5 int endOfInput - 1 if an unterminated last line is complete
+/// @param6 size_t *consumed - bytes processed, the rest is a partial line
+///
+/// @return elogVerifyResult_t - ELOG_VERIFY_OK to continue
+///-----------------------------------------------------------
+static elogVerifyResult_t elogVerifyText(elogVerifyState_t *state, elogVerifyReport_t *report, char *text,
+	size_t length, int endOfInput, size_t *consumed)
+{
+	elogVerifyResult_t result = ELOG_VERIFY_OK;
+	char *cursor = text;
+	char *end = text + length;
+
+	while ((cursor < end) && (result == ELOG_VERIFY_OK))
+	{
+		char *newline = (char *)memchr(cursor, '\n', (size_t)(end - cursor));
+		size_t lineLength;
+		if (newline == NULL)
+		{
+			if (!endOfInput)
+			{
+				/// Incomplete line, finish it after the next read
+				break;
+			}
+			newline = end;
+		}
+		lineLength = (size_t)(newline - cursor);
+		if ((lineLength > 0) && (cursor[lineLength - 1] == '\r'))
+		{
+			lineLength--;
+		}
+		result = elogVerifyLine(state, report, cursor, lineLength);
+		cursor = (newline < end) ? newline + 1 : end;
+	}
+	*consumed = (size_t)(cursor - text);
+	return result;
+}
+
+///-----------------------------------------------------------
+/// \brief Reads and checks the header of an encrypted segment
+///        and keys a cipher with the matching key file
+///
+/// @param1 FILE *file - segment, positioned at the start
+/// @param2 elogSegmentHeader_t *header - header output
+/// @param3 aeadContext_t *context - keyed on success
+///
+/// @return elogVerifyResult_t - ELOG_VERIFY_DECRYPT_FAILED for a
+///                              wrong key or unsupported cipher
+///-----------------------------------------------------------
+static elogVerifyResult_t elogOpenSegment(FILE *file, elogSegmentHeader_t *header, aeadContext_t *context)
+{
+	uint8_t key[AEAD_KEY_SIZE];
+	uint8_t keyId[8];
+	int keyed;
+
+	if (fread(header, sizeof(*header), 1, file) != 1)
+	{
+		return ELOG_VERIFY_IO_ERROR;
+	}
+	if ((memcmp(header->magic, ELOG_SEGMENT_MAGIC, sizeof(header->magic)) != 0) ||
+		(header->version != ELOG_SEGMENT_VERSION))
+	{
+		return ELOG_VERIFY_MALFORMED;
+	}
+	if (!elogLoadKey(ELOG_KEY_FILE_NAME, key, keyId) || (memcmp(keyId, header->keyId, sizeof(keyId)) != 0))
+	{
+		printf("E log: %s does not hold the key of this segment\n", ELOG_KEY_FILE_NAME);
+		return ELOG_VERIFY_DECRYPT_FAILED;
+	}
+	keyed = aeadInit(context, (aeadCipher_t)header->cipher, key);
+	memset(key, 0, sizeof(key));
+	if (!keyed)
+	{
+		printf("E log: cipher %u is not available on this host\n", (unsigned int)header->cipher);
+		return ELOG_VERIFY_DECRYPT_FAILED;
+	}
+	return ELOG_VERIFY_OK;
+}
+
+///-----------------------------------------------------------
+/// \brief Tells whether a segment header (of a later session)
+///        starts at the current position, without moving it
+///
+/// @param1 FILE *file - encrypted log
+///
+/// @return int - 1 if the next bytes are the segment magic
+///-----------------------------------------------------------
+static int elogAtSegmentHeader(FILE *file)
+{
+	char magic[sizeof(ELOG_SEGMENT_MAGIC) - 1];
+	const size_t got = fread(magic, 1, sizeof(magic), file);
+
+	fseek(file, -(long)got, SEEK_CUR);
+	return (got == sizeof(magic)) && (memcmp(magic, ELOG_SEGMENT_MAGIC, sizeof(magic)) == 0);
+}
+
+///-----------------------------------------------------------
+/// \brief Reads one encrypted block record at the current
+///        position, checks its tag and decrypts it. The
+///        ciphertext is read into text and decrypted in place,
+///        so tasks reading blocks at the same time share no
+///        buffer.
+///
+/// @param1 FILE *file - segment
+/// @param2 const elogSegmentHeader_t *header - segment header
+/// @param3 const aeadContext_t *context - keyed cipher
+/// @param4 uint32_t blockIndex - expected block index
+/// @param5 char *text - plaintext output
+/// @param6 size_t capacity - size of text
+/// @param7 size_t *length - plaintext length
+///
+/// @return elogVerifyResult_t - ELOG_VERIFY_OK if authentic
+///-----------------------------------------------------------
+static elogVerifyResult_t elogReadEncryptedBlock(FILE *file, const elogSegmentHeader_t *header,
+	const aeadContext_t *context, uint32_t blockIndex, char *text, size_t capacity, size_t *length)
+{
+	elogRecordHeader_t record;
+	uint8_t nonce[AEAD_NONCE_SIZE];
+	uint8_t aad[sizeof(elogSegmentHeader_t) + sizeof(elogRecordHeader_t)];
+	uint8_t tag[AEAD_TAG_SIZE];
+
+	if (fread(&record, sizeof(record), 1, file) != 1)
+	{
+		return ELOG_VERIFY_IO_ERROR;
+	}
+	if ((record.blockIndex != blockIndex) || (record.length > ELOG_MAX_BLOCK_TEXT) || (record.length > capacity))
+	{
+		return ELOG_VERIFY_MALFORMED;
+	}
+	if ((fread(text, 1, record.length, file) != record.length) ||
+		(fread(tag, 1, sizeof(tag), file) != sizeof(tag)))
+	{
+		/// A torn last record reads as a truncated file
+		return ELOG_VERIFY_MALFORMED;
+	}
+	elogBlockNonce(header, &record, nonce, aad);
+	if (!aeadOpen(context, nonce, aad, sizeof(aad), (const uint8_t *)text, record.length, tag, (uint8_t *)text))
+	{
+		return ELOG_VERIFY_DECRYPT_FAILED;
+	}
+	*length = record.length;
+	return ELOG_VERIFY_OK;
+}
+
+///-----------------------------------------------------------
+/// \brief Verifies an encrypted segment: every record is
+///        authenticated and decrypted, then its text has to
+///        hold exactly one sealed block
+///
+/// @param1 FILE *file - segment, positioned at the start
+/// @param2 elogVerifyState_t *state - verifier state
+/// @param3 elogVerifyReport_t *report - running report
+///
+/// @return elogVerifyResult_t - ELOG_VERIFY_OK if all blocks check out
+///-----------------------------------------------------------
+static elogVerifyResult_t elogVerifyEncrypted(FILE *file, elogVerifyState_t *state, elogVerifyReport_t *report)
+{
+	static char blockText[ELOG_MAX_BLOCK_TEXT];
+	elogSegmentHeader_t header;
+	aeadContext_t context;
+	elogVerifyResult_t result;
+	int next;
+
+	result = elogOpenSegment(file, &header, &context);
+	report->bytesRead += sizeof(header);
+	while ((result == ELOG_VERIFY_OK) && ((next = fgetc(file)) != EOF))
+	{
+		size_t length, consumed;
+		ungetc(next, file);
+		/// Each session's segment has its own header; the chain goes on
+		if (elogAtSegmentHeader(file))
+		{
+			aeadClear(&context);
+			result = elogOpenSegment(file, &header, &context);
+			report->bytesRead += sizeof(header);
+			continue;
+		}
+		result = elogReadEncryptedBlock(file, &header, &context, state->blockIndex, blockText, sizeof(blockText),
+			&length);
+		if (result == ELOG_VERIFY_OK)
+		{
+			report->bytesRead += sizeof(elogRecordHeader_t) + length + AEAD_TAG_SIZE;
+			result = elogVerifyText(state, report, blockText, length, 1, &consumed);
+		}
+		/// The writer only emits whole blocks, so nothing may be left open
+		if ((result == ELOG_VERIFY_OK) && (state->recordCount != 0))
+		{
+			result = ELOG_VERIFY_MALFORMED;
+		}
+	}
+	aeadClear(&context);
+	return result;
+}
+
+///-----------------------------------------------------------
+/// \brief Verifies an E log file: recomputes the Merkle root
+///        of every block, checks it against the trailer and
+///        walks the seal chain from the genesis value. Plain
+///        files are streamed in large sequential reads, an
+///        encrypted segment (recognised by its magic) is
+///        authenticated and decrypted block by block.
+///
+/// @param1 const char *path - E log file
+/// @param2 elogVerifyReport_t *report - filled in on return
+///
+/// @return elogVerifyResult_t - ELOG_VERIFY_OK if all seals match
+///-----------------------------------------------------------
+elogVerifyResult_t elogVerifyFile(const char *path, elogVerifyReport_t *report)
+{
+	/// Verification is not re-entrant, the buffers are too big for a task stack
+	static char readBuffer[ELOG_VERIFY_MAX_CARRY + ELOG_VERIFY_READ_SIZE];
+	static elogVerifyState_t state;
+	elogVerifyResult_t result = ELOG_VERIFY_OK;
+	char magic[sizeof(ELOG_SEGMENT_MAGIC) - 1];
+	size_t carried = 0;
+	FILE *file;
+
+	memset(report, 0, sizeof(*report));
+	memset(&state, 0, sizeof(state));
+
+	file = fopen(path, "rb");
+	if (file == NULL)
+	{
+		report->result = ELOG_VERIFY_IO_ERROR;
+		return report->result;
+	}
+
+	if ((fread(magic, 1, sizeof(magic), file) == sizeof(magic)) &&
+		(memcmp(magic, ELOG_SEGMENT_MAGIC, sizeof(magic)) == 0))
+	{
+		rewind(file);
+		result = elogVerifyEncrypted(file, &state, report);
+	}
+	else
+	{
+		rewind(file);
+		while (result == ELOG_VERIFY_OK)
+		{
+			size_t bytesRead = fread(readBuffer + carried, 1, ELOG_VERIFY_READ_SIZE, file);
+			const int endOfFile = (bytesRead == 0);
+			size_t consumed;
+
+			report->bytesRead += bytesRead;
+			result = elogVerifyText(&state, report, readBuffer, carried + bytesRead, endOfFile, &consumed);
+			if (endOfFile || (result != ELOG_VERIFY_OK))
+			{
+				break;
+			}
+			carried = carried + bytesRead - consumed;
+			if (carried > ELOG_VERIFY_MAX_CARRY)
+			{
+				result = ELOG_VERIFY_MALFORMED;
+				break;
+			}
+			memmove(readBuffer, readBuffer + consumed, carried);
+		}
+	}
+
+	if (ferror(file))
+	{
+		result = ELOG_VERIFY_IO_ERROR;
+	}
+	fclose(file);
+
+	report->result = result;
+	report->failedBlock = state.blockIndex;
+	report->unsealedRecords = (result == ELOG_VERIFY_OK) ? state.recordCount : 0;
+	return result;
+}
+
+///-----------------------------------------------------------
+/// \brief Number of sealed blocks. The count only grows once
+///        the block's table entry has been flushed.
+///
+/// @param N/A
+///
+/// @return uint32_t - sealed blocks
+///-----------------------------------------------------------
+uint32_t elogSealedBlocks(void)
+{
+	return elogState->blockIndex;
+}
+
+///-----------------------------------------------------------
+/// \brief Reads the E.blk table entry of one sealed block
+///
+/// @param1 uint32_t blockIndex - block
+/// @param2 elogBlockEntry_t *entry - output
+///
+/// @return int - 1 on success
+///-----------------------------------------------------------
+int elogReadBlockEntry(uint32_t blockIndex, elogBlockEntry_t *entry)
+{
+	FILE *table;
+	int found;
+
+	table = fopen(ELOG_BLOCK_TABLE_FILE_NAME, "rb");
+	if (table == NULL)
+	{
+		return 0;
+	}
+	found = (elogSeek(table, (uint64_t)blockIndex * sizeof(*entry)) == 0) && (fread(entry, sizeof(*entry), 1, table) == 1);
+	fclose(table);
+	return found;
+}
+
+///-----------------------------------------------------------
+/// \brief Reads the text of one sealed block through the
+///        E.blk table, without scanning the log. Encrypted
+///        blocks are authenticated before they are returned.
+///
+/// @param1 uint32_t blockIndex - block to read
+/// @param2 char *text - output, the block lines and its trailer
+/// @param3 size_t capacity - size of text
+/// @param4 size_t *length - bytes returned
+///
+/// @return int - 1 on success
+///-----------------------------------------------------------
+int elogReadBlock(uint32_t blockIndex, char *text, size_t capacity, size_t *length)
+{
+	elogBlockEntry_t entry;
+	elogVerifyResult_t result = ELOG_VERIFY_IO_ERROR;
+	FILE *file;
+
+	if (!elogReadBlockEntry(blockIndex, &entry))
+	{
+		return 0;
+	}
+
+	file = fopen(ELOG_ENCRYPT_AT_REST ? ELOG_ENCRYPTED_FILE_NAME : ELOG_FILE_NAME, "rb");
+	if (file == NULL)
+	{
+		return 0;
+	}
+	if (ELOG_ENCRYPT_AT_REST)
+	{
+		elogSegmentHeader_t header;
+		aeadContext_t context;
+		elogBlockEntry_t first = entry;
+
+		/// The segment header sits right before the segment's first block
+		if (((entry.segmentFirstBlock == blockIndex) || elogReadBlockEntry(entry.segmentFirstBlock, &first)) &&
+			(first.offset >= sizeof(header)) && (elogSeek(file, first.offset - sizeof(header)) == 0))
+		{
+			result = elogOpenSegment(file, &header, &context);
+			if ((result == ELOG_VERIFY_OK) && (elogSeek(file, entry.offset) == 0))
+			{
+				result = elogReadEncryptedBlock(file, &header, &context, blockIndex, text, capacity, length);
+			}
+			aeadClear(&context);
+		}
+	}
+	else if ((entry.length <= capacity) && (elogSeek(file, entry.offset) == 0) &&
+		(fread(text, 1, entry.length, file) == entry.length))
+	{
+		*length = entry.length;
+		result = ELOG_VERIFY_OK;
+	}
+	fclose(file);
+	return (result == ELOG_VERIFY_OK);
+}
+
+///-----------------------------------------------------------
+/// \brief Reads one E record, from the open block or from its
+///        sealed block. Not re-entrant: the block is read into
+///        a static buffer, so only one task (the G key) may
+///        read lines. Block reads of other tasks are unaffected.
+///
+/// @param1 uint32_t blockIndex - block holding the line
+/// @param2 uint32_t lineNumber - line number of the record
+/// @param3 char *line - output, the record line
+/// @param4 size_t capacity - size of line
+///
+/// @return int - 1 if the record was found
+///-----------------------------------------------------------
+int elogReadLine(uint32_t blockIndex, uint32_t lineNumber, char *line, size_t capacity)
+{
+	static char blockText[ELOG_MAX_BLOCK_TEXT + 1];
+	char prefix[24];
+	size_t prefixLength;
+	size_t blockLength;
+	char *cursor;
+	int found = 0;
+
+	if ((elogMutex == NULL) || (capacity == 0))
+	{
+		return 0;
+	}
+	/// Records of the open block are only in the writer state (or, in plain
+	/// mode, not yet covered by E.blk)
+	xSemaphoreTake(elogMutex, portMAX_DELAY);
+	if ((elogState->recordCount > 0) && (blockIndex == elogState->blockIndex) &&
+		(lineNumber >= elogState->firstLine) && (lineNumber - elogState->firstLine < elogState->recordCount))
+	{
+		const uint32_t record = lineNumber - elogState->firstLine;
+		const size_t length = (elogState->lineLength[record] < capacity) ? elogState->lineLength[record] : capacity - 1;
+
+		memcpy(line, elogState->lines[record], length);
+		line[length] = '\0';
+		found = 1;
+	}
+	xSemaphoreGive(elogMutex);
+	if (found)
+	{
+		return 1;
+	}
+
+	if (!elogReadBlock(blockIndex, blockText, ELOG_MAX_BLOCK_TEXT, &blockLength))
+	{
+		return 0;
+	}
+	blockText[blockLength] = '\0';
+	prefixLength = (size_t)snprintf(prefix, sizeof(prefix), "Line %u:", (unsigned int)lineNumber);
+	for (cursor = blockText; (cursor != NULL) && (*cursor != '\0'); )
+	{
+		char *end = strchr(cursor, '\n');
+
+		if (strncmp(cursor, prefix, prefixLength) == 0)
+		{
+			size_t length = (end != NULL) ? (size_t)(end - cursor) : strlen(cursor);
+
+			length = (length < capacity) ? length : capacity - 1;
+			memcpy(line, cursor, length);
+			line[length] = '\0';
+			return 1;
+		}
+		cursor = (end != NULL) ? end + 1 : NULL;
+	}
+	return 0;
+}
+
+///-----------------------------------------------------------
+/// \brief Decrypts the blocks of an encrypted segment in file
+///        order, handing each block's text to a visitor. Stops
+///        at the first block that fails authentication or that
+///        the visitor refuses.
+///
+/// @param1 const char *path - encrypted segment
+/// @param2 elogBlockVisitor_t visitor - called once per block
+/// @param3 void *context - passed to the visitor
+///
+/// @return int - 1 if every block was authentic and visited
+///-----------------------------------------------------------
+int elogDecryptBlocks(const char *path, elogBlockVisitor_t visitor, void *context)
+{
+	static char blockText[ELOG_MAX_BLOCK_TEXT];
+	elogSegmentHeader_t header;
+	aeadContext_t cipher;
+	elogVerifyResult_t result;
+	uint32_t blockIndex = 0;
+	FILE *file;
+	int next = EOF;
+
+	file = fopen(path, "rb");
+	if (file == NULL)
+	{
+		return 0;
+	}
+
+	result = elogOpenSegment(file, &header, &cipher);
+	while ((result == ELOG_VERIFY_OK) && ((next = fgetc(file)) != EOF))
+	{
+		size_t length;
+		ungetc(next, file);
+		if (elogAtSegmentHeader(file))
+		{
+			aeadClear(&cipher);
+			result = elogOpenSegment(file, &header, &cipher);
+			continue;
+		}
+		result = elogReadEncryptedBlock(file, &header, &cipher, blockIndex, blockText, sizeof(blockText), &length);
+		if (result == ELOG_VERIFY_OK)
+		{
+			if (!visitor(context, blockIndex, blockText, length))
+			{
+				break;
+			}
+			blockIndex++;
+		}
+	}
+	aeadClear(&cipher);
+	memset(blockText, 0, sizeof(blockText));
+
+	if (result != ELOG_VERIFY_OK)
+	{
+		printf("E log %s: block %u could not be decrypted\n", path, (unsigned int)blockIndex);
+	}
+	fclose(file);
+	return (result == ELOG_VERIFY_OK) && (next == EOF);
+}
+
+///-----------------------------------------------------------
+/// \brief Block visitor of elogDecryptFile: appends the text
+///
+/// @param1 void *context - output FILE *
+/// @param2 uint32_t blockIndex - block (unused)
+/// @param3 char *text - block text
+/// @param4 size_t length - bytes in text
+///
+/// @return int - 0 if the output can't be written
+///-----------------------------------------------------------
+static int elogWriteDecrypted(void *context, uint32_t blockIndex, char *text, size_t length)
+{
+	(void)blockIndex;
+	return (fwrite(text, 1, length, (FILE *)context) == length);
+}
+
+///-----------------------------------------------------------
+/// \brief Decrypts an encrypted segment into plain E log text,
+///        which --verify accepts like any E.txt. Stops at the
+///        first block that fails authentication.
+///
+/// @param1 const char *path - encrypted segment
+/// @param2 const char *outputPath - plain text output
+///
+/// @return int - 1 if every block was authentic
+///-----------------------------------------------------------
+int elogDecryptFile(const char *path, const char *outputPath)
+{
+	FILE *output = fopen(outputPath, "wb");
+	int decrypted;
+
+	if (output == NULL)
+	{
+		return 0;
+	}
+	decrypted = elogDecryptBlocks(path, elogWriteDecrypted, output);
+	return (fclose(output) == 0) && decrypted;
+}
+
+///-----------------------------------------------------------
+/// \brief Writes a new random 32 byte key file. An existing
+///        key is never overwritten, the segments written with
+///        it would be lost.
+///
+/// @param1 const char *path - key file
+///
+/// @return int - 1 on success
+///-----------------------------------------------------------
+int elogGenerateKeyFile(const char *path)
+{
+	uint8_t key[AEAD_KEY_SIZE];
+	size_t written;
+	FILE *file;
+
+	file = fopen(path, "rb");
+	if (file != NULL)
+	{
+		fclose(file);
+		printf("Key file %s already exists, not overwriting it\n", path);
+		return 0;
+	}
+	if (!csprngOsEntropy(key, sizeof(key)))
+	{
+		return 0;
+	}
+	file = fopen(path, "wb");
+	if (file == NULL)
+	{
+		memset(key, 0, sizeof(key));
+		return 0;
+	}
+	written = fwrite(key, 1, sizeof(key), file);
+	memset(key, 0, sizeof(key));
+	return ((fclose(file) == 0) && (written == sizeof(key)));
+}
+
+///-----------------------------------------------------------
+/// \brief Prints a verifier report to stdout
+///
+/// @param1 const char *path - verified file
+/// @param2 const elogVerifyReport_t *report - report
+///
+/// @return N/A
+///-----------------------------------------------------------
+void elogPrintVerifyReport(const char *path, const elogVerifyReport_t *report)
+{
+	static const char *resultNames[] = { "OK", "I/O error", "malformed", "Merkle root mismatch", "chain mismatch",
+		"decrypt failed" };
+
+	printf("E log %s: %s (sha256 backend %s)\n", path, resultNames[report->result], sha256BackendName());
+	printf("  %u sealed blocks, %u records verified, %u unsealed records, %" PRIu64 " bytes read\n",
+		(unsigned int)report->blocksVerified, (unsigned int)report->recordsVerified,
+		(unsigned int)report->unsealedRecords, report->bytesRead);
+	if (report->result != ELOG_VERIFY_OK)
+	{
+		printf("  First bad block: %u\n", (unsigned int)report->failedBlock);
+	}
+}
@@ -0,0 +1,165 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_elog.h
+///-----------------------------------------------------------------------------
+///
+/// \brief Tamper-evident E log: E records are grouped into blocks, each block
+///        is sealed with a Merkle root chained to the previous block's seal,
+///        optionally encrypted at rest block by block
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_ELOG_H
+#define PAYRANGE_ELOG_H
+
+#include "payrange.h"
+#include "payrange_sha256.h"
+#include "payrange_aead.h"
+
+/// E log configurable defines
+#define ELOG_FILE_NAME                  "E.txt"
+#define ELOG_RECORDS_PER_BLOCK          ( 64 )
+#define ELOG_MAX_LINE_LENGTH            ( 128 )
+/// A partially filled block is sealed once it has been open this long
+#define ELOG_SEAL_INTERVAL_MS           ( 1000 )
+/// Set to 1 to write E.enc (one AEAD record per block, key from E.key)
+/// instead of the plaintext E.txt
+#define ELOG_ENCRYPT_AT_REST            ( 0 )
+#define ELOG_ENCRYPTED_FILE_NAME        "E.enc"
+#define ELOG_KEY_FILE_NAME              "E.key"
+/// Block table: one elogBlockEntry_t per sealed block, for random access
+#define ELOG_BLOCK_TABLE_FILE_NAME      "E.blk"
+/// Longest seal trailer, and the largest block text: the record lines plus
+/// the seal trailer
+#define ELOG_MAX_SEAL_LENGTH            ( 256 )
+#define ELOG_MAX_BLOCK_TEXT             ( ELOG_RECORDS_PER_BLOCK * ELOG_MAX_LINE_LENGTH + ELOG_MAX_SEAL_LENGTH )
+
+/// Encrypted segment format identification
+#define ELOG_SEGMENT_MAGIC              "PRELOGE1"
+#define ELOG_SEGMENT_VERSION            ( 1 )
+
+/// Merkle tree domain separation prefixes (leaf, interior node, chain link)
+#define ELOG_LEAF_PREFIX                ( 0x00 )
+#define ELOG_NODE_PREFIX                ( 0x01 )
+#define ELOG_CHAIN_PREFIX               ( 0x02 )
+
+/// State of the open (not yet sealed) block and of the hash chain
+typedef struct
+{
+	uint8_t    chainHead[SHA256_DIGEST_SIZE];
+	uint32_t   blockIndex;
+	uint32_t   firstLine;
+	uint32_t   recordCount;
+	uint64_t   blockOffset;
+	TickType_t openedAt;
+	uint16_t   lineLength[ELOG_RECORDS_PER_BLOCK];
+	char       lines[ELOG_RECORDS_PER_BLOCK][ELOG_MAX_LINE_LENGTH];
+}elogBlockState_t;
+
+/// Block table entry (host byte order), locates block N in the E log file
+typedef struct
+{
+	uint64_t offset;
+	uint32_t length;
+	uint32_t firstLine;
+	uint32_t recordCount;
+	/// Encrypted log: first block of this block's segment, the segment
+	/// header is right before that block (0 in a plain log)
+	uint32_t segmentFirstBlock;
+}elogBlockEntry_t;
+
+/// Header of an encrypted segment, also part of every block's AAD
+typedef struct
+{
+	char     magic[8];
+	uint32_t version;
+	uint32_t cipher;
+	/// Per segment random nonce prefix, the block index completes the nonce
+	uint8_t  nonceSalt[8];
+	/// First bytes of SHA-256(key), catches a wrong key file early
+	uint8_t  keyId[8];
+	uint8_t  reserved[32];
+}elogSegmentHeader_t;
+
+/// Header of one encrypted block record, followed by ciphertext and tag
+typedef struct
+{
+	uint32_t blockIndex;
+	uint32_t length;
+}elogRecordHeader_t;
+
+/// Largest encrypted block record: header, block text and tag
+#define ELOG_MAX_BLOCK_RECORD           ( sizeof(elogRecordHeader_t) + ELOG_MAX_BLOCK_TEXT + AEAD_TAG_SIZE )
+
+/// Verifier outcome
+typedef enum
+{
+	ELOG_VERIFY_OK = 0,
+	ELOG_VERIFY_IO_ERROR,
+	ELOG_VERIFY_MALFORMED,
+	ELOG_VERIFY_ROOT_MISMATCH,
+	ELOG_VERIFY_CHAIN_MISMATCH,
+	ELOG_VERIFY_DECRYPT_FAILED
+}elogVerifyResult_t;
+
+/// Verifier report
+typedef struct
+{
+	elogVerifyResult_t result;
+	uint32_t           blocksVerified;
+	uint32_t           recordsVerified;
+	uint32_t           unsealedRecords;
+	uint32_t           failedBlock;
+	uint64_t           bytesRead;
+}elogVerifyReport_t;
+
+/// Receives the decrypted text of one block (lines and trailer, writable
+/// scratch until it returns); returns 0 to stop
+typedef int (*elogBlockVisitor_t)(void *context, uint32_t blockIndex, char *text, size_t length);
+
+/// Keeps the writer state in persistent memory and creates the writer mutex
+/// (call before the first record)
+void elogAttachState(elogBlockState_t *state);
+/// Appends one E record with its line number, sealing the block when full
+void elogAppendRecord(int lineNumber, const valueE_t *valueE);
+/// Appends consecutive E records (line numbers firstLineNumber...) with one flush
+void elogAppendBatch(int firstLineNumber, const valueE_t *records, int count);
+/// Seals the open block if it has been open longer than ELOG_SEAL_INTERVAL_MS
+void elogPoll(TickType_t currentTickTime);
+/// Seals the open block now (no-op when empty)
+void elogSealBlock(void);
+/// Computes the Merkle root of a block of record lines
+void elogMerkleRoot(const uint8_t *const *lines, const size_t *lengths, int count, uint8_t root[SHA256_DIGEST_SIZE]);
+/// Formats an E record as its line (no newline); returns the length
+int elogFormatRecord(int lineNumber, const valueE_t *valueE, char line[ELOG_MAX_LINE_LENGTH]);
+/// Links a block root into chainHead and formats the block's seal trailer
+/// (newline terminated); returns the length
+size_t elogFormatSeal(uint8_t chainHead[SHA256_DIGEST_SIZE], const uint8_t root[SHA256_DIGEST_SIZE],
+	uint32_t blockIndex, uint32_t firstLine, uint32_t recordCount, char *text, size_t capacity);
+/// Keys a cipher from a key file and fills in a new segment header; returns 0
+/// if the key file is not valid or no nonce salt or cipher could be made
+int elogCreateSegment(const char *keyPath, elogSegmentHeader_t *header, aeadContext_t *cipher);
+/// Encrypts a block text into one segment record (ELOG_MAX_BLOCK_RECORD bytes
+/// at most); returns the record size
+uint32_t elogEncryptBlock(const elogSegmentHeader_t *header, const aeadContext_t *cipher, uint32_t blockIndex,
+	const char *text, size_t length, uint8_t *record);
+/// Number of sealed blocks; blocks 0 to N - 1 are in the block table
+uint32_t elogSealedBlocks(void);
+/// Reads the block table entry of sealed block N; returns 1 on success
+int elogReadBlockEntry(uint32_t blockIndex, elogBlockEntry_t *entry);
+/// Reads the text of sealed block N (decrypting it if needed); returns 1 on success
+int elogReadBlock(uint32_t blockIndex, char *text, size_t capacity, size_t *length);
+/// Reads the record of a line from its block, sealed or open; returns 1 if found
+int elogReadLine(uint32_t blockIndex, uint32_t lineNumber, char *line, size_t capacity);
+/// Writes a new random key file for ELOG_ENCRYPT_AT_REST; returns 1 on success
+int elogGenerateKeyFile(const char *path);
+/// Decrypts the blocks of an encrypted segment one at a time into the visitor;
+/// returns 1 if every block was authentic and the visitor took them all
+int elogDecryptBlocks(const char *path, elogBlockVisitor_t visitor, void *context);
+/// Decrypts an encrypted segment into plain E log text; returns 1 on success
+int elogDecryptFile(const char *path, const char *outputPath);
+/// Checks every sealed block of an E log file (plain or encrypted)
+elogVerifyResult_t elogVerifyFile(const char *path, elogVerifyReport_t *report);
+/// Prints a verifier report to stdout
+void elogPrintVerifyReport(const char *path, const elogVerifyReport_t *report);
+
+#endif /// PAYRANGE_ELOG_H
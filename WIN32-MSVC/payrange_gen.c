@@ -0,0 +1,750 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_gen.c
+///-----------------------------------------------------------------------------
+///
+/// \brief Synthetic E history generator
+///
+/// The records are what the simulator would have written over a long run:
+///
+///  - A is a new 12 digit number every TASK_A_RUNTIME_IN_MS, drawn from the
+///    same uniform range as privateTaskA();
+///  - every TASK_B_RUNTIME_IN_MS a new 8 character B token replaces a random
+///    one of SIZE_OF_THE_TASK_B_ARRAY slots, as in privateTaskB();
+///  - captures arrive at random (a Poisson stream of the given rate); each
+///    takes the A on screen as D and is paired with a random populated B
+///    slot, as in storeCapturesE().
+///
+/// Every random value comes from ChaCha20 keyed with SHA-256 of the seed,
+/// with the nonce naming what is drawn: A of period k, B refresh k, or the
+/// captures of chunk c. Any part of the history can so be generated without
+/// the parts before it, and the output of a seed does not depend on how many
+/// threads made it. (An encrypted log still gets a fresh nonce salt, its
+/// plaintext is the same.)
+///
+/// Work is split into chunks of GEN_RECORDS_PER_CHUNK records. A worker
+/// claims the next chunk, generates and formats its records and computes the
+/// Merkle root of each block, all in parallel with the other workers. The
+/// hash chain is the only sequential step: the worker waits for the chain
+/// head left by the previous chunk, links its blocks and hands the head on.
+/// It then lays out the chunk (record lines with seal trailers, or encrypted
+/// block records) in one of threads + 2 output buffers. The calling thread
+/// writes the buffers in chunk order with one WriteFile() each and adds the
+/// chunk's entries to the block table, so the disk never waits for the
+/// generator as long as the workers keep ahead.
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+
+/// Standard includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+
+/// Kernel includes
+#include <FreeRTOS.h>
+
+#include "payrange_gen.h"
+#include "payrange_chacha20.h"
+#include "payrange_time.h"
+#include "payrange_tsc.h"
+
+/// Keystream drawn per refill of a random stream
+#define GEN_STREAM_BYTES                ( 4 * CHACHA20_BLOCK_SIZE )
+/// Nonce domains of the random streams
+#define GEN_STREAM_A                    ( 1 )
+#define GEN_STREAM_B                    ( 2 )
+#define GEN_STREAM_CAPTURES             ( 3 )
+#define GEN_BLOCKS_PER_CHUNK            ( GEN_RECORDS_PER_CHUNK / ELOG_RECORDS_PER_BLOCK )
+/// Tick of the first A and B, a B stringTime of 0 marks an empty slot
+#define GEN_FIRST_TICK                  ( 1 )
+/// Ticks of the A and B periods
+#define GEN_A_TICKS                     ( (uint64_t)TASK_A_RUNTIME_IN_MS * configTICK_RATE_HZ / 1000 )
+#define GEN_B_TICKS                     ( (uint64_t)TASK_B_RUNTIME_IN_MS * configTICK_RATE_HZ / 1000 )
+
+/// Random stream: ChaCha20 keystream for one nonce
+typedef struct
+{
+	chacha20Context_t cipher;
+	uint8_t           buffer[GEN_STREAM_BYTES];
+	uint32_t          position;
+}genStream_t;
+
+/// Output buffer of one chunk, the writer empties them in chunk order
+typedef struct
+{
+	/// Chunk that may fill this buffer next
+	uint64_t          nextChunk;
+	int               ready;
+	uint8_t          *data;
+	size_t            length;
+	uint32_t          blocks;
+	/// Offsets relative to the start of the chunk
+	elogBlockEntry_t  entries[GEN_BLOCKS_PER_CHUNK];
+}genSlot_t;
+
+/// Shared state of one run
+typedef struct
+{
+	const genOptions_t *options;
+	uint8_t             key[CHACHA20_KEY_SIZE];
+	elogSegmentHeader_t header;
+	aeadContext_t       cipher;
+	uint64_t            chunkCount;
+	/// Guards everything below, changes are signalled on changed
+	CRITICAL_SECTION    lock;
+	CONDITION_VARIABLE  changed;
+	int                 stop;
+	uint64_t            nextChunk;
+	/// Chunk whose blocks are linked next, and the chain head it starts from
+	uint64_t            chainChunk;
+	uint8_t             chainHead[SHA256_DIGEST_SIZE];
+	genSlot_t          *slots;
+	uint32_t            slotCount;
+}genRun_t;
+
+/// Working memory of one worker
+typedef struct
+{
+	genRun_t *run;
+	HANDLE    thread;
+	/// Capture times of the chunk, as cumulative exponential gaps
+	double    arrivals[GEN_RECORDS_PER_CHUNK + 2];
+	/// Record lines of the chunk, newline terminated, and where blocks start
+	char     *lines;
+	uint32_t  blockStart[GEN_BLOCKS_PER_CHUNK + 1];
+	uint8_t   roots[GEN_BLOCKS_PER_CHUNK][SHA256_DIGEST_SIZE];
+	uint16_t  sealLength[GEN_BLOCKS_PER_CHUNK];
+	char      seals[GEN_BLOCKS_PER_CHUNK][ELOG_MAX_SEAL_LENGTH];
+	char      blockText[ELOG_MAX_BLOCK_TEXT];
+	/// Simulated B list and the refresh that comes next
+	taskBStructure_t listB[SIZE_OF_THE_TASK_B_ARRAY];
+	uint64_t  nextRefresh;
+	/// A of the last period looked up
+	uint64_t  periodA;
+	int64_t   valueA;
+}genWorker_t;
+
+///-----------------------------------------------------------
+/// \brief Starts the random stream of one nonce
+///
+/// @param1 genStream_t *stream - stream to start
+/// @param2 const uint8_t key[32] - key derived from the seed
+/// @param3 uint32_t domain - GEN_STREAM_A, _B or _CAPTURES
+/// @param4 uint64_t index - A period, B refresh or chunk
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void genStreamInit(genStream_t *stream, const uint8_t key[CHACHA20_KEY_SIZE], uint32_t domain, uint64_t index)
+{
+	uint8_t nonce[CHACHA20_NONCE_SIZE];
+
+	for (int i = 0; i < 4; i++)
+	{
+		nonce[i] = (uint8_t)(domain >> (8 * i));
+	}
+	for (int i = 0; i < 8; i++)
+	{
+		nonce[4 + i] = (uint8_t)(index >> (8 * i));
+	}
+	chacha20Init(&stream->cipher, key, nonce, 0);
+	stream->position = GEN_STREAM_BYTES;
+}
+
+///-----------------------------------------------------------
+/// \brief Takes bytes from a random stream
+///
+/// @param1 genStream_t *stream - stream
+/// @param2 void *output - destination
+/// @param3 size_t length - bytes wanted
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void genStreamBytes(genStream_t *stream, void *output, size_t length)
+{
+	uint8_t *destination = (uint8_t *)output;
+
+	while (length > 0)
+	{
+		size_t available;
+
+		if (stream->position == GEN_STREAM_BYTES)
+		{
+			chacha20Keystream(&stream->cipher, stream->buffer, GEN_STREAM_BYTES / CHACHA20_BLOCK_SIZE);
+			stream->position = 0;
+		}
+		available = GEN_STREAM_BYTES - stream->position;
+		if (available > length)
+		{
+			available = length;
+		}
+		memcpy(destination, stream->buffer + stream->position, available);
+		stream->position += (uint32_t)available;
+		destination += available;
+		length -= available;
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Returns a uniform value in [0, bound) from a stream,
+///        redrawing like csprngUniform64()
+///
+/// @param1 genStream_t *stream - stream
+/// @param2 uint64_t bound - exclusive upper limit, > 0
+///
+/// @return uint64_t - random value
+///-----------------------------------------------------------
+static uint64_t genUniform(genStream_t *stream, uint64_t bound)
+{
+	const uint64_t threshold = (uint64_t)(0 - bound) % bound;
+	uint64_t value;
+
+	do
+	{
+		genStreamBytes(stream, &value, sizeof(value));
+	} while (value < threshold);
+	return value % bound;
+}
+
+///-----------------------------------------------------------
+/// \brief Returns the A shown during an A period
+///
+/// @param1 genWorker_t *worker - worker, caches the last period
+/// @param2 uint64_t period - A period since boot
+///
+/// @return int64_t - 12 digit A
+///-----------------------------------------------------------
+static int64_t genValueA(genWorker_t *worker, uint64_t period)
+{
+	genStream_t stream;
+
+	if (period != worker->periodA)
+	{
+		genStreamInit(&stream, worker->run->key, GEN_STREAM_A, period);
+		/// Same range as privateTaskA()
+		worker->valueA = (int64_t)genUniform(&stream, 900000000000) + 100000000000;
+		worker->periodA = period;
+	}
+	return worker->valueA;
+}
+
+///-----------------------------------------------------------
+/// \brief Draws B refresh k: the slot it replaces and, when
+///        valueB is given, the new B
+///
+/// @param1 const genRun_t *run - run
+/// @param2 uint64_t refresh - B refresh since boot
+/// @param3 taskBStructure_t *valueB - new B, or NULL for the slot only
+///
+/// @return uint32_t - slot replaced
+///-----------------------------------------------------------
+static uint32_t genRefreshB(const genRun_t *run, uint64_t refresh, taskBStructure_t *valueB)
+{
+	/// Character set of generateRandomString()
+	static const char charset[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+	const int charsetLength = (int)(sizeof(charset) - 1);
+	const int limit = 256 - (256 % charsetLength);
+	const uint64_t tick = GEN_FIRST_TICK + refresh * GEN_B_TICKS;
+	genStream_t stream;
+	uint32_t slot;
+	int produced = 0;
+
+	genStreamInit(&stream, run->key, GEN_STREAM_B, refresh);
+	slot = (uint32_t)genUniform(&stream, SIZE_OF_THE_TASK_B_ARRAY);
+	if (valueB == NULL)
+	{
+		return slot;
+	}
+	while (produced < NUMBER_OF_ALPHANUMERIC_DIGITS)
+	{
+		uint8_t byte;
+		genStreamBytes(&stream, &byte, 1);
+		if (byte < limit)
+		{
+			valueB->stringPlacer[produced++] = charset[byte % charsetLength];
+		}
+	}
+	valueB->stringPlacer[NUMBER_OF_ALPHANUMERIC_DIGITS] = '\0';
+	valueB->stringTime = (TickType_t)tick;
+	valueB->stringTimeUtcNs = GEN_START_UTC_NS + tick * TIME_NS_PER_TICK;
+	return slot;
+}
+
+///-----------------------------------------------------------
+/// \brief Rebuilds the B list as it was at a tick: each slot
+///        holds the latest refresh that picked it, found by
+///        walking the refreshes back from that tick
+///
+/// @param1 genWorker_t *worker - worker, listB and nextRefresh
+/// @param2 uint64_t tick - tick of the chunk's first capture
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void genRestoreB(genWorker_t *worker, uint64_t tick)
+{
+	const uint64_t refreshes = (tick - GEN_FIRST_TICK) / GEN_B_TICKS + 1;
+	int found[SIZE_OF_THE_TASK_B_ARRAY] = { 0 };
+	int missing = SIZE_OF_THE_TASK_B_ARRAY;
+
+	memset(worker->listB, 0, sizeof(worker->listB));
+	for (uint64_t refresh = refreshes; (refresh > 0) && (missing > 0); refresh--)
+	{
+		const uint32_t slot = genRefreshB(worker->run, refresh - 1, NULL);
+		if (!found[slot])
+		{
+			genRefreshB(worker->run, refresh - 1, &worker->listB[slot]);
+			found[slot] = 1;
+			missing--;
+		}
+	}
+	worker->nextRefresh = refreshes;
+}
+
+///-----------------------------------------------------------
+/// \brief Generates and formats the records of a chunk and
+///        computes the Merkle root of each of its blocks
+///
+/// @param1 genWorker_t *worker - worker
+/// @param2 uint64_t chunk - chunk index
+///
+/// @return uint32_t - blocks in the chunk
+///-----------------------------------------------------------
+static uint32_t genFillChunk(genWorker_t *worker, uint64_t chunk)
+{
+	const genOptions_t *options = worker->run->options;
+	const uint64_t firstRecord = chunk * GEN_RECORDS_PER_CHUNK;
+	const uint32_t count = (uint32_t)(((options->records - firstRecord) < GEN_RECORDS_PER_CHUNK) ?
+		(options->records - firstRecord) : GEN_RECORDS_PER_CHUNK);
+	const double nsPerCapture = 1e9 / (double)options->capturesPerSecond;
+	const double startNs = (double)firstRecord * nsPerCapture;
+	const double windowNs = (double)count * nsPerCapture;
+	const uint8_t *lines[ELOG_RECORDS_PER_BLOCK];
+	size_t lengths[ELOG_RECORDS_PER_BLOCK];
+	genStream_t stream;
+	uint32_t position = 0;
+	uint32_t blocks = 0;
+
+	/// count arrivals of a Poisson stream in the window: the sums of
+	/// count + 1 exponential gaps, scaled so that the last gap ends it
+	genStreamInit(&stream, worker->run->key, GEN_STREAM_CAPTURES, chunk);
+	worker->arrivals[0] = 0.0;
+	for (uint32_t i = 1; i <= count + 1; i++)
+	{
+		uint64_t bits;
+		genStreamBytes(&stream, &bits, sizeof(bits));
+		worker->arrivals[i] = worker->arrivals[i - 1] - log(1.0 - (double)(bits >> 11) * (1.0 / 9007199254740992.0));
+	}
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const double arrivalNs = startNs + windowNs * (worker->arrivals[i + 1] / worker->arrivals[count + 1]);
+		const uint64_t tick = GEN_FIRST_TICK + (uint64_t)arrivalNs / TIME_NS_PER_TICK;
+		const uint64_t period = (tick - GEN_FIRST_TICK) / GEN_A_TICKS;
+		const uint64_t tickA = GEN_FIRST_TICK + period * GEN_A_TICKS;
+		const uint32_t blockRecord = i % ELOG_RECORDS_PER_BLOCK;
+		valueE_t valueE;
+		uint32_t slot;
+
+		if (i == 0)
+		{
+			genRestoreB(worker, tick);
+		}
+		/// Apply the B refreshes up to the capture
+		while (GEN_FIRST_TICK + worker->nextRefresh * GEN_B_TICKS <= tick)
+		{
+			slot = genRefreshB(worker->run, worker->nextRefresh, NULL);
+			genRefreshB(worker->run, worker->nextRefresh, &worker->listB[slot]);
+			worker->nextRefresh++;
+		}
+
+		/// D is the A on screen at the capture, paired with a random B that
+		/// has been populated
+		do
+		{
+			slot = (uint32_t)genUniform(&stream, SIZE_OF_THE_TASK_B_ARRAY);
+		} while (worker->listB[slot].stringTime == 0);
+		valueE.randomValueB = worker->listB[slot];
+		valueE.currentValueD.randomNumberTime = (TickType_t)tickA;
+		valueE.currentValueD.randomNumber = genValueA(worker, period);
+		valueE.currentValueD.randomNumberTimeUtcNs = GEN_START_UTC_NS + tickA * TIME_NS_PER_TICK;
+
+		if (blockRecord == 0)
+		{
+			worker->blockStart[blocks] = position;
+		}
+		lines[blockRecord] = (const uint8_t *)(worker->lines + position);
+		lengths[blockRecord] = (size_t)elogFormatRecord((int)(firstRecord + i), &valueE, worker->lines + position);
+		position += (uint32_t)lengths[blockRecord];
+		worker->lines[position++] = '\n';
+
+		if ((blockRecord == ELOG_RECORDS_PER_BLOCK - 1) || (i == count - 1))
+		{
+			elogMerkleRoot(lines, lengths, (int)blockRecord + 1, worker->roots[blocks]);
+			blocks++;
+		}
+	}
+	worker->blockStart[blocks] = position;
+	return blocks;
+}
+
+///-----------------------------------------------------------
+/// \brief Links the blocks of a chunk into the hash chain and
+///        formats their seal trailers. Only the worker whose
+///        chunk is run->chainChunk calls it.
+///
+/// @param1 genWorker_t *worker - worker
+/// @param2 uint64_t chunk - chunk index
+/// @param3 uint32_t blocks - blocks in the chunk
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void genSealChunk(genWorker_t *worker, uint64_t chunk, uint32_t blocks)
+{
+	genRun_t *run = worker->run;
+	const uint64_t firstRecord = chunk * GEN_RECORDS_PER_CHUNK;
+
+	for (uint32_t block = 0; block < blocks; block++)
+	{
+		const uint64_t firstLine = firstRecord + (uint64_t)block * ELOG_RECORDS_PER_BLOCK;
+		const uint64_t recordCount = ((run->options->records - firstLine) < ELOG_RECORDS_PER_BLOCK) ?
+			(run->options->records - firstLine) : ELOG_RECORDS_PER_BLOCK;
+
+		worker->sealLength[block] = (uint16_t)elogFormatSeal(run->chainHead, worker->roots[block],
+			(uint32_t)(chunk * GEN_BLOCKS_PER_CHUNK + block), (uint32_t)firstLine, (uint32_t)recordCount,
+			worker->seals[block], sizeof(worker->seals[block]));
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Lays out a sealed chunk in its output buffer: the
+///        lines and trailer of each block, encrypted when the
+///        run writes a segment, and the block table entries
+///
+/// @param1 genWorker_t *worker - worker
+/// @param2 uint64_t chunk - chunk index
+/// @param3 uint32_t blocks - blocks in the chunk
+/// @param4 genSlot_t *slot - output buffer
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void genLayoutChunk(genWorker_t *worker, uint64_t chunk, uint32_t blocks, genSlot_t *slot)
+{
+	const genRun_t *run = worker->run;
+	size_t length = 0;
+
+	for (uint32_t block = 0; block < blocks; block++)
+	{
+		const uint64_t firstLine = chunk * GEN_RECORDS_PER_CHUNK + (uint64_t)block * ELOG_RECORDS_PER_BLOCK;
+		const size_t lineBytes = worker->blockStart[block + 1] - worker->blockStart[block];
+		const char *blockLines = worker->lines + worker->blockStart[block];
+		elogBlockEntry_t *entry = &slot->entries[block];
+
+		memset(entry, 0, sizeof(*entry));
+		entry->offset = length;
+		entry->firstLine = (uint32_t)firstLine;
+		entry->recordCount = (uint32_t)(((run->options->records - firstLine) < ELOG_RECORDS_PER_BLOCK) ?
+			(run->options->records - firstLine) : ELOG_RECORDS_PER_BLOCK);
+		if (run->options->encrypt)
+		{
+			memcpy(worker->blockText, blockLines, lineBytes);
+			memcpy(worker->blockText + lineBytes, worker->seals[block], worker->sealLength[block]);
+			entry->length = elogEncryptBlock(&run->header, &run->cipher, (uint32_t)(chunk * GEN_BLOCKS_PER_CHUNK + block),
+				worker->blockText, lineBytes + worker->sealLength[block], slot->data + length);
+		}
+		else
+		{
+			memcpy(slot->data + length, blockLines, lineBytes);
+			memcpy(slot->data + length + lineBytes, worker->seals[block], worker->sealLength[block]);
+			entry->length = (uint32_t)(lineBytes + worker->sealLength[block]);
+		}
+		length += entry->length;
+	}
+	slot->length = length;
+	slot->blocks = blocks;
+}
+
+///-----------------------------------------------------------
+/// \brief Worker thread: claims chunks in order, generates
+///        them, takes its turn on the hash chain and hands the
+///        laid out chunk to the writer
+///
+/// @param1 LPVOID parameter - genWorker_t of the thread
+///
+/// @return DWORD - 0
+///-----------------------------------------------------------
+static DWORD WINAPI genWorkerThread(LPVOID parameter)
+{
+	genWorker_t *worker = (genWorker_t *)parameter;
+	genRun_t *run = worker->run;
+
+	for (;;)
+	{
+		genSlot_t *slot;
+		uint64_t chunk;
+		uint32_t blocks;
+		int stop;
+
+		EnterCriticalSection(&run->lock);
+		if (run->stop || (run->nextChunk == run->chunkCount))
+		{
+			LeaveCriticalSection(&run->lock);
+			break;
+		}
+		chunk = run->nextChunk++;
+		LeaveCriticalSection(&run->lock);
+
+		blocks = genFillChunk(worker, chunk);
+
+		EnterCriticalSection(&run->lock);
+		while (!run->stop && (run->chainChunk != chunk))
+		{
+			SleepConditionVariableCS(&run->changed, &run->lock, INFINITE);
+		}
+		stop = run->stop;
+		LeaveCriticalSection(&run->lock);
+		if (stop)
+		{
+			break;
+		}
+		/// The chain head is this worker's until chainChunk moves on
+		genSealChunk(worker, chunk, blocks);
+
+		slot = &run->slots[chunk % run->slotCount];
+		EnterCriticalSection(&run->lock);
+		run->chainChunk++;
+		WakeAllConditionVariable(&run->changed);
+		while (!run->stop && (slot->nextChunk != chunk))
+		{
+			SleepConditionVariableCS(&run->changed, &run->lock, INFINITE);
+		}
+		stop = run->stop;
+		LeaveCriticalSection(&run->lock);
+		if (stop)
+		{
+			break;
+		}
+
+		genLayoutChunk(worker, chunk, blocks, slot);
+
+		EnterCriticalSection(&run->lock);
+		slot->ready = 1;
+		WakeAllConditionVariable(&run->changed);
+		LeaveCriticalSection(&run->lock);
+	}
+	return 0;
+}
+
+///-----------------------------------------------------------
+/// \brief Writes all of a buffer to a file
+///
+/// @param1 HANDLE file - file
+/// @param2 const void *data - bytes
+/// @param3 size_t length - byte count
+///
+/// @return int - 1 on success
+///-----------------------------------------------------------
+static int genWrite(HANDLE file, const void *data, size_t length)
+{
+	DWORD written;
+
+	return WriteFile(file, data, (DWORD)length, &written, NULL) && (written == (DWORD)length);
+}
+
+///-----------------------------------------------------------
+/// \brief Generates a dataset: starts the workers and writes
+///        their chunks in order to the E log and block table
+///
+/// @param1 const genOptions_t *options - what to generate
+/// @param2 genReport_t *report - counters
+///
+/// @return int - 1 on success, 0 on a bad option, key or write
+///-----------------------------------------------------------
+int genDataset(const genOptions_t *options, genReport_t *report)
+{
+	static genRun_t run;
+	genWorker_t *workers[GEN_MAX_THREADS];
+	uint8_t seed[8];
+	HANDLE logFile;
+	HANDLE tableFile;
+	uint64_t fileOffset = 0;
+	uint32_t started = 0;
+	DWORD disposition;
+	int outOfMemory;
+	int failed = 0;
+	const uint64_t start = tscNow();
+
+	memset(report, 0, sizeof(*report));
+	if ((options->records == 0) || (options->records > INT32_MAX) || (options->threads == 0) ||
+		(options->threads > GEN_MAX_THREADS) || (options->capturesPerSecond == 0))
+	{
+		printf("Dataset: 1 to %d records, 1 to %d threads and a rate above 0\n", INT32_MAX, GEN_MAX_THREADS);
+		return 0;
+	}
+
+	memset(&run, 0, sizeof(run));
+	run.options = options;
+	run.chunkCount = (options->records + GEN_RECORDS_PER_CHUNK - 1) / GEN_RECORDS_PER_CHUNK;
+	for (int i = 0; i < 8; i++)
+	{
+		seed[i] = (uint8_t)(options->seed >> (8 * i));
+	}
+	sha256(seed, sizeof(seed), run.key);
+	if (options->encrypt && !elogCreateSegment(ELOG_KEY_FILE_NAME, &run.header, &run.cipher))
+	{
+		printf("Dataset: no segment could be started with the key in %s (--genkey creates one)\n", ELOG_KEY_FILE_NAME);
+		return 0;
+	}
+
+	disposition = options->overwrite ? CREATE_ALWAYS : CREATE_NEW;
+	logFile = CreateFileA(options->logPath, GENERIC_WRITE, 0, NULL, disposition, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	tableFile = CreateFileA(options->tablePath, GENERIC_WRITE, 0, NULL, disposition, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if ((logFile == INVALID_HANDLE_VALUE) || (tableFile == INVALID_HANDLE_VALUE))
+	{
+		printf("Dataset: %s or %s could not be created%s\n", options->logPath, options->tablePath,
+			options->overwrite ? "" : " (existing files are only replaced with --force)");
+		/// Do not leave one new file behind without the other
+		if (logFile != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(logFile);
+			DeleteFileA(options->logPath);
+			logFile = INVALID_HANDLE_VALUE;
+		}
+		if (tableFile != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(tableFile);
+			DeleteFileA(options->tablePath);
+			tableFile = INVALID_HANDLE_VALUE;
+		}
+		failed = 1;
+	}
+	else if (options->encrypt)
+	{
+		failed = !genWrite(logFile, &run.header, sizeof(run.header));
+		fileOffset = sizeof(run.header);
+	}
+
+	/// Two spare buffers keep the workers going while one is written
+	run.slotCount = options->threads + 2;
+	run.slots = (genSlot_t *)calloc(run.slotCount, sizeof(genSlot_t));
+	outOfMemory = (run.slots == NULL);
+	for (uint32_t i = 0; !outOfMemory && (i < run.slotCount); i++)
+	{
+		run.slots[i].nextChunk = i;
+		run.slots[i].data = (uint8_t *)malloc(GEN_BLOCKS_PER_CHUNK * ELOG_MAX_BLOCK_RECORD);
+		outOfMemory = (run.slots[i].data == NULL);
+	}
+	InitializeCriticalSection(&run.lock);
+	InitializeConditionVariable(&run.changed);
+	for (uint32_t i = 0; !failed && !outOfMemory && (i < options->threads); i++)
+	{
+		genWorker_t *worker = (genWorker_t *)calloc(1, sizeof(genWorker_t));
+		char *lines = (char *)malloc((size_t)GEN_RECORDS_PER_CHUNK * ELOG_MAX_LINE_LENGTH);
+
+		if ((worker == NULL) || (lines == NULL))
+		{
+			free(worker);
+			free(lines);
+			outOfMemory = 1;
+			break;
+		}
+		worker->run = &run;
+		worker->lines = lines;
+		worker->periodA = UINT64_MAX;
+		worker->thread = CreateThread(NULL, 0, genWorkerThread, worker, 0, NULL);
+		workers[started++] = worker;
+	}
+	if (outOfMemory)
+	{
+		printf("Dataset: out of memory\n");
+		failed = 1;
+	}
+
+	/// Write the chunks in order as the workers finish them
+	for (uint64_t chunk = 0; !failed && (chunk < run.chunkCount); chunk++)
+	{
+		genSlot_t *slot = &run.slots[chunk % run.slotCount];
+
+		EnterCriticalSection(&run.lock);
+		while (!slot->ready)
+		{
+			SleepConditionVariableCS(&run.changed, &run.lock, INFINITE);
+		}
+		LeaveCriticalSection(&run.lock);
+
+		for (uint32_t block = 0; block < slot->blocks; block++)
+		{
+			slot->entries[block].offset += fileOffset;
+		}
+		if (!genWrite(logFile, slot->data, slot->length) ||
+			!genWrite(tableFile, slot->entries, slot->blocks * sizeof(elogBlockEntry_t)))
+		{
+			printf("Dataset: write failed after %" PRIu64 " bytes\n", report->bytesWritten);
+			failed = 1;
+		}
+		fileOffset += slot->length;
+		report->bytesWritten += slot->length;
+		report->blocks += slot->blocks;
+
+		EnterCriticalSection(&run.lock);
+		slot->ready = 0;
+		slot->nextChunk += run.slotCount;
+		WakeAllConditionVariable(&run.changed);
+		LeaveCriticalSection(&run.lock);
+	}
+
+	/// A failed run stops the workers wherever they wait
+	EnterCriticalSection(&run.lock);
+	run.stop = failed;
+	WakeAllConditionVariable(&run.changed);
+	LeaveCriticalSection(&run.lock);
+	for (uint32_t i = 0; i < started; i++)
+	{
+		WaitForSingleObject(workers[i]->thread, INFINITE);
+		CloseHandle(workers[i]->thread);
+		free(workers[i]->lines);
+		free(workers[i]);
+	}
+	DeleteCriticalSection(&run.lock);
+	for (uint32_t i = 0; (run.slots != NULL) && (i < run.slotCount); i++)
+	{
+		free(run.slots[i].data);
+	}
+	free(run.slots);
+	if (options->encrypt)
+	{
+		aeadClear(&run.cipher);
+	}
+	if (logFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(logFile);
+	}
+	if (tableFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(tableFile);
+	}
+
+	report->records = failed ? 0 : options->records;
+	report->threads = options->threads;
+	report->simulatedNs = (uint64_t)((double)options->records * 1e9 / (double)options->capturesPerSecond);
+	report->elapsedNs = tscToNs(tscNow() - start);
+	return !failed;
+}
+
+///-----------------------------------------------------------
+/// \brief Prints a generator report
+///
+/// @param1 const genReport_t *report - counters
+///
+/// @return N/A
+///-----------------------------------------------------------
+void genPrintReport(const genReport_t *report)
+{
+	const double seconds = (double)report->elapsedNs / 1e9;
+
+	printf("Dataset: %" PRIu64 " records in %u blocks, %.1f MB, %.1f simulated hours\n", report->records,
+		(unsigned int)report->blocks, (double)report->bytesWritten / 1e6, (double)report->simulatedNs / 3.6e12);
+	printf("Dataset: %u threads, %.3f s, %.0f records/s, %.1f MB/s written\n", (unsigned int)report->threads, seconds,
+		(seconds > 0.0) ? (double)report->records / seconds : 0.0,
+		(seconds > 0.0) ? (double)report->bytesWritten / 1e6 / seconds : 0.0);
+}
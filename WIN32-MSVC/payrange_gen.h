@@ -0,0 +1,64 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_gen.h
+///-----------------------------------------------------------------------------
+///
+/// \brief Synthetic E history: sealed E logs of any size with the record
+///        stream of a long simulator run, generated on all cores from a seed
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_GEN_H
+#define PAYRANGE_GEN_H
+
+/// Standard includes
+#include <stdint.h>
+
+#include "payrange_elog.h"
+
+/// Dataset generator configurable defines
+/// Records generated, sealed and written as one unit of work. The output of
+/// a seed depends on this and not on the number of threads.
+#define GEN_RECORDS_PER_CHUNK           ( 256 * ELOG_RECORDS_PER_BLOCK )
+#define GEN_MAX_THREADS                 ( 64 )
+/// Captures per second of simulated time when none is given
+#define GEN_DEFAULT_RATE                ( 100 )
+/// Simulated boot time: 2020-01-01 00:00:00 UTC
+#define GEN_START_UTC_NS                ( 1577836800ULL * 1000000000ULL )
+
+/// What to generate
+typedef struct
+{
+	uint64_t    records;
+	/// 0: plain E log, 1: encrypted segment (key from ELOG_KEY_FILE_NAME)
+	int         encrypt;
+	uint64_t    seed;
+	/// Worker threads; the calling thread writes
+	uint32_t    threads;
+	/// Captures per second of simulated time
+	uint32_t    capturesPerSecond;
+	const char *logPath;
+	const char *tablePath;
+	/// 0: refuse to replace an existing log or block table
+	int         overwrite;
+}genOptions_t;
+
+/// Counters of one run
+typedef struct
+{
+	uint64_t records;
+	uint32_t blocks;
+	uint32_t threads;
+	uint64_t bytesWritten;
+	/// Simulated time covered by the records
+	uint64_t simulatedNs;
+	uint64_t elapsedNs;
+}genReport_t;
+
+/// Generates options->records E records into a new E log and block table,
+/// replacing existing files only with options->overwrite; returns 1 on
+/// success
+int genDataset(const genOptions_t *options, genReport_t *report);
+/// Prints a generator report
+void genPrintReport(const genReport_t *report);
+
+#endif /// PAYRANGE_GEN_H
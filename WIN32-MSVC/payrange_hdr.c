@@ -0,0 +1,334 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_hdr.c
+///-----------------------------------------------------------------------------
+///
+/// \brief High dynamic range histogram
+///
+/// Same layout as HdrHistogram: values are grouped in buckets that double
+/// in width, each split into subBucketCount sub-buckets, enough for
+/// significantDigits decimal digits. The lower half of every bucket but the
+/// first repeats the previous bucket's range and is not stored, so a value
+/// is one leading-zero count and two shifts away from its counter. The
+/// memory is (bucketCount + 1) * subBucketCount / 2 counters: 216 KB for one
+/// ns to one minute at 3 digits.
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+
+/// Standard includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "payrange_hdr.h"
+
+///-----------------------------------------------------------
+/// \brief Counts the leading zero bits
+///
+/// @param1 uint64_t value - not 0
+///
+/// @return int32_t - 0 to 63
+///-----------------------------------------------------------
+static int32_t hdrLeadingZeros(uint64_t value)
+{
+	int32_t zeros = 0;
+
+	/// The x86 build has no 64-bit bit scan, halve the range instead
+	for (int32_t shift = 32; shift > 0; shift /= 2)
+	{
+		if ((value >> (64 - shift - zeros)) == 0)
+		{
+			zeros += shift;
+		}
+	}
+	return zeros;
+}
+
+///-----------------------------------------------------------
+/// \brief Bucket of a value
+///
+/// @param1 const hdrHistogram_t *histogram - histogram
+/// @param2 int64_t value - value
+///
+/// @return int32_t - bucket
+///-----------------------------------------------------------
+static int32_t hdrBucketIndex(const hdrHistogram_t *histogram, int64_t value)
+{
+	return 64 - histogram->subBucketHalfCountMagnitude - 1 -
+		hdrLeadingZeros((uint64_t)(value | histogram->subBucketMask));
+}
+
+///-----------------------------------------------------------
+/// \brief Counter of a value
+///
+/// @param1 const hdrHistogram_t *histogram - histogram
+/// @param2 int64_t value - value
+///
+/// @return int32_t - index into counts
+///-----------------------------------------------------------
+static int32_t hdrCountsIndex(const hdrHistogram_t *histogram, int64_t value)
+{
+	const int32_t bucket = hdrBucketIndex(histogram, value);
+	const int32_t subBucket = (int32_t)(value >> bucket);
+
+	return ((bucket + 1) << histogram->subBucketHalfCountMagnitude) + (subBucket - histogram->subBucketHalfCount);
+}
+
+///-----------------------------------------------------------
+/// \brief Highest value that falls into a counter
+///
+/// @param1 const hdrHistogram_t *histogram - histogram
+/// @param2 int32_t index - index into counts
+///
+/// @return int64_t - value
+///-----------------------------------------------------------
+static int64_t hdrHighestValueAt(const hdrHistogram_t *histogram, int32_t index)
+{
+	int32_t bucket = (index >> histogram->subBucketHalfCountMagnitude) - 1;
+	int32_t subBucket = (index & (histogram->subBucketHalfCount - 1)) + histogram->subBucketHalfCount;
+
+	if (bucket < 0)
+	{
+		subBucket -= histogram->subBucketHalfCount;
+		bucket = 0;
+	}
+	return ((int64_t)subBucket << bucket) + ((int64_t)1 << bucket) - 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Sets up an empty histogram
+///
+/// @param1 hdrHistogram_t *histogram - histogram
+/// @param2 int64_t highestValue - highest value tracked, 2 or more
+/// @param3 int32_t significantDigits - 1 to 5
+///
+/// @return int - 0 when out of memory
+///-----------------------------------------------------------
+int hdrInit(hdrHistogram_t *histogram, int64_t highestValue, int32_t significantDigits)
+{
+	const int64_t singleUnitRange = 2 * (int64_t)pow(10.0, significantDigits);
+	int32_t subBucketCountMagnitude = 0;
+	int64_t smallestUntracked;
+
+	memset(histogram, 0, sizeof(*histogram));
+	while (((int64_t)1 << subBucketCountMagnitude) < singleUnitRange)
+	{
+		subBucketCountMagnitude++;
+	}
+	histogram->highestValue = highestValue;
+	histogram->significantDigits = significantDigits;
+	histogram->subBucketHalfCountMagnitude = ((subBucketCountMagnitude > 1) ? subBucketCountMagnitude : 1) - 1;
+	histogram->subBucketCount = 1 << (histogram->subBucketHalfCountMagnitude + 1);
+	histogram->subBucketHalfCount = histogram->subBucketCount / 2;
+	histogram->subBucketMask = (int64_t)histogram->subBucketCount - 1;
+
+	histogram->bucketCount = 1;
+	smallestUntracked = histogram->subBucketCount;
+	while ((smallestUntracked <= highestValue) && (smallestUntracked <= INT64_MAX / 2))
+	{
+		smallestUntracked <<= 1;
+		histogram->bucketCount++;
+	}
+	histogram->countsLength = (histogram->bucketCount + 1) * histogram->subBucketHalfCount;
+	histogram->minValue = INT64_MAX;
+	histogram->counts = (int64_t *)calloc((size_t)histogram->countsLength, sizeof(int64_t));
+	return (histogram->counts != NULL);
+}
+
+///-----------------------------------------------------------
+/// \brief Frees the counts
+///
+/// @param1 hdrHistogram_t *histogram - histogram
+///
+/// @return N/A
+///-----------------------------------------------------------
+void hdrFree(hdrHistogram_t *histogram)
+{
+	free(histogram->counts);
+	histogram->counts = NULL;
+}
+
+///-----------------------------------------------------------
+/// \brief Records a value count times
+///
+/// @param1 hdrHistogram_t *histogram - histogram
+/// @param2 int64_t value - value, clamped to 0..highestValue
+/// @param3 int64_t count - times
+///
+/// @return N/A
+///-----------------------------------------------------------
+void hdrRecordCount(hdrHistogram_t *histogram, int64_t value, int64_t count)
+{
+	value = (value < 0) ? 0 : ((value > histogram->highestValue) ? histogram->highestValue : value);
+	histogram->counts[hdrCountsIndex(histogram, value)] += count;
+	histogram->totalCount += count;
+	histogram->minValue = (value < histogram->minValue) ? value : histogram->minValue;
+	histogram->maxValue = (value > histogram->maxValue) ? value : histogram->maxValue;
+}
+
+///-----------------------------------------------------------
+/// \brief Records a value
+///
+/// @param1 hdrHistogram_t *histogram - histogram
+/// @param2 int64_t value - value, clamped to 0..highestValue
+///
+/// @return N/A
+///-----------------------------------------------------------
+void hdrRecord(hdrHistogram_t *histogram, int64_t value)
+{
+	hdrRecordCount(histogram, value, 1);
+}
+
+///-----------------------------------------------------------
+/// \brief Adds the counts of another histogram
+///
+/// @param1 hdrHistogram_t *histogram - histogram
+/// @param2 const hdrHistogram_t *other - same highest value and
+///                                       digits
+///
+/// @return N/A
+///-----------------------------------------------------------
+void hdrAdd(hdrHistogram_t *histogram, const hdrHistogram_t *other)
+{
+	for (int32_t i = 0; i < other->countsLength; i++)
+	{
+		histogram->counts[i] += other->counts[i];
+	}
+	histogram->totalCount += other->totalCount;
+	histogram->minValue = (other->minValue < histogram->minValue) ? other->minValue : histogram->minValue;
+	histogram->maxValue = (other->maxValue > histogram->maxValue) ? other->maxValue : histogram->maxValue;
+}
+
+///-----------------------------------------------------------
+/// \brief Value at a percentile
+///
+/// @param1 const hdrHistogram_t *histogram - histogram
+/// @param2 double percentile - 0 to 100
+///
+/// @return int64_t - highest value of the counter that holds it
+///-----------------------------------------------------------
+int64_t hdrValueAtPercentile(const hdrHistogram_t *histogram, double percentile)
+{
+	int64_t wanted = (int64_t)(((percentile < 100.0) ? percentile : 100.0) / 100.0 * (double)histogram->totalCount + 0.5);
+	int64_t total = 0;
+
+	wanted = (wanted > 0) ? wanted : 1;
+	for (int32_t i = 0; i < histogram->countsLength; i++)
+	{
+		total += histogram->counts[i];
+		if (total >= wanted)
+		{
+			const int64_t value = hdrHighestValueAt(histogram, i);
+			return (value < histogram->maxValue) ? value : histogram->maxValue;
+		}
+	}
+	return 0;
+}
+
+///-----------------------------------------------------------
+/// \brief Mean of the recorded values
+///
+/// @param1 const hdrHistogram_t *histogram - histogram
+///
+/// @return double - mean, each counter at its middle value
+///-----------------------------------------------------------
+double hdrMean(const hdrHistogram_t *histogram)
+{
+	double sum = 0.0;
+
+	if (histogram->totalCount == 0)
+	{
+		return 0.0;
+	}
+	for (int32_t i = 0; i < histogram->countsLength; i++)
+	{
+		if (histogram->counts[i] > 0)
+		{
+			const int64_t highest = hdrHighestValueAt(histogram, i);
+			const int64_t lowest = (i > 0) ? hdrHighestValueAt(histogram, i - 1) + 1 : 0;
+			sum += (double)histogram->counts[i] * ((double)lowest + (double)highest) / 2.0;
+		}
+	}
+	return sum / (double)histogram->totalCount;
+}
+
+///-----------------------------------------------------------
+/// \brief Standard deviation of the recorded values
+///
+/// @param1 const hdrHistogram_t *histogram - histogram
+///
+/// @return double - standard deviation
+///-----------------------------------------------------------
+double hdrStdDeviation(const hdrHistogram_t *histogram)
+{
+	const double mean = hdrMean(histogram);
+	double squares = 0.0;
+
+	if (histogram->totalCount == 0)
+	{
+		return 0.0;
+	}
+	for (int32_t i = 0; i < histogram->countsLength; i++)
+	{
+		if (histogram->counts[i] > 0)
+		{
+			const int64_t highest = hdrHighestValueAt(histogram, i);
+			const int64_t lowest = (i > 0) ? hdrHighestValueAt(histogram, i - 1) + 1 : 0;
+			const double deviation = ((double)lowest + (double)highest) / 2.0 - mean;
+			squares += (double)histogram->counts[i] * deviation * deviation;
+		}
+	}
+	return sqrt(squares / (double)histogram->totalCount);
+}
+
+///-----------------------------------------------------------
+/// \brief Writes the percentile distribution: a line per
+///        reporting level, the levels closing in on 100% by
+///        HDR_TICKS_PER_HALF_DISTANCE steps per halving of the
+///        distance, then the summary lines
+///
+/// @param1 const hdrHistogram_t *histogram - histogram
+/// @param2 FILE *output - output
+/// @param3 double unitRatio - recorded units per printed unit
+///
+/// @return N/A
+///-----------------------------------------------------------
+void hdrPrintPercentiles(const hdrHistogram_t *histogram, FILE *output, double unitRatio)
+{
+	double level = 0.0;
+	int64_t total = 0;
+
+	fprintf(output, "%12s %14s %10s %14s\n\n", "Value", "Percentile", "TotalCount", "1/(1-Percentile)");
+	for (int32_t i = 0; (i < histogram->countsLength) && (total < histogram->totalCount); i++)
+	{
+		const int64_t highest = hdrHighestValueAt(histogram, i);
+		const double value = (double)((highest < histogram->maxValue) ? highest : histogram->maxValue) / unitRatio;
+
+		if (histogram->counts[i] == 0)
+		{
+			continue;
+		}
+		total += histogram->counts[i];
+		if (total == histogram->totalCount)
+		{
+			fprintf(output, "%12.3f %1.12f %10lld\n", value, 1.0, (long long)total);
+			break;
+		}
+		while ((double)total * 100.0 / (double)histogram->totalCount >= level)
+		{
+			const double halfDistances = floor(log(100.0 / (100.0 - level)) / log(2.0)) + 1.0;
+			const double ticks = HDR_TICKS_PER_HALF_DISTANCE * pow(2.0, halfDistances);
+
+			fprintf(output, "%12.3f %1.12f %10lld %14.2f\n", value, level / 100.0, (long long)total,
+				1.0 / (1.0 - level / 100.0));
+			level += 100.0 / ticks;
+		}
+	}
+	fprintf(output, "#[Mean    = %12.3f, StdDeviation   = %12.3f]\n", hdrMean(histogram) / unitRatio,
+		hdrStdDeviation(histogram) / unitRatio);
+	fprintf(output, "#[Max     = %12.3f, Total count    = %12lld]\n", (double)histogram->maxValue / unitRatio,
+		(long long)histogram->totalCount);
+	fprintf(output, "#[Buckets = %12d, SubBuckets     = %12d]\n", (int)histogram->bucketCount,
+		(int)histogram->subBucketCount);
+}
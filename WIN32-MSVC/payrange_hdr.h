@@ -0,0 +1,60 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_hdr.h
+///-----------------------------------------------------------------------------
+///
+/// \brief High dynamic range histogram: latencies from one unit to minutes at
+///        a fixed number of significant digits, in the HdrHistogram layout,
+///        printed as an HdrHistogram percentile distribution
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_HDR_H
+#define PAYRANGE_HDR_H
+
+/// Standard includes
+#include <stdio.h>
+#include <stdint.h>
+
+/// Histogram configurable defines
+/// Percentile reporting ticks per half distance to 100%, as HdrHistogram's
+/// outputPercentileDistribution() uses by default
+#define HDR_TICKS_PER_HALF_DISTANCE     ( 5 )
+
+/// Histogram of values from 1 to highestValue
+typedef struct
+{
+	int64_t  highestValue;
+	int32_t  significantDigits;
+	int32_t  subBucketHalfCountMagnitude;
+	int32_t  subBucketCount;
+	int32_t  subBucketHalfCount;
+	int64_t  subBucketMask;
+	int32_t  bucketCount;
+	int32_t  countsLength;
+	int64_t  totalCount;
+	int64_t  minValue;
+	int64_t  maxValue;
+	int64_t *counts;
+}hdrHistogram_t;
+
+/// Sets up an empty histogram of values 1 to highestValue, exact to
+/// significantDigits (1 to 5) digits; returns 0 when out of memory
+int hdrInit(hdrHistogram_t *histogram, int64_t highestValue, int32_t significantDigits);
+/// Frees the counts
+void hdrFree(hdrHistogram_t *histogram);
+/// Records a value; values above highestValue are recorded as highestValue
+void hdrRecord(hdrHistogram_t *histogram, int64_t value);
+/// Records a value count times
+void hdrRecordCount(hdrHistogram_t *histogram, int64_t value, int64_t count);
+/// Adds the counts of another histogram of the same layout
+void hdrAdd(hdrHistogram_t *histogram, const hdrHistogram_t *other);
+/// Highest value at or below which percentile (0 to 100) of the values are
+int64_t hdrValueAtPercentile(const hdrHistogram_t *histogram, double percentile);
+/// Mean and standard deviation of the recorded values
+double hdrMean(const hdrHistogram_t *histogram);
+double hdrStdDeviation(const hdrHistogram_t *histogram);
+/// Writes the percentile distribution in HdrHistogram's text format (what
+/// the HdrHistogram plotter reads), values divided by unitRatio
+void hdrPrintPercentiles(const hdrHistogram_t *histogram, FILE *output, double unitRatio);
+
+#endif /// PAYRANGE_HDR_H
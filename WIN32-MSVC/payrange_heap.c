@@ -0,0 +1,241 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_heap.c
+///-----------------------------------------------------------------------------
+///
+/// \brief Per-task heap accounting
+///
+/// heap_5 reports every allocation and free through the traceMALLOC and
+/// traceFREE macros, which FreeRTOSConfig.h points here. Both run inside
+/// the heap's vTaskSuspendAll() section, so no other task can be in here at
+/// the same time and the tables need no lock of their own.
+///
+/// A task's account number is kept in its application task tag, assigned
+/// on its first allocation, so finding the account is one tag read. Each
+/// live block remembers its account and size: a block freed by another task
+/// (a queue deleted by its consumer, say) is still credited back to the
+/// task that allocated it, and the size is the one that was charged.
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+
+/// Standard includes
+#include <stdio.h>
+#include <string.h>
+
+/// Kernel includes
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "payrange_heap.h"
+
+/// Account of allocations made before the scheduler runs
+#define HEAP_STARTUP_ACCOUNT            ( 0 )
+/// Account shared by the tasks that found the table full
+#define HEAP_OVERFLOW_ACCOUNT           ( HEAP_MAX_ACCOUNTS - 1 )
+
+/// One live block
+typedef struct
+{
+	void    *address;
+	uint32_t size;
+	uint32_t account;
+}heapBlock_t;
+
+static heapAccount_t heapAccounts[HEAP_MAX_ACCOUNTS] =
+{
+	{ "(startup)", 0, 0, 0, 0, 0, 0 }
+};
+static uint32_t heapAccountCount = 1;
+/// Live blocks hashed by address, with linear probing and backward shift
+/// deletion, so no tombstones pile up
+static heapBlock_t heapBlocks[HEAP_MAX_BLOCKS];
+/// Allocations that did not fit in heapBlocks, and frees of unknown blocks
+static uint32_t heapUntracked = 0;
+
+///-----------------------------------------------------------
+/// \brief Finds the account of the calling task, assigning
+///        one (and tagging the task) on its first allocation
+///
+/// @param N/A
+///
+/// @return uint32_t - account index
+///-----------------------------------------------------------
+static uint32_t heapCurrentAccount(void)
+{
+	TaskHandle_t task;
+	uint32_t account;
+
+	if (xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED)
+	{
+		return HEAP_STARTUP_ACCOUNT;
+	}
+	task = xTaskGetCurrentTaskHandle();
+	account = (uint32_t)(uintptr_t)xTaskGetApplicationTaskTag(task);
+	if (account != 0)
+	{
+		return account;
+	}
+
+	if (heapAccountCount < HEAP_OVERFLOW_ACCOUNT)
+	{
+		account = heapAccountCount++;
+		strncpy(heapAccounts[account].name, pcTaskGetTaskName(task), sizeof(heapAccounts[account].name) - 1);
+	}
+	else
+	{
+		account = HEAP_OVERFLOW_ACCOUNT;
+		strcpy(heapAccounts[account].name, "(other tasks)");
+		heapAccountCount = HEAP_MAX_ACCOUNTS;
+	}
+	vTaskSetApplicationTaskTag(task, (TaskHookFunction_t)(uintptr_t)account);
+	return account;
+}
+
+///-----------------------------------------------------------
+/// \brief Hash slot of a block address
+///
+/// @param1 const void *address - block
+///
+/// @return uint32_t - first slot to probe
+///-----------------------------------------------------------
+static uint32_t heapSlot(const void *address)
+{
+	/// Blocks are 8 byte aligned, the low bits carry nothing
+	return (uint32_t)(((uintptr_t)address >> 3) * 2654435761u) % HEAP_MAX_BLOCKS;
+}
+
+///-----------------------------------------------------------
+/// \brief Charges an allocation to the calling task
+///
+/// @param1 void *address - new block, NULL if the heap is exhausted
+/// @param2 size_t size - bytes taken from the heap
+///
+/// @return N/A
+///-----------------------------------------------------------
+void heapAccountMalloc(void *address, size_t size)
+{
+	const uint32_t account = heapCurrentAccount();
+	heapAccount_t *owner = &heapAccounts[account];
+	uint32_t slot;
+
+	if (address == NULL)
+	{
+		owner->failures++;
+		return;
+	}
+	owner->allocations++;
+	owner->liveBlocks++;
+	owner->liveBytes += (uint32_t)size;
+	if (owner->liveBytes > owner->peakBytes)
+	{
+		owner->peakBytes = owner->liveBytes;
+	}
+
+	slot = heapSlot(address);
+	for (int probe = 0; probe < HEAP_MAX_BLOCKS; probe++)
+	{
+		if (heapBlocks[slot].address == NULL)
+		{
+			heapBlocks[slot].address = address;
+			heapBlocks[slot].size = (uint32_t)size;
+			heapBlocks[slot].account = account;
+			return;
+		}
+		slot = (slot + 1) % HEAP_MAX_BLOCKS;
+	}
+	heapUntracked++;
+}
+
+///-----------------------------------------------------------
+/// \brief Credits a free back to the task that allocated it
+///
+/// @param1 void *address - block being freed
+/// @param2 size_t size - bytes returned to the heap
+///
+/// @return N/A
+///-----------------------------------------------------------
+void heapAccountFree(void *address, size_t size)
+{
+	uint32_t slot = heapSlot(address);
+
+	(void)size;
+	for (int probe = 0; probe < HEAP_MAX_BLOCKS; probe++)
+	{
+		heapBlock_t *block = &heapBlocks[slot];
+		if (block->address == NULL)
+		{
+			break;
+		}
+		if (block->address == address)
+		{
+			heapAccount_t *owner = &heapAccounts[block->account];
+			uint32_t hole = slot;
+			owner->frees++;
+			owner->liveBlocks--;
+			owner->liveBytes -= block->size;
+
+			/// Pull later entries of the probe chain back over the hole
+			for (uint32_t next = (slot + 1) % HEAP_MAX_BLOCKS; heapBlocks[next].address != NULL;
+				next = (next + 1) % HEAP_MAX_BLOCKS)
+			{
+				const uint32_t home = heapSlot(heapBlocks[next].address);
+				/// Movable unless its home slot lies cyclically in (hole, next]
+				if (((next > hole) && ((home <= hole) || (home > next))) ||
+					((next < hole) && ((home <= hole) && (home > next))))
+				{
+					heapBlocks[hole] = heapBlocks[next];
+					hole = next;
+				}
+			}
+			heapBlocks[hole].address = NULL;
+			return;
+		}
+		slot = (slot + 1) % HEAP_MAX_BLOCKS;
+	}
+	heapUntracked++;
+}
+
+///-----------------------------------------------------------
+/// \brief Copies the accounts
+///
+/// @param1 heapAccount_t *accounts - output
+/// @param2 int maxAccounts - room in accounts
+///
+/// @return int - accounts copied
+///-----------------------------------------------------------
+int heapGetAccounts(heapAccount_t *accounts, int maxAccounts)
+{
+	int count;
+
+	/// The hooks run with the scheduler suspended, so does the copy
+	vTaskSuspendAll();
+	count = ((int)heapAccountCount < maxAccounts) ? (int)heapAccountCount : maxAccounts;
+	memcpy(accounts, heapAccounts, (size_t)count * sizeof(heapAccount_t));
+	(void)xTaskResumeAll();
+	return count;
+}
+
+///-----------------------------------------------------------
+/// \brief Prints every account and the heap totals
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+void heapPrintAccounts(void)
+{
+	heapAccount_t accounts[HEAP_MAX_ACCOUNTS];
+	const int count = heapGetAccounts(accounts, HEAP_MAX_ACCOUNTS);
+
+	printf("Heap: %u bytes free, %u at the lowest, %u untracked blocks\n",
+		(unsigned int)xPortGetFreeHeapSize(), (unsigned int)xPortGetMinimumEverFreeHeapSize(),
+		(unsigned int)heapUntracked);
+	printf("  %-16s %8s %8s %7s %8s %8s %6s\n", "task", "live", "peak", "blocks", "allocs", "frees", "failed");
+	for (int i = 0; i < count; i++)
+	{
+		printf("  %-16s %8u %8u %7u %8u %8u %6u\n", accounts[i].name, (unsigned int)accounts[i].liveBytes,
+			(unsigned int)accounts[i].peakBytes, (unsigned int)accounts[i].liveBlocks,
+			(unsigned int)accounts[i].allocations, (unsigned int)accounts[i].frees,
+			(unsigned int)accounts[i].failures);
+	}
+}
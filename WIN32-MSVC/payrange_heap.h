@@ -0,0 +1,46 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_heap.h
+///-----------------------------------------------------------------------------
+///
+/// \brief Per-task heap accounting: every pvPortMalloc()/vPortFree() is
+///        charged to the task that made the allocation, found through its
+///        application task tag
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_HEAP_H
+#define PAYRANGE_HEAP_H
+
+/// Standard includes
+#include <stddef.h>
+#include <stdint.h>
+
+/// Heap accounting configurable defines
+/// Accounts: one for allocations made before the scheduler starts, one per
+/// task, the last one is shared by tasks that found the table full
+#define HEAP_MAX_ACCOUNTS               ( 24 )
+/// Live blocks tracked; 24 KB of heap in blocks of 16 bytes or more
+#define HEAP_MAX_BLOCKS                 ( 1024 )
+
+/// Counters of one account
+typedef struct
+{
+	char     name[16];
+	uint32_t liveBytes;
+	uint32_t peakBytes;
+	uint32_t liveBlocks;
+	uint32_t allocations;
+	uint32_t frees;
+	uint32_t failures;
+}heapAccount_t;
+
+/// traceMALLOC hook (FreeRTOSConfig.h), called with the scheduler suspended
+void heapAccountMalloc(void *address, size_t size);
+/// traceFREE hook (FreeRTOSConfig.h), called with the scheduler suspended
+void heapAccountFree(void *address, size_t size);
+/// Copies up to maxAccounts accounts; returns the number copied
+int heapGetAccounts(heapAccount_t *accounts, int maxAccounts);
+/// Prints every account and the heap totals to stdout
+void heapPrintAccounts(void);
+
+#endif /// PAYRANGE_HEAP_H
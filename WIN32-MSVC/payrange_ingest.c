@@ -0,0 +1,410 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_ingest.c
+///-----------------------------------------------------------------------------
+///
+/// \brief C capture ingestion gateway
+///
+/// A single reactor task owns a non-blocking listening socket on the
+/// loopback interface and up to INGEST_MAX_CLIENTS terminal connections. Each
+/// pass polls all sockets with one select() call, pulls whatever has arrived
+/// with one large recv() per ready client and turns every complete 8 byte
+/// request into a captureRequest_t. All requests read in one pass get the same
+/// A snapshot and tick - they arrived at the same time as far as the
+/// simulation can tell - so A is read once per pass, not once per request.
+///
+/// Every request passes the terminal's token bucket (payrange_admit.h) before
+/// it is queued. A deferred request stays at the head of its client buffer
+/// and is asked about again on later passes; it is stamped in the pass that
+/// admits it. A shed request is dropped and counted.
+///
+/// When the capture queue is full the reactor stops draining that client and
+/// yields to the E writer; unread requests stay in the socket
+/// buffers and TCP flow control slows the terminals down.
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+
+/// Winsock must come before windows.h, which FreeRTOS.h pulls in
+#include <winsock2.h>
+
+/// Standard includes
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+/// Kernel includes
+#include <FreeRTOS.h>
+#include <task.h>
+#include <queue.h>
+
+#include "payrange_ingest.h"
+#include "payrange_admit.h"
+#include "payrange_ahistory.h"
+#include "payrange_time.h"
+#include "payrange_critical.h"
+
+/// Outcome of draining one client
+#define INGEST_DRAINED                  ( 0 )
+#define INGEST_STALLED                  ( 1 )
+#define INGEST_DEFERRED                 ( 2 )
+
+/// One terminal connection and its partially consumed receive buffer
+typedef struct
+{
+	SOCKET     socket;
+	/// Peer has hung up, close once its buffered requests are queued
+	int        closing;
+	/// The request at the head of the buffer waits for a token since deferredSince
+	int        deferred;
+	TickType_t deferredSince;
+	uint32_t   buffered;
+	uint8_t    buffer[INGEST_READ_SIZE];
+}ingestClient_t;
+
+/// Reactor configuration, set by ingestCreateTask()
+static QueueHandle_t ingestQueue;
+/// Sockets, owned by the reactor task
+static SOCKET ingestListener = INVALID_SOCKET;
+static ingestClient_t ingestClients[INGEST_MAX_CLIENTS];
+/// Counters, written by the reactor task only
+static ingestStats_t ingestStats;
+
+///-----------------------------------------------------------
+/// \brief Opens the non-blocking listening socket
+///
+/// @param N/A
+///
+/// @return int - 1 on success
+///-----------------------------------------------------------
+static int ingestListen(void)
+{
+	WSADATA wsaData;
+	struct sockaddr_in address;
+	u_long nonBlocking = 1;
+
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+	{
+		return 0;
+	}
+	ingestListener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (ingestListener == INVALID_SOCKET)
+	{
+		return 0;
+	}
+
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(INGEST_PORT);
+	if ((bind(ingestListener, (struct sockaddr *)&address, sizeof(address)) != 0) ||
+		(listen(ingestListener, SOMAXCONN) != 0) ||
+		(ioctlsocket(ingestListener, FIONBIO, &nonBlocking) != 0))
+	{
+		closesocket(ingestListener);
+		ingestListener = INVALID_SOCKET;
+		return 0;
+	}
+	return 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Accepts every pending connection
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void ingestAccept(void)
+{
+	for (;;)
+	{
+		u_long nonBlocking = 1;
+		int slot;
+		SOCKET client = accept(ingestListener, NULL, NULL);
+		if (client == INVALID_SOCKET)
+		{
+			return;
+		}
+		for (slot = 0; slot < INGEST_MAX_CLIENTS; slot++)
+		{
+			if (ingestClients[slot].socket == INVALID_SOCKET)
+			{
+				break;
+			}
+		}
+		if ((slot == INGEST_MAX_CLIENTS) || (ioctlsocket(client, FIONBIO, &nonBlocking) != 0))
+		{
+			closesocket(client);
+			continue;
+		}
+		ingestClients[slot].socket = client;
+		ingestClients[slot].closing = 0;
+		ingestClients[slot].deferred = 0;
+		ingestClients[slot].buffered = 0;
+		ingestStats.connections++;
+		ingestStats.activeClients++;
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Closes a client connection
+///
+/// @param1 ingestClient_t *client - client to close
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void ingestClose(ingestClient_t *client)
+{
+	closesocket(client->socket);
+	client->socket = INVALID_SOCKET;
+	ingestStats.activeClients--;
+}
+
+///-----------------------------------------------------------
+/// \brief Queues the complete requests buffered for a client
+///        that admission control lets through
+///
+/// @param1 ingestClient_t *client - client to drain
+/// @param2 const valueD_t *stamp - A and tick of this pass
+///
+/// @return int - INGEST_DRAINED, INGEST_STALLED if the capture
+///               queue filled up, INGEST_DEFERRED if the client
+///               is over its rate
+///-----------------------------------------------------------
+static int ingestDrain(ingestClient_t *client, const valueD_t *stamp)
+{
+	captureRequest_t capture;
+	ingestRequest_t request;
+	uint32_t consumed = 0;
+	uint32_t queued = 0;
+	int result = INGEST_DRAINED;
+
+	capture.valueD = *stamp;
+	while (client->buffered - consumed >= sizeof(request))
+	{
+		admitOutcome_t outcome;
+		memcpy(&request, client->buffer + consumed, sizeof(request));
+		/// A terminal may not pose as the console or a gateway client
+		if ((request.terminalId == CAPTURE_SOURCE_CONSOLE) || (request.terminalId & CAPTURE_SOURCE_GATEWAY))
+		{
+			ingestStats.rejected++;
+			consumed += sizeof(request);
+			continue;
+		}
+		/// Ask for a token only when the capture can be queued right away
+		if (uxQueueSpacesAvailable(ingestQueue) == 0)
+		{
+			ingestStats.stalls++;
+			result = INGEST_STALLED;
+			break;
+		}
+		outcome = admitRequest(request.terminalId, client->deferred ? &client->deferredSince : NULL);
+		if (outcome == ADMIT_DEFER)
+		{
+			if (!client->deferred)
+			{
+				client->deferred = 1;
+				client->deferredSince = stamp->randomNumberTime;
+			}
+			result = INGEST_DEFERRED;
+			break;
+		}
+		client->deferred = 0;
+		if (outcome == ADMIT_ADMIT)
+		{
+			capture.source = request.terminalId;
+			capture.sequence = request.sequence;
+			if (xQueueSend(ingestQueue, &capture, 0) != pdPASS)
+			{
+				/// The console took the last slot; the token is lost, the request is not
+				ingestStats.stalls++;
+				result = INGEST_STALLED;
+				break;
+			}
+			queued++;
+		}
+		else
+		{
+			ingestStats.shed++;
+		}
+		consumed += sizeof(request);
+	}
+	if (consumed > 0)
+	{
+		ingestStats.requests += queued;
+		ingestStats.batches += (queued > 0);
+		/// Keep the partial request (or the unqueued ones) at the buffer start
+		client->buffered -= consumed;
+		memmove(client->buffer, client->buffer + consumed, client->buffered);
+	}
+	return result;
+}
+
+///-----------------------------------------------------------
+/// \brief Reactor task: polls the sockets, reads in batches
+///        and forwards the requests
+///
+/// @param 1 void *pvParameters - placeholder for FreeRTOS
+///                               Task parameters
+///
+/// @return None - Task always runs without a return
+///-----------------------------------------------------------
+static void ingestTask(void *pvParameters)
+{
+	const TickType_t xIdleDelay = INGEST_IDLE_DELAY_MS / portTICK_PERIOD_MS;
+
+	/// Just to remove compiler warnings
+	(void)pvParameters;
+
+	for (int i = 0; i < INGEST_MAX_CLIENTS; i++)
+	{
+		ingestClients[i].socket = INVALID_SOCKET;
+	}
+	if (!ingestListen())
+	{
+		printf("Ingest: cannot listen on 127.0.0.1:%d, remote captures disabled\n", INGEST_PORT);
+		vTaskDelete(NULL);
+		return;
+	}
+
+	for (;;)
+	{
+		struct timeval noWait = { 0, 0 };
+		fd_set readable;
+		valueD_t stamp;
+		SOCKET highest = ingestListener;
+		int backlogged = 0;
+		int deferred = 0;
+		int ready;
+
+		FD_ZERO(&readable);
+		FD_SET(ingestListener, &readable);
+		for (int i = 0; i < INGEST_MAX_CLIENTS; i++)
+		{
+			/// A client with a full buffer waits until the E pipeline took its requests
+			if ((ingestClients[i].socket != INVALID_SOCKET) && !ingestClients[i].closing &&
+				(ingestClients[i].buffered < INGEST_READ_SIZE))
+			{
+				FD_SET(ingestClients[i].socket, &readable);
+				highest = (ingestClients[i].socket > highest) ? ingestClients[i].socket : highest;
+			}
+		}
+		/// Winsock ignores the first argument, BSD sockets need it
+		ready = select((int)highest + 1, &readable, NULL, NULL, &noWait);
+		if (ready > 0)
+		{
+			if (FD_ISSET(ingestListener, &readable))
+			{
+				ingestAccept();
+			}
+			for (int i = 0; i < INGEST_MAX_CLIENTS; i++)
+			{
+				ingestClient_t *client = &ingestClients[i];
+				int received;
+				if ((client->socket == INVALID_SOCKET) || client->closing || !FD_ISSET(client->socket, &readable))
+				{
+					continue;
+				}
+				received = recv(client->socket, (char *)client->buffer + client->buffered,
+					(int)(INGEST_READ_SIZE - client->buffered), 0);
+				if (received > 0)
+				{
+					client->buffered += (uint32_t)received;
+					ingestStats.bytes += (uint64_t)received;
+				}
+				else if ((received == 0) || (WSAGetLastError() != WSAEWOULDBLOCK))
+				{
+					client->closing = 1;
+				}
+			}
+		}
+
+		/// One stamp for everything that arrived in this pass, A as of this tick
+		stamp.randomNumberTime = xTaskGetTickCount();
+		stamp.randomNumberTimeUtcNs = timeTickToUtcNs(stamp.randomNumberTime);
+		if (!aHistoryLookup(stamp.randomNumberTime, &stamp.randomNumber, NULL))
+		{
+			stamp.randomNumber = 0;
+		}
+		for (int i = 0; i < INGEST_MAX_CLIENTS; i++)
+		{
+			ingestClient_t *client = &ingestClients[i];
+			if (client->socket == INVALID_SOCKET)
+			{
+				continue;
+			}
+			switch (ingestDrain(client, &stamp))
+			{
+				case INGEST_STALLED:
+					backlogged = 1;
+					break;
+				case INGEST_DEFERRED:
+					deferred = 1;
+					break;
+				default:
+					if (client->closing)
+					{
+						ingestClose(client);
+					}
+					break;
+			}
+		}
+
+		if (backlogged)
+		{
+			/// Let the E writer (same priority) empty the queue
+			taskYIELD();
+		}
+		else if ((ready <= 0) || deferred)
+		{
+			/// Nothing to read, or a client waits for tokens, which come in per tick
+			vTaskDelay(xIdleDelay);
+		}
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Creates the gateway task
+///
+/// @param1 QueueHandle_t captureQueue - E pipeline input
+/// @param2 UBaseType_t priority - task priority
+///
+/// @return N/A
+///-----------------------------------------------------------
+void ingestCreateTask(QueueHandle_t captureQueue, UBaseType_t priority)
+{
+	ingestQueue = captureQueue;
+	xTaskCreate(ingestTask, "Ingest", configMINIMAL_STACK_SIZE, NULL, priority, NULL);
+}
+
+///-----------------------------------------------------------
+/// \brief Copies the gateway counters
+///
+/// @param1 ingestStats_t *stats - output
+///
+/// @return N/A
+///-----------------------------------------------------------
+void ingestGetStats(ingestStats_t *stats)
+{
+	PAYRANGE_ENTER_CRITICAL();
+	*stats = ingestStats;
+	PAYRANGE_EXIT_CRITICAL();
+}
+
+///-----------------------------------------------------------
+/// \brief Prints the gateway counters
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+void ingestPrintStats(void)
+{
+	ingestStats_t stats;
+
+	ingestGetStats(&stats);
+	printf("Ingest 127.0.0.1:%d: %u clients (%u connections), %" PRIu64 " requests in %" PRIu64
+		" batches, %" PRIu64 " shed, %" PRIu64 " rejected, %" PRIu64 " bytes, %" PRIu64 " stalls\n", INGEST_PORT,
+		(unsigned int)stats.activeClients, (unsigned int)stats.connections, stats.requests, stats.batches,
+		stats.shed, stats.rejected, stats.bytes, stats.stalls);
+}
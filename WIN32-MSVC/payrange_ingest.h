@@ -0,0 +1,60 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_ingest.h
+///-----------------------------------------------------------------------------
+///
+/// \brief C capture ingestion gateway: remote terminals send capture
+///        requests over a loopback socket, the gateway stamps them with the
+///        current A and tick and feeds them to the E pipeline
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_INGEST_H
+#define PAYRANGE_INGEST_H
+
+#include "payrange.h"
+
+/// Kernel includes
+#include <queue.h>
+
+/// Ingestion configurable defines
+#define INGEST_PORT                     ( 7377 )
+#define INGEST_MAX_CLIENTS              ( 16 )
+/// Receive buffer per client; one recv() can bring in this many bytes of requests
+#define INGEST_READ_SIZE                ( 16 * 1024 )
+/// Reactor sleep when no socket is ready
+#define INGEST_IDLE_DELAY_MS            ( 1 )
+
+/// Wire format of one capture request (little-endian, 8 bytes, no reply)
+typedef struct
+{
+	/// 1 to 0x7FFFFFFF, the other ids are reserved (payrange.h)
+	uint32_t terminalId;
+	uint32_t sequence;
+}ingestRequest_t;
+
+/// Gateway counters
+typedef struct
+{
+	uint32_t connections;
+	uint32_t activeClients;
+	/// Requests queued to the E pipeline
+	uint64_t requests;
+	uint64_t batches;
+	/// Requests dropped by admission control
+	uint64_t shed;
+	/// Requests dropped for a terminal id of the console or the request gateway
+	uint64_t rejected;
+	uint64_t bytes;
+	/// Times the capture queue was full and reading paused (back-pressure)
+	uint64_t stalls;
+}ingestStats_t;
+
+/// Creates the gateway task. Requests go to captureQueue as captureRequest_t,
+/// stamped with the tick at which they were read and the A current then.
+void ingestCreateTask(QueueHandle_t captureQueue, UBaseType_t priority);
+/// Copies the gateway counters
+void ingestGetStats(ingestStats_t *stats);
+/// Prints the gateway counters to stdout
+void ingestPrintStats(void);
+
+#endif /// PAYRANGE_INGEST_H
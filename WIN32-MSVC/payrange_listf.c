@@ -0,0 +1,659 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_listf.c
+///-----------------------------------------------------------------------------
+///
+/// \brief List F index with epoch-based reclamation and incremental resize
+///
+/// Every F value is an entry in a chained hash table keyed by its A code.
+/// An entry is never changed while a lookup can reach it, apart from its
+/// next link: the writer stores a value by linking a new entry at the head
+/// of its bucket and unlinking the entry it replaces. Unlinked entries are
+/// retired with the current epoch and reused once no reader announced that
+/// epoch or an earlier one, so a lookup walks the chains without a lock and
+/// the writer never waits for it.
+///
+/// A resize switches new entries to the second bucket table and then moves
+/// the old table over LISTF_MIGRATE_ENTRIES entries at a time, on every
+/// store and on the E writer's idle polls. An entry being moved is linked
+/// into the new table before it is unlinked from the old one, and lookups
+/// search the old table first, so they find it either way; a slot seen
+/// twice is reported once. A shrink hides the slots past the new capacity
+/// at once and drops their entries as their buckets are migrated.
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+
+/// Standard includes
+#include <stdio.h>
+#include <string.h>
+
+/// Kernel includes
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "payrange_atomic.h"
+#include "payrange_listf.h"
+#include "payrange_mvcc.h"
+#include "payrange_cdc.h"
+
+/// Reader not holding an epoch
+#define LISTF_IDLE                      ( 0 )
+/// Entries: every slot, the retired ones and the one being stored
+#define LISTF_POOL_SIZE                 ( MAX_SIZE_OF_VALUE_E_STRUCTURE + LISTF_MAX_RETIRED + 1 )
+
+/// One F value in the index
+typedef struct listFEntry_s
+{
+	struct listFEntry_s *volatile next;
+	valueE_t                      value;
+	uint32_t                      slot;
+	/// Bucket table the entry is linked into
+	uint32_t                      table;
+}listFEntry_t;
+
+/// Which bucket table takes new entries, and the one being drained
+typedef struct
+{
+	seqlock_t lock;
+	uint32_t  current;
+	uint32_t  currentMask;
+	uint32_t  oldMask;
+	uint32_t  migrating;
+}listFLayout_t;
+
+/// Entry waiting until no reader can hold it
+typedef struct
+{
+	listFEntry_t *entry;
+	uint32_t      epoch;
+}listFRetired_t;
+
+/// Shared with the readers
+static listFEntry_t *volatile listFBuckets[2][LISTF_MAX_BUCKETS];
+static listFLayout_t listFLayout;
+static volatile uint32_t listFCapacityNow = 0;
+static volatile uint32_t listFCurrentEpoch = 1;
+static volatile uint32_t listFReaderEpochs[LISTF_MAX_READERS];
+static volatile LONG listFReaderTaken[LISTF_MAX_READERS];
+/// Resize asked for by listFRequestResize(), 0 when none
+static volatile uint32_t listFRequested = 0;
+
+/// Writer only
+static listFEntry_t listFPool[LISTF_POOL_SIZE];
+static listFEntry_t *listFFree = NULL;
+static listFEntry_t *listFSlots[MAX_SIZE_OF_VALUE_E_STRUCTURE];
+static listFRetired_t listFRetired[LISTF_MAX_RETIRED];
+static uint32_t listFRetiredHead = 0;
+static uint32_t listFRetiredCount = 0;
+/// Next old bucket to migrate
+static uint32_t listFMigrateCursor = 0;
+static uint32_t listFEntryCount = 0;
+static uint32_t listFResizes = 0;
+static uint32_t listFStalls = 0;
+/// State file copy of the slots and the capacity
+static valueE_t *listFPersistent = NULL;
+static uint32_t *listFPersistentCapacity = NULL;
+
+///-----------------------------------------------------------
+/// \brief Bucket of an A code
+///
+/// @param1 int64_t a - A code
+/// @param2 uint32_t mask - bucket count - 1
+///
+/// @return uint32_t - bucket
+///-----------------------------------------------------------
+static uint32_t listFHash(int64_t a, uint32_t mask)
+{
+	return (uint32_t)(((uint64_t)a * 0x9E3779B97F4A7C15ULL) >> 40) & mask;
+}
+
+///-----------------------------------------------------------
+/// \brief Bucket count for a capacity
+///
+/// @param1 uint32_t capacity - slots
+///
+/// @return uint32_t - power of two, at least twice capacity
+///-----------------------------------------------------------
+static uint32_t listFBucketsFor(uint32_t capacity)
+{
+	uint32_t buckets = LISTF_MIN_BUCKETS;
+
+	while (buckets < 2 * capacity)
+	{
+		buckets <<= 1;
+	}
+	return buckets;
+}
+
+///-----------------------------------------------------------
+/// \brief Frees the retired entries no reader can hold: those
+///        retired before the epoch of every active reader
+///
+/// @param N/A
+///
+/// @return uint32_t - entries freed
+///-----------------------------------------------------------
+static uint32_t listFReclaim(void)
+{
+	uint32_t freed = 0;
+
+	while (listFRetiredCount > 0)
+	{
+		const uint32_t tail = (listFRetiredHead + LISTF_MAX_RETIRED - listFRetiredCount) % LISTF_MAX_RETIRED;
+		listFRetired_t *retired = &listFRetired[tail];
+
+		for (int reader = 0; reader < LISTF_MAX_READERS; reader++)
+		{
+			const uint32_t epoch = listFReaderEpochs[reader];
+			/// Wrap safe epoch <= retired->epoch
+			if ((epoch != LISTF_IDLE) && ((int32_t)(epoch - retired->epoch) <= 0))
+			{
+				return freed;
+			}
+		}
+		retired->entry->next = listFFree;
+		listFFree = retired->entry;
+		listFRetiredCount--;
+		freed++;
+	}
+	return freed;
+}
+
+///-----------------------------------------------------------
+/// \brief Reclaims until something was freed; waits a tick at
+///        a time while a reader holds every retired entry
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void listFReclaimOrWait(void)
+{
+	while (listFReclaim() == 0)
+	{
+		listFStalls++;
+		configASSERT(xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED);
+		vTaskDelay(1);
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Takes a free entry
+///
+/// @param N/A
+///
+/// @return listFEntry_t * - entry
+///-----------------------------------------------------------
+static listFEntry_t *listFAllocate(void)
+{
+	listFEntry_t *entry;
+
+	if (listFFree == NULL)
+	{
+		listFReclaimOrWait();
+	}
+	entry = listFFree;
+	listFFree = entry->next;
+	return entry;
+}
+
+///-----------------------------------------------------------
+/// \brief Queues an unlinked entry for reuse
+///
+/// @param1 listFEntry_t *entry - entry no longer in any table
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void listFRetire(listFEntry_t *entry)
+{
+	if (listFRetiredCount == LISTF_MAX_RETIRED)
+	{
+		listFReclaimOrWait();
+	}
+	listFRetired[listFRetiredHead].entry = entry;
+	listFRetired[listFRetiredHead].epoch = listFCurrentEpoch;
+	listFRetiredHead = (listFRetiredHead + 1) % LISTF_MAX_RETIRED;
+	listFRetiredCount++;
+}
+
+///-----------------------------------------------------------
+/// \brief Ends a writer operation: entries retired so far are
+///        out of reach for readers that announce from now on
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void listFAdvanceEpoch(void)
+{
+	uint32_t epoch = listFCurrentEpoch + 1;
+
+	if (epoch == LISTF_IDLE)
+	{
+		epoch++;
+	}
+	/// The unlinks must be visible before the new epoch
+	PAYRANGE_MEMORY_BARRIER();
+	listFCurrentEpoch = epoch;
+}
+
+///-----------------------------------------------------------
+/// \brief Links an entry at the head of its bucket
+///
+/// @param1 listFEntry_t *entry - filled in entry
+/// @param2 uint32_t table - bucket table
+/// @param3 uint32_t mask - bucket count of the table - 1
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void listFLink(listFEntry_t *entry, uint32_t table, uint32_t mask)
+{
+	listFEntry_t *volatile *bucket = &listFBuckets[table][listFHash(entry->value.currentValueD.randomNumber, mask)];
+
+	entry->table = table;
+	entry->next = *bucket;
+	/// The entry must be complete before it can be reached
+	PAYRANGE_COMPILER_BARRIER();
+	*bucket = entry;
+}
+
+///-----------------------------------------------------------
+/// \brief Unlinks an entry from its bucket; readers walking
+///        past it still reach the rest of the chain
+///
+/// @param1 listFEntry_t *entry - linked entry
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void listFUnlink(listFEntry_t *entry)
+{
+	const uint32_t mask = (entry->table == listFLayout.current) ? listFLayout.currentMask : listFLayout.oldMask;
+	listFEntry_t *volatile *link = &listFBuckets[entry->table][listFHash(entry->value.currentValueD.randomNumber, mask)];
+
+	while (*link != entry)
+	{
+		configASSERT(*link != NULL);
+		link = &(*link)->next;
+	}
+	*link = entry->next;
+}
+
+///-----------------------------------------------------------
+/// \brief Moves up to LISTF_MIGRATE_ENTRIES old entries (or
+///        empty old buckets) to the new table
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void listFMigrateStep(void)
+{
+	const uint32_t old = 1 - listFLayout.current;
+	const uint32_t oldBuckets = listFLayout.oldMask + 1;
+	int budget = LISTF_MIGRATE_ENTRIES;
+
+	if (!listFLayout.migrating)
+	{
+		return;
+	}
+	while ((budget-- > 0) && (listFMigrateCursor < oldBuckets))
+	{
+		listFEntry_t *entry = listFBuckets[old][listFMigrateCursor];
+
+		if (entry == NULL)
+		{
+			listFMigrateCursor++;
+			continue;
+		}
+		if (entry->slot < listFCapacityNow)
+		{
+			listFEntry_t *copy = listFAllocate();
+			copy->value = entry->value;
+			copy->slot = entry->slot;
+			listFLink(copy, listFLayout.current, listFLayout.currentMask);
+			listFSlots[entry->slot] = copy;
+		}
+		else
+		{
+			/// Past the end of a shrunk List F
+			listFSlots[entry->slot] = NULL;
+			listFEntryCount--;
+		}
+		/// Only after the copy is reachable in the new table
+		listFBuckets[old][listFMigrateCursor] = entry->next;
+		listFRetire(entry);
+	}
+	listFAdvanceEpoch();
+
+	if (listFMigrateCursor == oldBuckets)
+	{
+		seqlockWriteBegin(&listFLayout.lock);
+		listFLayout.migrating = 0;
+		seqlockWriteEnd(&listFLayout.lock);
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Starts a resize
+///
+/// @param1 uint32_t capacity - new number of slots
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void listFStartResize(uint32_t capacity)
+{
+	const uint32_t mask = listFBucketsFor(capacity) - 1;
+	const uint32_t shrinking = (capacity < listFCapacityNow);
+
+	listFResizes++;
+	/// The slots past the end are empty from here on for time travel and
+	/// the change stream too, and in the state file, so a later grow and a
+	/// restart (or --lookup) do not bring their old values back
+	for (uint32_t slot = capacity; slot < listFCapacityNow; slot++)
+	{
+		if (listFSlots[slot] != NULL)
+		{
+			mvccRecordF(slot, NULL);
+			cdcEmitF(slot, &listFSlots[slot]->value, NULL);
+		}
+		memset(&listFPersistent[slot], 0, sizeof(valueE_t));
+	}
+	mvccRecordSlots(MVCC_LIST_F, capacity);
+	/// Lookups skip the slots past the end from here on
+	listFCapacityNow = capacity;
+	*listFPersistentCapacity = capacity;
+	if ((mask == listFLayout.currentMask) && !shrinking)
+	{
+		/// Same buckets and nothing to drop, the new slots are just empty
+		return;
+	}
+
+	/// The other table was emptied by the previous migration
+	seqlockWriteBegin(&listFLayout.lock);
+	listFLayout.oldMask = listFLayout.currentMask;
+	listFLayout.current = 1 - listFLayout.current;
+	listFLayout.currentMask = mask;
+	listFLayout.migrating = 1;
+	seqlockWriteEnd(&listFLayout.lock);
+	listFMigrateCursor = 0;
+}
+
+///-----------------------------------------------------------
+/// \brief Builds the index from the persistent slots
+///
+/// @param1 valueE_t *persistent - slots in the state file
+/// @param2 uint32_t *capacity - capacity in the state file
+///
+/// @return N/A
+///-----------------------------------------------------------
+void listFInit(valueE_t *persistent, uint32_t *capacity)
+{
+	if ((*capacity == 0) || (*capacity > MAX_SIZE_OF_VALUE_E_STRUCTURE))
+	{
+		*capacity = SIZE_OF_VALUE_E_STRUCTURE;
+	}
+	listFPersistent = persistent;
+	listFPersistentCapacity = capacity;
+	listFCapacityNow = *capacity;
+
+	for (int i = LISTF_POOL_SIZE - 1; i >= 0; i--)
+	{
+		listFPool[i].next = listFFree;
+		listFFree = &listFPool[i];
+	}
+	listFLayout.current = 0;
+	listFLayout.currentMask = listFBucketsFor(*capacity) - 1;
+
+	for (uint32_t slot = 0; slot < *capacity; slot++)
+	{
+		/// Every stored value has a B, empty slots have no B time
+		if (persistent[slot].randomValueB.stringTime != 0)
+		{
+			listFEntry_t *entry = listFAllocate();
+			entry->value = persistent[slot];
+			entry->slot = slot;
+			listFLink(entry, listFLayout.current, listFLayout.currentMask);
+			listFSlots[slot] = entry;
+			listFEntryCount++;
+		}
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Claims a reader slot
+///
+/// @param N/A
+///
+/// @return int - reader id, -1 when all slots are taken
+///-----------------------------------------------------------
+int listFReaderRegister(void)
+{
+	for (int reader = 0; reader < LISTF_MAX_READERS; reader++)
+	{
+		if (InterlockedCompareExchange(&listFReaderTaken[reader], 1, 0) == 0)
+		{
+			return reader;
+		}
+	}
+	return -1;
+}
+
+///-----------------------------------------------------------
+/// \brief Collects the matching entries of one chain
+///
+/// @param1 const listFEntry_t *entry - head of the chain
+/// @param2 int64_t a - A code
+/// @param3 uint32_t capacity - slots visible to the lookup
+/// @param4 valueE_t *results - output
+/// @param5 uint32_t *slots - slots of the results so far
+/// @param6 int found - results so far
+/// @param7 int maxResults - room in results
+///
+/// @return int - results now
+///-----------------------------------------------------------
+static int listFSearch(const listFEntry_t *entry, int64_t a, uint32_t capacity, valueE_t *results,
+	uint32_t *slots, int found, int maxResults)
+{
+	for (; entry != NULL; entry = entry->next)
+	{
+		int seen = 0;
+
+		if ((entry->value.currentValueD.randomNumber != a) || (entry->slot >= capacity))
+		{
+			continue;
+		}
+		/// Met in both tables while it is being migrated
+		for (int i = 0; i < found; i++)
+		{
+			seen |= (slots[i] == entry->slot);
+		}
+		if (!seen && (found < maxResults))
+		{
+			results[found] = entry->value;
+			slots[found] = entry->slot;
+			found++;
+		}
+	}
+	return found;
+}
+
+///-----------------------------------------------------------
+/// \brief Finds the F values holding an A code
+///
+/// @param1 int reader - id from listFReaderRegister()
+/// @param2 int64_t a - A code
+/// @param3 valueE_t *results - output
+/// @param4 int maxResults - room in results
+///
+/// @return int - values found
+///-----------------------------------------------------------
+int listFLookup(int reader, int64_t a, valueE_t *results, int maxResults)
+{
+	uint32_t slots[MAX_SIZE_OF_VALUE_E_STRUCTURE];
+	uint32_t sequence;
+	int found;
+
+	configASSERT((reader >= 0) && (reader < LISTF_MAX_READERS));
+	if (maxResults > MAX_SIZE_OF_VALUE_E_STRUCTURE)
+	{
+		maxResults = MAX_SIZE_OF_VALUE_E_STRUCTURE;
+	}
+	/// Entries reachable from here on stay allocated until the end
+	listFReaderEpochs[reader] = listFCurrentEpoch;
+	PAYRANGE_MEMORY_BARRIER();
+
+	do
+	{
+		const uint32_t capacity = listFCapacityNow;
+		uint32_t current, currentMask, oldMask, migrating;
+
+		sequence = seqlockReadBegin(&listFLayout.lock);
+		current = listFLayout.current;
+		currentMask = listFLayout.currentMask;
+		oldMask = listFLayout.oldMask;
+		migrating = listFLayout.migrating;
+
+		found = 0;
+		if (migrating)
+		{
+			found = listFSearch(listFBuckets[1 - current][listFHash(a, oldMask)], a, capacity,
+				results, slots, found, maxResults);
+		}
+		found = listFSearch(listFBuckets[current][listFHash(a, currentMask)], a, capacity,
+			results, slots, found, maxResults);
+	} while (seqlockReadRetry(&listFLayout.lock, sequence));
+
+	PAYRANGE_COMPILER_BARRIER();
+	listFReaderEpochs[reader] = LISTF_IDLE;
+	return found;
+}
+
+///-----------------------------------------------------------
+/// \brief Returns the number of slots
+///
+/// @param N/A
+///
+/// @return uint32_t - capacity
+///-----------------------------------------------------------
+uint32_t listFCapacity(void)
+{
+	return listFCapacityNow;
+}
+
+///-----------------------------------------------------------
+/// \brief Stores a value E in a slot
+///
+/// @param1 uint32_t slot - slot below listFCapacity()
+/// @param2 const valueE_t *value - value E
+///
+/// @return N/A
+///-----------------------------------------------------------
+void listFStore(uint32_t slot, const valueE_t *value)
+{
+	listFEntry_t *entry;
+	listFEntry_t *replaced;
+
+	configASSERT(slot < listFCapacityNow);
+	entry = listFAllocate();
+	entry->value = *value;
+	entry->slot = slot;
+	listFLink(entry, listFLayout.current, listFLayout.currentMask);
+
+	replaced = listFSlots[slot];
+	listFSlots[slot] = entry;
+	if (replaced != NULL)
+	{
+		listFUnlink(replaced);
+		listFRetire(replaced);
+	}
+	else
+	{
+		listFEntryCount++;
+	}
+	listFAdvanceEpoch();
+	listFPersistent[slot] = *value;
+	mvccRecordF(slot, value);
+	/// The replaced entry is only reclaimed by this writer, later
+	cdcEmitF(slot, (replaced != NULL) ? &replaced->value : NULL, value);
+
+	listFMigrateStep();
+}
+
+///-----------------------------------------------------------
+/// \brief Asks the writer to resize List F
+///
+/// @param1 uint32_t capacity - new number of slots
+///
+/// @return int - 0 if capacity is out of range
+///-----------------------------------------------------------
+int listFRequestResize(uint32_t capacity)
+{
+	if ((capacity == 0) || (capacity > MAX_SIZE_OF_VALUE_E_STRUCTURE))
+	{
+		return 0;
+	}
+	listFRequested = capacity;
+	return 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Starts a requested resize once the previous one is
+///        done, and migrates one step
+///
+/// @param N/A
+///
+/// @return int - 1 while migration work is left
+///-----------------------------------------------------------
+int listFMaintain(void)
+{
+	const uint32_t requested = listFRequested;
+
+	if ((requested != 0) && !listFLayout.migrating)
+	{
+		listFRequested = 0;
+		listFStartResize(requested);
+	}
+	listFMigrateStep();
+	listFReclaim();
+	return listFLayout.migrating || (listFRequested != 0);
+}
+
+///-----------------------------------------------------------
+/// \brief Copies the counters
+///
+/// @param1 listFStats_t *stats - output
+///
+/// @return N/A
+///-----------------------------------------------------------
+void listFGetStats(listFStats_t *stats)
+{
+	stats->capacity = listFCapacityNow;
+	stats->entries = listFEntryCount;
+	stats->buckets = listFLayout.currentMask + 1;
+	stats->migrating = listFLayout.migrating;
+	stats->bucketsLeft = listFLayout.migrating ? (listFLayout.oldMask + 1 - listFMigrateCursor) : 0;
+	stats->retired = listFRetiredCount;
+	stats->resizes = listFResizes;
+	stats->stalls = listFStalls;
+}
+
+///-----------------------------------------------------------
+/// \brief Prints the counters
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+void listFPrintStats(void)
+{
+	listFStats_t stats;
+
+	listFGetStats(&stats);
+	printf("List F: %u slots, %u values, %u buckets, %u resizes, %u retired, %u writer stalls\n",
+		(unsigned int)stats.capacity, (unsigned int)stats.entries, (unsigned int)stats.buckets,
+		(unsigned int)stats.resizes, (unsigned int)stats.retired, (unsigned int)stats.stalls);
+	if (stats.migrating)
+	{
+		printf("List F: resize in progress, %u old buckets left\n", (unsigned int)stats.bucketsLeft);
+	}
+}
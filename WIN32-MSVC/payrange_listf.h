@@ -0,0 +1,68 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_listf.h
+///-----------------------------------------------------------------------------
+///
+/// \brief List F with an A code index, resizable at runtime: lookups run
+///        without locks, the E writer never waits for them, and a resize
+///        migrates the index a few entries at a time
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_LISTF_H
+#define PAYRANGE_LISTF_H
+
+#include "payrange.h"
+
+/// List F configurable defines
+/// Readers (tasks doing lookups) registered at the same time
+#define LISTF_MAX_READERS               ( 8 )
+/// Index buckets: a power of two of at least twice the capacity
+#define LISTF_MAX_BUCKETS               ( 2 * MAX_SIZE_OF_VALUE_E_STRUCTURE )
+#define LISTF_MIN_BUCKETS               ( 8 )
+/// Entries replaced or migrated but possibly still read by a lookup
+#define LISTF_MAX_RETIRED               ( 256 )
+/// Entries moved by one migration step, the latency budget of a resize
+#define LISTF_MIGRATE_ENTRIES           ( 16 )
+/// How often the E writer looks for a resize request while no C arrives
+#define LISTF_MAINTENANCE_POLL_MS       ( 100 )
+
+/// List F counters
+typedef struct
+{
+	uint32_t capacity;
+	uint32_t entries;
+	uint32_t buckets;
+	/// Resize in progress: old buckets left to migrate
+	uint32_t migrating;
+	uint32_t bucketsLeft;
+	uint32_t retired;
+	uint32_t resizes;
+	/// Times the writer found every entry still held by a reader
+	uint32_t stalls;
+}listFStats_t;
+
+/// Builds the index from the first *capacity slots of persistent (the state
+/// file), which every change is mirrored into. A capacity of 0 or above
+/// MAX_SIZE_OF_VALUE_E_STRUCTURE becomes SIZE_OF_VALUE_E_STRUCTURE. Call
+/// before the scheduler starts.
+void listFInit(valueE_t *persistent, uint32_t *capacity);
+/// Claims a reader slot; returns its id, or -1 when all are taken
+int listFReaderRegister(void);
+/// Copies up to maxResults F values holding A code a; returns the number found
+int listFLookup(int reader, int64_t a, valueE_t *results, int maxResults);
+/// Current number of slots
+uint32_t listFCapacity(void);
+/// Single writer: stores value E in a slot below listFCapacity(), and moves
+/// the index one migration step on when a resize is in progress
+void listFStore(uint32_t slot, const valueE_t *value);
+/// Asks the writer to resize List F; returns 0 if capacity is out of range
+int listFRequestResize(uint32_t capacity);
+/// Single writer: starts a requested resize and migrates one step; returns 1
+/// while there is migration work left
+int listFMaintain(void);
+/// Copies the counters
+void listFGetStats(listFStats_t *stats);
+/// Prints the counters
+void listFPrintStats(void);
+
+#endif /// PAYRANGE_LISTF_H
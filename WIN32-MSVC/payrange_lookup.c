@@ -0,0 +1,554 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_lookup.c
+///-----------------------------------------------------------------------------
+///
+/// \brief Bulk lookup of A codes
+///
+/// The codes are read, sorted and deduplicated first. List F (at most
+/// MAX_SIZE_OF_VALUE_E_STRUCTURE slots, from the state file) is then probed
+/// per slot, and the E history is read once from start to end with a binary
+/// search of the sorted codes per line, so the cost is one pass over each
+/// input plus n log n for the sort.
+/// Matches are collected with the index of their code and sorted by it, and
+/// the output is a merge of the sorted codes with the sorted matches: every
+/// code gets its F and E hits in E log order, or NOT FOUND.
+///
+/// Output lines:
+///
+///     <A> F <slot>: <B time> <B string> <B UTC ns> <D time> <D UTC ns>
+///     <A> E Line <n>: <E record as written to the E log>
+///     <A> NOT FOUND
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+
+/// Standard includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "payrange_lookup.h"
+#include "payrange_elog.h"
+#include "payrange_state.h"
+#include "payrange_tsc.h"
+
+/// Where a match was found
+typedef enum
+{
+	LOOKUP_IN_F = 0,
+	LOOKUP_IN_E
+}lookupSource_t;
+
+/// One hit: the code it belongs to and its output text
+typedef struct
+{
+	uint32_t       codeIndex;
+	/// F before E, then in the order found
+	lookupSource_t source;
+	uint32_t       order;
+	char           text[ELOG_MAX_LINE_LENGTH];
+}lookupMatch_t;
+
+/// Growing array of hits
+typedef struct
+{
+	lookupMatch_t *matches;
+	uint32_t       count;
+	uint32_t       capacity;
+}lookupMatches_t;
+
+/// What an E history scan probes and fills in
+typedef struct
+{
+	const int64_t   *codes;
+	uint32_t         count;
+	lookupMatches_t *list;
+	lookupReport_t  *report;
+	/// Set when a hit could not be stored
+	int              outOfMemory;
+}lookupScan_t;
+
+///-----------------------------------------------------------
+/// \brief qsort comparator of codes
+///-----------------------------------------------------------
+static int lookupCompareCodes(const void *left, const void *right)
+{
+	const int64_t a = *(const int64_t *)left;
+	const int64_t b = *(const int64_t *)right;
+
+	return (a > b) - (a < b);
+}
+
+///-----------------------------------------------------------
+/// \brief qsort comparator of matches: by code, F before E,
+///        then in the order found
+///-----------------------------------------------------------
+static int lookupCompareMatches(const void *left, const void *right)
+{
+	const lookupMatch_t *a = (const lookupMatch_t *)left;
+	const lookupMatch_t *b = (const lookupMatch_t *)right;
+
+	if (a->codeIndex != b->codeIndex)
+	{
+		return (a->codeIndex > b->codeIndex) ? 1 : -1;
+	}
+	if (a->source != b->source)
+	{
+		return (a->source > b->source) ? 1 : -1;
+	}
+	return (a->order > b->order) - (a->order < b->order);
+}
+
+///-----------------------------------------------------------
+/// \brief Finds a code in the sorted, deduplicated codes
+///
+/// @param1 const int64_t *codes - sorted codes
+/// @param2 uint32_t count - number of codes
+/// @param3 int64_t code - code to find
+///
+/// @return int64_t - index, -1 if absent
+///-----------------------------------------------------------
+static int64_t lookupFindCode(const int64_t *codes, uint32_t count, int64_t code)
+{
+	uint32_t low = 0;
+	uint32_t high = count;
+
+	while (low < high)
+	{
+		const uint32_t middle = low + (high - low) / 2;
+		if (codes[middle] < code)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	return ((low < count) && (codes[low] == code)) ? (int64_t)low : -1;
+}
+
+///-----------------------------------------------------------
+/// \brief Adds a hit
+///
+/// @param1 lookupMatches_t *list - hits
+/// @param2 uint32_t codeIndex - index of the code hit
+/// @param3 lookupSource_t source - F or E
+/// @param4 const char *text - output text
+///
+/// @return int - 0 when out of memory
+///-----------------------------------------------------------
+static int lookupAddMatch(lookupMatches_t *list, uint32_t codeIndex, lookupSource_t source, const char *text)
+{
+	lookupMatch_t *match;
+
+	if (list->count == list->capacity)
+	{
+		const uint32_t capacity = (list->capacity == 0) ? 1024 : 2 * list->capacity;
+		lookupMatch_t *matches = (lookupMatch_t *)realloc(list->matches, capacity * sizeof(lookupMatch_t));
+		if (matches == NULL)
+		{
+			return 0;
+		}
+		list->matches = matches;
+		list->capacity = capacity;
+	}
+	match = &list->matches[list->count];
+	match->codeIndex = codeIndex;
+	match->source = source;
+	match->order = list->count++;
+	strncpy(match->text, text, sizeof(match->text) - 1);
+	match->text[sizeof(match->text) - 1] = '\0';
+	return 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Reads, sorts and deduplicates the codes
+///
+/// @param1 const char *path - one code per line
+/// @param2 uint32_t *count - output, number of unique codes
+/// @param3 lookupReport_t *report - counters
+///
+/// @return int64_t * - codes (free() them), NULL on failure
+///-----------------------------------------------------------
+static int64_t *lookupReadCodes(const char *path, uint32_t *count, lookupReport_t *report)
+{
+	FILE *file = fopen(path, "r");
+	int64_t *codes = NULL;
+	uint32_t capacity = 0;
+	uint32_t unique = 0;
+	char line[64];
+
+	if (file == NULL)
+	{
+		printf("Lookup: %s could not be opened\n", path);
+		return NULL;
+	}
+	*count = 0;
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		char *end;
+		long long code;
+
+		if ((line[0] == '\n') || (line[0] == '\r') || (line[0] == '\0'))
+		{
+			continue;
+		}
+		report->codesRead++;
+		code = strtoll(line, &end, 10);
+		if ((end == line) || (code < 0) || ((*end != '\0') && (*end != '\n') && (*end != '\r')))
+		{
+			report->codesRejected++;
+			continue;
+		}
+		if (*count == capacity)
+		{
+			int64_t *grown;
+			capacity = (capacity == 0) ? 65536 : 2 * capacity;
+			grown = (int64_t *)realloc(codes, capacity * sizeof(int64_t));
+			if (grown == NULL)
+			{
+				printf("Lookup: out of memory after %u codes\n", (unsigned int)*count);
+				free(codes);
+				fclose(file);
+				return NULL;
+			}
+			codes = grown;
+		}
+		codes[(*count)++] = (int64_t)code;
+	}
+	fclose(file);
+
+	if (*count > 0)
+	{
+		qsort(codes, *count, sizeof(int64_t), lookupCompareCodes);
+		unique = 1;
+		for (uint32_t i = 1; i < *count; i++)
+		{
+			if (codes[i] != codes[unique - 1])
+			{
+				codes[unique++] = codes[i];
+			}
+		}
+	}
+	*count = unique;
+	report->codesUnique = unique;
+	return codes;
+}
+
+///-----------------------------------------------------------
+/// \brief Probes the codes with every List F slot
+///
+/// @param1 const char *statePath - state file
+/// @param2 const int64_t *codes - sorted codes
+/// @param3 uint32_t count - number of codes
+/// @param4 lookupMatches_t *list - hits
+/// @param5 lookupReport_t *report - counters
+///
+/// @return int - 0 when out of memory
+///-----------------------------------------------------------
+static int lookupListF(const char *statePath, const int64_t *codes, uint32_t count, lookupMatches_t *list,
+	lookupReport_t *report)
+{
+	static payrangeState_t state;
+	char text[ELOG_MAX_LINE_LENGTH];
+	uint32_t capacity;
+
+	if (!stateReadFile(statePath, &state))
+	{
+		printf("Lookup: no valid state in %s, List F is not searched\n", statePath);
+		return 1;
+	}
+	report->listFAvailable = 1;
+	capacity = ((state.valueECapacity == 0) || (state.valueECapacity > MAX_SIZE_OF_VALUE_E_STRUCTURE)) ?
+		SIZE_OF_VALUE_E_STRUCTURE : state.valueECapacity;
+	for (int slot = 0; slot < (int)capacity; slot++)
+	{
+		const valueE_t *valueE = &state.valueE[slot];
+		int64_t index;
+
+		/// Slot never written
+		if ((valueE->currentValueD.randomNumber == 0) && (valueE->randomValueB.stringTime == 0))
+		{
+			continue;
+		}
+		index = lookupFindCode(codes, count, valueE->currentValueD.randomNumber);
+		if (index < 0)
+		{
+			continue;
+		}
+		snprintf(text, sizeof(text), "%d: %d %s %"PRIu64" %d %"PRIu64, slot,
+			valueE->randomValueB.stringTime, valueE->randomValueB.stringPlacer,
+			valueE->randomValueB.stringTimeUtcNs, valueE->currentValueD.randomNumberTime,
+			valueE->currentValueD.randomNumberTimeUtcNs);
+		if (!lookupAddMatch(list, (uint32_t)index, LOOKUP_IN_F, text))
+		{
+			return 0;
+		}
+		report->fMatches++;
+	}
+	return 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Reads the A code of an E record line
+///
+/// @param1 const char *line - "Line <n>: <B time> <B string>
+///                            <B UTC> <D time> <A> <D UTC>"
+/// @param2 int64_t *code - output
+///
+/// @return int - 0 if the line is not an E record
+///-----------------------------------------------------------
+static int lookupParseRecord(const char *line, int64_t *code)
+{
+	const char *field;
+	char *end;
+
+	if (strncmp(line, "Line ", 5) != 0)
+	{
+		return 0;
+	}
+	field = strchr(line, ':');
+	if (field == NULL)
+	{
+		return 0;
+	}
+	field++;
+	/// Skip B time, B string, B UTC and D time
+	for (int skip = 0; skip < 4; skip++)
+	{
+		while (*field == ' ')
+		{
+			field++;
+		}
+		while ((*field != ' ') && (*field != '\0'))
+		{
+			field++;
+		}
+	}
+	*code = (int64_t)strtoll(field, &end, 10);
+	return (end != field);
+}
+
+///-----------------------------------------------------------
+/// \brief Probes the codes with one E log line
+///
+/// @param1 lookupScan_t *scan - codes and hits
+/// @param2 char *line - the line, newline stripped on a hit
+///
+/// @return int - 0 if out of memory
+///-----------------------------------------------------------
+static int lookupProbeLine(lookupScan_t *scan, char *line)
+{
+	int64_t code;
+	int64_t index;
+
+	if (!lookupParseRecord(line, &code))
+	{
+		return 1;
+	}
+	scan->report->eLinesScanned++;
+	index = lookupFindCode(scan->codes, scan->count, code);
+	if (index < 0)
+	{
+		return 1;
+	}
+	line[strcspn(line, "\r\n")] = '\0';
+	if (!lookupAddMatch(scan->list, (uint32_t)index, LOOKUP_IN_E, line))
+	{
+		scan->outOfMemory = 1;
+		return 0;
+	}
+	scan->report->eMatches++;
+	return 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Block visitor of an encrypted E log: probes the
+///        codes with every line of the decrypted block
+///
+/// @param1 void *context - lookupScan_t
+/// @param2 uint32_t blockIndex - block (unused)
+/// @param3 char *text - block lines and trailer
+/// @param4 size_t length - bytes in text
+///
+/// @return int - 0 if out of memory
+///-----------------------------------------------------------
+static int lookupScanBlock(void *context, uint32_t blockIndex, char *text, size_t length)
+{
+	char *const end = text + length;
+	char *line = text;
+
+	(void)blockIndex;
+	while (line < end)
+	{
+		char *newline = memchr(line, '\n', (size_t)(end - line));
+		/// Every line of a block ends in a newline, the trailer included
+		if (newline == NULL)
+		{
+			break;
+		}
+		*newline = '\0';
+		if (!lookupProbeLine((lookupScan_t *)context, line))
+		{
+			return 0;
+		}
+		line = newline + 1;
+	}
+	return 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Scans the E history once, probing the codes with
+///        every record. An encrypted log is decrypted one block
+///        at a time in memory, its text never reaches the disk.
+///
+/// @param1 const char *path - E log
+/// @param2 const int64_t *codes - sorted codes
+/// @param3 uint32_t count - number of codes
+/// @param4 lookupMatches_t *list - hits
+/// @param5 lookupReport_t *report - counters
+///
+/// @return int - 0 if the log can't be read or out of memory
+///-----------------------------------------------------------
+static int lookupHistoryE(const char *path, const int64_t *codes, uint32_t count, lookupMatches_t *list,
+	lookupReport_t *report)
+{
+	lookupScan_t scan = { codes, count, list, report, 0 };
+	char line[ELOG_MAX_LINE_LENGTH + 2];
+	FILE *file;
+
+	if (ELOG_ENCRYPT_AT_REST)
+	{
+		/// The encrypted blocks are authenticated on the way
+		if (!elogDecryptBlocks(path, lookupScanBlock, &scan) && !scan.outOfMemory)
+		{
+			printf("Lookup: only the authentic blocks of %s are searched\n", path);
+		}
+		return !scan.outOfMemory;
+	}
+
+	file = fopen(path, "r");
+	if (file == NULL)
+	{
+		printf("Lookup: E log %s could not be opened\n", path);
+		return 0;
+	}
+	setvbuf(file, NULL, _IOFBF, LOOKUP_OUTPUT_BUFFER);
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		if (!lookupProbeLine(&scan, line))
+		{
+			fclose(file);
+			return 0;
+		}
+	}
+	fclose(file);
+	return 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Writes every code with its hits, in code order
+///
+/// @param1 const char *path - output file
+/// @param2 const int64_t *codes - sorted codes
+/// @param3 uint32_t count - number of codes
+/// @param4 const lookupMatches_t *list - hits sorted by code
+/// @param5 lookupReport_t *report - counters
+///
+/// @return int - 0 if the output can't be written
+///-----------------------------------------------------------
+static int lookupWriteResults(const char *path, const int64_t *codes, uint32_t count,
+	const lookupMatches_t *list, lookupReport_t *report)
+{
+	FILE *output = fopen(path, "w");
+	uint32_t next = 0;
+	int written;
+
+	if (output == NULL)
+	{
+		printf("Lookup: %s could not be created\n", path);
+		return 0;
+	}
+	setvbuf(output, NULL, _IOFBF, LOOKUP_OUTPUT_BUFFER);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if ((next < list->count) && (list->matches[next].codeIndex == i))
+		{
+			report->codesFound++;
+			while ((next < list->count) && (list->matches[next].codeIndex == i))
+			{
+				fprintf(output, "%"PRId64" %c %s\n", codes[i],
+					(list->matches[next].source == LOOKUP_IN_F) ? 'F' : 'E', list->matches[next].text);
+				next++;
+			}
+		}
+		else
+		{
+			fprintf(output, "%"PRId64" NOT FOUND\n", codes[i]);
+		}
+	}
+	written = !ferror(output);
+	return (fclose(output) == 0) && written;
+}
+
+///-----------------------------------------------------------
+/// \brief Looks up a file of A codes in List F and the E
+///        history
+///
+/// @param1 const char *codesPath - one A code per line
+/// @param2 const char *outputPath - results
+/// @param3 const char *elogPath - E log
+/// @param4 const char *statePath - state file holding List F
+/// @param5 lookupReport_t *report - counters
+///
+/// @return int - 1 on success
+///-----------------------------------------------------------
+int lookupBulk(const char *codesPath, const char *outputPath, const char *elogPath, const char *statePath,
+	lookupReport_t *report)
+{
+	const uint64_t start = tscNow();
+	lookupMatches_t list = { NULL, 0, 0 };
+	uint32_t count = 0;
+	int64_t *codes;
+	int success = 0;
+
+	memset(report, 0, sizeof(*report));
+	codes = lookupReadCodes(codesPath, &count, report);
+	if (codes == NULL)
+	{
+		return 0;
+	}
+
+	if (lookupListF(statePath, codes, count, &list, report) &&
+		lookupHistoryE(elogPath, codes, count, &list, report))
+	{
+		qsort(list.matches, list.count, sizeof(lookupMatch_t), lookupCompareMatches);
+		success = lookupWriteResults(outputPath, codes, count, &list, report);
+	}
+	free(list.matches);
+	free(codes);
+	report->elapsedNs = tscToNs(tscNow() - start);
+	return success;
+}
+
+///-----------------------------------------------------------
+/// \brief Prints a lookup report
+///
+/// @param1 const lookupReport_t *report - counters
+///
+/// @return N/A
+///-----------------------------------------------------------
+void lookupPrintReport(const lookupReport_t *report)
+{
+	const double seconds = (double)report->elapsedNs / 1e9;
+
+	printf("Lookup: %u codes read, %u rejected, %u unique, %u found\n", (unsigned int)report->codesRead,
+		(unsigned int)report->codesRejected, (unsigned int)report->codesUnique, (unsigned int)report->codesFound);
+	printf("Lookup: %u F hits%s, %u E hits in %u E records\n", (unsigned int)report->fMatches,
+		report->listFAvailable ? "" : " (List F not available)", (unsigned int)report->eMatches,
+		(unsigned int)report->eLinesScanned);
+	printf("Lookup: %.3f s, %.0f codes per minute\n", seconds,
+		(seconds > 0.0) ? (double)report->codesRead * 60.0 / seconds : 0.0);
+}
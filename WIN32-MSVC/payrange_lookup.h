@@ -0,0 +1,44 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_lookup.h
+///-----------------------------------------------------------------------------
+///
+/// \brief Bulk lookup: resolves a file of A codes against List F and the E
+///        history in one pass over each
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_LOOKUP_H
+#define PAYRANGE_LOOKUP_H
+
+/// Standard includes
+#include <stdint.h>
+
+/// Bulk lookup configurable defines
+/// Output buffer size
+#define LOOKUP_OUTPUT_BUFFER            ( 1024 * 1024 )
+
+/// Counters of one bulk lookup
+typedef struct
+{
+	uint32_t codesRead;
+	/// Lines that are not a non-negative decimal number
+	uint32_t codesRejected;
+	uint32_t codesUnique;
+	uint32_t codesFound;
+	uint32_t eLinesScanned;
+	uint32_t fMatches;
+	uint32_t eMatches;
+	/// 1 if List F was read from the state file
+	int      listFAvailable;
+	uint64_t elapsedNs;
+}lookupReport_t;
+
+/// Looks up every code of codesPath, writes the results to outputPath in
+/// code order; returns 1 on success. elogPath is the E log (E.enc when
+/// ELOG_ENCRYPT_AT_REST), statePath the state file holding List F.
+int lookupBulk(const char *codesPath, const char *outputPath, const char *elogPath, const char *statePath,
+	lookupReport_t *report);
+/// Prints a lookup report
+void lookupPrintReport(const lookupReport_t *report);
+
+#endif /// PAYRANGE_LOOKUP_H
@@ -0,0 +1,662 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_merge.c
+///-----------------------------------------------------------------------------
+///
+/// \brief K-way merge of per-lane E logs
+///
+/// Every lane keeps its current record, and a loser tree over the lanes
+/// keeps the lane with the oldest one at the root: taking a record and
+/// reading the next of its lane replays one leaf to root path, log2(lanes)
+/// comparisons, and the rest of the tree is left alone. The key is the D
+/// UTC time of the record with the lane as tie-break, so equal times come
+/// out in lane order and, within a lane, in line order.
+///
+/// Lanes are read with overlapped I/O in MERGE_READ_BYTES pieces, two
+/// buffers per lane: while the merge consumes one, the next piece of the
+/// file is read into the other. A record that crosses from one buffer into
+/// the next is copied to a small carry buffer, any other record is handed
+/// out in place. Nothing else is held per lane, so hundreds of lanes and
+/// files of any size merge in lanes * 2 * MERGE_READ_BYTES of memory.
+///
+/// Lane logs are plain E logs (decrypt encrypted ones with --decrypt first);
+/// seal lines and anything else that is not a record are skipped.
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+
+/// Standard includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+/// Kernel includes
+#include <FreeRTOS.h>
+
+#include "payrange_merge.h"
+#include "payrange_tsc.h"
+
+/// Decimal digits of the largest uint64_t
+#define MERGE_MAX_DIGITS                ( 20 )
+
+/// One lane: its read buffers, the carry of a record that crosses them,
+/// and its current record
+typedef struct
+{
+	HANDLE      file;
+	OVERLAPPED  overlapped;
+	char       *buffers[2];
+	/// Buffer being consumed, the other one is being read ahead
+	uint32_t    current;
+	uint32_t    position;
+	uint32_t    length;
+	uint64_t    nextOffset;
+	int         pending;
+	int         endOfFile;
+	char        carry[MERGE_MAX_LINE_LENGTH + 1];
+	/// Current record
+	int         exhausted;
+	uint64_t    timestampNs;
+	uint32_t    laneLine;
+	const char *fields;
+	uint32_t    fieldsLength;
+}mergeLane_t;
+
+struct mergeStream
+{
+	mergeLane_t  *lanes;
+	uint32_t      laneCount;
+	/// Loser tree: tree[0] is the winner, tree[1..laneCount-1] the loser
+	/// of each match; leaf of lane l is node laneCount + l
+	uint32_t     *tree;
+	uint64_t      sequence;
+	/// Lane whose record was handed out last, advanced by the next call
+	int64_t       lastLane;
+	mergeReport_t report;
+	uint64_t      start;
+};
+
+///-----------------------------------------------------------
+/// \brief Starts reading the next piece of a lane into the
+///        buffer that is not being consumed
+///
+/// @param1 mergeLane_t *lane - lane
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void mergeLaneReadAhead(mergeLane_t *lane)
+{
+	if (lane->endOfFile)
+	{
+		return;
+	}
+	ResetEvent(lane->overlapped.hEvent);
+	lane->overlapped.Offset = (DWORD)lane->nextOffset;
+	lane->overlapped.OffsetHigh = (DWORD)(lane->nextOffset >> 32);
+	if (!ReadFile(lane->file, lane->buffers[1 - lane->current], MERGE_READ_BYTES, NULL, &lane->overlapped) &&
+		(GetLastError() != ERROR_IO_PENDING))
+	{
+		/// Past the end, or the file can't be read any further
+		lane->endOfFile = 1;
+		return;
+	}
+	lane->nextOffset += MERGE_READ_BYTES;
+	lane->pending = 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Waits for the read ahead of a lane and starts
+///        consuming it
+///
+/// @param1 mergeLane_t *lane - lane
+/// @param2 mergeReport_t *report - counters
+///
+/// @return int - 0 at the end of the lane
+///-----------------------------------------------------------
+static int mergeLaneSwitch(mergeLane_t *lane, mergeReport_t *report)
+{
+	DWORD bytes = 0;
+
+	if (!lane->pending)
+	{
+		return 0;
+	}
+	lane->pending = 0;
+	if (!GetOverlappedResult(lane->file, &lane->overlapped, &bytes, TRUE) || (bytes == 0))
+	{
+		lane->endOfFile = 1;
+		return 0;
+	}
+	lane->current = 1 - lane->current;
+	lane->position = 0;
+	lane->length = (uint32_t)bytes;
+	report->bytesRead += bytes;
+	if (bytes < MERGE_READ_BYTES)
+	{
+		lane->endOfFile = 1;
+	}
+	mergeLaneReadAhead(lane);
+	return 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Next line of a lane, without the line end. Lines
+///        longer than MERGE_MAX_LINE_LENGTH are skipped and
+///        counted as malformed.
+///
+/// @param1 mergeLane_t *lane - lane
+/// @param2 const char **line - output, valid until the next call
+/// @param3 uint32_t *length - output
+/// @param4 mergeReport_t *report - counters
+///
+/// @return int - 0 at the end of the lane
+///-----------------------------------------------------------
+static int mergeLaneReadLine(mergeLane_t *lane, const char **line, uint32_t *length, mergeReport_t *report)
+{
+	uint32_t carried = 0;
+	int cut = 0;
+
+	for (;;)
+	{
+		char *start = lane->buffers[lane->current] + lane->position;
+		const uint32_t available = lane->length - lane->position;
+		const char *newline = (const char *)memchr(start, '\n', available);
+		const uint32_t taken = (newline != NULL) ? (uint32_t)(newline - start) : available;
+		int more;
+
+		if ((newline != NULL) && (carried == 0) && !cut)
+		{
+			lane->position += taken + 1;
+			if (taken > MERGE_MAX_LINE_LENGTH)
+			{
+				report->malformed++;
+				continue;
+			}
+			*line = start;
+			*length = taken;
+			break;
+		}
+		/// The line started in the previous buffer
+		if (carried + taken > MERGE_MAX_LINE_LENGTH)
+		{
+			cut = 1;
+		}
+		else
+		{
+			memcpy(lane->carry + carried, start, taken);
+			carried += taken;
+		}
+		lane->position += taken + (newline != NULL);
+		more = (newline == NULL) && mergeLaneSwitch(lane, report);
+		if (!more && cut)
+		{
+			report->malformed++;
+			carried = 0;
+			cut = 0;
+			if (newline != NULL)
+			{
+				continue;
+			}
+		}
+		if (!more)
+		{
+			/// The last line may have no line end
+			if ((newline == NULL) && (carried == 0))
+			{
+				return 0;
+			}
+			lane->carry[carried] = '\0';
+			*line = lane->carry;
+			*length = carried;
+			break;
+		}
+	}
+	if ((*length > 0) && ((*line)[*length - 1] == '\r'))
+	{
+		(*length)--;
+	}
+	return 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Reads a decimal number
+///
+/// @param1 const char **cursor - in/out, position in the line
+/// @param2 const char *end - end of the line
+/// @param3 uint64_t *value - output
+///
+/// @return int - 0 if there are no digits
+///-----------------------------------------------------------
+static int mergeParseNumber(const char **cursor, const char *end, uint64_t *value)
+{
+	const char *digits = *cursor;
+
+	*value = 0;
+	while ((*cursor < end) && (**cursor >= '0') && (**cursor <= '9'))
+	{
+		*value = *value * 10 + (uint64_t)(**cursor - '0');
+		(*cursor)++;
+	}
+	return (*cursor != digits);
+}
+
+///-----------------------------------------------------------
+/// \brief Moves a lane to its next record
+///
+/// @param1 mergeLane_t *lane - lane
+/// @param2 mergeReport_t *report - counters
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void mergeLaneAdvance(mergeLane_t *lane, mergeReport_t *report)
+{
+	const uint64_t previous = lane->timestampNs;
+	const char *line;
+	uint32_t length;
+
+	while (mergeLaneReadLine(lane, &line, &length, report))
+	{
+		const char *end = line + length;
+		const char *cursor = line + 5;
+		const char *field;
+		uint64_t laneLine;
+
+		if ((length < 5) || (memcmp(line, "Line ", 5) != 0))
+		{
+			/// Seal line, header or an empty line
+			continue;
+		}
+		if (!mergeParseNumber(&cursor, end, &laneLine) || (cursor == end) || (*cursor != ':'))
+		{
+			report->malformed++;
+			continue;
+		}
+		cursor++;
+		while ((cursor < end) && (*cursor == ' '))
+		{
+			cursor++;
+		}
+		lane->fields = cursor;
+		lane->fieldsLength = (uint32_t)(end - cursor);
+		lane->laneLine = (uint32_t)laneLine;
+		/// D UTC ns is the last field
+		field = end;
+		while ((field > cursor) && (field[-1] != ' '))
+		{
+			field--;
+		}
+		if (!mergeParseNumber(&field, end, &lane->timestampNs) || (field != end))
+		{
+			report->malformed++;
+			continue;
+		}
+		report->outOfOrder += (lane->timestampNs < previous);
+		return;
+	}
+	lane->exhausted = 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Orders two lanes by their current records; an
+///        exhausted lane comes after any other
+///
+/// @param1 const mergeStream_t *stream - stream
+/// @param2 uint32_t a - lane
+/// @param3 uint32_t b - lane
+///
+/// @return int - 1 if lane a goes first
+///-----------------------------------------------------------
+static int mergeBefore(const mergeStream_t *stream, uint32_t a, uint32_t b)
+{
+	const mergeLane_t *laneA = &stream->lanes[a];
+	const mergeLane_t *laneB = &stream->lanes[b];
+
+	if (laneA->exhausted != laneB->exhausted)
+	{
+		return laneB->exhausted;
+	}
+	if (laneA->timestampNs != laneB->timestampNs)
+	{
+		return (laneA->timestampNs < laneB->timestampNs);
+	}
+	return (a < b);
+}
+
+///-----------------------------------------------------------
+/// \brief Plays every match of the loser tree once
+///
+/// @param1 mergeStream_t *stream - stream with every lane at
+///                                 its first record
+///
+/// @return int - 0 when out of memory
+///-----------------------------------------------------------
+static int mergeBuildTree(mergeStream_t *stream)
+{
+	const uint32_t count = stream->laneCount;
+	/// Winner of each node, leaves included
+	uint32_t *winners = (uint32_t *)malloc(2 * count * sizeof(uint32_t));
+
+	if (winners == NULL)
+	{
+		return 0;
+	}
+	for (uint32_t lane = 0; lane < count; lane++)
+	{
+		winners[count + lane] = lane;
+	}
+	for (uint32_t node = count - 1; node >= 1; node--)
+	{
+		const uint32_t left = winners[2 * node];
+		const uint32_t right = winners[2 * node + 1];
+		const int leftFirst = mergeBefore(stream, left, right);
+
+		winners[node] = leftFirst ? left : right;
+		stream->tree[node] = leftFirst ? right : left;
+	}
+	stream->tree[0] = (count > 1) ? winners[1] : 0;
+	free(winners);
+	return 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Replays the matches from a lane's leaf to the root
+///        after its record changed
+///
+/// @param1 mergeStream_t *stream - stream
+/// @param2 uint32_t lane - lane
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void mergeReplay(mergeStream_t *stream, uint32_t lane)
+{
+	uint32_t winner = lane;
+
+	for (uint32_t node = (stream->laneCount + lane) / 2; node >= 1; node /= 2)
+	{
+		if (mergeBefore(stream, stream->tree[node], winner))
+		{
+			const uint32_t loser = winner;
+			winner = stream->tree[node];
+			stream->tree[node] = loser;
+		}
+	}
+	stream->tree[0] = winner;
+}
+
+///-----------------------------------------------------------
+/// \brief Closes the lanes and frees the stream
+///
+/// @param1 mergeStream_t *stream - stream, may be NULL
+///
+/// @return N/A
+///-----------------------------------------------------------
+void mergeClose(mergeStream_t *stream)
+{
+	if (stream == NULL)
+	{
+		return;
+	}
+	for (uint32_t i = 0; (stream->lanes != NULL) && (i < stream->laneCount); i++)
+	{
+		mergeLane_t *lane = &stream->lanes[i];
+		DWORD bytes;
+
+		if (lane->file != INVALID_HANDLE_VALUE)
+		{
+			if (lane->pending)
+			{
+				/// The buffer must outlive the read
+				CancelIo(lane->file);
+				GetOverlappedResult(lane->file, &lane->overlapped, &bytes, TRUE);
+			}
+			CloseHandle(lane->file);
+		}
+		if (lane->overlapped.hEvent != NULL)
+		{
+			CloseHandle(lane->overlapped.hEvent);
+		}
+		free(lane->buffers[0]);
+		free(lane->buffers[1]);
+	}
+	free(stream->lanes);
+	free(stream->tree);
+	free(stream);
+}
+
+///-----------------------------------------------------------
+/// \brief Opens the lane logs and reads their first records
+///
+/// @param1 const char *const *lanePaths - lane logs
+/// @param2 uint32_t laneCount - 1 to MERGE_MAX_LANES
+///
+/// @return mergeStream_t * - stream, NULL on failure
+///-----------------------------------------------------------
+mergeStream_t *mergeOpen(const char *const *lanePaths, uint32_t laneCount)
+{
+	mergeStream_t *stream;
+
+	if ((laneCount == 0) || (laneCount > MERGE_MAX_LANES))
+	{
+		printf("Merge: %u lanes, 1 to %d are supported\n", (unsigned int)laneCount, MERGE_MAX_LANES);
+		return NULL;
+	}
+	stream = (mergeStream_t *)calloc(1, sizeof(mergeStream_t));
+	if (stream == NULL)
+	{
+		return NULL;
+	}
+	stream->start = tscNow();
+	stream->lastLane = -1;
+	stream->laneCount = laneCount;
+	stream->report.lanes = laneCount;
+	stream->lanes = (mergeLane_t *)calloc(laneCount, sizeof(mergeLane_t));
+	stream->tree = (uint32_t *)calloc(laneCount, sizeof(uint32_t));
+	if ((stream->lanes == NULL) || (stream->tree == NULL))
+	{
+		printf("Merge: out of memory for %u lanes\n", (unsigned int)laneCount);
+		mergeClose(stream);
+		return NULL;
+	}
+	for (uint32_t i = 0; i < laneCount; i++)
+	{
+		stream->lanes[i].file = INVALID_HANDLE_VALUE;
+	}
+
+	for (uint32_t i = 0; i < laneCount; i++)
+	{
+		mergeLane_t *lane = &stream->lanes[i];
+
+		lane->file = CreateFileA(lanePaths[i], GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+			FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (lane->file == INVALID_HANDLE_VALUE)
+		{
+			printf("Merge: lane %u, %s could not be opened\n", (unsigned int)i, lanePaths[i]);
+			mergeClose(stream);
+			return NULL;
+		}
+		lane->overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+		lane->buffers[0] = (char *)malloc(MERGE_READ_BYTES);
+		lane->buffers[1] = (char *)malloc(MERGE_READ_BYTES);
+		if ((lane->overlapped.hEvent == NULL) || (lane->buffers[0] == NULL) || (lane->buffers[1] == NULL))
+		{
+			printf("Merge: out of memory at lane %u\n", (unsigned int)i);
+			mergeClose(stream);
+			return NULL;
+		}
+		stream->report.bufferBytes += 2 * MERGE_READ_BYTES;
+		/// Every lane's first read is in flight before any is waited for
+		lane->current = 1;
+		mergeLaneReadAhead(lane);
+	}
+	for (uint32_t i = 0; i < laneCount; i++)
+	{
+		mergeLaneAdvance(&stream->lanes[i], &stream->report);
+	}
+	if (!mergeBuildTree(stream))
+	{
+		mergeClose(stream);
+		return NULL;
+	}
+	return stream;
+}
+
+///-----------------------------------------------------------
+/// \brief Next record of the merged stream
+///
+/// @param1 mergeStream_t *stream - stream
+/// @param2 mergeRecord_t *record - output
+///
+/// @return int - 0 once every lane is exhausted
+///-----------------------------------------------------------
+int mergeNext(mergeStream_t *stream, mergeRecord_t *record)
+{
+	const mergeLane_t *lane;
+	uint32_t winner;
+
+	/// The previous record stays valid until now
+	if (stream->lastLane >= 0)
+	{
+		mergeLaneAdvance(&stream->lanes[stream->lastLane], &stream->report);
+		mergeReplay(stream, (uint32_t)stream->lastLane);
+	}
+	winner = stream->tree[0];
+	lane = &stream->lanes[winner];
+	if (lane->exhausted)
+	{
+		stream->lastLane = -1;
+		return 0;
+	}
+	record->sequence = stream->sequence++;
+	record->timestampNs = lane->timestampNs;
+	record->lane = winner;
+	record->laneLine = lane->laneLine;
+	record->fields = lane->fields;
+	record->fieldsLength = lane->fieldsLength;
+	stream->lastLane = winner;
+	stream->report.records++;
+	return 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Counters so far
+///
+/// @param1 const mergeStream_t *stream - stream
+/// @param2 mergeReport_t *report - output
+///
+/// @return N/A
+///-----------------------------------------------------------
+void mergeGetReport(const mergeStream_t *stream, mergeReport_t *report)
+{
+	*report = stream->report;
+	report->elapsedNs = tscToNs(tscNow() - stream->start);
+}
+
+///-----------------------------------------------------------
+/// \brief Writes a number in decimal
+///
+/// @param1 char *text - output, MERGE_MAX_DIGITS
+/// @param2 uint64_t value - number
+///
+/// @return uint32_t - characters written
+///-----------------------------------------------------------
+static uint32_t mergeFormatNumber(char *text, uint64_t value)
+{
+	char digits[MERGE_MAX_DIGITS];
+	uint32_t count = 0;
+
+	do
+	{
+		digits[count++] = (char)('0' + value % 10);
+		value /= 10;
+	} while (value > 0);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		text[i] = digits[count - 1 - i];
+	}
+	return count;
+}
+
+///-----------------------------------------------------------
+/// \brief Merges the lane logs into one file
+///
+/// @param1 const char *const *lanePaths - lane logs
+/// @param2 uint32_t laneCount - number of lanes
+/// @param3 const char *outputPath - merged log
+/// @param4 mergeReport_t *report - counters
+///
+/// @return int - 1 on success
+///-----------------------------------------------------------
+int mergeLogs(const char *const *lanePaths, uint32_t laneCount, const char *outputPath, mergeReport_t *report)
+{
+	char line[MERGE_MAX_LINE_LENGTH + 4 * MERGE_MAX_DIGITS];
+	mergeStream_t *stream;
+	mergeRecord_t record;
+	FILE *output;
+	int success;
+
+	memset(report, 0, sizeof(*report));
+	output = fopen(outputPath, "wb");
+	if (output == NULL)
+	{
+		printf("Merge: %s could not be created\n", outputPath);
+		return 0;
+	}
+	setvbuf(output, NULL, _IOFBF, MERGE_WRITE_BYTES);
+	stream = mergeOpen(lanePaths, laneCount);
+	if (stream == NULL)
+	{
+		fclose(output);
+		return 0;
+	}
+
+	while (mergeNext(stream, &record))
+	{
+		uint32_t length = 0;
+
+		memcpy(line, "Line ", 5);
+		length += 5;
+		length += mergeFormatNumber(line + length, record.sequence);
+		line[length++] = ':';
+		line[length++] = ' ';
+		/// Room for the fields, two numbers, two spaces and the line end
+		if (record.fieldsLength > sizeof(line) - length - (2 * MERGE_MAX_DIGITS + 3))
+		{
+			stream->report.malformed++;
+			continue;
+		}
+		memcpy(line + length, record.fields, record.fieldsLength);
+		length += record.fieldsLength;
+		line[length++] = ' ';
+		length += mergeFormatNumber(line + length, record.lane);
+		line[length++] = ' ';
+		length += mergeFormatNumber(line + length, record.laneLine);
+		line[length++] = '\n';
+		fwrite(line, 1, length, output);
+		stream->report.bytesWritten += length;
+	}
+
+	success = (fclose(output) == 0);
+	mergeGetReport(stream, report);
+	mergeClose(stream);
+	return success;
+}
+
+///-----------------------------------------------------------
+/// \brief Prints a merge report
+///
+/// @param1 const mergeReport_t *report - counters
+///
+/// @return N/A
+///-----------------------------------------------------------
+void mergePrintReport(const mergeReport_t *report)
+{
+	const double seconds = (double)report->elapsedNs / 1e9;
+
+	printf("Merge: %u lanes, %" PRIu64 " records, %" PRIu64 " out of lane order, %" PRIu64 " malformed\n",
+		(unsigned int)report->lanes, report->records, report->outOfOrder, report->malformed);
+	printf("Merge: %.1f MB read, %.1f MB written, %.1f MB of lane buffers\n", (double)report->bytesRead / 1e6,
+		(double)report->bytesWritten / 1e6, (double)report->bufferBytes / 1e6);
+	printf("Merge: %.3f s, %.0f records/s, %.1f MB/s read\n", seconds,
+		(seconds > 0.0) ? (double)report->records / seconds : 0.0,
+		(seconds > 0.0) ? (double)report->bytesRead / 1e6 / seconds : 0.0);
+}
@@ -0,0 +1,79 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_merge.h
+///-----------------------------------------------------------------------------
+///
+/// \brief K-way merge of per-lane E logs: the records of N lane logs, each in
+///        time order with its own line numbers, as one stream in D time
+///        order with a global sequence number
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_MERGE_H
+#define PAYRANGE_MERGE_H
+
+/// Standard includes
+#include <stdint.h>
+
+/// Merge configurable defines
+/// Size of one read; each lane holds two of these, one being consumed and
+/// one being read ahead, so memory is lanes * 2 * MERGE_READ_BYTES
+#define MERGE_READ_BYTES                ( 128 * 1024 )
+/// Output buffer size
+#define MERGE_WRITE_BYTES               ( 1024 * 1024 )
+/// Longest record line; longer ones are cut and counted as malformed
+#define MERGE_MAX_LINE_LENGTH           ( 256 )
+/// Most lanes of one merge
+#define MERGE_MAX_LANES                 ( 4096 )
+
+/// One record of the merged stream. fields points into the lane's read
+/// buffer and is valid until the next mergeNext().
+typedef struct
+{
+	/// Global sequence, from 0
+	uint64_t    sequence;
+	/// D UTC ns, the merge key
+	uint64_t    timestampNs;
+	uint32_t    lane;
+	uint32_t    laneLine;
+	/// The record after "Line <n>: ", without the line end
+	const char *fields;
+	uint32_t    fieldsLength;
+}mergeRecord_t;
+
+/// Counters of one merge
+typedef struct
+{
+	uint32_t lanes;
+	uint64_t records;
+	uint64_t bytesRead;
+	uint64_t bytesWritten;
+	/// Records older than the previous record of their lane, which the
+	/// merge can only emit late
+	uint64_t outOfOrder;
+	/// Lines starting with "Line " that could not be parsed or were cut
+	uint64_t malformed;
+	/// Read buffers of all lanes
+	uint64_t bufferBytes;
+	uint64_t elapsedNs;
+}mergeReport_t;
+
+/// Merge stream, opaque
+typedef struct mergeStream mergeStream_t;
+
+/// Opens the lane logs (plain E logs) and reads the first record of each;
+/// NULL if a lane cannot be opened or out of memory
+mergeStream_t *mergeOpen(const char *const *lanePaths, uint32_t laneCount);
+/// Next record in (D time, lane) order; 0 at the end of every lane
+int mergeNext(mergeStream_t *stream, mergeRecord_t *record);
+/// Counters so far
+void mergeGetReport(const mergeStream_t *stream, mergeReport_t *report);
+/// Closes the lanes and frees the stream
+void mergeClose(mergeStream_t *stream);
+/// Merges the lane logs into outputPath as "Line <sequence>: <record>
+/// <lane> <lane line>", which --lookup reads like an E log; returns 1 on
+/// success
+int mergeLogs(const char *const *lanePaths, uint32_t laneCount, const char *outputPath, mergeReport_t *report);
+/// Prints a merge report
+void mergePrintReport(const mergeReport_t *report);
+
+#endif /// PAYRANGE_MERGE_H
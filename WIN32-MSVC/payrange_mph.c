@@ -0,0 +1,348 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_mph.c
+///-----------------------------------------------------------------------------
+///
+/// \brief Minimal perfect hash (BBHash)
+///
+/// Level 0 is a bit array of about MPH_GAMMA_PERCENT / 100 bits per key.
+/// Every key hashes to one bit; a bit hit by exactly one key is set and that
+/// key is placed, the keys that collided move on to the next, smaller level
+/// with another hash. A key's slot is the number of set bits before its bit
+/// across all levels, counted in constant time from a rank sampled every
+/// MPH_RANK_WORDS words. A key of the set is placed at the first level where
+/// its bit is set, since a bit hit by two keys is left clear, so a lookup
+/// walks the levels until it finds a set bit: 1.6 levels on average.
+///
+/// With 2 bits per key per level, e^(-1/2) of the keys are placed at each
+/// level and the whole hash (bits and ranks) takes about 3.5 bits per key.
+///
+/// File layout, host byte order: keys, levels, fallback count, words per
+/// level, the words, then the fallback keys.
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+
+/// Standard includes
+#include <stdlib.h>
+#include <string.h>
+
+#include "payrange_mph.h"
+
+///-----------------------------------------------------------
+/// \brief Hash of a key at a level
+///
+/// @param1 int64_t key - key
+/// @param2 uint32_t level - level
+///
+/// @return uint64_t - hash
+///-----------------------------------------------------------
+static uint64_t mphHash(int64_t key, uint32_t level)
+{
+	uint64_t hash = (uint64_t)key ^ (0xD6E8FEB86659FD93ULL * (level + 1));
+
+	hash = (hash ^ (hash >> 32)) * 0xD6E8FEB86659FD93ULL;
+	hash = (hash ^ (hash >> 32)) * 0xD6E8FEB86659FD93ULL;
+	return hash ^ (hash >> 32);
+}
+
+///-----------------------------------------------------------
+/// \brief Counts the set bits of a word; x86 builds have no
+///        64-bit popcount instruction to rely on
+///
+/// @param1 uint64_t word - word
+///
+/// @return uint32_t - set bits
+///-----------------------------------------------------------
+static uint32_t mphPopCount(uint64_t word)
+{
+	word = word - ((word >> 1) & 0x5555555555555555ULL);
+	word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+	word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (uint32_t)((word * 0x0101010101010101ULL) >> 56);
+}
+
+///-----------------------------------------------------------
+/// \brief qsort comparator of keys
+///-----------------------------------------------------------
+static int mphCompareKeys(const void *left, const void *right)
+{
+	const int64_t a = *(const int64_t *)left;
+	const int64_t b = *(const int64_t *)right;
+
+	return (a < b) ? -1 : (a > b);
+}
+
+///-----------------------------------------------------------
+/// \brief Samples the set bits before every MPH_RANK_WORDS
+///        words
+///
+/// @param1 mph_t *mph - hash with its bits
+///
+/// @return int - 1 on success
+///-----------------------------------------------------------
+static int mphRank(mph_t *mph)
+{
+	const uint32_t samples = mph->words / MPH_RANK_WORDS + 1;
+	uint32_t total = 0;
+
+	mph->ranks = (uint32_t *)malloc(((size_t)samples + 1) * sizeof(uint32_t));
+	if (mph->ranks == NULL)
+	{
+		return 0;
+	}
+	for (uint32_t word = 0; word < mph->words; word++)
+	{
+		if ((word % MPH_RANK_WORDS) == 0)
+		{
+			mph->ranks[word / MPH_RANK_WORDS] = total;
+		}
+		total += mphPopCount(mph->bits[word]);
+	}
+	/// Slot of the first fallback key
+	mph->ranks[samples] = total;
+	return (total + mph->fallbackCount == mph->keys);
+}
+
+///-----------------------------------------------------------
+/// \brief Counts the set bits before a bit
+///
+/// @param1 const mph_t *mph - hash
+/// @param2 uint32_t word - word of the bit
+/// @param3 uint32_t bit - bit in the word
+///
+/// @return uint32_t - set bits before it
+///-----------------------------------------------------------
+static uint32_t mphRankOf(const mph_t *mph, uint32_t word, uint32_t bit)
+{
+	uint32_t rank = mph->ranks[word / MPH_RANK_WORDS];
+
+	for (uint32_t before = word - word % MPH_RANK_WORDS; before < word; before++)
+	{
+		rank += mphPopCount(mph->bits[before]);
+	}
+	return rank + mphPopCount(mph->bits[word] & ((1ULL << bit) - 1));
+}
+
+///-----------------------------------------------------------
+/// \brief Builds the hash of a set of distinct keys
+///
+/// @param1 mph_t *mph - output
+/// @param2 const int64_t *keys - keys
+/// @param3 uint32_t count - number of keys
+///
+/// @return int - 1 on success
+///-----------------------------------------------------------
+int mphBuild(mph_t *mph, const int64_t *keys, uint32_t count)
+{
+	/// Keys not placed yet; level bits are built in a collision array first
+	int64_t *remaining = (int64_t *)malloc(((size_t)count + 1) * sizeof(int64_t));
+	uint64_t *collisions = NULL;
+	uint32_t left = count;
+	int failed = 0;
+	int built = 0;
+
+	memset(mph, 0, sizeof(*mph));
+	mph->keys = count;
+	if (remaining == NULL)
+	{
+		return 0;
+	}
+	memcpy(remaining, keys, (size_t)count * sizeof(int64_t));
+
+	while ((left > 0) && (mph->levels < MPH_MAX_LEVELS))
+	{
+		const uint32_t level = mph->levels;
+		const uint32_t words = (uint32_t)(((uint64_t)left * MPH_GAMMA_PERCENT / 100 + 63) / 64);
+		const uint64_t bitCount = (uint64_t)words * 64;
+		uint64_t *grown = (uint64_t *)realloc(mph->bits, ((size_t)mph->words + words) * sizeof(uint64_t));
+		uint64_t *levelBits;
+		uint32_t kept = 0;
+
+		free(collisions);
+		collisions = (uint64_t *)calloc(words, sizeof(uint64_t));
+		if (grown != NULL)
+		{
+			mph->bits = grown;
+		}
+		if ((grown == NULL) || (collisions == NULL))
+		{
+			failed = 1;
+			break;
+		}
+		levelBits = mph->bits + mph->words;
+		memset(levelBits, 0, (size_t)words * sizeof(uint64_t));
+
+		for (uint32_t i = 0; i < left; i++)
+		{
+			const uint64_t bit = mphHash(remaining[i], level) % bitCount;
+			const uint64_t mask = 1ULL << (bit & 63);
+
+			if (levelBits[bit >> 6] & mask)
+			{
+				collisions[bit >> 6] |= mask;
+			}
+			levelBits[bit >> 6] |= mask;
+		}
+		for (uint32_t word = 0; word < words; word++)
+		{
+			levelBits[word] &= ~collisions[word];
+		}
+		/// The keys whose bit was cleared try the next level
+		for (uint32_t i = 0; i < left; i++)
+		{
+			const uint64_t bit = mphHash(remaining[i], level) % bitCount;
+
+			if ((levelBits[bit >> 6] & (1ULL << (bit & 63))) == 0)
+			{
+				remaining[kept++] = remaining[i];
+			}
+		}
+
+		mph->levelStart[level] = mph->words;
+		mph->levelWords[level] = words;
+		mph->words += words;
+		mph->levels++;
+		left = kept;
+	}
+	free(collisions);
+
+	if (!failed)
+	{
+		qsort(remaining, left, sizeof(int64_t), mphCompareKeys);
+		mph->fallbackCount = left;
+		mph->fallback = remaining;
+		remaining = NULL;
+		built = mphRank(mph);
+	}
+	free(remaining);
+	if (!built)
+	{
+		mphFree(mph);
+	}
+	return built;
+}
+
+///-----------------------------------------------------------
+/// \brief Slot of a key of the set
+///
+/// @param1 const mph_t *mph - hash
+/// @param2 int64_t key - key
+///
+/// @return uint32_t - slot, MPH_NOT_FOUND if no level holds it
+///-----------------------------------------------------------
+uint32_t mphLookup(const mph_t *mph, int64_t key)
+{
+	uint32_t low = 0;
+	uint32_t high = mph->fallbackCount;
+
+	for (uint32_t level = 0; level < mph->levels; level++)
+	{
+		const uint64_t bit = mphHash(key, level) % ((uint64_t)mph->levelWords[level] * 64);
+		const uint32_t word = mph->levelStart[level] + (uint32_t)(bit >> 6);
+
+		if (mph->bits[word] & (1ULL << (bit & 63)))
+		{
+			return mphRankOf(mph, word, (uint32_t)(bit & 63));
+		}
+	}
+	while (low < high)
+	{
+		const uint32_t middle = low + (high - low) / 2;
+
+		if (mph->fallback[middle] < key)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	if ((low < mph->fallbackCount) && (mph->fallback[low] == key))
+	{
+		return mph->ranks[mph->words / MPH_RANK_WORDS + 1] + low;
+	}
+	return MPH_NOT_FOUND;
+}
+
+///-----------------------------------------------------------
+/// \brief Appends the hash to a file
+///
+/// @param1 const mph_t *mph - hash
+/// @param2 FILE *file - output
+///
+/// @return int - 1 on success
+///-----------------------------------------------------------
+int mphWrite(const mph_t *mph, FILE *file)
+{
+	fwrite(&mph->keys, sizeof(uint32_t), 1, file);
+	fwrite(&mph->levels, sizeof(uint32_t), 1, file);
+	fwrite(&mph->fallbackCount, sizeof(uint32_t), 1, file);
+	fwrite(mph->levelWords, sizeof(uint32_t), mph->levels, file);
+	fwrite(mph->bits, sizeof(uint64_t), mph->words, file);
+	fwrite(mph->fallback, sizeof(int64_t), mph->fallbackCount, file);
+	return !ferror(file);
+}
+
+///-----------------------------------------------------------
+/// \brief Reads a hash written by mphWrite()
+///
+/// @param1 mph_t *mph - output
+/// @param2 FILE *file - input, at the hash
+///
+/// @return int - 1 on success
+///-----------------------------------------------------------
+int mphRead(mph_t *mph, FILE *file)
+{
+	memset(mph, 0, sizeof(*mph));
+	if ((fread(&mph->keys, sizeof(uint32_t), 1, file) != 1) || (fread(&mph->levels, sizeof(uint32_t), 1, file) != 1) ||
+		(fread(&mph->fallbackCount, sizeof(uint32_t), 1, file) != 1) || (mph->levels > MPH_MAX_LEVELS) ||
+		(mph->fallbackCount > mph->keys) ||
+		(fread(mph->levelWords, sizeof(uint32_t), mph->levels, file) != mph->levels))
+	{
+		return 0;
+	}
+	for (uint32_t level = 0; level < mph->levels; level++)
+	{
+		mph->levelStart[level] = mph->words;
+		mph->words += mph->levelWords[level];
+	}
+	mph->bits = (uint64_t *)malloc(((size_t)mph->words + 1) * sizeof(uint64_t));
+	mph->fallback = (int64_t *)malloc(((size_t)mph->fallbackCount + 1) * sizeof(int64_t));
+	if ((mph->bits == NULL) || (mph->fallback == NULL) ||
+		(fread(mph->bits, sizeof(uint64_t), mph->words, file) != mph->words) ||
+		(fread(mph->fallback, sizeof(int64_t), mph->fallbackCount, file) != mph->fallbackCount) || !mphRank(mph))
+	{
+		mphFree(mph);
+		return 0;
+	}
+	return 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Bytes of RAM held by the hash
+///
+/// @param1 const mph_t *mph - hash
+///
+/// @return uint64_t - bytes
+///-----------------------------------------------------------
+uint64_t mphSizeBytes(const mph_t *mph)
+{
+	return (uint64_t)mph->words * sizeof(uint64_t) + ((uint64_t)mph->words / MPH_RANK_WORDS + 2) * sizeof(uint32_t) +
+		(uint64_t)mph->fallbackCount * sizeof(int64_t);
+}
+
+///-----------------------------------------------------------
+/// \brief Frees the hash
+///
+/// @param1 mph_t *mph - hash
+///
+/// @return N/A
+///-----------------------------------------------------------
+void mphFree(mph_t *mph)
+{
+	free(mph->bits);
+	free(mph->ranks);
+	free(mph->fallback);
+	memset(mph, 0, sizeof(*mph));
+}
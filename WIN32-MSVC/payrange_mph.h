@@ -0,0 +1,58 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_mph.h
+///-----------------------------------------------------------------------------
+///
+/// \brief Minimal perfect hash of a static set of 64-bit keys (BBHash): maps
+///        each of n keys to its own slot in [0, n) in about 3.5 bits per key
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_MPH_H
+#define PAYRANGE_MPH_H
+
+/// Standard includes
+#include <stdint.h>
+#include <stdio.h>
+
+/// Minimal perfect hash configurable defines
+/// Bits per key of each level, in percent; more is faster to build and
+/// query, less is smaller
+#define MPH_GAMMA_PERCENT               ( 200 )
+/// Keys still colliding after this many levels are kept in a sorted list
+#define MPH_MAX_LEVELS                  ( 24 )
+/// Words per rank sample: 8 keeps the ranks at 1/16 of the bits
+#define MPH_RANK_WORDS                  ( 8 )
+/// Returned for a key that was not in the set (other such keys get any slot)
+#define MPH_NOT_FOUND                   ( 0xFFFFFFFFu )
+
+/// Minimal perfect hash
+typedef struct
+{
+	uint32_t keys;
+	uint32_t levels;
+	/// First word and word count of each level in bits
+	uint32_t levelStart[MPH_MAX_LEVELS];
+	uint32_t levelWords[MPH_MAX_LEVELS];
+	uint32_t words;
+	uint64_t *bits;
+	/// Set bits before every MPH_RANK_WORDS words
+	uint32_t *ranks;
+	/// Keys no level could place, sorted; they take the last slots
+	uint32_t fallbackCount;
+	int64_t  *fallback;
+}mph_t;
+
+/// Builds the hash of count distinct keys; returns 1 on success
+int mphBuild(mph_t *mph, const int64_t *keys, uint32_t count);
+/// Slot of a key of the set
+uint32_t mphLookup(const mph_t *mph, int64_t key);
+/// Appends the hash to a file; returns 1 on success
+int mphWrite(const mph_t *mph, FILE *file);
+/// Reads a hash written by mphWrite(); returns 1 on success
+int mphRead(mph_t *mph, FILE *file);
+/// Bytes of RAM held by the hash
+uint64_t mphSizeBytes(const mph_t *mph);
+/// Frees the hash
+void mphFree(mph_t *mph);
+
+#endif /// PAYRANGE_MPH_H
@@ -0,0 +1,394 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_mvcc.c
+///-----------------------------------------------------------------------------
+///
+/// \brief Versioned B list and List F
+///
+/// Every slot of both lists has a ring of its last versions, each stamped
+/// with the extended tick it was stored at. Storing a value writes the next
+/// ring entry and publishes the new version count under the slot's sequence
+/// lock: a few copies, and the writer (Task B or the E writer) never waits
+/// for a reader. The ticks of a slot only grow, so the version current at a
+/// tick T is found by a binary search of the ring, and the state of a whole
+/// list at T takes one search per slot. The list sizes are versioned the
+/// same way, as two more slots.
+///
+/// Retention is bounded by the ring depths: once a slot's ring wraps, ticks
+/// before its oldest version are answered as expired rather than guessed.
+/// Versions live in RAM only; the values in the state file are recorded as
+/// of tick 0 at start-up, ticks starting over with every run.
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+
+/// Standard includes
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+/// Kernel includes
+#include <FreeRTOS.h>
+
+#include "payrange_mvcc.h"
+#include "payrange_atomic.h"
+#include "payrange_time.h"
+
+/// The list sizes, one slot per list
+#define MVCC_SIZES                      ( MVCC_LISTS )
+
+/// Version rings of a list, slot after slot
+typedef struct
+{
+	uint32_t           slots;
+	uint32_t           depth;
+	uint32_t           valueSize;
+	seqlock_t         *locks;
+	/// Versions stored per slot; the newest is number written - 1
+	volatile uint32_t *written;
+	uint64_t          *ticks;
+	uint8_t           *values;
+	uint32_t           versions;
+}mvccList_t;
+
+static seqlock_t mvccBLocks[MAX_SIZE_OF_THE_TASK_B_ARRAY];
+static volatile uint32_t mvccBWritten[MAX_SIZE_OF_THE_TASK_B_ARRAY];
+static uint64_t mvccBTicks[MAX_SIZE_OF_THE_TASK_B_ARRAY * MVCC_B_VERSIONS];
+static taskBStructure_t mvccBValues[MAX_SIZE_OF_THE_TASK_B_ARRAY * MVCC_B_VERSIONS];
+
+static seqlock_t mvccFLocks[MAX_SIZE_OF_VALUE_E_STRUCTURE];
+static volatile uint32_t mvccFWritten[MAX_SIZE_OF_VALUE_E_STRUCTURE];
+static uint64_t mvccFTicks[MAX_SIZE_OF_VALUE_E_STRUCTURE * MVCC_F_VERSIONS];
+static valueE_t mvccFValues[MAX_SIZE_OF_VALUE_E_STRUCTURE * MVCC_F_VERSIONS];
+
+static seqlock_t mvccSizeLocks[MVCC_LISTS];
+static volatile uint32_t mvccSizeWritten[MVCC_LISTS];
+static uint64_t mvccSizeTicks[MVCC_LISTS * MVCC_SIZE_VERSIONS];
+static uint32_t mvccSizeValues[MVCC_LISTS * MVCC_SIZE_VERSIONS];
+
+static mvccList_t mvccLists[MVCC_LISTS + 1] =
+{
+	{ MAX_SIZE_OF_THE_TASK_B_ARRAY, MVCC_B_VERSIONS, sizeof(taskBStructure_t), mvccBLocks, mvccBWritten,
+		mvccBTicks, (uint8_t *)mvccBValues, 0 },
+	{ MAX_SIZE_OF_VALUE_E_STRUCTURE, MVCC_F_VERSIONS, sizeof(valueE_t), mvccFLocks, mvccFWritten,
+		mvccFTicks, (uint8_t *)mvccFValues, 0 },
+	{ MVCC_LISTS, MVCC_SIZE_VERSIONS, sizeof(uint32_t), mvccSizeLocks, mvccSizeWritten,
+		mvccSizeTicks, (uint8_t *)mvccSizeValues, 0 }
+};
+
+///-----------------------------------------------------------
+/// \brief Stores a version of a slot. One writer per slot.
+///
+/// @param1 mvccList_t *list - list
+/// @param2 uint32_t slot - slot
+/// @param3 uint64_t tick - extended tick of the change
+/// @param4 const void *value - new value, NULL for an empty slot
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void mvccStore(mvccList_t *list, uint32_t slot, uint64_t tick, const void *value)
+{
+	const uint32_t number = list->written[slot];
+	const uint32_t index = slot * list->depth + (number & (list->depth - 1));
+
+	configASSERT(slot < list->slots);
+	seqlockWriteBegin(&list->locks[slot]);
+	list->ticks[index] = tick;
+	if (value != NULL)
+	{
+		memcpy(list->values + (size_t)index * list->valueSize, value, list->valueSize);
+	}
+	else
+	{
+		memset(list->values + (size_t)index * list->valueSize, 0, list->valueSize);
+	}
+	list->written[slot] = number + 1;
+	seqlockWriteEnd(&list->locks[slot]);
+	list->versions++;
+}
+
+///-----------------------------------------------------------
+/// \brief Finds the version of a slot current at a tick: the
+///        last one stored at or before it
+///
+/// @param1 const mvccList_t *list - list
+/// @param2 uint32_t slot - slot
+/// @param3 uint64_t tick - extended tick
+/// @param4 void *value - output, zeroed unless a version is found
+///
+/// @return mvccSlotState_t - MVCC_SLOT_VALUE when a version is found
+///-----------------------------------------------------------
+static mvccSlotState_t mvccFind(const mvccList_t *list, uint32_t slot, uint64_t tick, void *value)
+{
+	const uint64_t *ticks = list->ticks + (size_t)slot * list->depth;
+	const uint32_t mask = list->depth - 1;
+	mvccSlotState_t state;
+	uint32_t sequence;
+
+	do
+	{
+		uint32_t number;
+		uint32_t low;
+		uint32_t high;
+
+		sequence = seqlockReadBegin(&list->locks[slot]);
+		number = list->written[slot];
+		low = (number > list->depth) ? (number - list->depth) : 0;
+		high = number;
+		memset(value, 0, list->valueSize);
+		if ((number == 0) || (ticks[low & mask] > tick))
+		{
+			/// Before the first version the slot was empty; before the oldest
+			/// one kept it held something that was dropped
+			state = (low == 0) ? MVCC_SLOT_EMPTY : MVCC_SLOT_EXPIRED;
+			continue;
+		}
+		/// ticks[low] <= tick < ticks[high], high past the newest
+		while (high - low > 1)
+		{
+			const uint32_t middle = low + (high - low) / 2;
+
+			if (ticks[middle & mask] <= tick)
+			{
+				low = middle;
+			}
+			else
+			{
+				high = middle;
+			}
+		}
+		memcpy(value, list->values + ((size_t)slot * list->depth + (low & mask)) * list->valueSize, list->valueSize);
+		state = MVCC_SLOT_VALUE;
+	} while (seqlockReadRetry(&list->locks[slot], sequence));
+	return state;
+}
+
+///-----------------------------------------------------------
+/// \brief Records the lists as of tick 0
+///
+/// @param1 const taskBStructure_t *taskB - B list
+/// @param2 uint32_t taskBSlots - B list slots in use
+/// @param3 const valueE_t *valueE - List F
+/// @param4 uint32_t valueESlots - List F slots
+///
+/// @return N/A
+///-----------------------------------------------------------
+void mvccInit(const taskBStructure_t *taskB, uint32_t taskBSlots, const valueE_t *valueE, uint32_t valueESlots)
+{
+	for (uint32_t slot = 0; slot < taskBSlots; slot++)
+	{
+		if (taskB[slot].stringTime != 0)
+		{
+			mvccStore(&mvccLists[MVCC_LIST_B], slot, 0, &taskB[slot]);
+		}
+	}
+	for (uint32_t slot = 0; slot < valueESlots; slot++)
+	{
+		if (valueE[slot].randomValueB.stringTime != 0)
+		{
+			mvccStore(&mvccLists[MVCC_LIST_F], slot, 0, &valueE[slot]);
+		}
+	}
+	mvccStore(&mvccLists[MVCC_SIZES], MVCC_LIST_B, 0, &taskBSlots);
+	mvccStore(&mvccLists[MVCC_SIZES], MVCC_LIST_F, 0, &valueESlots);
+}
+
+///-----------------------------------------------------------
+/// \brief Records a B slot value. Task B only.
+///
+/// @param1 uint32_t slot - B list slot
+/// @param2 const taskBStructure_t *value - value, NULL if emptied
+///
+/// @return N/A
+///-----------------------------------------------------------
+void mvccRecordB(uint32_t slot, const taskBStructure_t *value)
+{
+	mvccStore(&mvccLists[MVCC_LIST_B], slot, timeNowTick64(), value);
+}
+
+///-----------------------------------------------------------
+/// \brief Records a List F slot value. E writer only.
+///
+/// @param1 uint32_t slot - List F slot
+/// @param2 const valueE_t *value - value E, NULL if dropped
+///
+/// @return N/A
+///-----------------------------------------------------------
+void mvccRecordF(uint32_t slot, const valueE_t *value)
+{
+	mvccStore(&mvccLists[MVCC_LIST_F], slot, timeNowTick64(), value);
+}
+
+///-----------------------------------------------------------
+/// \brief Records a new list size
+///
+/// @param1 uint32_t list - MVCC_LIST_B or MVCC_LIST_F
+/// @param2 uint32_t slots - slots in use from now on
+///
+/// @return N/A
+///-----------------------------------------------------------
+void mvccRecordSlots(uint32_t list, uint32_t slots)
+{
+	configASSERT(list < MVCC_LISTS);
+	mvccStore(&mvccLists[MVCC_SIZES], list, timeNowTick64(), &slots);
+}
+
+///-----------------------------------------------------------
+/// \brief Size of a list at a tick
+///
+/// @param1 uint32_t list - MVCC_LIST_B or MVCC_LIST_F
+/// @param2 uint64_t tick - extended tick
+///
+/// @return uint32_t - slots in use, 0 if that size expired
+///-----------------------------------------------------------
+uint32_t mvccSlotsAt(uint32_t list, uint64_t tick)
+{
+	uint32_t slots;
+
+	configASSERT(list < MVCC_LISTS);
+	mvccFind(&mvccLists[MVCC_SIZES], list, tick, &slots);
+	return slots;
+}
+
+///-----------------------------------------------------------
+/// \brief Value of a B slot at a tick
+///
+/// @param1 uint32_t slot - B list slot
+/// @param2 uint64_t tick - extended tick
+/// @param3 taskBStructure_t *value - output
+///
+/// @return mvccSlotState_t - state of the slot
+///-----------------------------------------------------------
+mvccSlotState_t mvccBAt(uint32_t slot, uint64_t tick, taskBStructure_t *value)
+{
+	const mvccSlotState_t state = mvccFind(&mvccLists[MVCC_LIST_B], slot, tick, value);
+
+	/// An emptied slot is stored as a zero value
+	return ((state == MVCC_SLOT_VALUE) && (value->stringTime == 0)) ? MVCC_SLOT_EMPTY : state;
+}
+
+///-----------------------------------------------------------
+/// \brief Value of a List F slot at a tick
+///
+/// @param1 uint32_t slot - List F slot
+/// @param2 uint64_t tick - extended tick
+/// @param3 valueE_t *value - output
+///
+/// @return mvccSlotState_t - state of the slot
+///-----------------------------------------------------------
+mvccSlotState_t mvccFAt(uint32_t slot, uint64_t tick, valueE_t *value)
+{
+	const mvccSlotState_t state = mvccFind(&mvccLists[MVCC_LIST_F], slot, tick, value);
+
+	return ((state == MVCC_SLOT_VALUE) && (value->randomValueB.stringTime == 0)) ? MVCC_SLOT_EMPTY : state;
+}
+
+///-----------------------------------------------------------
+/// \brief Copies the counters of a list
+///
+/// @param1 uint32_t list - MVCC_LIST_B or MVCC_LIST_F
+/// @param2 mvccStats_t *stats - output
+///
+/// @return N/A
+///-----------------------------------------------------------
+void mvccGetStats(uint32_t list, mvccStats_t *stats)
+{
+	const mvccList_t *versioned = &mvccLists[list];
+
+	configASSERT(list < MVCC_LISTS);
+	memset(stats, 0, sizeof(*stats));
+	stats->slots = mvccSlotsAt(list, UINT64_MAX);
+	stats->versions = versioned->versions;
+	for (uint32_t slot = 0; slot < versioned->slots; slot++)
+	{
+		const uint32_t number = versioned->written[slot];
+
+		if (number > versioned->depth)
+		{
+			/// The oldest kept version; a racing store only moves it later
+			const uint64_t oldest = versioned->ticks[slot * versioned->depth + (number & (versioned->depth - 1))];
+
+			stats->retained += versioned->depth;
+			if (oldest > stats->horizon)
+			{
+				stats->horizon = oldest;
+			}
+		}
+		else
+		{
+			stats->retained += number;
+		}
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Prints both lists as they were at a tick
+///
+/// @param1 TickType_t tick - tick, within 2^31 ticks of now
+///
+/// @return N/A
+///-----------------------------------------------------------
+void mvccPrintStateAt(TickType_t tick)
+{
+	const uint64_t extended = timeExtendTick(tick);
+	const uint32_t taskBSlots = mvccSlotsAt(MVCC_LIST_B, extended);
+	const uint32_t valueESlots = mvccSlotsAt(MVCC_LIST_F, extended);
+	uint32_t emptyF = 0;
+	taskBStructure_t valueB;
+	valueE_t valueE;
+	mvccStats_t stats;
+
+	printf("State at tick %u:\n", (unsigned int)tick);
+	if (taskBSlots == 0)
+	{
+		printf("B list: size at that tick no longer kept\n");
+	}
+	for (uint32_t slot = 0; slot < taskBSlots; slot++)
+	{
+		switch (mvccBAt(slot, extended, &valueB))
+		{
+			case MVCC_SLOT_VALUE:
+				printf("  B[%u] = %s, B Time = %u\n", (unsigned int)slot, valueB.stringPlacer,
+					(unsigned int)valueB.stringTime);
+				break;
+			case MVCC_SLOT_EMPTY:
+				printf("  B[%u] empty\n", (unsigned int)slot);
+				break;
+			default:
+				printf("  B[%u] no longer kept\n", (unsigned int)slot);
+				break;
+		}
+	}
+	if (valueESlots == 0)
+	{
+		printf("List F: size at that tick no longer kept\n");
+	}
+	for (uint32_t slot = 0; slot < valueESlots; slot++)
+	{
+		switch (mvccFAt(slot, extended, &valueE))
+		{
+			case MVCC_SLOT_VALUE:
+				printf("  F[%u] = A %" PRId64 " (D Time = %u) paired with B %s (B Time = %u)\n", (unsigned int)slot,
+					valueE.currentValueD.randomNumber, (unsigned int)valueE.currentValueD.randomNumberTime,
+					valueE.randomValueB.stringPlacer, (unsigned int)valueE.randomValueB.stringTime);
+				break;
+			case MVCC_SLOT_EMPTY:
+				emptyF++;
+				break;
+			default:
+				printf("  F[%u] no longer kept\n", (unsigned int)slot);
+				break;
+		}
+	}
+	if (emptyF > 0)
+	{
+		printf("  %u List F slots empty\n", (unsigned int)emptyF);
+	}
+
+	for (uint32_t list = 0; list < MVCC_LISTS; list++)
+	{
+		mvccGetStats(list, &stats);
+		printf("%s: %u versions stored, %u kept, complete from extended tick %" PRIu64 "\n",
+			(list == MVCC_LIST_B) ? "B list" : "List F", (unsigned int)stats.versions, (unsigned int)stats.retained,
+			stats.horizon);
+	}
+}
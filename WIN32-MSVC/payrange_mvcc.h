@@ -0,0 +1,80 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_mvcc.h
+///-----------------------------------------------------------------------------
+///
+/// \brief Versioned B list and List F: every slot keeps its recent values
+///        with the tick each was stored at, so the state of both lists at a
+///        past tick can be read back
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_MVCC_H
+#define PAYRANGE_MVCC_H
+
+/// Standard includes
+#include <stdint.h>
+
+/// Kernel includes
+#include <FreeRTOS.h>
+
+#include "payrange.h"
+
+/// Versioned lists configurable defines
+/// Versions kept per slot, powers of two; a B slot is replaced every
+/// SIZE_OF_THE_TASK_B_ARRAY B periods on average, so 64 versions go back
+/// about 25 minutes at the default settings
+#define MVCC_B_VERSIONS                 ( 64 )
+#define MVCC_F_VERSIONS                 ( 16 )
+/// Versions kept of each list size
+#define MVCC_SIZE_VERSIONS              ( 32 )
+
+/// The lists
+#define MVCC_LIST_B                     ( 0 )
+#define MVCC_LIST_F                     ( 1 )
+#define MVCC_LISTS                      ( 2 )
+
+/// State of a slot at a past tick
+typedef enum
+{
+	/// The slot held a value
+	MVCC_SLOT_VALUE = 0,
+	/// The slot was empty
+	MVCC_SLOT_EMPTY,
+	/// The versions that old were dropped, the state is not known
+	MVCC_SLOT_EXPIRED
+}mvccSlotState_t;
+
+/// Version counters of a list
+typedef struct
+{
+	uint32_t slots;
+	/// Versions stored since start-up and versions still kept
+	uint32_t versions;
+	uint32_t retained;
+	/// Extended tick of the oldest version every slot still has, so any
+	/// tick from there on can be answered in full
+	uint64_t horizon;
+}mvccStats_t;
+
+/// Records the current B list and List F as of tick 0; call once after
+/// configInit() and before the scheduler starts
+void mvccInit(const taskBStructure_t *taskB, uint32_t taskBSlots, const valueE_t *valueE, uint32_t valueESlots);
+/// Task B: records a B slot value, NULL when the slot was emptied
+void mvccRecordB(uint32_t slot, const taskBStructure_t *value);
+/// E writer: records a List F slot value, NULL when a shrink dropped it
+void mvccRecordF(uint32_t slot, const valueE_t *value);
+/// Records a new size of list MVCC_LIST_B or MVCC_LIST_F; each list size
+/// has one writer, the one that stores its values
+void mvccRecordSlots(uint32_t list, uint32_t slots);
+/// Size of a list at tick (extended, payrange_time.h); 0 if it expired
+uint32_t mvccSlotsAt(uint32_t list, uint64_t tick);
+/// Value of a B slot at tick; the value is zeroed unless MVCC_SLOT_VALUE
+mvccSlotState_t mvccBAt(uint32_t slot, uint64_t tick, taskBStructure_t *value);
+/// Value of a List F slot at tick; the value is zeroed unless MVCC_SLOT_VALUE
+mvccSlotState_t mvccFAt(uint32_t slot, uint64_t tick, valueE_t *value);
+/// Copies the counters of a list
+void mvccGetStats(uint32_t list, mvccStats_t *stats);
+/// Prints both lists as they were at a tick
+void mvccPrintStateAt(TickType_t tick);
+
+#endif /// PAYRANGE_MVCC_H
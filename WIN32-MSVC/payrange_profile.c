@@ -0,0 +1,421 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_profile.c
+///-----------------------------------------------------------------------------
+///
+/// \brief Sampling profiler
+///
+/// In the simulator every FreeRTOS task is a host thread and only the one
+/// the kernel selected runs, so a host profiler sees anonymous threads. Here
+/// a plain host thread (not a FreeRTOS task, the kernel never suspends it)
+/// wakes every PROFILE_INTERVAL_MS, asks the kernel which task is current,
+/// suspends that task's thread, takes its registers, walks the frame
+/// pointer chain and resumes it. The sample is stored under the task so the
+/// folded output starts every stack with the task name.
+///
+/// While the task thread is suspended the sampler only makes kernel calls
+/// (GetThreadContext, ReadProcessMemory): the thread may hold a CRT or heap
+/// lock, so anything that could take one would deadlock. Symbols are only
+/// resolved when the profile is written.
+///
+/// The thread of a task is found the way the Win32 port finds it: the first
+/// TCB member points at the port's xThreadState, whose first member is the
+/// thread handle. The stack walk follows EBP, so it is complete in builds
+/// with frame pointers (Debug); optimized frames show up truncated.
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+
+/// Standard includes
+#include <stdio.h>
+#include <string.h>
+
+/// Kernel includes
+#include <FreeRTOS.h>
+#include <task.h>
+
+/// Host includes
+#include <dbghelp.h>
+
+#include "payrange_profile.h"
+
+/// One distinct stack and how often it was sampled
+typedef struct
+{
+	uint32_t count;
+	uint16_t task;
+	uint16_t depth;
+	uint32_t hash;
+	/// Innermost frame first
+	uintptr_t frames[PROFILE_MAX_DEPTH];
+}profileStack_t;
+
+/// One task seen by the sampler
+typedef struct
+{
+	TaskHandle_t handle;
+	uint32_t     samples;
+	char         name[configMAX_TASK_NAME_LEN];
+}profileTask_t;
+
+/// Samples, written by the sampler thread only while it runs
+static profileStack_t profileStacks[PROFILE_MAX_STACKS];
+static profileTask_t profileTasks[PROFILE_MAX_TASKS];
+static uint32_t profileTaskCount;
+static uint32_t profileSamples;
+static uint32_t profileDropped;
+/// Sampler thread
+static HANDLE profileThread = NULL;
+static volatile LONG profileRunning = 0;
+
+///-----------------------------------------------------------
+/// \brief Finds the sampler entry of a task, adding it on its
+///        first sample
+///
+/// @param1 TaskHandle_t handle - task
+///
+/// @return int - index, -1 when the table is full
+///-----------------------------------------------------------
+static int profileFindTask(TaskHandle_t handle)
+{
+	for (uint32_t i = 0; i < profileTaskCount; i++)
+	{
+		if (profileTasks[i].handle == handle)
+		{
+			return (int)i;
+		}
+	}
+	if (profileTaskCount == PROFILE_MAX_TASKS)
+	{
+		return -1;
+	}
+	profileTasks[profileTaskCount].handle = handle;
+	profileTasks[profileTaskCount].samples = 0;
+	strncpy(profileTasks[profileTaskCount].name, pcTaskGetTaskName(handle), configMAX_TASK_NAME_LEN - 1);
+	profileTasks[profileTaskCount].name[configMAX_TASK_NAME_LEN - 1] = '\0';
+	return (int)profileTaskCount++;
+}
+
+///-----------------------------------------------------------
+/// \brief Takes the stack of a suspended thread
+///
+/// @param1 HANDLE thread - suspended thread
+/// @param2 uintptr_t *frames - PROFILE_MAX_DEPTH return addresses
+///
+/// @return int - frames taken, 0 on failure
+///-----------------------------------------------------------
+static int profileWalkStack(HANDLE thread, uintptr_t *frames)
+{
+	CONTEXT context;
+	uintptr_t framePointer;
+	int depth = 0;
+
+	memset(&context, 0, sizeof(context));
+	context.ContextFlags = CONTEXT_CONTROL | CONTEXT_INTEGER;
+	if (!GetThreadContext(thread, &context))
+	{
+		return 0;
+	}
+#if defined(_M_IX86) || defined(__i386__)
+	frames[depth++] = (uintptr_t)context.Eip;
+	framePointer = (uintptr_t)context.Ebp;
+#else
+	frames[depth++] = (uintptr_t)context.Rip;
+	framePointer = (uintptr_t)context.Rbp;
+#endif
+
+	/// Each frame holds the caller's frame pointer and the return address
+	while ((depth < PROFILE_MAX_DEPTH) && (framePointer != 0))
+	{
+		uintptr_t frame[2];
+		SIZE_T bytesRead = 0;
+		if (!ReadProcessMemory(GetCurrentProcess(), (LPCVOID)framePointer, frame, sizeof(frame), &bytesRead) ||
+			(bytesRead != sizeof(frame)) || (frame[1] == 0))
+		{
+			break;
+		}
+		frames[depth++] = frame[1];
+		/// Stacks grow down; anything else is not a frame chain
+		if ((frame[0] <= framePointer) || (frame[0] - framePointer > 1024 * 1024))
+		{
+			break;
+		}
+		framePointer = frame[0];
+	}
+	return depth;
+}
+
+///-----------------------------------------------------------
+/// \brief Adds one sample to the stack table
+///
+/// @param1 int task - sampler task index
+/// @param2 const uintptr_t *frames - stack
+/// @param3 int depth - frames in the stack
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void profileRecord(int task, const uintptr_t *frames, int depth)
+{
+	uint32_t hash = 2166136261u ^ (uint32_t)task;
+	uint32_t slot;
+
+	for (int i = 0; i < depth; i++)
+	{
+		hash = (hash ^ (uint32_t)frames[i]) * 16777619u;
+	}
+	if (hash == 0)
+	{
+		hash = 1;
+	}
+
+	slot = hash % PROFILE_MAX_STACKS;
+	for (int probe = 0; probe < PROFILE_MAX_STACKS; probe++)
+	{
+		profileStack_t *stack = &profileStacks[slot];
+		if (stack->hash == 0)
+		{
+			stack->hash = hash;
+			stack->task = (uint16_t)task;
+			stack->depth = (uint16_t)depth;
+			memcpy(stack->frames, frames, (size_t)depth * sizeof(frames[0]));
+			stack->count = 1;
+			return;
+		}
+		if ((stack->hash == hash) && (stack->task == task) && (stack->depth == depth) &&
+			(memcmp(stack->frames, frames, (size_t)depth * sizeof(frames[0])) == 0))
+		{
+			stack->count++;
+			return;
+		}
+		slot = (slot + 1) % PROFILE_MAX_STACKS;
+	}
+	profileDropped++;
+}
+
+///-----------------------------------------------------------
+/// \brief Samples the running task once
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void profileSample(void)
+{
+	uintptr_t frames[PROFILE_MAX_DEPTH];
+	TaskHandle_t handle;
+	HANDLE thread;
+	int task, depth;
+
+	handle = xTaskGetCurrentTaskHandle();
+	if (handle == NULL)
+	{
+		return;
+	}
+	task = profileFindTask(handle);
+	if (task < 0)
+	{
+		profileDropped++;
+		return;
+	}
+	/// TCB -> port xThreadState -> thread handle, as in the Win32 port
+	thread = *(HANDLE *)(*(void **)handle);
+
+	if (SuspendThread(thread) == (DWORD)-1)
+	{
+		return;
+	}
+	depth = profileWalkStack(thread, frames);
+	ResumeThread(thread);
+
+	if (depth > 0)
+	{
+		profileSamples++;
+		profileTasks[task].samples++;
+		profileRecord(task, frames, depth);
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Sampler thread (host thread, not a FreeRTOS task)
+///
+/// @param1 LPVOID parameter - unused
+///
+/// @return DWORD - 0
+///-----------------------------------------------------------
+static DWORD WINAPI profileThreadFunction(LPVOID parameter)
+{
+	(void)parameter;
+
+	while (profileRunning)
+	{
+		Sleep(PROFILE_INTERVAL_MS);
+		profileSample();
+	}
+	return 0;
+}
+
+///-----------------------------------------------------------
+/// \brief Writes one symbolized frame
+///
+/// @param1 FILE *output - folded stack file
+/// @param2 uintptr_t address - code address
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void profileWriteFrame(FILE *output, uintptr_t address)
+{
+	char buffer[sizeof(SYMBOL_INFO) + MAX_SYM_NAME];
+	SYMBOL_INFO *symbol = (SYMBOL_INFO *)buffer;
+	DWORD64 displacement = 0;
+
+	memset(buffer, 0, sizeof(SYMBOL_INFO));
+	symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+	symbol->MaxNameLen = MAX_SYM_NAME;
+	if (SymFromAddr(GetCurrentProcess(), (DWORD64)address, &displacement, symbol))
+	{
+		fprintf(output, ";%s", symbol->Name);
+	}
+	else
+	{
+		fprintf(output, ";0x%p", (void *)address);
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Writes the folded stacks: one line per distinct
+///        stack, task name first, outermost frame to innermost,
+///        then the sample count
+///
+/// @param N/A
+///
+/// @return int - 1 if the file was written
+///-----------------------------------------------------------
+static int profileWriteFolded(void)
+{
+	static int symbolsLoaded = 0;
+	FILE *output = fopen(PROFILE_FILE_NAME, "w");
+
+	if (output == NULL)
+	{
+		return 0;
+	}
+	if (!symbolsLoaded)
+	{
+		SymSetOptions(SYMOPT_UNDNAME | SYMOPT_DEFERRED_LOADS);
+		symbolsLoaded = SymInitialize(GetCurrentProcess(), NULL, TRUE);
+	}
+
+	for (int i = 0; i < PROFILE_MAX_STACKS; i++)
+	{
+		const profileStack_t *stack = &profileStacks[i];
+		if (stack->hash == 0)
+		{
+			continue;
+		}
+		fprintf(output, "%s", profileTasks[stack->task].name);
+		for (int frame = stack->depth - 1; frame >= 0; frame--)
+		{
+			/// Return addresses point after the call, look up the call itself
+			profileWriteFrame(output, (frame == 0) ? stack->frames[frame] : (stack->frames[frame] - 1));
+		}
+		fprintf(output, " %u\n", (unsigned int)stack->count);
+	}
+	fclose(output);
+	return 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Starts sampling
+///
+/// @param N/A
+///
+/// @return int - 1 if the sampler runs
+///-----------------------------------------------------------
+int profileStart(void)
+{
+	if (profileRunning)
+	{
+		return 1;
+	}
+	memset(profileStacks, 0, sizeof(profileStacks));
+	profileTaskCount = 0;
+	profileSamples = 0;
+	profileDropped = 0;
+
+	/// The default host timer resolution is 15.6 ms
+	timeBeginPeriod(PROFILE_INTERVAL_MS);
+	profileRunning = 1;
+	profileThread = CreateThread(NULL, 0, profileThreadFunction, NULL, 0, NULL);
+	if (profileThread == NULL)
+	{
+		profileRunning = 0;
+		timeEndPeriod(PROFILE_INTERVAL_MS);
+		return 0;
+	}
+	/// Above the task threads, so samples are taken on time
+	SetThreadPriority(profileThread, THREAD_PRIORITY_HIGHEST);
+	return 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Stops sampling and reports
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+void profileStop(void)
+{
+	if (!profileRunning)
+	{
+		return;
+	}
+	profileRunning = 0;
+	WaitForSingleObject(profileThread, INFINITE);
+	CloseHandle(profileThread);
+	profileThread = NULL;
+	timeEndPeriod(PROFILE_INTERVAL_MS);
+
+	printf("Profile: %u samples, %u dropped, %s %s\n", (unsigned int)profileSamples, (unsigned int)profileDropped,
+		profileWriteFolded() ? "folded stacks in" : "could not write", PROFILE_FILE_NAME);
+	for (uint32_t i = 0; i < profileTaskCount; i++)
+	{
+		printf("  %-*s %6u samples %5.1f%%\n", configMAX_TASK_NAME_LEN, profileTasks[i].name,
+			(unsigned int)profileTasks[i].samples,
+			(profileSamples > 0) ? 100.0 * profileTasks[i].samples / profileSamples : 0.0);
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Starts or stops the profiler
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+void profileToggle(void)
+{
+	if (profileRunning)
+	{
+		profileStop();
+	}
+	else if (profileStart())
+	{
+		printf("Profile: sampling every %d ms, press P again to stop\n", PROFILE_INTERVAL_MS);
+	}
+	else
+	{
+		printf("Profile: the sampler thread could not be started\n");
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Tells whether the profiler is sampling
+///
+/// @param N/A
+///
+/// @return int - 1 while sampling
+///-----------------------------------------------------------
+int profileIsRunning(void)
+{
+	return (int)profileRunning;
+}
@@ -0,0 +1,33 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_profile.h
+///-----------------------------------------------------------------------------
+///
+/// \brief Sampling profiler: host stack samples attributed to the FreeRTOS
+///        task that was running, written as folded stacks for flame graphs
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_PROFILE_H
+#define PAYRANGE_PROFILE_H
+
+/// Profiler configurable defines
+#define PROFILE_FILE_NAME               "profile.folded"
+/// Sampling period; the host timer resolution is raised to match while running
+#define PROFILE_INTERVAL_MS             ( 1 )
+/// Frames kept per sample, innermost first
+#define PROFILE_MAX_DEPTH               ( 32 )
+/// Distinct stacks kept; samples of further stacks are counted as dropped
+#define PROFILE_MAX_STACKS              ( 4096 )
+/// Distinct tasks told apart
+#define PROFILE_MAX_TASKS               ( 32 )
+
+/// Starts sampling (clears the previous profile); returns 0 on failure
+int profileStart(void);
+/// Stops sampling, writes PROFILE_FILE_NAME and prints the samples per task
+void profileStop(void);
+/// Starts or stops the profiler
+void profileToggle(void);
+/// 1 while sampling
+int profileIsRunning(void);
+
+#endif /// PAYRANGE_PROFILE_H
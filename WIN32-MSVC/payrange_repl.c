@@ -0,0 +1,730 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_repl.c
+///-----------------------------------------------------------------------------
+///
+/// \brief E log shipping to a standby
+///
+/// The unit of replication is the sealed E log block: it is persisted, its
+/// Merkle seal lets the standby's copy be checked with --verify, and the
+/// block table locates any of them without scanning the log. A low priority
+/// shipper task connects to the standby (a second PayRange process started
+/// with --standby) over a non-blocking loopback socket, the way the ingest
+/// gateway runs its clients:
+///
+///     standby -> primary   replHello_t: the first line the standby needs
+///     primary -> standby   replBlockHeader_t + block text, per block
+///     standby -> primary   replAck_t, per block once it is on disk
+///
+/// Catch-up starts at the block holding the requested line, found by a
+/// binary search of the block table, and every sealed block from there on
+/// is shipped in order. Acknowledgements are pipelined: up to
+/// REPL_MAX_IN_FLIGHT blocks are sent ahead of them, and none counts past the
+/// last line shipped. A standby asking for a line past the end of this E log
+/// holds another log and is disconnected.
+///
+/// In async mode (repl_sync = 0 in the config file) the E writer never hears
+/// of the standby. In sync mode it seals the open block after each batch and
+/// waits, up to REPL_SYNC_TIMEOUT_MS, until the standby acknowledged every
+/// line of the batch; that makes blocks as small as the batches, and a
+/// batch waits at least one tick. Without a connected standby sync mode
+/// commits at once and counts the batch as unprotected.
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+
+/// Winsock must come before windows.h, which FreeRTOS.h pulls in
+#include <winsock2.h>
+#include <io.h>
+
+/// Standard includes
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+/// Kernel includes
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "payrange_repl.h"
+#include "payrange_elog.h"
+#include "payrange_critical.h"
+
+/// Shipper connection states
+#define REPL_DISCONNECTED               ( 0 )
+#define REPL_CONNECTING                 ( 1 )
+#define REPL_HANDSHAKE                  ( 2 )
+#define REPL_STREAMING                  ( 3 )
+
+/// Largest frame: header and block text
+#define REPL_MAX_FRAME                  ( sizeof(replBlockHeader_t) + ELOG_MAX_BLOCK_TEXT )
+/// Standby progress message, every this many blocks
+#define REPL_STANDBY_REPORT_BLOCKS      ( 100 )
+
+/// Shipper state, owned by the shipper task
+static SOCKET replSocket = INVALID_SOCKET;
+static int replState = REPL_DISCONNECTED;
+static TickType_t replDisconnectedAt = 0;
+/// Hello or acknowledgements received in part
+static uint8_t replReceived[sizeof(replHello_t) + REPL_MAX_IN_FLIGHT * sizeof(replAck_t)];
+static uint32_t replReceivedBytes = 0;
+/// Frame being sent
+static uint8_t replFrame[REPL_MAX_FRAME];
+static uint32_t replFrameLength = 0;
+static uint32_t replFrameSent = 0;
+static uint32_t replNextBlock = 0;
+static uint32_t replInFlight = 0;
+static uint32_t replAckedBlocks = 0;
+static uint32_t replPersistedBlocks = 0;
+static TickType_t replCaughtUpAt = 0;
+/// Lines below this one were shipped (or held by the standby already); an
+/// acknowledgement never counts for more
+static uint32_t replShippedLine = 0;
+/// Hello line of the last standby refused for being ahead of this E log
+static uint32_t replRefusedLine = UINT32_MAX;
+/// Read by the E writer in sync mode
+static volatile uint32_t replAckedLine = 0;
+static volatile int replConnected = 0;
+/// Counters, written by the shipper task (and the sync fields by the E writer)
+static replStats_t replCounters;
+
+///-----------------------------------------------------------
+/// \brief Drops the connection; the next attempt is made
+///        REPL_RECONNECT_INTERVAL_MS later
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void replClose(void)
+{
+	if (replConnected)
+	{
+		printf("Repl: standby disconnected at line %u\n", (unsigned int)replAckedLine);
+	}
+	if (replSocket != INVALID_SOCKET)
+	{
+		closesocket(replSocket);
+	}
+	replSocket = INVALID_SOCKET;
+	replState = REPL_DISCONNECTED;
+	replConnected = 0;
+	replCounters.connected = 0;
+	replReceivedBytes = 0;
+	replFrameLength = 0;
+	replFrameSent = 0;
+	replInFlight = 0;
+	replDisconnectedAt = xTaskGetTickCount();
+}
+
+///-----------------------------------------------------------
+/// \brief Starts a non-blocking connection to the standby
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void replConnect(void)
+{
+	struct sockaddr_in address;
+	u_long nonBlocking = 1;
+
+	replSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if ((replSocket == INVALID_SOCKET) || (ioctlsocket(replSocket, FIONBIO, &nonBlocking) != 0))
+	{
+		replClose();
+		return;
+	}
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(REPL_PORT);
+	if (connect(replSocket, (struct sockaddr *)&address, sizeof(address)) == 0)
+	{
+		replState = REPL_HANDSHAKE;
+	}
+	else if (WSAGetLastError() == WSAEWOULDBLOCK)
+	{
+		replState = REPL_CONNECTING;
+	}
+	else
+	{
+		replClose();
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Checks whether a pending connection completed
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void replCheckConnect(void)
+{
+	struct timeval noWait = { 0, 0 };
+	fd_set writable;
+	fd_set failed;
+
+	FD_ZERO(&writable);
+	FD_ZERO(&failed);
+	FD_SET(replSocket, &writable);
+	FD_SET(replSocket, &failed);
+	/// Winsock reports a refused connection in the exception set
+	if (select((int)replSocket + 1, NULL, &writable, &failed, &noWait) > 0)
+	{
+		if (FD_ISSET(replSocket, &failed))
+		{
+			replClose();
+		}
+		else if (FD_ISSET(replSocket, &writable))
+		{
+			replState = REPL_HANDSHAKE;
+		}
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Finds the sealed block holding a line
+///
+/// @param1 uint32_t line - line number
+/// @param2 uint32_t sealed - sealed blocks
+///
+/// @return uint32_t - block, sealed if no sealed block holds it
+///-----------------------------------------------------------
+static uint32_t replFindBlock(uint32_t line, uint32_t sealed)
+{
+	uint32_t low = 0;
+	uint32_t high = sealed;
+
+	while (low < high)
+	{
+		const uint32_t middle = low + (high - low) / 2;
+		elogBlockEntry_t entry;
+
+		if (elogReadBlockEntry(middle, &entry) && (entry.firstLine + entry.recordCount <= line))
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	return low;
+}
+
+///-----------------------------------------------------------
+/// \brief Takes the hello or the acknowledgements received
+///
+/// @param N/A
+///
+/// @return int - 1 if anything was received
+///-----------------------------------------------------------
+static int replReceive(void)
+{
+	uint32_t consumed = 0;
+	int received;
+
+	received = recv(replSocket, (char *)replReceived + replReceivedBytes,
+		(int)(sizeof(replReceived) - replReceivedBytes), 0);
+	if (received <= 0)
+	{
+		if ((received == 0) || (WSAGetLastError() != WSAEWOULDBLOCK))
+		{
+			replClose();
+		}
+		return 0;
+	}
+	replReceivedBytes += (uint32_t)received;
+
+	if ((replState == REPL_HANDSHAKE) && (replReceivedBytes >= sizeof(replHello_t)))
+	{
+		replHello_t hello;
+		elogBlockEntry_t last;
+		uint32_t persistedLine = 0;
+		uint32_t sealed;
+
+		memcpy(&hello, replReceived, sizeof(hello));
+		if (memcmp(hello.magic, REPL_MAGIC, sizeof(hello.magic)) != 0)
+		{
+			printf("Repl: 127.0.0.1:%d is not a PayRange standby\n", REPL_PORT);
+			replClose();
+			return 0;
+		}
+		consumed = sizeof(hello);
+		sealed = elogSealedBlocks();
+		if ((sealed > 0) && elogReadBlockEntry(sealed - 1, &last))
+		{
+			persistedLine = last.firstLine + last.recordCount;
+		}
+		if (hello.nextLine > persistedLine)
+		{
+			/// A standby of another or an older E log: shipping from its line
+			/// would append this log to it, and sync mode would count lines it
+			/// never got as acknowledged
+			if (hello.nextLine != replRefusedLine)
+			{
+				printf("Repl: the standby asks for line %u but this E log ends at line %u, start it on a new file\n",
+					(unsigned int)hello.nextLine, (unsigned int)persistedLine);
+				replRefusedLine = hello.nextLine;
+			}
+			replClose();
+			return 0;
+		}
+		replRefusedLine = UINT32_MAX;
+		replNextBlock = replFindBlock(hello.nextLine, sealed);
+		replAckedBlocks = replNextBlock;
+		replAckedLine = hello.nextLine;
+		replShippedLine = hello.nextLine;
+		replState = REPL_STREAMING;
+		replConnected = 1;
+		replCounters.connected = 1;
+		replCounters.connections++;
+		printf("Repl: standby connected, shipping from line %u (block %u)\n", (unsigned int)hello.nextLine,
+			(unsigned int)replNextBlock);
+	}
+	while ((replState == REPL_STREAMING) && (replReceivedBytes - consumed >= sizeof(replAck_t)))
+	{
+		replAck_t ack;
+
+		memcpy(&ack, replReceived + consumed, sizeof(ack));
+		consumed += sizeof(ack);
+		if (ack.nextLine > replShippedLine)
+		{
+			ack.nextLine = replShippedLine;
+		}
+		if (ack.nextLine > replAckedLine)
+		{
+			replAckedLine = ack.nextLine;
+		}
+		if ((ack.blockIndex < replNextBlock) && (ack.blockIndex + 1 > replAckedBlocks))
+		{
+			replAckedBlocks = ack.blockIndex + 1;
+		}
+		replInFlight -= (replInFlight > 0);
+		replCounters.blocksAcked++;
+	}
+	memmove(replReceived, replReceived + consumed, replReceivedBytes - consumed);
+	replReceivedBytes -= consumed;
+	return 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Reads the next sealed block into the frame buffer
+///        when the window allows
+///
+/// @param N/A
+///
+/// @return int - 1 if a frame was loaded
+///-----------------------------------------------------------
+static int replLoadFrame(void)
+{
+	replBlockHeader_t header;
+	elogBlockEntry_t entry;
+	size_t length;
+
+	if ((replFrameSent < replFrameLength) || (replInFlight >= REPL_MAX_IN_FLIGHT) ||
+		(replNextBlock >= elogSealedBlocks()))
+	{
+		return 0;
+	}
+	if (!elogReadBlockEntry(replNextBlock, &entry) ||
+		!elogReadBlock(replNextBlock, (char *)replFrame + sizeof(header), ELOG_MAX_BLOCK_TEXT, &length))
+	{
+		printf("Repl: block %u is not readable, retrying\n", (unsigned int)replNextBlock);
+		replClose();
+		return 0;
+	}
+	header.blockIndex = replNextBlock;
+	header.firstLine = entry.firstLine;
+	header.recordCount = entry.recordCount;
+	header.length = (uint32_t)length;
+	memcpy(replFrame, &header, sizeof(header));
+	replShippedLine = entry.firstLine + entry.recordCount;
+	replFrameLength = (uint32_t)(sizeof(header) + length);
+	replFrameSent = 0;
+	replNextBlock++;
+	replInFlight++;
+	replCounters.blocksShipped++;
+	return 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Sends what the socket takes of the current frame
+///
+/// @param N/A
+///
+/// @return int - 1 if anything was sent
+///-----------------------------------------------------------
+static int replSend(void)
+{
+	int sent;
+
+	if (replFrameSent == replFrameLength)
+	{
+		return 0;
+	}
+	sent = send(replSocket, (const char *)replFrame + replFrameSent, (int)(replFrameLength - replFrameSent), 0);
+	if (sent <= 0)
+	{
+		if (WSAGetLastError() != WSAEWOULDBLOCK)
+		{
+			replClose();
+		}
+		return 0;
+	}
+	replFrameSent += (uint32_t)sent;
+	replCounters.bytesShipped += (uint64_t)sent;
+	return 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Updates the lag counters
+///
+/// @param1 TickType_t now - current tick
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void replUpdateLag(TickType_t now)
+{
+	const uint32_t sealed = elogSealedBlocks();
+	const uint32_t ackedLine = replAckedLine;
+	elogBlockEntry_t entry;
+
+	if ((sealed != replPersistedBlocks) && (sealed > 0) && elogReadBlockEntry(sealed - 1, &entry))
+	{
+		replPersistedBlocks = sealed;
+		replCounters.persistedLine = entry.firstLine + entry.recordCount;
+	}
+	replCounters.ackedLine = ackedLine;
+	replCounters.lagLines = (replCounters.persistedLine > ackedLine) ? (replCounters.persistedLine - ackedLine) : 0;
+	replCounters.lagBlocks = (replPersistedBlocks > replAckedBlocks) ? (replPersistedBlocks - replAckedBlocks) : 0;
+	if (replCounters.lagLines == 0)
+	{
+		replCaughtUpAt = now;
+	}
+	replCounters.lagMs = (uint32_t)((TickType_t)(now - replCaughtUpAt) * portTICK_PERIOD_MS);
+}
+
+///-----------------------------------------------------------
+/// \brief Shipper task: keeps a connection to the standby and
+///        streams sealed blocks over it
+///
+/// @param 1 void *pvParameters - placeholder for FreeRTOS
+///                               Task parameters
+///
+/// @return None - Task always runs without a return
+///-----------------------------------------------------------
+static void replTask(void *pvParameters)
+{
+	const TickType_t xIdleDelay = REPL_IDLE_DELAY_MS / portTICK_PERIOD_MS;
+	const TickType_t xReconnect = REPL_RECONNECT_INTERVAL_MS / portTICK_PERIOD_MS;
+	WSADATA wsaData;
+
+	/// Just to remove compiler warnings
+	(void)pvParameters;
+
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+	{
+		printf("Repl: no Winsock, replication disabled\n");
+		vTaskDelete(NULL);
+		return;
+	}
+	replDisconnectedAt = xTaskGetTickCount() - xReconnect;
+	for (;;)
+	{
+		const TickType_t now = xTaskGetTickCount();
+		int busy = 0;
+
+		switch (replState)
+		{
+			case REPL_DISCONNECTED:
+				if ((TickType_t)(now - replDisconnectedAt) >= xReconnect)
+				{
+					replConnect();
+				}
+				break;
+			case REPL_CONNECTING:
+				replCheckConnect();
+				break;
+			default:
+				busy = replReceive();
+				if (replState == REPL_STREAMING)
+				{
+					busy |= replLoadFrame();
+					busy |= replSend();
+				}
+				break;
+		}
+		replUpdateLag(now);
+		if (!busy)
+		{
+			vTaskDelay(xIdleDelay);
+		}
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Creates the shipper task
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+void replCreateTask(void)
+{
+	xTaskCreate(replTask, "Repl", configMINIMAL_STACK_SIZE, NULL, REPL_TASK_PRIORITY, NULL);
+}
+
+///-----------------------------------------------------------
+/// \brief Sync mode: waits until the standby holds every line
+///        below nextLine. E writer only.
+///
+/// @param1 uint32_t nextLine - first line not to wait for
+///
+/// @return N/A
+///-----------------------------------------------------------
+void replWaitDurable(uint32_t nextLine)
+{
+	const TickType_t xTimeout = REPL_SYNC_TIMEOUT_MS / portTICK_PERIOD_MS;
+	TickType_t start;
+
+	if (!replConnected)
+	{
+		replCounters.syncUnprotected++;
+		return;
+	}
+	/// Only sealed blocks are shipped
+	elogSealBlock();
+	replCounters.syncWaits++;
+	start = xTaskGetTickCount();
+	while (replAckedLine < nextLine)
+	{
+		if (!replConnected || ((TickType_t)(xTaskGetTickCount() - start) >= xTimeout))
+		{
+			replCounters.syncTimeouts++;
+			return;
+		}
+		vTaskDelay(1);
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Copies the counters
+///
+/// @param1 replStats_t *stats - output
+///
+/// @return N/A
+///-----------------------------------------------------------
+void replGetStats(replStats_t *stats)
+{
+	PAYRANGE_ENTER_CRITICAL();
+	*stats = replCounters;
+	PAYRANGE_EXIT_CRITICAL();
+}
+
+///-----------------------------------------------------------
+/// \brief Prints the counters
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+void replPrintStats(void)
+{
+	replStats_t stats;
+
+	replGetStats(&stats);
+	printf("Repl 127.0.0.1:%d: standby %s (%u connections), %" PRIu64 " blocks shipped, %" PRIu64 " acked, %" PRIu64
+		" bytes\n", REPL_PORT, stats.connected ? "connected" : "not connected", (unsigned int)stats.connections,
+		stats.blocksShipped, stats.blocksAcked, stats.bytesShipped);
+	printf("Repl: lines below %u sealed, below %u on the standby, lag %u lines / %u blocks / %u ms\n",
+		(unsigned int)stats.persistedLine, (unsigned int)stats.ackedLine, (unsigned int)stats.lagLines,
+		(unsigned int)stats.lagBlocks, (unsigned int)stats.lagMs);
+	printf("Repl: sync mode %u waits, %u timeouts, %u batches without a standby\n", (unsigned int)stats.syncWaits,
+		(unsigned int)stats.syncTimeouts, (unsigned int)stats.syncUnprotected);
+}
+
+///-----------------------------------------------------------
+/// \brief Receives exactly length bytes
+///
+/// @param1 SOCKET socket - blocking socket
+/// @param2 void *buffer - output
+/// @param3 int length - bytes wanted
+///
+/// @return int - 1 on success, 0 if the peer went away
+///-----------------------------------------------------------
+static int replReceiveAll(SOCKET socket, void *buffer, int length)
+{
+	int received = 0;
+
+	while (received < length)
+	{
+		const int count = recv(socket, (char *)buffer + received, length - received, 0);
+
+		if (count <= 0)
+		{
+			return 0;
+		}
+		received += count;
+	}
+	return 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Opens the standby's copy of the log and finds the
+///        line after its last complete block; a block cut
+///        short by a crash is removed
+///
+/// @param1 const char *path - standby log
+/// @param2 uint32_t *nextLine - output, first missing line
+///
+/// @return FILE * - the file, positioned for appending
+///-----------------------------------------------------------
+static FILE *replOpenStandbyLog(const char *path, uint32_t *nextLine)
+{
+	char line[ELOG_MAX_LINE_LENGTH + 256];
+	int64_t complete = 0;
+	int64_t size;
+	FILE *file;
+
+	*nextLine = 0;
+	file = fopen(path, "r+b");
+	if (file == NULL)
+	{
+		return fopen(path, "w+b");
+	}
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		unsigned int block;
+		unsigned int firstLine;
+		unsigned int recordCount;
+
+		if (sscanf(line, "Seal %u: %u %u", &block, &firstLine, &recordCount) == 3)
+		{
+			*nextLine = firstLine + recordCount;
+			complete = _ftelli64(file);
+		}
+	}
+	_fseeki64(file, 0, SEEK_END);
+	size = _ftelli64(file);
+	if (size > complete)
+	{
+		printf("Standby: dropping %" PRId64 " bytes of an incomplete block\n", size - complete);
+		_chsize_s(_fileno(file), complete);
+	}
+	_fseeki64(file, complete, SEEK_SET);
+	return file;
+}
+
+///-----------------------------------------------------------
+/// \brief Standby process: accepts the primary, asks for the
+///        first missing line, writes each block it receives
+///        to disk and acknowledges it
+///
+/// @param1 const char *path - standby log
+/// @param2 int64_t fromLine - line to start from, -1 to resume
+///
+/// @return int - 1 if the standby could not start
+///-----------------------------------------------------------
+int replRunStandby(const char *path, int64_t fromLine)
+{
+	static char text[ELOG_MAX_BLOCK_TEXT];
+	struct sockaddr_in address;
+	WSADATA wsaData;
+	SOCKET listener;
+	uint32_t nextLine;
+	uint64_t blocks = 0;
+	FILE *file;
+
+	file = replOpenStandbyLog(path, &nextLine);
+	if (file == NULL)
+	{
+		printf("Standby: cannot open %s\n", path);
+		return 1;
+	}
+	if (fromLine >= 0)
+	{
+		nextLine = (uint32_t)fromLine;
+	}
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+	{
+		fclose(file);
+		return 1;
+	}
+	listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(REPL_PORT);
+	if ((listener == INVALID_SOCKET) || (bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0) ||
+		(listen(listener, 1) != 0))
+	{
+		printf("Standby: cannot listen on 127.0.0.1:%d\n", REPL_PORT);
+		fclose(file);
+		WSACleanup();
+		return 1;
+	}
+
+	for (;;)
+	{
+		replHello_t hello;
+		SOCKET primary;
+
+		printf("Standby: %s holds the lines below %u, waiting for the primary on 127.0.0.1:%d\n", path,
+			(unsigned int)nextLine, REPL_PORT);
+		primary = accept(listener, NULL, NULL);
+		if (primary == INVALID_SOCKET)
+		{
+			continue;
+		}
+		memset(&hello, 0, sizeof(hello));
+		memcpy(hello.magic, REPL_MAGIC, sizeof(hello.magic));
+		hello.nextLine = nextLine;
+		if (send(primary, (const char *)&hello, sizeof(hello), 0) != (int)sizeof(hello))
+		{
+			closesocket(primary);
+			continue;
+		}
+
+		for (;;)
+		{
+			replBlockHeader_t header;
+			replAck_t ack;
+
+			if (!replReceiveAll(primary, &header, sizeof(header)) || (header.length > sizeof(text)) ||
+				!replReceiveAll(primary, text, (int)header.length))
+			{
+				break;
+			}
+			if (header.firstLine > nextLine)
+			{
+				/// Lines are missing: reconnecting asks for them again
+				printf("Standby: block %u starts at line %u, expected %u\n", (unsigned int)header.blockIndex,
+					(unsigned int)header.firstLine, (unsigned int)nextLine);
+				break;
+			}
+			if (header.firstLine + header.recordCount > nextLine)
+			{
+				/// On disk before it is acknowledged
+				fwrite(text, 1, header.length, file);
+				fflush(file);
+				_commit(_fileno(file));
+				nextLine = header.firstLine + header.recordCount;
+			}
+			ack.blockIndex = header.blockIndex;
+			ack.nextLine = nextLine;
+			if (send(primary, (const char *)&ack, sizeof(ack), 0) != (int)sizeof(ack))
+			{
+				break;
+			}
+			if ((++blocks % REPL_STANDBY_REPORT_BLOCKS) == 0)
+			{
+				printf("Standby: %" PRIu64 " blocks received, lines below %u on disk\n", blocks,
+					(unsigned int)nextLine);
+			}
+		}
+		closesocket(primary);
+		printf("Standby: primary disconnected\n");
+	}
+}
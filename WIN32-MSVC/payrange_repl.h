@@ -0,0 +1,103 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_repl.h
+///-----------------------------------------------------------------------------
+///
+/// \brief E log shipping: sealed E log blocks are streamed to a standby
+///        process over a loopback socket, which writes them to its own copy
+///        of the log and acknowledges each one once it is on disk
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_REPL_H
+#define PAYRANGE_REPL_H
+
+/// Standard includes
+#include <stdint.h>
+
+/// Kernel includes
+#include <FreeRTOS.h>
+
+/// Replication configurable defines
+/// The standby listens here, the simulator connects to it
+#define REPL_PORT                       ( 7378 )
+/// Blocks shipped ahead of the standby's acknowledgements
+#define REPL_MAX_IN_FLIGHT              ( 8 )
+/// Wait between two connection attempts while there is no standby
+#define REPL_RECONNECT_INTERVAL_MS      ( 1000 )
+/// Shipper sleep when there is nothing to send or receive
+#define REPL_IDLE_DELAY_MS              ( 5 )
+/// Longest wait of the E writer for an acknowledgement in sync mode; a
+/// standby that is slower than this is left behind, not waited for
+#define REPL_SYNC_TIMEOUT_MS            ( 2000 )
+#define REPL_TASK_PRIORITY              ( tskIDLE_PRIORITY + 1 )
+/// Copy of the E log written by --standby
+#define REPL_STANDBY_FILE_NAME          "E.standby.txt"
+
+/// Wire format identification
+#define REPL_MAGIC                      "PRREPL01"
+
+/// Standby to primary, once per connection: the first line it needs
+typedef struct
+{
+	char     magic[8];
+	uint32_t nextLine;
+	uint32_t reserved;
+}replHello_t;
+
+/// Primary to standby, followed by length bytes of block text (the lines
+/// and the seal trailer, as elogReadBlock() returns them)
+typedef struct
+{
+	uint32_t blockIndex;
+	uint32_t firstLine;
+	uint32_t recordCount;
+	uint32_t length;
+}replBlockHeader_t;
+
+/// Standby to primary, per block once it is on disk
+typedef struct
+{
+	uint32_t blockIndex;
+	/// The standby holds every line below this one
+	uint32_t nextLine;
+}replAck_t;
+
+/// Replication counters
+typedef struct
+{
+	uint32_t connected;
+	uint32_t connections;
+	uint64_t blocksShipped;
+	uint64_t blocksAcked;
+	uint64_t bytesShipped;
+	/// Lines sealed here and lines the standby acknowledged (both exclusive)
+	uint32_t persistedLine;
+	uint32_t ackedLine;
+	/// Replication lag: lines and blocks the standby is missing, and how long
+	/// it has been behind
+	uint32_t lagLines;
+	uint32_t lagBlocks;
+	uint32_t lagMs;
+	/// Sync mode: batches that waited for an acknowledgement, waits that
+	/// timed out, and batches committed while no standby was connected
+	uint32_t syncWaits;
+	uint32_t syncTimeouts;
+	uint32_t syncUnprotected;
+}replStats_t;
+
+/// Creates the low priority task that connects to the standby and ships
+/// sealed blocks to it
+void replCreateTask(void);
+/// E writer, sync mode: seals the open block and waits until the standby
+/// acknowledged every line below nextLine (or REPL_SYNC_TIMEOUT_MS passed)
+void replWaitDurable(uint32_t nextLine);
+/// Copies the counters
+void replGetStats(replStats_t *stats);
+/// Prints the counters
+void replPrintStats(void);
+/// Standby process (--standby): receives blocks into path and acknowledges
+/// them, resuming after its last complete block, or at fromLine if it is
+/// not negative. Runs until the process is stopped.
+int replRunStandby(const char *path, int64_t fromLine);
+
+#endif /// PAYRANGE_REPL_H
@@ -0,0 +1,594 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_rpc.c
+///-----------------------------------------------------------------------------
+///
+/// \brief Request gateway
+///
+/// The ingest gateway is fire and forget, which is the fastest way in but
+/// tells a terminal nothing about how long its captures took. This gateway
+/// runs the same kind of reactor - one non-blocking listener, one select()
+/// per pass, one stamp per pass, admission per client - and answers every
+/// request:
+///
+/// - a capture is queued to the E writer like a terminal's and remembered
+///   in the client's pending list; the E writer reports the captures it
+///   stored (rpcCapturesStored()) and the reactor answers them, so a reply
+///   covers the gateway, admission, the capture queue and the E log write.
+///   A shed capture is answered at once with RPC_SHED.
+/// - a lookup is done by the reactor itself, List F and then the A to E
+///   index, like the G key, and answered with the number of matches.
+///
+/// A client whose replies or pending captures are backed up is not read
+/// until they drain, so a client that sends faster than the system answers
+/// sees its requests wait in the socket - which is what an open-loop load
+/// generator has to see. A client that shuts down its sending side still
+/// gets the replies to everything it sent.
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+
+/// Winsock must come before windows.h, which FreeRTOS.h pulls in
+#include <winsock2.h>
+
+/// Standard includes
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+/// Kernel includes
+#include <FreeRTOS.h>
+#include <task.h>
+#include <queue.h>
+
+#include "payrange_rpc.h"
+#include "payrange_admit.h"
+#include "payrange_ahistory.h"
+#include "payrange_listf.h"
+#include "payrange_eindex.h"
+#include "payrange_time.h"
+#include "payrange_critical.h"
+
+/// Outcome of draining one client
+#define RPC_DRAINED                     ( 0 )
+#define RPC_STALLED                     ( 1 )
+#define RPC_WAITING                     ( 2 )
+
+/// A capture waiting for the E writer
+typedef struct
+{
+	/// Capture sequence given to the E writer
+	uint32_t captureSequence;
+	/// Request sequence and tag of the client
+	uint32_t sequence;
+	uint64_t tag;
+}rpcPending_t;
+
+/// One client connection with its request, reply and pending buffers
+typedef struct
+{
+	SOCKET       socket;
+	/// Peer has finished sending, close once everything is answered
+	int          closing;
+	/// The request at the head of the buffer waits for a token since deferredSince
+	int          deferred;
+	TickType_t   deferredSince;
+	uint32_t     buffered;
+	uint8_t      buffer[RPC_READ_SIZE];
+	uint32_t     replyBytes;
+	uint8_t      replies[RPC_WRITE_SIZE];
+	rpcPending_t pending[RPC_MAX_PENDING];
+	uint32_t     pendingHead;
+	uint32_t     pendingCount;
+	/// Capture sequence of the slot's next capture, never reset, so captures
+	/// of a closed connection can't be taken for the next one's
+	uint32_t     nextCapture;
+}rpcClient_t;
+
+/// Reactor configuration, set by rpcCreateTask()
+static QueueHandle_t rpcQueue;
+/// Sockets, owned by the reactor task
+static SOCKET rpcListener = INVALID_SOCKET;
+static rpcClient_t rpcClients[RPC_MAX_CLIENTS];
+/// Capture sequence + 1 of the last capture the E writer stored, per slot
+static volatile uint32_t rpcStored[RPC_MAX_CLIENTS];
+/// List F reader of the reactor
+static int rpcListFReader = -1;
+/// Counters, written by the reactor task only
+static rpcStats_t rpcStats;
+
+///-----------------------------------------------------------
+/// \brief Opens the non-blocking listening socket
+///
+/// @param N/A
+///
+/// @return int - 1 on success
+///-----------------------------------------------------------
+static int rpcListen(void)
+{
+	WSADATA wsaData;
+	struct sockaddr_in address;
+	u_long nonBlocking = 1;
+
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+	{
+		return 0;
+	}
+	rpcListener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (rpcListener == INVALID_SOCKET)
+	{
+		return 0;
+	}
+
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(RPC_PORT);
+	if ((bind(rpcListener, (struct sockaddr *)&address, sizeof(address)) != 0) ||
+		(listen(rpcListener, SOMAXCONN) != 0) ||
+		(ioctlsocket(rpcListener, FIONBIO, &nonBlocking) != 0))
+	{
+		closesocket(rpcListener);
+		rpcListener = INVALID_SOCKET;
+		return 0;
+	}
+	return 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Accepts every pending connection
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void rpcAccept(void)
+{
+	for (;;)
+	{
+		u_long nonBlocking = 1;
+		int slot;
+		SOCKET client = accept(rpcListener, NULL, NULL);
+		if (client == INVALID_SOCKET)
+		{
+			return;
+		}
+		for (slot = 0; slot < RPC_MAX_CLIENTS; slot++)
+		{
+			if (rpcClients[slot].socket == INVALID_SOCKET)
+			{
+				break;
+			}
+		}
+		if ((slot == RPC_MAX_CLIENTS) || (ioctlsocket(client, FIONBIO, &nonBlocking) != 0))
+		{
+			closesocket(client);
+			continue;
+		}
+		rpcClients[slot].socket = client;
+		rpcClients[slot].closing = 0;
+		rpcClients[slot].deferred = 0;
+		rpcClients[slot].buffered = 0;
+		rpcClients[slot].replyBytes = 0;
+		rpcClients[slot].pendingHead = 0;
+		rpcClients[slot].pendingCount = 0;
+		rpcStats.connections++;
+		rpcStats.activeClients++;
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Closes a client connection; its pending captures
+///        are stored without a reply
+///
+/// @param1 rpcClient_t *client - client to close
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void rpcClose(rpcClient_t *client)
+{
+	closesocket(client->socket);
+	client->socket = INVALID_SOCKET;
+	rpcStats.orphaned += client->pendingCount;
+	client->pendingCount = 0;
+	rpcStats.activeClients--;
+}
+
+///-----------------------------------------------------------
+/// \brief Appends a reply to a client's reply buffer
+///
+/// @param1 rpcClient_t *client - client
+/// @param2 const rpcReply_t *reply - reply
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void rpcReply(rpcClient_t *client, const rpcReply_t *reply)
+{
+	configASSERT(client->replyBytes + sizeof(*reply) <= RPC_WRITE_SIZE);
+	memcpy(client->replies + client->replyBytes, reply, sizeof(*reply));
+	client->replyBytes += sizeof(*reply);
+	rpcStats.replies++;
+}
+
+///-----------------------------------------------------------
+/// \brief Answers the pending captures the E writer stored
+///
+/// @param1 rpcClient_t *client - client
+/// @param2 int slot - client slot
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void rpcAnswerStored(rpcClient_t *client, int slot)
+{
+	const uint32_t stored = rpcStored[slot];
+	rpcReply_t reply;
+
+	memset(&reply, 0, sizeof(reply));
+	reply.type = RPC_CAPTURE;
+	reply.status = RPC_OK;
+	while ((client->pendingCount > 0) && (client->replyBytes + sizeof(reply) <= RPC_WRITE_SIZE))
+	{
+		const rpcPending_t *pending = &client->pending[client->pendingHead];
+
+		/// Stored once the E writer moved past it, in wrap-safe order
+		if ((int32_t)(stored - pending->captureSequence) <= 0)
+		{
+			break;
+		}
+		reply.sequence = pending->sequence;
+		reply.tag = pending->tag;
+		rpcReply(client, &reply);
+		client->pendingHead = (client->pendingHead + 1) % RPC_MAX_PENDING;
+		client->pendingCount--;
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Looks up an A code in List F and the E history
+///
+/// @param1 int64_t code - A code
+///
+/// @return uint32_t - matches
+///-----------------------------------------------------------
+static uint32_t rpcLookup(int64_t code)
+{
+	static valueE_t listFMatches[MAX_SIZE_OF_VALUE_E_STRUCTURE];
+	static eIndexEntry_t historyMatches[EINDEX_LOOKUP_MAX_RESULTS];
+	int matches;
+
+	if (rpcListFReader < 0)
+	{
+		rpcListFReader = listFReaderRegister();
+		configASSERT(rpcListFReader >= 0);
+	}
+	matches = listFLookup(rpcListFReader, code, listFMatches, MAX_SIZE_OF_VALUE_E_STRUCTURE);
+	matches += eIndexLookup(code, historyMatches, EINDEX_LOOKUP_MAX_RESULTS);
+	return (uint32_t)matches;
+}
+
+///-----------------------------------------------------------
+/// \brief Handles the complete requests buffered for a client
+///        while its replies and pending captures have room
+///
+/// @param1 rpcClient_t *client - client
+/// @param2 int slot - client slot
+/// @param3 const valueD_t *stamp - A and tick of this pass
+///
+/// @return int - RPC_DRAINED, RPC_STALLED if the capture queue
+///               filled up, RPC_WAITING if the client is over its
+///               rate or its replies or pending captures are full
+///-----------------------------------------------------------
+static int rpcDrain(rpcClient_t *client, int slot, const valueD_t *stamp)
+{
+	captureRequest_t capture;
+	rpcRequest_t request;
+	rpcReply_t reply;
+	uint32_t consumed = 0;
+	int result = RPC_DRAINED;
+
+	capture.valueD = *stamp;
+	while (client->buffered - consumed >= sizeof(request))
+	{
+		if (client->replyBytes + sizeof(reply) > RPC_WRITE_SIZE)
+		{
+			result = RPC_WAITING;
+			break;
+		}
+		memcpy(&request, client->buffer + consumed, sizeof(request));
+		memset(&reply, 0, sizeof(reply));
+		reply.type = request.type;
+		reply.sequence = request.sequence;
+		reply.tag = request.tag;
+
+		if (request.type == RPC_LOOKUP)
+		{
+			reply.status = RPC_OK;
+			reply.matches = rpcLookup(request.code);
+			rpcStats.lookups++;
+			rpcReply(client, &reply);
+		}
+		else if (request.type != RPC_CAPTURE)
+		{
+			reply.status = RPC_BAD_REQUEST;
+			rpcReply(client, &reply);
+		}
+		else
+		{
+			admitOutcome_t outcome;
+
+			if (client->pendingCount == RPC_MAX_PENDING)
+			{
+				result = RPC_WAITING;
+				break;
+			}
+			/// Ask for a token only when the capture can be queued right away
+			if (uxQueueSpacesAvailable(rpcQueue) == 0)
+			{
+				result = RPC_STALLED;
+				break;
+			}
+			outcome = admitRequest(RPC_SOURCE_BASE + (uint32_t)slot, client->deferred ? &client->deferredSince : NULL);
+			if (outcome == ADMIT_DEFER)
+			{
+				if (!client->deferred)
+				{
+					client->deferred = 1;
+					client->deferredSince = stamp->randomNumberTime;
+				}
+				result = RPC_WAITING;
+				break;
+			}
+			client->deferred = 0;
+			if (outcome == ADMIT_ADMIT)
+			{
+				rpcPending_t *pending = &client->pending[(client->pendingHead + client->pendingCount) % RPC_MAX_PENDING];
+
+				capture.source = RPC_SOURCE_BASE + (uint32_t)slot;
+				capture.sequence = client->nextCapture;
+				if (xQueueSend(rpcQueue, &capture, 0) != pdPASS)
+				{
+					/// The console took the last slot; the token is lost, the request is not
+					result = RPC_STALLED;
+					break;
+				}
+				pending->captureSequence = client->nextCapture++;
+				pending->sequence = request.sequence;
+				pending->tag = request.tag;
+				client->pendingCount++;
+				rpcStats.captures++;
+			}
+			else
+			{
+				reply.status = RPC_SHED;
+				rpcStats.shed++;
+				rpcReply(client, &reply);
+			}
+		}
+		consumed += sizeof(request);
+	}
+	if (consumed > 0)
+	{
+		/// Keep the partial request (or the unhandled ones) at the buffer start
+		client->buffered -= consumed;
+		memmove(client->buffer, client->buffer + consumed, client->buffered);
+	}
+	return result;
+}
+
+///-----------------------------------------------------------
+/// \brief Sends what the socket takes of a client's replies
+///
+/// @param1 rpcClient_t *client - client
+///
+/// @return int - 0 if the connection failed
+///-----------------------------------------------------------
+static int rpcFlush(rpcClient_t *client)
+{
+	int sent;
+
+	if (client->replyBytes == 0)
+	{
+		return 1;
+	}
+	sent = send(client->socket, (const char *)client->replies, (int)client->replyBytes, 0);
+	if (sent <= 0)
+	{
+		return (WSAGetLastError() == WSAEWOULDBLOCK);
+	}
+	client->replyBytes -= (uint32_t)sent;
+	memmove(client->replies, client->replies + sent, client->replyBytes);
+	return 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Reactor task: polls the sockets, handles the
+///        requests and sends the replies
+///
+/// @param 1 void *pvParameters - placeholder for FreeRTOS
+///                               Task parameters
+///
+/// @return None - Task always runs without a return
+///-----------------------------------------------------------
+static void rpcTask(void *pvParameters)
+{
+	const TickType_t xIdleDelay = RPC_IDLE_DELAY_MS / portTICK_PERIOD_MS;
+
+	/// Just to remove compiler warnings
+	(void)pvParameters;
+
+	for (int i = 0; i < RPC_MAX_CLIENTS; i++)
+	{
+		rpcClients[i].socket = INVALID_SOCKET;
+	}
+	if (!rpcListen())
+	{
+		printf("RPC: cannot listen on 127.0.0.1:%d, request gateway disabled\n", RPC_PORT);
+		vTaskDelete(NULL);
+		return;
+	}
+
+	for (;;)
+	{
+		struct timeval noWait = { 0, 0 };
+		fd_set readable;
+		valueD_t stamp;
+		SOCKET highest = rpcListener;
+		int backlogged = 0;
+		int busy = 0;
+		int ready;
+
+		FD_ZERO(&readable);
+		FD_SET(rpcListener, &readable);
+		for (int i = 0; i < RPC_MAX_CLIENTS; i++)
+		{
+			/// A client with a full buffer waits until its requests are handled
+			if ((rpcClients[i].socket != INVALID_SOCKET) && !rpcClients[i].closing &&
+				(rpcClients[i].buffered < RPC_READ_SIZE))
+			{
+				FD_SET(rpcClients[i].socket, &readable);
+				highest = (rpcClients[i].socket > highest) ? rpcClients[i].socket : highest;
+			}
+		}
+		/// Winsock ignores the first argument, BSD sockets need it
+		ready = select((int)highest + 1, &readable, NULL, NULL, &noWait);
+		if (ready > 0)
+		{
+			if (FD_ISSET(rpcListener, &readable))
+			{
+				rpcAccept();
+			}
+			for (int i = 0; i < RPC_MAX_CLIENTS; i++)
+			{
+				rpcClient_t *client = &rpcClients[i];
+				int received;
+				if ((client->socket == INVALID_SOCKET) || client->closing || !FD_ISSET(client->socket, &readable))
+				{
+					continue;
+				}
+				received = recv(client->socket, (char *)client->buffer + client->buffered,
+					(int)(RPC_READ_SIZE - client->buffered), 0);
+				if (received > 0)
+				{
+					client->buffered += (uint32_t)received;
+					busy = 1;
+				}
+				else if ((received == 0) || (WSAGetLastError() != WSAEWOULDBLOCK))
+				{
+					client->closing = 1;
+				}
+			}
+		}
+
+		/// One stamp for everything that arrived in this pass, A as of this tick
+		stamp.randomNumberTime = xTaskGetTickCount();
+		stamp.randomNumberTimeUtcNs = timeTickToUtcNs(stamp.randomNumberTime);
+		if (!aHistoryLookup(stamp.randomNumberTime, &stamp.randomNumber, NULL))
+		{
+			stamp.randomNumber = 0;
+		}
+		for (int i = 0; i < RPC_MAX_CLIENTS; i++)
+		{
+			rpcClient_t *client = &rpcClients[i];
+			const uint32_t replyBytes = client->replyBytes;
+			if (client->socket == INVALID_SOCKET)
+			{
+				continue;
+			}
+			rpcAnswerStored(client, i);
+			if (rpcDrain(client, i, &stamp) == RPC_STALLED)
+			{
+				rpcStats.stalls++;
+				backlogged = 1;
+			}
+			busy |= (client->replyBytes != replyBytes);
+			if (!rpcFlush(client))
+			{
+				rpcClose(client);
+			}
+			else if (client->closing && (client->buffered < sizeof(rpcRequest_t)) && (client->pendingCount == 0) &&
+				(client->replyBytes == 0))
+			{
+				rpcClose(client);
+			}
+		}
+
+		if (backlogged)
+		{
+			/// Let the E writer (same priority) empty the queue
+			taskYIELD();
+		}
+		else if (!busy)
+		{
+			/// Nothing read or answered; clients may wait for tokens or the E writer
+			vTaskDelay(xIdleDelay);
+		}
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Creates the gateway task
+///
+/// @param1 QueueHandle_t captureQueue - E pipeline input
+/// @param2 UBaseType_t priority - task priority
+///
+/// @return N/A
+///-----------------------------------------------------------
+void rpcCreateTask(QueueHandle_t captureQueue, UBaseType_t priority)
+{
+	rpcQueue = captureQueue;
+	xTaskCreate(rpcTask, "RPC", configMINIMAL_STACK_SIZE, NULL, priority, NULL);
+}
+
+///-----------------------------------------------------------
+/// \brief Notes the gateway's captures of a stored batch.
+///        E writer only.
+///
+/// @param1 const captureRequest_t *captures - stored captures
+/// @param2 int count - number of captures
+///
+/// @return N/A
+///-----------------------------------------------------------
+void rpcCapturesStored(const captureRequest_t *captures, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		const uint32_t slot = captures[i].source - RPC_SOURCE_BASE;
+
+		/// A client's captures reach the E writer in order
+		if (slot < RPC_MAX_CLIENTS)
+		{
+			rpcStored[slot] = captures[i].sequence + 1;
+		}
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Copies the gateway counters
+///
+/// @param1 rpcStats_t *stats - output
+///
+/// @return N/A
+///-----------------------------------------------------------
+void rpcGetStats(rpcStats_t *stats)
+{
+	PAYRANGE_ENTER_CRITICAL();
+	*stats = rpcStats;
+	PAYRANGE_EXIT_CRITICAL();
+}
+
+///-----------------------------------------------------------
+/// \brief Prints the gateway counters
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+void rpcPrintStats(void)
+{
+	rpcStats_t stats;
+
+	rpcGetStats(&stats);
+	printf("RPC 127.0.0.1:%d: %u clients (%u connections), %" PRIu64 " captures, %" PRIu64 " lookups, %" PRIu64
+		" shed, %" PRIu64 " replies, %" PRIu64 " unanswered, %" PRIu64 " stalls\n", RPC_PORT,
+		(unsigned int)stats.activeClients, (unsigned int)stats.connections, stats.captures, stats.lookups,
+		stats.shed, stats.replies, stats.orphaned, stats.stalls);
+}
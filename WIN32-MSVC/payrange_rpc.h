@@ -0,0 +1,92 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_rpc.h
+///-----------------------------------------------------------------------------
+///
+/// \brief Request gateway: C captures and G lookups over a loopback socket,
+///        each answered with a reply, for clients that measure latency
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_RPC_H
+#define PAYRANGE_RPC_H
+
+#include "payrange.h"
+#include "payrange_ingest.h"
+
+/// Kernel includes
+#include <queue.h>
+
+/// Request gateway configurable defines
+#define RPC_PORT                        ( 7379 )
+#define RPC_MAX_CLIENTS                 ( 8 )
+/// Receive and reply buffers per client
+#define RPC_READ_SIZE                   ( 16 * 1024 )
+#define RPC_WRITE_SIZE                  ( 64 * 1024 )
+/// Captures per client queued to the E writer and not stored yet; a client
+/// with this many is not read until the E writer catches up
+#define RPC_MAX_PENDING                 ( 4096 )
+/// Reactor sleep when no socket is ready
+#define RPC_IDLE_DELAY_MS               ( 1 )
+/// Admission sources of the clients, in the range no terminal can use
+#define RPC_SOURCE_BASE                 ( CAPTURE_SOURCE_GATEWAY )
+
+/// Request types
+#define RPC_CAPTURE                     ( 1 )
+#define RPC_LOOKUP                      ( 2 )
+
+/// Reply status
+#define RPC_OK                          ( 0 )
+/// Capture dropped by admission control
+#define RPC_SHED                        ( 1 )
+#define RPC_BAD_REQUEST                 ( 2 )
+
+/// Wire format of one request (little-endian, 24 bytes)
+typedef struct
+{
+	uint32_t type;
+	uint32_t sequence;
+	/// RPC_LOOKUP: the A code
+	int64_t  code;
+	/// Returned unchanged in the reply
+	uint64_t tag;
+}rpcRequest_t;
+
+/// Wire format of one reply (little-endian, 24 bytes). A capture is answered
+/// once the E writer stored it, a lookup once it was done; replies to
+/// captures and lookups may overtake each other.
+typedef struct
+{
+	uint32_t type;
+	uint32_t status;
+	uint32_t sequence;
+	/// RPC_LOOKUP: List F matches plus E history matches
+	uint32_t matches;
+	uint64_t tag;
+}rpcReply_t;
+
+/// Gateway counters
+typedef struct
+{
+	uint32_t connections;
+	uint32_t activeClients;
+	uint64_t captures;
+	uint64_t lookups;
+	uint64_t shed;
+	uint64_t replies;
+	/// Captures whose client went away before they were answered
+	uint64_t orphaned;
+	/// Times the capture queue was full and a client's requests waited
+	uint64_t stalls;
+}rpcStats_t;
+
+/// Creates the gateway task. Captures go to captureQueue, stamped like the
+/// ingest gateway's.
+void rpcCreateTask(QueueHandle_t captureQueue, UBaseType_t priority);
+/// E writer: a batch of captures was stored, answer the gateway's ones
+void rpcCapturesStored(const captureRequest_t *captures, int count);
+/// Copies the gateway counters
+void rpcGetStats(rpcStats_t *stats);
+/// Prints the gateway counters to stdout
+void rpcPrintStats(void);
+
+#endif /// PAYRANGE_RPC_H
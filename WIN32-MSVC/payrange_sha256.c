@@ -0,0 +1,530 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_sha256.c
+///-----------------------------------------------------------------------------
+///
+/// \brief SHA-256 (FIPS 180-4) with SHA-NI and AVX2 multi-buffer acceleration
+///
+/// The single-buffer compression function is picked once at run time: SHA-NI
+/// when the CPU has it, plain C otherwise. Batches of short messages (Merkle
+/// leaves and nodes of the E log) go through sha256ManyPrefixed(), which on
+/// CPUs without SHA-NI but with AVX2 hashes 8 messages at a time, one per
+/// 32-bit lane.
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+
+/// Standard includes
+#include <string.h>
+
+/// Compiler includes
+#include <immintrin.h>
+
+#include "payrange_cpu.h"
+#include "payrange_sha256.h"
+
+/// Number of messages hashed in parallel by the AVX2 path
+#define SHA256_AVX2_LANES               ( 8 )
+
+#define ROTR32(x, n)                    ( ((x) >> (n)) | ((x) << (32 - (n))) )
+
+/// Round constants
+static const uint32_t sha256K[64] =
+{
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/// Initial hash value
+static const uint32_t sha256H0[8] =
+{
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+/// Compression function signature, processes whole 64 byte blocks
+typedef void (*sha256CompressFunction_t)(uint32_t state[8], const uint8_t *data, size_t blocks);
+
+static sha256CompressFunction_t sha256Compress = NULL;
+static int sha256UseAvx2Lanes = 0;
+static const char *sha256Backend = "c";
+
+///-----------------------------------------------------------
+/// \brief Big-endian 32-bit load/store helpers
+///-----------------------------------------------------------
+static uint32_t sha256LoadBe32(const uint8_t *bytes)
+{
+	return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | (uint32_t)bytes[3];
+}
+
+static void sha256StoreBe32(uint8_t *bytes, uint32_t value)
+{
+	bytes[0] = (uint8_t)(value >> 24);
+	bytes[1] = (uint8_t)(value >> 16);
+	bytes[2] = (uint8_t)(value >> 8);
+	bytes[3] = (uint8_t)value;
+}
+
+///-----------------------------------------------------------
+/// \brief Portable compression function
+///
+/// @param1 uint32_t state[8] - chaining value, updated in place
+/// @param2 const uint8_t *data - whole message blocks
+/// @param3 size_t blocks - number of 64 byte blocks
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void sha256CompressC(uint32_t state[8], const uint8_t *data, size_t blocks)
+{
+	uint32_t w[64];
+	uint32_t a, b, c, d, e, f, g, h, t1, t2;
+
+	while (blocks--)
+	{
+		for (int t = 0; t < 16; t++)
+		{
+			w[t] = sha256LoadBe32(data + 4 * t);
+		}
+		for (int t = 16; t < 64; t++)
+		{
+			uint32_t s0 = ROTR32(w[t - 15], 7) ^ ROTR32(w[t - 15], 18) ^ (w[t - 15] >> 3);
+			uint32_t s1 = ROTR32(w[t - 2], 17) ^ ROTR32(w[t - 2], 19) ^ (w[t - 2] >> 10);
+			w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+		}
+
+		a = state[0]; b = state[1]; c = state[2]; d = state[3];
+		e = state[4]; f = state[5]; g = state[6]; h = state[7];
+		for (int t = 0; t < 64; t++)
+		{
+			t1 = h + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) + ((e & f) ^ (~e & g)) + sha256K[t] + w[t];
+			t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+			h = g; g = f; f = e; e = d + t1;
+			d = c; c = b; b = a; a = t1 + t2;
+		}
+		state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+		state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+
+		data += SHA256_BLOCK_SIZE;
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief SHA-NI compression function
+///
+/// @param1 uint32_t state[8] - chaining value, updated in place
+/// @param2 const uint8_t *data - whole message blocks
+/// @param3 size_t blocks - number of 64 byte blocks
+///
+/// @return N/A
+///-----------------------------------------------------------
+PAYRANGE_TARGET("sha,sse4.1,ssse3")
+static void sha256CompressShaNi(uint32_t state[8], const uint8_t *data, size_t blocks)
+{
+	const __m128i byteSwapMask = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+	__m128i state0, state1, savedState0, savedState1, tmp, roundInput;
+	__m128i msg[4];
+
+	/// Reorder the state into the ABEF/CDGH layout used by the instructions
+	tmp = _mm_loadu_si128((const __m128i *)&state[0]);
+	state1 = _mm_loadu_si128((const __m128i *)&state[4]);
+	tmp = _mm_shuffle_epi32(tmp, 0xB1);
+	state1 = _mm_shuffle_epi32(state1, 0x1B);
+	state0 = _mm_alignr_epi8(tmp, state1, 8);
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+	while (blocks--)
+	{
+		savedState0 = state0;
+		savedState1 = state1;
+
+		/// 16 groups of 4 rounds, the message schedule is kept in a 4 vector window
+		for (int i = 0; i < 16; i++)
+		{
+			if (i < 4)
+			{
+				msg[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16 * i)), byteSwapMask);
+			}
+			else
+			{
+				tmp = _mm_sha256msg1_epu32(msg[i & 3], msg[(i + 1) & 3]);
+				tmp = _mm_add_epi32(tmp, _mm_alignr_epi8(msg[(i + 3) & 3], msg[(i + 2) & 3], 4));
+				msg[i & 3] = _mm_sha256msg2_epu32(tmp, msg[(i + 3) & 3]);
+			}
+			roundInput = _mm_add_epi32(msg[i & 3], _mm_loadu_si128((const __m128i *)&sha256K[4 * i]));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, roundInput);
+			roundInput = _mm_shuffle_epi32(roundInput, 0x0E);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, roundInput);
+		}
+
+		state0 = _mm_add_epi32(state0, savedState0);
+		state1 = _mm_add_epi32(state1, savedState1);
+		data += SHA256_BLOCK_SIZE;
+	}
+
+	/// Back to the ABCD/EFGH layout
+	tmp = _mm_shuffle_epi32(state0, 0x1B);
+	state1 = _mm_shuffle_epi32(state1, 0xB1);
+	state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+	state1 = _mm_alignr_epi8(state1, tmp, 8);
+	_mm_storeu_si128((__m128i *)&state[0], state0);
+	_mm_storeu_si128((__m128i *)&state[4], state1);
+}
+
+/// AVX2 helpers for the 8-lane path
+#define AVX2_ROTR(x, n)                 _mm256_or_si256(_mm256_srli_epi32((x), (n)), _mm256_slli_epi32((x), 32 - (n)))
+#define AVX2_ADD(x, y)                  _mm256_add_epi32((x), (y))
+
+///-----------------------------------------------------------
+/// \brief Hashes up to 8 pre-padded messages in parallel,
+///        one per 32-bit lane. Lanes that run out of blocks
+///        keep their state through the remaining iterations.
+///
+/// @param1 const uint8_t *lanes[8] - padded messages
+/// @param2 const int laneBlocks[8] - blocks per lane (0 = unused)
+/// @param3 uint8_t *outputs[8] - digest destinations
+///
+/// @return N/A
+///-----------------------------------------------------------
+PAYRANGE_TARGET("avx2")
+static void sha256ManyAvx2(const uint8_t *lanes[SHA256_AVX2_LANES], const int laneBlocks[SHA256_AVX2_LANES],
+	uint8_t *outputs[SHA256_AVX2_LANES])
+{
+	__m256i state[8], w[16];
+	__m256i a, b, c, d, e, f, g, h, t1, t2, mask;
+	uint32_t lanesState[8][SHA256_AVX2_LANES];
+	int maxBlocks = 0;
+
+	for (int lane = 0; lane < SHA256_AVX2_LANES; lane++)
+	{
+		if (laneBlocks[lane] > maxBlocks)
+		{
+			maxBlocks = laneBlocks[lane];
+		}
+	}
+	for (int i = 0; i < 8; i++)
+	{
+		state[i] = _mm256_set1_epi32((int)sha256H0[i]);
+	}
+
+	for (int block = 0; block < maxBlocks; block++)
+	{
+		const int offset = block * SHA256_BLOCK_SIZE;
+		for (int t = 0; t < 16; t++)
+		{
+			const int wordOffset = offset + 4 * t;
+			w[t] = _mm256_setr_epi32(
+				(int)sha256LoadBe32(lanes[0] + wordOffset), (int)sha256LoadBe32(lanes[1] + wordOffset),
+				(int)sha256LoadBe32(lanes[2] + wordOffset), (int)sha256LoadBe32(lanes[3] + wordOffset),
+				(int)sha256LoadBe32(lanes[4] + wordOffset), (int)sha256LoadBe32(lanes[5] + wordOffset),
+				(int)sha256LoadBe32(lanes[6] + wordOffset), (int)sha256LoadBe32(lanes[7] + wordOffset));
+		}
+
+		a = state[0]; b = state[1]; c = state[2]; d = state[3];
+		e = state[4]; f = state[5]; g = state[6]; h = state[7];
+		for (int t = 0; t < 64; t++)
+		{
+			if (t >= 16)
+			{
+				__m256i w15 = w[(t - 15) & 15];
+				__m256i w2 = w[(t - 2) & 15];
+				__m256i s0 = _mm256_xor_si256(_mm256_xor_si256(AVX2_ROTR(w15, 7), AVX2_ROTR(w15, 18)), _mm256_srli_epi32(w15, 3));
+				__m256i s1 = _mm256_xor_si256(_mm256_xor_si256(AVX2_ROTR(w2, 17), AVX2_ROTR(w2, 19)), _mm256_srli_epi32(w2, 10));
+				w[t & 15] = AVX2_ADD(AVX2_ADD(w[t & 15], s0), AVX2_ADD(w[(t - 7) & 15], s1));
+			}
+			t1 = AVX2_ADD(h, _mm256_xor_si256(_mm256_xor_si256(AVX2_ROTR(e, 6), AVX2_ROTR(e, 11)), AVX2_ROTR(e, 25)));
+			t1 = AVX2_ADD(t1, _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g)));
+			t1 = AVX2_ADD(t1, AVX2_ADD(_mm256_set1_epi32((int)sha256K[t]), w[t & 15]));
+			t2 = _mm256_xor_si256(_mm256_xor_si256(AVX2_ROTR(a, 2), AVX2_ROTR(a, 13)), AVX2_ROTR(a, 22));
+			t2 = AVX2_ADD(t2, _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b))));
+			h = g; g = f; f = e; e = AVX2_ADD(d, t1);
+			d = c; c = b; b = a; a = AVX2_ADD(t1, t2);
+		}
+
+		/// Only lanes that still had this block take the update
+		mask = _mm256_setr_epi32(
+			(block < laneBlocks[0]) ? -1 : 0, (block < laneBlocks[1]) ? -1 : 0,
+			(block < laneBlocks[2]) ? -1 : 0, (block < laneBlocks[3]) ? -1 : 0,
+			(block < laneBlocks[4]) ? -1 : 0, (block < laneBlocks[5]) ? -1 : 0,
+			(block < laneBlocks[6]) ? -1 : 0, (block < laneBlocks[7]) ? -1 : 0);
+		state[0] = _mm256_blendv_epi8(state[0], AVX2_ADD(state[0], a), mask);
+		state[1] = _mm256_blendv_epi8(state[1], AVX2_ADD(state[1], b), mask);
+		state[2] = _mm256_blendv_epi8(state[2], AVX2_ADD(state[2], c), mask);
+		state[3] = _mm256_blendv_epi8(state[3], AVX2_ADD(state[3], d), mask);
+		state[4] = _mm256_blendv_epi8(state[4], AVX2_ADD(state[4], e), mask);
+		state[5] = _mm256_blendv_epi8(state[5], AVX2_ADD(state[5], f), mask);
+		state[6] = _mm256_blendv_epi8(state[6], AVX2_ADD(state[6], g), mask);
+		state[7] = _mm256_blendv_epi8(state[7], AVX2_ADD(state[7], h), mask);
+	}
+
+	for (int i = 0; i < 8; i++)
+	{
+		_mm256_storeu_si256((__m256i *)lanesState[i], state[i]);
+	}
+	for (int lane = 0; lane < SHA256_AVX2_LANES; lane++)
+	{
+		if (outputs[lane] != NULL)
+		{
+			for (int i = 0; i < 8; i++)
+			{
+				sha256StoreBe32(outputs[lane] + 4 * i, lanesState[i][lane]);
+			}
+		}
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Picks the compression backend on first use
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void sha256SelectBackend(void)
+{
+	const cpuFeatures_t *features;
+
+	if (sha256Compress != NULL)
+	{
+		return;
+	}
+	features = cpuGetFeatures();
+	if (features->hasShaNi)
+	{
+		sha256Backend = "sha-ni";
+		sha256Compress = sha256CompressShaNi;
+	}
+	else
+	{
+		/// Without SHA-NI the multi-buffer lanes beat one-at-a-time hashing
+		sha256UseAvx2Lanes = features->hasAvx2;
+		sha256Backend = features->hasAvx2 ? "avx2" : "c";
+		sha256Compress = sha256CompressC;
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Writes prefix || message || padding into a block
+///        aligned buffer
+///
+/// @param1 uint8_t prefix - domain separation byte
+/// @param2 const uint8_t *message - message bytes
+/// @param3 size_t length - message length
+/// @param4 uint8_t *padded - SHA256_MANY_MAX_BLOCKS blocks
+///
+/// @return int - number of blocks, 0 if the message is too long
+///-----------------------------------------------------------
+static int sha256PadPrefixed(uint8_t prefix, const uint8_t *message, size_t length, uint8_t *padded)
+{
+	const size_t totalLength = length + 1;
+	const int blocks = (int)((totalLength + 9 + SHA256_BLOCK_SIZE - 1) / SHA256_BLOCK_SIZE);
+	const uint64_t bitLength = (uint64_t)totalLength * 8;
+
+	if (blocks > SHA256_MANY_MAX_BLOCKS)
+	{
+		return 0;
+	}
+	padded[0] = prefix;
+	memcpy(padded + 1, message, length);
+	padded[totalLength] = 0x80;
+	memset(padded + totalLength + 1, 0, (size_t)blocks * SHA256_BLOCK_SIZE - totalLength - 1);
+	sha256StoreBe32(padded + blocks * SHA256_BLOCK_SIZE - 8, (uint32_t)(bitLength >> 32));
+	sha256StoreBe32(padded + blocks * SHA256_BLOCK_SIZE - 4, (uint32_t)bitLength);
+	return blocks;
+}
+
+///-----------------------------------------------------------
+/// \brief Starts a streaming hash
+///
+/// @param1 sha256Context_t *context - context to initialize
+///
+/// @return N/A
+///-----------------------------------------------------------
+void sha256Init(sha256Context_t *context)
+{
+	sha256SelectBackend();
+	memcpy(context->state, sha256H0, sizeof(context->state));
+	context->totalLength = 0;
+	context->bufferLength = 0;
+}
+
+///-----------------------------------------------------------
+/// \brief Absorbs message bytes
+///
+/// @param1 sha256Context_t *context - running hash
+/// @param2 const void *data - message bytes
+/// @param3 size_t length - number of bytes
+///
+/// @return N/A
+///-----------------------------------------------------------
+void sha256Update(sha256Context_t *context, const void *data, size_t length)
+{
+	const uint8_t *bytes = (const uint8_t *)data;
+
+	context->totalLength += length;
+	/// Top up a partially filled block first
+	if (context->bufferLength > 0)
+	{
+		size_t fill = SHA256_BLOCK_SIZE - context->bufferLength;
+		if (fill > length)
+		{
+			fill = length;
+		}
+		memcpy(context->buffer + context->bufferLength, bytes, fill);
+		context->bufferLength += (uint32_t)fill;
+		bytes += fill;
+		length -= fill;
+		if (context->bufferLength < SHA256_BLOCK_SIZE)
+		{
+			return;
+		}
+		sha256Compress(context->state, context->buffer, 1);
+		context->bufferLength = 0;
+	}
+	/// Whole blocks straight from the caller's buffer
+	if (length >= SHA256_BLOCK_SIZE)
+	{
+		size_t blocks = length / SHA256_BLOCK_SIZE;
+		sha256Compress(context->state, bytes, blocks);
+		bytes += blocks * SHA256_BLOCK_SIZE;
+		length -= blocks * SHA256_BLOCK_SIZE;
+	}
+	if (length > 0)
+	{
+		memcpy(context->buffer, bytes, length);
+		context->bufferLength = (uint32_t)length;
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Pads, finishes and outputs the digest
+///
+/// @param1 sha256Context_t *context - running hash
+/// @param2 uint8_t digest[32] - output
+///
+/// @return N/A
+///-----------------------------------------------------------
+void sha256Final(sha256Context_t *context, uint8_t digest[SHA256_DIGEST_SIZE])
+{
+	const uint64_t bitLength = context->totalLength * 8;
+	uint32_t used = context->bufferLength;
+
+	context->buffer[used++] = 0x80;
+	if (used > SHA256_BLOCK_SIZE - 8)
+	{
+		memset(context->buffer + used, 0, SHA256_BLOCK_SIZE - used);
+		sha256Compress(context->state, context->buffer, 1);
+		used = 0;
+	}
+	memset(context->buffer + used, 0, SHA256_BLOCK_SIZE - 8 - used);
+	sha256StoreBe32(context->buffer + SHA256_BLOCK_SIZE - 8, (uint32_t)(bitLength >> 32));
+	sha256StoreBe32(context->buffer + SHA256_BLOCK_SIZE - 4, (uint32_t)bitLength);
+	sha256Compress(context->state, context->buffer, 1);
+
+	for (int i = 0; i < 8; i++)
+	{
+		sha256StoreBe32(digest + 4 * i, context->state[i]);
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief One-shot hash
+///
+/// @param1 const void *data - message bytes
+/// @param2 size_t length - number of bytes
+/// @param3 uint8_t digest[32] - output
+///
+/// @return N/A
+///-----------------------------------------------------------
+void sha256(const void *data, size_t length, uint8_t digest[SHA256_DIGEST_SIZE])
+{
+	sha256Context_t context;
+
+	sha256Init(&context);
+	sha256Update(&context, data, length);
+	sha256Final(&context, digest);
+}
+
+///-----------------------------------------------------------
+/// \brief Hashes count independent prefixed messages:
+///        digests[i] = SHA-256(prefix || messages[i])
+///
+/// @param1 uint8_t prefix - domain separation byte
+/// @param2 const uint8_t *const *messages - message pointers
+/// @param3 const size_t *lengths - message lengths
+/// @param4 uint8_t (*digests)[32] - one digest per message
+/// @param5 int count - number of messages
+///
+/// @return N/A
+///-----------------------------------------------------------
+void sha256ManyPrefixed(uint8_t prefix, const uint8_t *const *messages, const size_t *lengths,
+	uint8_t (*digests)[SHA256_DIGEST_SIZE], int count)
+{
+	static const uint8_t emptyLane[SHA256_MANY_MAX_BLOCKS * SHA256_BLOCK_SIZE];
+	uint8_t padded[SHA256_AVX2_LANES][SHA256_MANY_MAX_BLOCKS * SHA256_BLOCK_SIZE];
+	const uint8_t *lanes[SHA256_AVX2_LANES];
+	uint8_t *outputs[SHA256_AVX2_LANES];
+	int laneBlocks[SHA256_AVX2_LANES];
+	int lanesUsed = 0;
+
+	sha256SelectBackend();
+	for (int i = 0; i < count; i++)
+	{
+		int blocks = sha256PadPrefixed(prefix, messages[i], lengths[i], padded[lanesUsed]);
+		if (blocks == 0)
+		{
+			/// Too long for a lane, stream it
+			sha256Context_t context;
+			sha256Init(&context);
+			sha256Update(&context, &prefix, 1);
+			sha256Update(&context, messages[i], lengths[i]);
+			sha256Final(&context, digests[i]);
+		}
+		else if (!sha256UseAvx2Lanes)
+		{
+			uint32_t state[8];
+			memcpy(state, sha256H0, sizeof(state));
+			sha256Compress(state, padded[lanesUsed], (size_t)blocks);
+			for (int j = 0; j < 8; j++)
+			{
+				sha256StoreBe32(digests[i] + 4 * j, state[j]);
+			}
+		}
+		else
+		{
+			lanes[lanesUsed] = padded[lanesUsed];
+			laneBlocks[lanesUsed] = blocks;
+			outputs[lanesUsed] = digests[i];
+			lanesUsed++;
+		}
+
+		/// Flush a full set of lanes, or the partial set at the end
+		if ((lanesUsed == SHA256_AVX2_LANES) || ((i == count - 1) && (lanesUsed > 0)))
+		{
+			for (int lane = lanesUsed; lane < SHA256_AVX2_LANES; lane++)
+			{
+				lanes[lane] = emptyLane;
+				laneBlocks[lane] = 0;
+				outputs[lane] = NULL;
+			}
+			sha256ManyAvx2(lanes, laneBlocks, outputs);
+			lanesUsed = 0;
+		}
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Name of the selected backend, for reports
+///
+/// @param N/A
+///
+/// @return const char * - "sha-ni", "avx2" or "c"
+///-----------------------------------------------------------
+const char *sha256BackendName(void)
+{
+	sha256SelectBackend();
+	return sha256Backend;
+}
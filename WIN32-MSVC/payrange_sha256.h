@@ -0,0 +1,44 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_sha256.h
+///-----------------------------------------------------------------------------
+///
+/// \brief SHA-256 with SHA-NI and AVX2 multi-buffer acceleration
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_SHA256_H
+#define PAYRANGE_SHA256_H
+
+/// Standard includes
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_DIGEST_SIZE              ( 32 )
+#define SHA256_BLOCK_SIZE               ( 64 )
+/// Longest message (prefix included) hashed by the multi-buffer lanes,
+/// longer messages fall back to the single-buffer path
+#define SHA256_MANY_MAX_BLOCKS          ( 4 )
+
+/// Streaming hash context
+typedef struct
+{
+	uint32_t state[8];
+	uint64_t totalLength;
+	uint8_t  buffer[SHA256_BLOCK_SIZE];
+	uint32_t bufferLength;
+}sha256Context_t;
+
+/// Streaming interface
+void sha256Init(sha256Context_t *context);
+void sha256Update(sha256Context_t *context, const void *data, size_t length);
+void sha256Final(sha256Context_t *context, uint8_t digest[SHA256_DIGEST_SIZE]);
+/// One-shot hash of a contiguous buffer
+void sha256(const void *data, size_t length, uint8_t digest[SHA256_DIGEST_SIZE]);
+/// Hashes count independent messages, each preceded by the one byte prefix.
+/// Uses SHA-NI when available, 8-lane AVX2 otherwise, then plain C.
+void sha256ManyPrefixed(uint8_t prefix, const uint8_t *const *messages, const size_t *lengths,
+	uint8_t (*digests)[SHA256_DIGEST_SIZE], int count);
+/// Name of the compression backend in use ("sha-ni", "avx2", "c")
+const char *sha256BackendName(void);
+
+#endif /// PAYRANGE_SHA256_H
@@ -38,6 +38,7 @@
 /// Standard includes
 #include <stdio.h>
 #include <inttypes.h>
+#include <string.h>
 #include <conio.h>
 
 /// Kernel includes
@@ -46,18 +47,30 @@
 #include <queue.h>
 #include <timers.h>
 
+/// PayRange includes
+#include "payrange.h"
+#include "payrange_elog.h"
+#include "payrange_csprng.h"
+#include "payrange_state.h"
+#include "payrange_ingest.h"
+#include "payrange_admit.h"
+#include "payrange_ahistory.h"
+#include "payrange_time.h"
+#include "payrange_profile.h"
+#include "payrange_heap.h"
+#include "payrange_listf.h"
+#include "payrange_atomic.h"
+#include "payrange_config.h"
+#include "payrange_eindex.h"
+#include "payrange_mvcc.h"
+#include "payrange_cdc.h"
+#include "payrange_repl.h"
+#include "payrange_rpc.h"
+
 /// Priorities at which the tasks are created
 #define mainCHECK_TASK_PRIORITY			( configMAX_PRIORITIES - 2 )
 #define ENABLE_DEBUG_PRINTS
 
-/// Project Configurable defines
-#define TASK_A_RUNTIME_IN_MS			( 250 )
-#define TASK_B_RUNTIME_IN_MS			( 5000 )
-#define KEYBOARD_TASK_DELAY_IN_MS       ( 5 )
-#define NUMBER_OF_ALPHANUMERIC_DIGITS   ( 8 )
-#define SIZE_OF_THE_TASK_B_ARRAY		( 5 )
-#define SIZE_OF_VALUE_E_STRUCTURE       ( 7 )
-
 #ifdef noENABLE_DEBUG_PRINTS
 #define DEBUGPRINT						printf
 #else
@@ -73,43 +86,52 @@ static void privateTaskA(void *pvParameters);
 static void privateTaskB(void *pvParameters);
 /// Keaboard Task Listener - can be substituted by an interrupt on a real system
 static void keyboardTrackTask(void *pvParameters);
+/// E writer task, pairs queued captures with B and stores them in batches
+static void eWriterTask(void *pvParameters);
 /// C Key Pressed handler
-static void handleInterruptC(void);
+static void handleInterruptC(TickType_t pressedAt);
+/// Hands deferred console captures to the E writer as admission allows
+static void submitConsoleCaptures(void);
 /// G Key Pressed handler
 static void handleInterruptG(void);
+/// V Key Pressed handler
+static void handleInterruptV(void);
+/// R Key Pressed handler
+static void handleInterruptR(void);
+/// T Key Pressed handler
+static void handleInterruptT(void);
+/// Pairs a batch of captures with B and stores the E values
+static void storeCapturesE(const captureRequest_t *captures, int count);
 /// File Write Function
-static void writeToFileE(int slotToWrite);
-/// Structure for Task B array of alphanumerics and time
-typedef struct
-{
-	TickType_t stringTime;
-	char stringPlacer[8];
-}taskBStructure_t;
-/// Structure for D (Value A + Time)
-typedef struct
-{
-	TickType_t randomNumberTime;
-	int64_t    randomNumber;
-}valueD_t;
-/// Structure for E (Value B + Value D)
-typedef struct
-{
-	taskBStructure_t randomValueB;
-	valueD_t         currentValueD;
-}valueE_t;
+static void writeToFileE(const valueE_t *records, int count);
+/// Consistent copy of a B list slot
+static void readSlotB(int slot, taskBStructure_t *valueB);
 
 /// Global task handles for suspension and other operations
 TaskHandle_t xTaskAHandle;
 TaskHandle_t xTaskBHandle;
 TaskHandle_t xKeyboardTaskHandle;
+TaskHandle_t xEWriterTaskHandle;
+/// Captures (C key and remote terminals) waiting for the E writer
+QueueHandle_t xCaptureQueue;
+/// Console captures waiting for admission, oldest first; D is stamped at the
+/// key press, a deferred capture keeps it
+static captureRequest_t consoleCaptures[ADMIT_CONSOLE_DEFER_DEPTH];
+static TickType_t consoleCapturedAt[ADMIT_CONSOLE_DEFER_DEPTH];
+static int consoleCaptureHead = 0;
+static int consoleCaptureCount = 0;
+/// The head capture has been asked about and deferred
+static int consoleCaptureDeferred = 0;
 /// Global access for randomly generated number from Task A
-int64_t currentRandomNumberFromTaskA;
-/// Global access for Task B Structure for pairing
-taskBStructure_t taskBStructure[SIZE_OF_THE_TASK_B_ARRAY];
-/// Global access for Value E structure
-valueE_t valueEStructure[SIZE_OF_VALUE_E_STRUCTURE];
-/// Global line number counter for file E.txt
-int fileELineNumber;
+volatile int64_t currentRandomNumberFromTaskA;
+/// Persistent state: B list, list F, E.txt line counter and E log writer
+payrangeState_t *payrangeState;
+/// Global access for Task B Structure for pairing (lives in the state file)
+taskBStructure_t *taskBStructure;
+/// One sequence lock per B list slot. Task B is the only writer, readers
+/// copy a slot and retry if it changed. List F has its own index
+/// (payrange_listf.h).
+static seqlock_t taskBLocks[MAX_SIZE_OF_THE_TASK_B_ARRAY];
 ///-----------------------------------------------------------
 /// \brief This is the main function that starts the tasks
 ///        initiates the interrupts and starts the RTOS scheduler
@@ -120,12 +142,47 @@ int fileELineNumber;
 ///-----------------------------------------------------------
 int main_payrange( void )
 {
-	/// Initialize the line number counter
-	fileELineNumber = 0;
+	payrangeConfig_t config;
+
+	/// Map the state of the previous run; the line number counter, B list and
+	/// list F continue where it stopped (all zero on a cold start)
+	payrangeState = stateOpen();
+	/// Anchor the tick counter to UTC before any B or D is stamped
+	timeInit();
+	taskBStructure = payrangeState->taskB;
+	listFInit(payrangeState->valueE, &payrangeState->valueECapacity);
+	/// Periods and list sizes, re-read whenever the config file changes
+	configInit();
+	/// Both lists are versioned from here on, for time travel queries
+	configGet(&config);
+	mvccInit(taskBStructure, config.taskBSlots, payrangeState->valueE, payrangeState->valueECapacity);
+	/// The A to E index picks up where the E log stopped
+	eIndexInit(&payrangeState->eindex);
+	elogAttachState(&payrangeState->elog);
+	/// Change events keep their offsets across restarts
+	cdcAttachState(&payrangeState->cdcNextOffset);
+	/// All captures go through one queue to the E writer
+	xCaptureQueue = xQueueCreate(CAPTURE_QUEUE_LENGTH, sizeof(captureRequest_t));
+	configASSERT(xCaptureQueue != NULL);
 	/// Create the 2 random value generating tasks with default stack and priority
 	xTaskCreate(privateTaskA, "TaskA", configMINIMAL_STACK_SIZE, NULL, mainCHECK_TASK_PRIORITY, &xTaskAHandle);
 	xTaskCreate(privateTaskB, "TaskB", configMINIMAL_STACK_SIZE, NULL, mainCHECK_TASK_PRIORITY, &xTaskBHandle);
 	xTaskCreate(keyboardTrackTask, "Keyboard", configMINIMAL_STACK_SIZE, NULL, mainCHECK_TASK_PRIORITY, &xKeyboardTaskHandle);
+	/// E writer and the gateway feeding it captures from remote terminals
+	xTaskCreate(eWriterTask, "EWriter", configMINIMAL_STACK_SIZE, NULL, mainCHECK_TASK_PRIORITY, &xEWriterTaskHandle);
+	ingestCreateTask(xCaptureQueue, mainCHECK_TASK_PRIORITY);
+	/// Captures and lookups that are answered, for latency measurements
+	rpcCreateTask(xCaptureQueue, mainCHECK_TASK_PRIORITY);
+	/// Flushes the state file to disk in the background
+	stateCreateSyncTask();
+	/// Keeps the tick/UTC anchor fresh
+	timeCreateTask();
+	/// Applies changes of the config file to the running tasks
+	configCreateTask();
+	/// Writes the A to E index runs and merges them in the background
+	eIndexCreateTask();
+	/// Ships sealed E log blocks to a standby, when one is running
+	replCreateTask();
 	///Debug check for FreeRTOS. Fail in case any task/timer creation has failed.
 	configASSERT(privateTaskA != NULL || privateTaskB != NULL);
 
@@ -146,8 +203,8 @@ int main_payrange( void )
 ///-----------------------------------------------------------
 static int generateIntRandomNumber(int max)
 {
-	/// Generate the random number with a standard C random generator
-	return (rand() % max);
+	/// Generate the random number with the buffered CSPRNG, free of modulo bias
+	return (int)csprngUniform((uint32_t)max);
 }
 ///-----------------------------------------------------------
 /// \brief Generic function to return a random alphanumeric
@@ -170,21 +227,15 @@ void generateRandomString(char *generatedRandomString, int length)
 		{
 			/// Determine the length of the character set
 			int charsetLength = (int)(sizeof(charset) - 1);
-			/// Generate the random alphanumeric one by one
-			for (int i = 0; i < length; i++)
-			{
-				int charKey = rand() % charsetLength;
-				generatedRandomString[i] = charset[charKey];
-			}
-			/// Finish up the string with the line termination
-			generatedRandomString[length] = '\0';
+			/// B strings act as tokens, so they come from the CSPRNG (NUL terminated)
+			csprngString(generatedRandomString, length, charset, charsetLength);
 		}
 	}
 }
 
 ///-----------------------------------------------------------
 /// \brief This is the handler for Task A, generates a random
-///        12 digit number every 250 ms
+///        12 digit number every configured period (250 ms)
 ///
 /// @param 1 void *pvParameters - placeholder for FreeRTOS
 ///                               Task parameters
@@ -194,7 +245,7 @@ void generateRandomString(char *generatedRandomString, int length)
 static void privateTaskA( void *pvParameters )
 {
 	/// Local Variables
-	const TickType_t xCycleFrequency = TASK_A_RUNTIME_IN_MS / portTICK_PERIOD_MS;
+	payrangeConfig_t config;
 	int64_t generatedRandomNumber;
 
 	/// Just to remove compiler warning.
@@ -204,16 +255,18 @@ static void privateTaskA( void *pvParameters )
 	for (;;)
 	{
 		/// Generate the 12 digit random number
-		generatedRandomNumber = rand();
-		generatedRandomNumber = (generatedRandomNumber << 32 | rand());
-		generatedRandomNumber = (generatedRandomNumber % (899999999999)) + 100000000000;
+		generatedRandomNumber = (int64_t)csprngUniform64(900000000000) + 100000000000;
 		currentRandomNumberFromTaskA = generatedRandomNumber;
 		///Debug assert if the generated number is not 12 digits
 		configASSERT((generatedRandomNumber > 100000000000) || (generatedRandomNumber < 1000000000000));
+		/// Captures resolve their D against the time each A appeared on screen;
+		/// stamped before the print, so a key seen from here on gets this A
+		aHistoryPush(generatedRandomNumber, xTaskGetTickCount());
 		/// Required print per instructions
 		printf("A-Thread Random Number: %" PRIu64 "\n", (int64_t)generatedRandomNumber);
-		///Simulated Sleep for 250ms
-		vTaskDelay(xCycleFrequency);
+		///Simulated Sleep for the configured period, a change applies here
+		configGet(&config);
+		vTaskDelay(config.taskAPeriodMs / portTICK_PERIOD_MS);
 	}
 }
 
@@ -230,11 +283,15 @@ static void privateTaskA( void *pvParameters )
 static void privateTaskB( void *pvParameters )
 {
 	///Local Variables
-	char taskBRandomString[NUMBER_OF_ALPHANUMERIC_DIGITS - 1];
+	char taskBRandomString[NUMBER_OF_ALPHANUMERIC_DIGITS + 1];
 	char(*randomStringPointer);
 	randomStringPointer = taskBRandomString;
 	int randomSlot;
 	TickType_t currentTickTime;
+	uint64_t stringTimeUtcNs;
+	taskBStructure_t replacedB;
+	payrangeConfig_t config;
+	uint32_t slotsInUse = MAX_SIZE_OF_THE_TASK_B_ARRAY;
 
 	/// Just to remove compiler warnings
 	( void ) pvParameters;
@@ -246,23 +303,54 @@ static void privateTaskB( void *pvParameters )
 		generateRandomString(randomStringPointer, NUMBER_OF_ALPHANUMERIC_DIGITS);
 		DEBUGPRINT("Random String generated by Task B is %s \n", taskBRandomString);
 
+		/// Empty the slots dropped by a smaller configured B list, so that
+		/// growing it again does not bring back old B values
+		configGet(&config);
+		while (slotsInUse > config.taskBSlots)
+		{
+			slotsInUse--;
+			if (taskBStructure[slotsInUse].stringTime != 0)
+			{
+				mvccRecordB(slotsInUse, NULL);
+				cdcEmitB(slotsInUse, &taskBStructure[slotsInUse], NULL);
+			}
+			seqlockWriteBegin(&taskBLocks[slotsInUse]);
+			memset(&taskBStructure[slotsInUse], 0, sizeof(taskBStructure[slotsInUse]));
+			seqlockWriteEnd(&taskBLocks[slotsInUse]);
+			stateMarkDirty();
+		}
+		if (slotsInUse != config.taskBSlots)
+		{
+			mvccRecordSlots(MVCC_LIST_B, config.taskBSlots);
+		}
+		slotsInUse = config.taskBSlots;
+
 		/// Get Current Timer/Tick Count
 		currentTickTime = xTaskGetTickCount();
-		/// Determine the random slot for storing - total 5 slots (0-4)
-		randomSlot = generateIntRandomNumber(SIZE_OF_THE_TASK_B_ARRAY - 1);
+		/// Determine the random slot for storing, any of the configured slots
+		randomSlot = generateIntRandomNumber((int)config.taskBSlots);
 		/// Copy over the generated string and time to the array
+		stringTimeUtcNs = timeTickToUtcNs(currentTickTime);
+		/// Task B is the only writer, the slot can be read without the lock
+		replacedB = taskBStructure[randomSlot];
+		seqlockWriteBegin(&taskBLocks[randomSlot]);
 		taskBStructure[randomSlot].stringTime = currentTickTime;
-		strcpy(taskBStructure[randomSlot].stringPlacer, taskBRandomString);
+		taskBStructure[randomSlot].stringTimeUtcNs = stringTimeUtcNs;
+		memcpy(taskBStructure[randomSlot].stringPlacer, taskBRandomString, sizeof(taskBRandomString));
+		seqlockWriteEnd(&taskBLocks[randomSlot]);
+		mvccRecordB((uint32_t)randomSlot, &taskBStructure[randomSlot]);
+		cdcEmitB((uint32_t)randomSlot, (replacedB.stringTime != 0) ? &replacedB : NULL, &taskBStructure[randomSlot]);
+		stateMarkDirty();
 
 #ifdef ENABLE_DEBUG_PRINTS
 		/// Debug Check
-		for (int i = 0; i < SIZE_OF_THE_TASK_B_ARRAY;i++)
+		for (int i = 0; i < (int)config.taskBSlots;i++)
 		{
 			DEBUGPRINT("String %d is %d %s \n", i, taskBStructure[i].stringTime, taskBStructure[i].stringPlacer);
 		}
 #endif //ENABLE_DEBUG_PRINTS
-		///Simulated Sleep for 5 seconds
-		vTaskDelay(TASK_B_RUNTIME_IN_MS);
+		///Simulated Sleep for the configured period (5 seconds)
+		vTaskDelay(config.taskBPeriodMs / portTICK_PERIOD_MS);
 	}
 }
 ///-----------------------------------------------------------
@@ -276,6 +364,8 @@ static void privateTaskB( void *pvParameters )
 ///-----------------------------------------------------------
 static void keyboardTrackTask(void *pvParameters)
 {
+	payrangeConfig_t config;
+
 	/// Just to remove compiler warnings
 	(void)pvParameters;
 
@@ -283,11 +373,21 @@ static void keyboardTrackTask(void *pvParameters)
 	for (;;)
 	{
 		/// Delay the task immediatelly. Most Frequest listener task
-		vTaskDelay(KEYBOARD_TASK_DELAY_IN_MS);
+		configGet(&config);
+		vTaskDelay(config.keyboardDelayMs / portTICK_PERIOD_MS);
+		/// Seal the open E log block once it has been waiting long enough
+		elogPoll(xTaskGetTickCount());
+		/// Retry the console captures that were over the rate
+		submitConsoleCaptures();
 		/// Wait for the keyboard press - not a standard embedded implementation,
 		/// but for all intents and purposes of this challenge, it works.
 		if (_kbhit())
 		{
+			/// Timestamp the key when this poll sees it, before any handling. The
+			/// press itself may be up to one keyboard delay older: _kbhit() gives
+			/// no arrival time. On a real system the keyboard interrupt would take
+			/// this tick.
+			TickType_t keyPressedAt = xTaskGetTickCount();
 			/// Extract the pressed keyboard key. Again, not a standard embedded FW way
 			/// but this works in the Visual Studio simulation mode
 			int keyboardKey = _getch();
@@ -296,14 +396,60 @@ static void keyboardTrackTask(void *pvParameters)
 				/// Cases for C key pressed
 				case 67:
 				case 99:
-					/// Get Current Timer/Tick Count
-					handleInterruptC();
+					handleInterruptC(keyPressedAt);
 					break;
                 /// Cases for G key pressed
 				case 71:
 				case 103:
 					handleInterruptG();
 					break;
+				/// Cases for V key pressed
+				case 86:
+				case 118:
+					handleInterruptV();
+					break;
+				/// Cases for R key pressed - resize List F
+				case 82:
+				case 114:
+					handleInterruptR();
+					break;
+				/// Cases for T key pressed - B list and List F at a past tick
+				case 84:
+				case 116:
+					handleInterruptT();
+					break;
+				/// Cases for M key pressed - B list and List F change events
+				case 77:
+				case 109:
+					cdcPrintConsole();
+					break;
+				/// Cases for S key pressed - E log shipping and standby lag
+				case 83:
+				case 115:
+					replPrintStats();
+					break;
+				/// Cases for I key pressed - gateway and admission counters
+				case 73:
+				case 105:
+					ingestPrintStats();
+					rpcPrintStats();
+					admitPrintStats();
+					break;
+				/// Cases for P key pressed - start/stop the sampling profiler
+				case 80:
+				case 112:
+					profileToggle();
+					break;
+				/// Cases for H key pressed - dump the per-task heap accounts
+				case 72:
+				case 104:
+					heapPrintAccounts();
+					break;
+				/// Cases for L key pressed - rank the critical sections
+				case 76:
+				case 108:
+					criticalPrintReport();
+					break;
                 /// Catch all the rest of the keys, just in case
 				default:
 					DEBUGPRINT("Illegal Key. The key pressed was %d\n", keyboardKey);
@@ -314,110 +460,243 @@ static void keyboardTrackTask(void *pvParameters)
 }
 ///-----------------------------------------------------------
 /// \brief This is the handler for Interrupt C - C key pressed
-///         on the keyboard. Saves Value D and E. All storage 
-///         and handling is local.
+///         on the keyboard. Captures Value D and hands it to
+///         the E writer through admission control, like a
+///         capture from a remote terminal. D pairs the tick
+///         the keyboard poll saw the key at with the A that was
+///         on screen at that tick, even if a newer A came out
+///         while the key was being handled. A press shortly
+///         before an A change can still get the newer A when
+///         the poll only sees it after the change.
 ///
-/// @param N/A
+/// @param1 TickType_t pressedAt - tick at which the poll saw the key
 ///
 /// @return N/A
 ///-----------------------------------------------------------
-static void handleInterruptC(void)
+static void handleInterruptC(TickType_t pressedAt)
 {
-	int randomSlotB;
-	int randomSlotF;
-	BOOL foundValidValueB = FALSE;
+	static uint32_t consoleSequence = 0;
 	/// Local Variables
-	valueD_t valueDStructure;
+	captureRequest_t capture;
+	int slot;
 
-	TickType_t currentTickTime;
-	/// Get the current timer
-	currentTickTime = xTaskGetTickCount();
 	/// Save off the Value D
-	valueDStructure.randomNumber = currentRandomNumberFromTaskA;
-	valueDStructure.randomNumberTime = currentTickTime;
+	capture.source = CAPTURE_SOURCE_CONSOLE;
+	capture.sequence = consoleSequence++;
+	capture.valueD.randomNumberTime = pressedAt;
+	capture.valueD.randomNumberTimeUtcNs = timeTickToUtcNs(pressedAt);
+	if (!aHistoryLookup(pressedAt, &capture.valueD.randomNumber, NULL))
+	{
+		/// Pressed before the first A was shown
+		capture.valueD.randomNumber = currentRandomNumberFromTaskA;
+	}
+	DEBUGPRINT("C Key pressed! Time: %d, Value: %" PRIu64 "\n", capture.valueD.randomNumberTime, capture.valueD.randomNumber);
 
-	/// Create value E (pair value D with Value B)
-	/// Find a valid Value B
-	while (!foundValidValueB)
+	if (consoleCaptureCount == ADMIT_CONSOLE_DEFER_DEPTH)
+	{
+		admitShed(CAPTURE_SOURCE_CONSOLE);
+		printf("C capture shed, %d captures are already waiting\n", ADMIT_CONSOLE_DEFER_DEPTH);
+		return;
+	}
+	/// Queue it behind the captures that are still waiting, order is kept
+	slot = (consoleCaptureHead + consoleCaptureCount) % ADMIT_CONSOLE_DEFER_DEPTH;
+	consoleCaptures[slot] = capture;
+	consoleCapturedAt[slot] = capture.valueD.randomNumberTime;
+	consoleCaptureCount++;
+	submitConsoleCaptures();
+}
+
+///-----------------------------------------------------------
+/// \brief Passes waiting console captures to the E writer, in
+///         order, until admission control defers one or the
+///         capture queue is full. Shed captures are dropped.
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void submitConsoleCaptures(void)
+{
+	while ((consoleCaptureCount > 0) && (uxQueueSpacesAvailable(xCaptureQueue) > 0))
 	{
-		randomSlotB = generateIntRandomNumber(SIZE_OF_THE_TASK_B_ARRAY);
-		if (taskBStructure[randomSlotB].stringTime == 0)
+		const captureRequest_t *capture = &consoleCaptures[consoleCaptureHead];
+		admitOutcome_t outcome = admitRequest(CAPTURE_SOURCE_CONSOLE,
+			consoleCaptureDeferred ? &consoleCapturedAt[consoleCaptureHead] : NULL);
+
+		if (outcome == ADMIT_DEFER)
+		{
+			consoleCaptureDeferred = 1;
+			return;
+		}
+		if (outcome == ADMIT_ADMIT)
 		{
-			DEBUGPRINT("Random Slot B value invalid %d \n", randomSlotB);
-			/// Do nothing. Structure B slot hasn't been populated
+			/// The gateway may have taken the last slot, keep the capture
+			if (xQueueSend(xCaptureQueue, capture, 0) != pdPASS)
+			{
+				return;
+			}
 		}
 		else
 		{
-			/// Exit the randomization loop. Value is found.
-			DEBUGPRINT("Found a valid Slot B Value %d \n", randomSlotB);
-			foundValidValueB = TRUE;
+			printf("C capture shed, the console is over its capture rate\n");
 		}
+		consoleCaptureDeferred = 0;
+		consoleCaptureHead = (consoleCaptureHead + 1) % ADMIT_CONSOLE_DEFER_DEPTH;
+		consoleCaptureCount--;
 	}
+}
 
-	/// Determine the random slot for storing - total 5 slots (0-4)
-	randomSlotF = generateIntRandomNumber(SIZE_OF_VALUE_E_STRUCTURE - 1);
-	/// Store the vales into the E structure into the List F slot
-	valueEStructure[randomSlotF].randomValueB.stringTime = taskBStructure[randomSlotB].stringTime;
-	strcpy(valueEStructure[randomSlotF].randomValueB.stringPlacer, taskBStructure[randomSlotB].stringPlacer);
-	valueEStructure[randomSlotF].currentValueD.randomNumber = valueDStructure.randomNumber;
-	valueEStructure[randomSlotF].currentValueD.randomNumberTime = valueDStructure.randomNumberTime;
+///-----------------------------------------------------------
+/// \brief This is the E writer task. Waits for captures and
+///         takes everything queued behind the first one (up
+///         to CAPTURE_BATCH_SIZE), so a burst costs one file
+///         flush instead of one per capture.
+///
+/// @param 1 void *pvParameters - placeholder for FreeRTOS
+///                               Task parameters
+///
+/// @return None - Task always runs without a return
+///-----------------------------------------------------------
+static void eWriterTask(void *pvParameters)
+{
+	const TickType_t xMaintenancePoll = LISTF_MAINTENANCE_POLL_MS / portTICK_PERIOD_MS;
+	captureRequest_t captures[CAPTURE_BATCH_SIZE];
+	TickType_t xWait = xMaintenancePoll;
+	int count;
 
-	/// Write the contents of E into the E.txt
-	writeToFileE(randomSlotF);
+	/// Just to remove compiler warnings
+	(void)pvParameters;
 
-	DEBUGPRINT("C Key pressed! Time: %d, Value: %" PRIu64 "\n", valueDStructure.randomNumberTime, valueDStructure.randomNumber);
-	DEBUGPRINT("Selected B is %d String %s Time %d slot %d\n", randomSlotB, valueEStructure[randomSlotF].randomValueB.stringPlacer, valueEStructure[randomSlotF].randomValueB.stringTime, randomSlotF);
+	for (;;)
+	{
+		/// Without captures, a List F resize moves on one step per tick
+		if (xQueueReceive(xCaptureQueue, &captures[0], xWait) != pdPASS)
+		{
+			xWait = listFMaintain() ? 1 : xMaintenancePoll;
+			continue;
+		}
+		count = 1;
+		while ((count < CAPTURE_BATCH_SIZE) && (xQueueReceive(xCaptureQueue, &captures[count], 0) == pdPASS))
+		{
+			count++;
+		}
+		storeCapturesE(captures, count);
+		/// Answers the request gateway's captures of the batch
+		rpcCapturesStored(captures, count);
+	}
 }
 
 ///-----------------------------------------------------------
-/// \brief This is the function that saves value E to "E.txt"
-///        along with the line number
+/// \brief Pairs every capture (Value D) with a random B to
+///         make Value E, stores it in a random List F slot and
+///         writes the batch to E.txt
 ///
-/// @param int slotToWrite
+/// @param1 const captureRequest_t *captures - captured D values
+/// @param2 int count - number of captures
 ///
 /// @return N/A
 ///-----------------------------------------------------------
-static void writeToFileE(int slotToWrite)
+static void storeCapturesE(const captureRequest_t *captures, int count)
 {
-	FILE *fileE;
-	/// Handle file operations in a critical section to avoid corruption
-	/// Check if the E.txt file already exists
-
-	portENTER_CRITICAL();
-	
-	fileE = fopen("E.txt", "r");
-	if ((fileE != NULL) && (fileELineNumber != 0))
+	valueE_t records[CAPTURE_BATCH_SIZE];
+	taskBStructure_t valueB;
+	payrangeConfig_t config;
+	int randomSlotB;
+	int randomSlotF;
+
+	configGet(&config);
+
+	for (int i = 0; i < count; i++)
 	{
-		/// File exists from the current session, need to append
-		fclose(fileE);
-		fileE = fopen("E.txt", "a");
+		BOOL foundValidValueB = FALSE;
+		/// Create value E (pair value D with Value B)
+		/// Find a valid Value B
+		while (!foundValidValueB)
+		{
+			randomSlotB = generateIntRandomNumber((int)config.taskBSlots);
+			readSlotB(randomSlotB, &valueB);
+			if (valueB.stringTime == 0)
+			{
+				DEBUGPRINT("Random Slot B value invalid %d \n", randomSlotB);
+				/// Structure B slot hasn't been populated, give Task B a chance to run
+				vTaskDelay(1);
+			}
+			else
+			{
+				/// Exit the randomization loop. Value is found.
+				DEBUGPRINT("Found a valid Slot B Value %d \n", randomSlotB);
+				foundValidValueB = TRUE;
+			}
+		}
+
+		/// Determine the random slot for storing, any of the current List F slots
+		randomSlotF = generateIntRandomNumber((int)listFCapacity());
+		/// Store the vales into the E structure into the List F slot
+		records[i].randomValueB = valueB;
+		records[i].currentValueD = captures[i].valueD;
+		listFStore((uint32_t)randomSlotF, &records[i]);
+
+		DEBUGPRINT("Selected B is %d String %s Time %d slot %d\n", randomSlotB, records[i].randomValueB.stringPlacer, records[i].randomValueB.stringTime, randomSlotF);
 	}
-	else
+
+	/// Write the contents of E into the E.txt
+	writeToFileE(records, count);
+}
+
+///-----------------------------------------------------------
+/// \brief This is the function that saves a batch of value E
+///        to "E.txt" along with the line numbers. The E log
+///        seals the records in blocks for tamper evidence.
+///        In sync replication mode it returns once the standby
+///        holds the batch.
+///
+/// @param1 const valueE_t *records - E values in capture order
+/// @param2 int count - number of records
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void writeToFileE(const valueE_t *records, int count)
+{
+	payrangeConfig_t config;
+
+	/// The E log serialises its file operations with its own mutex, and only
+	/// the E writer moves the line number, so no critical section is needed
+	elogAppendBatch(payrangeState->fileELineNumber, records, count);
+	payrangeState->fileELineNumber += count;
+	stateMarkDirty();
+	/// Sync replication: the batch is committed once the standby has it too
+	configGet(&config);
+	if (config.replSync)
 	{
-		/// File doesn't exist or an old version of the file is present, create new and overwrite
-		fclose(fileE);
-		fileE = fopen("E.txt", "w");
+		replWaitDurable((uint32_t)payrangeState->fileELineNumber);
 	}
-	
-	configASSERT(fileE != NULL);
-	
-	///No Specific order has been listed for Value E, so writing the contents in structure order
-	fprintf(fileE, "Line %d: %d %s %d %"PRIu64"\n", fileELineNumber,
-		valueEStructure[slotToWrite].randomValueB.stringTime,
-		valueEStructure[slotToWrite].randomValueB.stringPlacer,
-		valueEStructure[slotToWrite].currentValueD.randomNumberTime,
-		valueEStructure[slotToWrite].currentValueD.randomNumber);
-	fileELineNumber++;
-    fclose(fileE);
-
-	/// Exit the critical session. File operations are over
-	portEXIT_CRITICAL();
+}
+
+///-----------------------------------------------------------
+/// \brief Copies a B list slot, retrying while Task B is
+///         writing it
+///
+/// @param1 int slot - B list slot
+/// @param2 taskBStructure_t *valueB - output
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void readSlotB(int slot, taskBStructure_t *valueB)
+{
+	uint32_t sequence;
+
+	do
+	{
+		sequence = seqlockReadBegin(&taskBLocks[slot]);
+		*valueB = taskBStructure[slot];
+	} while (seqlockReadRetry(&taskBLocks[slot], sequence));
 }
 
 ///-----------------------------------------------------------
 /// \brief This is the handler for Interrupt G - G key pressed
 ///         on the keyboard. Pauses A Thread, does E look-up
-///         based on the value of A
+///         based on the value of A: List F, then the whole E
+///         history through the A to E index
 ///
 /// @param N/A
 ///
@@ -425,7 +704,12 @@ static void writeToFileE(int slotToWrite)
 ///-----------------------------------------------------------
 static void handleInterruptG(void)
 {
+	static int listFReader = -1;
+	static valueE_t listFMatches[MAX_SIZE_OF_VALUE_E_STRUCTURE];
+	static eIndexEntry_t historyMatches[EINDEX_LOOKUP_MAX_RESULTS];
+	static char historyLine[ELOG_MAX_LINE_LENGTH];
 	int64_t userInputAValue;
+	int matches;
 	BOOL userInputFound = FALSE;
 	/// Suspend Task A
 	vTaskSuspend(xTaskAHandle);
@@ -435,15 +719,18 @@ static void handleInterruptG(void)
 
 	DEBUGPRINT("Value inputted is %" PRIu64 "\n", userInputAValue);
 
-	/// Look up the E based on the A number
-	for (int i = 0; i < (SIZE_OF_VALUE_E_STRUCTURE - 1); i++)
+	/// Look up the E based on the A number in the List F index
+	if (listFReader < 0)
 	{
-		if (userInputAValue == valueEStructure[i].currentValueD.randomNumber)
-		{
-			///Found the value, print it
-			printf("E Value Found. Corresponding B Time = %d, B String = %s", valueEStructure[i].randomValueB.stringTime, valueEStructure[i].randomValueB.stringPlacer);
-			userInputFound = TRUE;
-		}
+		listFReader = listFReaderRegister();
+		configASSERT(listFReader >= 0);
+	}
+	matches = listFLookup(listFReader, userInputAValue, listFMatches, MAX_SIZE_OF_VALUE_E_STRUCTURE);
+	for (int i = 0; i < matches; i++)
+	{
+		///Found the value, print it
+		printf("E Value Found. Corresponding B Time = %d, B String = %s", listFMatches[i].randomValueB.stringTime, listFMatches[i].randomValueB.stringPlacer);
+		userInputFound = TRUE;
 	}
 	/// Print "Not Found" if the value was not found
 	if (userInputFound == FALSE)
@@ -451,6 +738,103 @@ static void handleInterruptG(void)
 		
 		printf("Value %" PRIu64 " was not found in List F \n", userInputAValue);
 	}
+
+	/// Every E record of the code, a few page reads however long the history
+	matches = eIndexLookup(userInputAValue, historyMatches, EINDEX_LOOKUP_MAX_RESULTS);
+	printf("Value %" PRIu64 " has %d%s records in the E history\n", userInputAValue, matches,
+		(matches == EINDEX_LOOKUP_MAX_RESULTS) ? " or more" : "");
+	for (int i = 0; i < matches; i++)
+	{
+		if (elogReadLine(historyMatches[i].block, historyMatches[i].line, historyLine, sizeof(historyLine)))
+		{
+			printf("  %s\n", historyLine);
+		}
+		else
+		{
+			printf("  Line %u: not readable in block %u\n", (unsigned int)historyMatches[i].line,
+				(unsigned int)historyMatches[i].block);
+		}
+	}
+	eIndexPrintStats();
 	/// Resume the A Thread
 	vTaskResume(xTaskAHandle);
-}
\ No newline at end of file
+}
+
+///-----------------------------------------------------------
+/// \brief This is the handler for Interrupt R - R key pressed
+///         on the keyboard. Pauses A Thread and asks for the
+///         new List F size; the E writer migrates to it in
+///         steps while capture goes on
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void handleInterruptR(void)
+{
+	unsigned int userInputCapacity = 0;
+
+	/// Suspend Task A
+	vTaskSuspend(xTaskAHandle);
+	listFPrintStats();
+	printf("\n Please enter the new List F size (1-%d): ", MAX_SIZE_OF_VALUE_E_STRUCTURE);
+	scanf("%u", &userInputCapacity);
+
+	if (listFRequestResize(userInputCapacity))
+	{
+		printf("List F is being resized to %u slots\n", userInputCapacity);
+	}
+	else
+	{
+		printf("List F size %u is out of range\n", userInputCapacity);
+	}
+	/// Resume the A Thread
+	vTaskResume(xTaskAHandle);
+}
+
+///-----------------------------------------------------------
+/// \brief This is the handler for Interrupt T - T key pressed
+///         on the keyboard. Pauses A Thread and prints the B
+///         list and List F as they were at the tick entered,
+///         e.g. the D Time of a disputed E
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void handleInterruptT(void)
+{
+	unsigned int userInputTick = 0;
+
+	/// Suspend Task A
+	vTaskSuspend(xTaskAHandle);
+	printf("\n Please enter the tick (now %u): ", (unsigned int)xTaskGetTickCount());
+	scanf("%u", &userInputTick);
+	mvccPrintStateAt((TickType_t)userInputTick);
+	/// Resume the A Thread
+	vTaskResume(xTaskAHandle);
+}
+
+///-----------------------------------------------------------
+/// \brief This is the handler for Interrupt V - V key pressed
+///         on the keyboard. Seals the open block and verifies
+///         the E log seals and hash chain
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void handleInterruptV(void)
+{
+#if ELOG_ENCRYPT_AT_REST
+	const char *path = ELOG_ENCRYPTED_FILE_NAME;
+#else
+	const char *path = ELOG_FILE_NAME;
+#endif
+	elogVerifyReport_t report;
+
+	/// Seal whatever is pending so every record written so far is covered
+	elogSealBlock();
+	elogVerifyFile(path, &report);
+	elogPrintVerifyReport(path, &report);
+}
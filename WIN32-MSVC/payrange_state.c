@@ -0,0 +1,213 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_state.c
+///-----------------------------------------------------------------------------
+///
+/// \brief Memory-mapped state file
+///
+/// The state file is mapped once at start-up and the tasks keep working on
+/// the mapped memory, so a restart costs one open, one map and a header
+/// check, however long the E history is. Writes reach the OS page cache
+/// immediately (and survive a crash of the simulator); the sync task pushes
+/// dirty pages to the disk in the background at most once per
+/// STATE_SYNC_INTERVAL_MS, so no task ever waits for the disk.
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+
+/// Standard includes
+#include <stdio.h>
+#include <string.h>
+
+/// Kernel includes
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "payrange_state.h"
+#include "payrange_tsc.h"
+
+/// Mapping handles, NULL while the state lives in stateFallback
+static HANDLE stateFileHandle = NULL;
+static HANDLE stateMappingHandle = NULL;
+static payrangeState_t *stateView = NULL;
+/// RAM state for a run without a usable state file
+static payrangeState_t stateFallback;
+/// Bumped on every change, the sync task flushes when it moves
+static volatile LONG stateDirtyCount = 0;
+
+///-----------------------------------------------------------
+/// \brief Checks a mapped state written by an earlier run
+///
+/// @param1 const payrangeState_t *state - mapped state
+///
+/// @return int - 1 if it can be used as is
+///-----------------------------------------------------------
+static int stateIsValid(const payrangeState_t *state)
+{
+	if ((memcmp(state->magic, STATE_MAGIC, sizeof(state->magic)) != 0) ||
+		(state->version != STATE_VERSION) || (state->size != sizeof(payrangeState_t)))
+	{
+		return 0;
+	}
+	return (state->fileELineNumber >= 0) && (state->elog.recordCount <= ELOG_RECORDS_PER_BLOCK);
+}
+
+///-----------------------------------------------------------
+/// \brief Maps the state file, creating or resetting it when
+///        it is missing or was written by another version
+///
+/// @param N/A
+///
+/// @return payrangeState_t * - state for this run, never NULL
+///-----------------------------------------------------------
+payrangeState_t *stateOpen(void)
+{
+	const uint64_t start = tscNow();
+	payrangeState_t *state = &stateFallback;
+
+	stateFileHandle = CreateFileA(STATE_FILE_NAME, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+		OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (stateFileHandle != INVALID_HANDLE_VALUE)
+	{
+		/// Mapping a larger size than the file grows it, the new bytes are zero
+		stateMappingHandle = CreateFileMappingA(stateFileHandle, NULL, PAGE_READWRITE, 0,
+			(DWORD)sizeof(payrangeState_t), NULL);
+		if (stateMappingHandle != NULL)
+		{
+			stateView = (payrangeState_t *)MapViewOfFile(stateMappingHandle, FILE_MAP_ALL_ACCESS, 0, 0,
+				sizeof(payrangeState_t));
+		}
+	}
+	if (stateView != NULL)
+	{
+		state = stateView;
+	}
+	else
+	{
+		printf("State: %s could not be mapped, this run starts cold and is not saved\n", STATE_FILE_NAME);
+		if (stateMappingHandle != NULL)
+		{
+			CloseHandle(stateMappingHandle);
+			stateMappingHandle = NULL;
+		}
+		if (stateFileHandle != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(stateFileHandle);
+		}
+		stateFileHandle = NULL;
+	}
+
+	if (!stateIsValid(state))
+	{
+		memset(state, 0, sizeof(*state));
+		memcpy(state->magic, STATE_MAGIC, sizeof(state->magic));
+		state->version = STATE_VERSION;
+		state->size = sizeof(payrangeState_t);
+	}
+	state->generation++;
+	stateMarkDirty();
+
+	if (state->generation > 1)
+	{
+		printf("State: warm restart #%u from %s in %u us, %d E lines, E log block %u\n",
+			(unsigned int)(state->generation - 1), STATE_FILE_NAME,
+			(unsigned int)(tscToNs(tscNow() - start) / 1000),
+			(int)state->fileELineNumber, (unsigned int)state->elog.blockIndex);
+	}
+	return state;
+}
+
+///-----------------------------------------------------------
+/// \brief Reads a state file into memory without mapping or
+///        changing it, for the offline tools. A running
+///        simulator flushes its state every
+///        STATE_SYNC_INTERVAL_MS, the copy may be that old.
+///
+/// @param1 const char *path - state file
+/// @param2 payrangeState_t *state - output
+///
+/// @return int - 1 if the file holds a valid state of this version
+///-----------------------------------------------------------
+int stateReadFile(const char *path, payrangeState_t *state)
+{
+	FILE *file = fopen(path, "rb");
+	size_t length;
+
+	if (file == NULL)
+	{
+		return 0;
+	}
+	length = fread(state, 1, sizeof(*state), file);
+	fclose(file);
+	return (length == sizeof(*state)) && stateIsValid(state);
+}
+
+///-----------------------------------------------------------
+/// \brief Notes that the state changed
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+void stateMarkDirty(void)
+{
+	InterlockedIncrement(&stateDirtyCount);
+}
+
+///-----------------------------------------------------------
+/// \brief Writes the dirty pages of the state to disk
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+void stateSync(void)
+{
+	if (stateView != NULL)
+	{
+		FlushViewOfFile(stateView, sizeof(payrangeState_t));
+		FlushFileBuffers(stateFileHandle);
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Sync task: flushes the state once per interval if
+///        anything changed since the last flush
+///
+/// @param 1 void *pvParameters - placeholder for FreeRTOS
+///                               Task parameters
+///
+/// @return None - Task always runs without a return
+///-----------------------------------------------------------
+static void stateSyncTask(void *pvParameters)
+{
+	const TickType_t xSyncInterval = STATE_SYNC_INTERVAL_MS / portTICK_PERIOD_MS;
+	LONG flushedCount = 0;
+
+	/// Just to remove compiler warnings
+	(void)pvParameters;
+
+	for (;;)
+	{
+		vTaskDelay(xSyncInterval);
+		if (stateDirtyCount != flushedCount)
+		{
+			flushedCount = stateDirtyCount;
+			stateSync();
+		}
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Creates the sync task (only when a file is mapped)
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+void stateCreateSyncTask(void)
+{
+	if (stateView != NULL)
+	{
+		xTaskCreate(stateSyncTask, "StateSync", configMINIMAL_STACK_SIZE, NULL, STATE_SYNC_TASK_PRIORITY, NULL);
+	}
+}
@@ -0,0 +1,67 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_state.h
+///-----------------------------------------------------------------------------
+///
+/// \brief Memory-mapped state file: the B list, list F, the E line counter
+///        and the E log writer state survive a restart of the simulator
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_STATE_H
+#define PAYRANGE_STATE_H
+
+#include "payrange.h"
+#include "payrange_elog.h"
+#include "payrange_eindex.h"
+
+/// State file configurable defines
+#define STATE_FILE_NAME                 "PayRange.state"
+/// Dirty pages are flushed to disk this often by the sync task
+#define STATE_SYNC_INTERVAL_MS          ( 1000 )
+#define STATE_SYNC_TASK_PRIORITY        ( tskIDLE_PRIORITY + 1 )
+
+/// State file format identification; bump the version on any layout change
+#define STATE_MAGIC                     "PRSTATE1"
+#define STATE_VERSION                   ( 7 )
+
+/// Contents of the state file. The whole file is mapped, the tasks work on
+/// it directly. The CSPRNG key is deliberately not part of it: a restored
+/// key would replay B tokens, every run reseeds from the OS instead.
+typedef struct
+{
+	/// Versioned header
+	char             magic[8];
+	uint32_t         version;
+	uint32_t         size;
+	/// Number of times the state has been opened, 1 on a cold start
+	uint32_t         generation;
+	uint32_t         reserved;
+
+	/// B list: slots at or above the configured size are empty
+	taskBStructure_t taskB[MAX_SIZE_OF_THE_TASK_B_ARRAY];
+	/// List F: slots in use, 0 on a cold start (SIZE_OF_VALUE_E_STRUCTURE)
+	uint32_t         valueECapacity;
+	valueE_t         valueE[MAX_SIZE_OF_VALUE_E_STRUCTURE];
+	int32_t          fileELineNumber;
+	elogBlockState_t elog;
+	/// A to E index entries not yet written to a run
+	eIndexMemtables_t eindex;
+	/// Change data capture: offset the next event gets, so offsets keep
+	/// growing across restarts (payrange_cdc.h)
+	volatile int64_t cdcNextOffset;
+}payrangeState_t;
+
+/// Maps (creating if needed) and validates the state file. Never returns
+/// NULL: without a usable file the state lives in RAM for this run.
+payrangeState_t *stateOpen(void);
+/// Copies a state file (e.g. of a running simulator) for the offline tools;
+/// returns 1 if it is a valid state of this version
+int stateReadFile(const char *path, payrangeState_t *state);
+/// Notes that the state changed, the sync task flushes it later
+void stateMarkDirty(void);
+/// Flushes the mapped state to disk now
+void stateSync(void);
+/// Creates the low priority task that flushes dirty state in batches
+void stateCreateSyncTask(void);
+
+#endif /// PAYRANGE_STATE_H
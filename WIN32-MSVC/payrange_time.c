@@ -0,0 +1,192 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_time.c
+///-----------------------------------------------------------------------------
+///
+/// \brief Time service
+///
+/// The anchor pairs one tick, extended to 64 bits, with the UTC time read at
+/// that tick. A later tick is extended by adding its (signed, wrap safe)
+/// distance from the anchor tick, and converted to UTC by adding that
+/// distance in nanoseconds to the anchor time: a subtraction, a multiply
+/// and an add per record, with no system call. The time task moves the
+/// anchor forward every TIME_REFRESH_INTERVAL_MS, which keeps the 32-bit
+/// distance small and follows adjustments of the wall clock.
+///
+/// The anchor is published under a sequence lock: the time task is the
+/// only writer and readers in any task never wait for it.
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+
+/// Kernel includes
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "payrange_atomic.h"
+#include "payrange_time.h"
+
+/// FILETIME counts 100 ns intervals since 1601-01-01
+#define TIME_FILETIME_UNIX_EPOCH        ( 116444736000000000ULL )
+#define TIME_NS_PER_FILETIME            ( 100ULL )
+
+/// Tick/UTC anchor
+typedef struct
+{
+	seqlock_t  lock;
+	TickType_t tick;
+	uint64_t   tick64;
+	uint64_t   utcNs;
+}timeAnchor_t;
+
+static timeAnchor_t timeAnchor;
+
+///-----------------------------------------------------------
+/// \brief Reads the wall clock
+///
+/// @param N/A
+///
+/// @return uint64_t - nanoseconds since 1970-01-01 UTC
+///-----------------------------------------------------------
+static uint64_t timeReadUtcNs(void)
+{
+	FILETIME fileTime;
+	ULARGE_INTEGER intervals;
+
+	GetSystemTimeAsFileTime(&fileTime);
+	intervals.LowPart = fileTime.dwLowDateTime;
+	intervals.HighPart = fileTime.dwHighDateTime;
+	return (intervals.QuadPart - TIME_FILETIME_UNIX_EPOCH) * TIME_NS_PER_FILETIME;
+}
+
+///-----------------------------------------------------------
+/// \brief Copies the anchor
+///
+/// @param1 timeAnchor_t *anchor - output
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void timeReadAnchor(timeAnchor_t *anchor)
+{
+	uint32_t sequence;
+
+	do
+	{
+		sequence = seqlockReadBegin(&timeAnchor.lock);
+		anchor->tick = timeAnchor.tick;
+		anchor->tick64 = timeAnchor.tick64;
+		anchor->utcNs = timeAnchor.utcNs;
+	} while (seqlockReadRetry(&timeAnchor.lock, sequence));
+}
+
+///-----------------------------------------------------------
+/// \brief Anchors the tick counter to the wall clock
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+void timeInit(void)
+{
+	seqlockWriteBegin(&timeAnchor.lock);
+	timeAnchor.tick = xTaskGetTickCount();
+	timeAnchor.tick64 = timeAnchor.tick;
+	timeAnchor.utcNs = timeReadUtcNs();
+	seqlockWriteEnd(&timeAnchor.lock);
+}
+
+///-----------------------------------------------------------
+/// \brief Moves the anchor to the current tick. Only the time
+///        task (or timeInit before it) writes the anchor.
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+void timeRefresh(void)
+{
+	const TickType_t tick = xTaskGetTickCount();
+	const uint64_t tick64 = timeExtendTick(tick);
+	const uint64_t utcNs = timeReadUtcNs();
+
+	seqlockWriteBegin(&timeAnchor.lock);
+	timeAnchor.tick = tick;
+	timeAnchor.tick64 = tick64;
+	timeAnchor.utcNs = utcNs;
+	seqlockWriteEnd(&timeAnchor.lock);
+}
+
+///-----------------------------------------------------------
+/// \brief Extends a 32-bit tick to 64 bits
+///
+/// @param1 TickType_t tick - tick within 2^31 ticks of now
+///
+/// @return uint64_t - extended tick
+///-----------------------------------------------------------
+uint64_t timeExtendTick(TickType_t tick)
+{
+	timeAnchor_t anchor;
+
+	timeReadAnchor(&anchor);
+	return anchor.tick64 + (int64_t)(int32_t)(tick - anchor.tick);
+}
+
+///-----------------------------------------------------------
+/// \brief Returns the current tick extended to 64 bits
+///
+/// @param N/A
+///
+/// @return uint64_t - extended tick
+///-----------------------------------------------------------
+uint64_t timeNowTick64(void)
+{
+	return timeExtendTick(xTaskGetTickCount());
+}
+
+///-----------------------------------------------------------
+/// \brief Converts a tick to UTC
+///
+/// @param1 TickType_t tick - tick within 2^31 ticks of now
+///
+/// @return uint64_t - nanoseconds since 1970-01-01 UTC
+///-----------------------------------------------------------
+uint64_t timeTickToUtcNs(TickType_t tick)
+{
+	timeAnchor_t anchor;
+
+	timeReadAnchor(&anchor);
+	return anchor.utcNs + (uint64_t)((int64_t)(int32_t)(tick - anchor.tick) * (int64_t)TIME_NS_PER_TICK);
+}
+
+///-----------------------------------------------------------
+/// \brief Time task: refreshes the anchor periodically
+///
+/// @param 1 void *pvParameters - placeholder for FreeRTOS
+///                               Task parameters
+///
+/// @return None - Task always runs without a return
+///-----------------------------------------------------------
+static void timeTask(void *pvParameters)
+{
+	const TickType_t xRefreshInterval = TIME_REFRESH_INTERVAL_MS / portTICK_PERIOD_MS;
+
+	/// Just to remove compiler warnings
+	(void)pvParameters;
+
+	for (;;)
+	{
+		vTaskDelay(xRefreshInterval);
+		timeRefresh();
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief Creates the time task
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+void timeCreateTask(void)
+{
+	xTaskCreate(timeTask, "Time", configMINIMAL_STACK_SIZE, NULL, TIME_TASK_PRIORITY, NULL);
+}
@@ -0,0 +1,41 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_time.h
+///-----------------------------------------------------------------------------
+///
+/// \brief Time service: 64-bit extended ticks and tick to UTC conversion
+///        through a cached, periodically refreshed anchor
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_TIME_H
+#define PAYRANGE_TIME_H
+
+/// Standard includes
+#include <stdint.h>
+
+/// Kernel includes
+#include <FreeRTOS.h>
+
+/// Time service configurable defines
+/// The tick/UTC anchor is re-read this often; ticks must stay within 2^31
+/// ticks (24 days at 1 kHz) of the anchor to be extended correctly
+#define TIME_REFRESH_INTERVAL_MS        ( 1000 )
+#define TIME_TASK_PRIORITY              ( tskIDLE_PRIORITY + 1 )
+/// Nanoseconds per tick
+#define TIME_NS_PER_TICK                ( 1000000000ULL / configTICK_RATE_HZ )
+
+/// Anchors the tick counter to the wall clock; call once before the
+/// scheduler starts
+void timeInit(void);
+/// Creates the low priority task that refreshes the anchor
+void timeCreateTask(void);
+/// Re-reads the wall clock and moves the anchor to the current tick
+void timeRefresh(void);
+/// Extends a 32-bit tick, taken within 2^31 ticks of now, to 64 bits
+uint64_t timeExtendTick(TickType_t tick);
+/// Current tick, extended to 64 bits
+uint64_t timeNowTick64(void);
+/// UTC time of a tick, in nanoseconds since 1970-01-01
+uint64_t timeTickToUtcNs(TickType_t tick);
+
+#endif /// PAYRANGE_TIME_H
@@ -0,0 +1,921 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_tools.c
+///-----------------------------------------------------------------------------
+///
+/// \brief Offline command-line tools bundled into the PayRange executable.
+///        They run before the scheduler is started and never start it.
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+
+/// Winsock must come before windows.h
+#include <winsock2.h>
+
+/// Standard includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <inttypes.h>
+
+#include "payrange_tools.h"
+#include "payrange_elog.h"
+#include "payrange_aead.h"
+#include "payrange_csprng.h"
+#include "payrange_ingest.h"
+#include "payrange_tsc.h"
+#include "payrange_lookup.h"
+#include "payrange_state.h"
+#include "payrange_repl.h"
+#include "payrange_merge.h"
+#include "payrange_rpc.h"
+#include "payrange_hdr.h"
+#include "payrange_gen.h"
+
+/// AEAD benchmark: message sizes and the amount of data per measurement
+#define TOOL_BENCH_MAX_MESSAGE          ( 64 * 1024 )
+#define TOOL_BENCH_BYTES_PER_RUN        ( 64 * 1024 * 1024 )
+/// RNG benchmark: B tokens generated per measurement
+#define TOOL_BENCH_TOKENS               ( 4 * 1000 * 1000 )
+/// Clock benchmark: timestamps read per measurement
+#define TOOL_BENCH_CLOCK_READS          ( 10 * 1000 * 1000 )
+/// Ingestion load: requests per send() and the most connections opened
+#define TOOL_INGEST_CHUNK               ( 2048 )
+#define TOOL_INGEST_MAX_CONNECTIONS     ( INGEST_MAX_CLIENTS )
+/// --loadgen: requests sent in one send() when the schedule is behind
+#define TOOL_LOADGEN_BATCH              ( 256 )
+/// --loadgen: wait for the last replies before the rest counts as unanswered
+#define TOOL_LOADGEN_DRAIN_MS           ( 5000 )
+/// --loadgen: the schedule counts whole nanoseconds between requests
+#define TOOL_LOADGEN_MAX_RATE           ( 1e9 )
+/// --loadgen: latency range and resolution of the histogram
+#define TOOL_LOADGEN_HIGHEST_NS         ( 60LL * 1000 * 1000 * 1000 )
+#define TOOL_LOADGEN_DIGITS             ( 3 )
+#define TOOL_LOADGEN_FILE_NAME          "loadgen.hgrm"
+
+/// Tool entry point, gets the arguments that follow the tool name
+typedef int (*payrangeToolFunction_t)(int argc, char *argv[]);
+
+/// Tool table entry
+typedef struct
+{
+	const char            *name;
+	const char            *usage;
+	payrangeToolFunction_t function;
+}payrangeTool_t;
+
+///-----------------------------------------------------------
+/// \brief --verify [file...] : checks the seals of E logs
+///
+/// @param1 int argc - number of files
+/// @param2 char *argv[] - files, the current E log when none are given
+///
+/// @return int - 0 when every file verifies, 1 otherwise
+///-----------------------------------------------------------
+static int toolVerify(int argc, char *argv[])
+{
+#if ELOG_ENCRYPT_AT_REST
+	static char defaultPath[] = ELOG_ENCRYPTED_FILE_NAME;
+#else
+	static char defaultPath[] = ELOG_FILE_NAME;
+#endif
+	char *defaultArgv[] = { defaultPath };
+	elogVerifyReport_t report;
+	int failures = 0;
+
+	if (argc == 0)
+	{
+		argc = 1;
+		argv = defaultArgv;
+	}
+	for (int i = 0; i < argc; i++)
+	{
+		if (elogVerifyFile(argv[i], &report) != ELOG_VERIFY_OK)
+		{
+			failures++;
+		}
+		elogPrintVerifyReport(argv[i], &report);
+	}
+	return (failures == 0) ? 0 : 1;
+}
+
+///-----------------------------------------------------------
+/// \brief --genkey [file] : creates a random E log key file
+///
+/// @param1 int argc - 0 or 1
+/// @param2 char *argv[] - key file, E.key when none is given
+///
+/// @return int - 0 on success
+///-----------------------------------------------------------
+static int toolGenerateKey(int argc, char *argv[])
+{
+	const char *path = (argc > 0) ? argv[0] : ELOG_KEY_FILE_NAME;
+
+	if (!elogGenerateKeyFile(path))
+	{
+		printf("Could not create key file %s\n", path);
+		return 1;
+	}
+	printf("Created key file %s\n", path);
+	return 0;
+}
+
+///-----------------------------------------------------------
+/// \brief --decrypt [in] [out] : decrypts an encrypted E log
+///
+/// @param1 int argc - 0 to 2
+/// @param2 char *argv[] - input (E.enc) and output (E.dec.txt)
+///
+/// @return int - 0 when every block was authentic
+///-----------------------------------------------------------
+static int toolDecrypt(int argc, char *argv[])
+{
+	const char *path = (argc > 0) ? argv[0] : ELOG_ENCRYPTED_FILE_NAME;
+	const char *outputPath = (argc > 1) ? argv[1] : "E.dec.txt";
+
+	return elogDecryptFile(path, outputPath) ? 0 : 1;
+}
+
+///-----------------------------------------------------------
+/// \brief --block N : prints sealed block N using the block
+///        table (random access, authenticated when encrypted)
+///
+/// @param1 int argc - 1
+/// @param2 char *argv[] - block index
+///
+/// @return int - 0 on success
+///-----------------------------------------------------------
+static int toolReadBlock(int argc, char *argv[])
+{
+	static char blockText[ELOG_MAX_BLOCK_TEXT];
+	size_t length;
+	uint32_t blockIndex;
+
+	if (argc < 1)
+	{
+		printf("--block needs a block index\n");
+		return 2;
+	}
+	blockIndex = (uint32_t)strtoul(argv[0], NULL, 10);
+	if (!elogReadBlock(blockIndex, blockText, sizeof(blockText), &length))
+	{
+		printf("Block %u could not be read\n", (unsigned int)blockIndex);
+		return 1;
+	}
+	fwrite(blockText, 1, length, stdout);
+	return 0;
+}
+
+///-----------------------------------------------------------
+/// \brief --bench-aead : seal and open throughput of each
+///        cipher available on this host at E log block sizes
+///
+/// @param1 int argc - unused
+/// @param2 char *argv[] - unused
+///
+/// @return int - 0
+///-----------------------------------------------------------
+static int toolBenchAead(int argc, char *argv[])
+{
+	static const aeadCipher_t ciphers[] = { AEAD_CIPHER_AES256_GCM, AEAD_CIPHER_CHACHA20_POLY1305 };
+	static const size_t messageSizes[] = { 1024, 4096, TOOL_BENCH_MAX_MESSAGE };
+	static uint8_t plainText[TOOL_BENCH_MAX_MESSAGE];
+	static uint8_t cipherText[TOOL_BENCH_MAX_MESSAGE];
+	uint8_t key[AEAD_KEY_SIZE];
+	uint8_t nonce[AEAD_NONCE_SIZE];
+	uint8_t aad[72];
+	uint8_t tag[AEAD_TAG_SIZE];
+	aeadContext_t context;
+
+	(void)argc;
+	(void)argv;
+	/// Contents don't matter for the timing, only that they are not all zero
+	for (size_t i = 0; i < sizeof(plainText); i++)
+	{
+		plainText[i] = (uint8_t)(i * 131 + 7);
+	}
+	memset(key, 0x5A, sizeof(key));
+	memset(nonce, 0, sizeof(nonce));
+	memset(aad, 0xA5, sizeof(aad));
+
+	printf("Preferred cipher on this host: %s\n", aeadCipherName(aeadPreferredCipher()));
+	for (size_t c = 0; c < sizeof(ciphers) / sizeof(ciphers[0]); c++)
+	{
+		if (!aeadInit(&context, ciphers[c], key))
+		{
+			printf("%-20s not available on this host\n", aeadCipherName(ciphers[c]));
+			continue;
+		}
+		for (size_t m = 0; m < sizeof(messageSizes) / sizeof(messageSizes[0]); m++)
+		{
+			const size_t size = messageSizes[m];
+			const uint32_t iterations = (uint32_t)(TOOL_BENCH_BYTES_PER_RUN / size);
+			double sealSeconds, openSeconds;
+			int authentic = 1;
+			clock_t start;
+
+			start = clock();
+			for (uint32_t i = 0; i < iterations; i++)
+			{
+				nonce[0] = (uint8_t)i;
+				aeadSeal(&context, nonce, aad, sizeof(aad), plainText, size, cipherText, tag);
+			}
+			sealSeconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+			/// The last sealed message is opened over and over
+			start = clock();
+			for (uint32_t i = 0; i < iterations; i++)
+			{
+				authentic &= aeadOpen(&context, nonce, aad, sizeof(aad), cipherText, size, tag, plainText);
+			}
+			openSeconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+			printf("%-20s %6u bytes: seal %8.1f MB/s, open %8.1f MB/s%s\n", aeadCipherName(ciphers[c]),
+				(unsigned int)size,
+				(sealSeconds > 0.0) ? TOOL_BENCH_BYTES_PER_RUN / sealSeconds / 1e6 : 0.0,
+				(openSeconds > 0.0) ? TOOL_BENCH_BYTES_PER_RUN / openSeconds / 1e6 : 0.0,
+				authentic ? "" : " (TAG MISMATCH)");
+		}
+		aeadClear(&context);
+	}
+	return 0;
+}
+
+///-----------------------------------------------------------
+/// \brief --bench-rng : B token generation with rand() (the
+///        old path) against the buffered CSPRNG, plus raw
+///        CSPRNG byte throughput
+///
+/// @param1 int argc - unused
+/// @param2 char *argv[] - unused
+///
+/// @return int - 0
+///-----------------------------------------------------------
+static int toolBenchRng(int argc, char *argv[])
+{
+	static const char charset[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+	static uint8_t bytes[TOOL_BENCH_MAX_MESSAGE];
+	const int charsetLength = (int)(sizeof(charset) - 1);
+	char token[NUMBER_OF_ALPHANUMERIC_DIGITS + 1];
+	unsigned int checksum = 0;
+	double seconds;
+	clock_t start;
+
+	(void)argc;
+	(void)argv;
+	start = clock();
+	for (int i = 0; i < TOOL_BENCH_TOKENS; i++)
+	{
+		for (int j = 0; j < NUMBER_OF_ALPHANUMERIC_DIGITS; j++)
+		{
+			token[j] = charset[rand() % charsetLength];
+		}
+		token[NUMBER_OF_ALPHANUMERIC_DIGITS] = '\0';
+		checksum += (unsigned char)token[0];
+	}
+	seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	printf("rand() tokens:  %10.0f tokens/s\n", (seconds > 0.0) ? TOOL_BENCH_TOKENS / seconds : 0.0);
+
+	start = clock();
+	for (int i = 0; i < TOOL_BENCH_TOKENS; i++)
+	{
+		csprngString(token, NUMBER_OF_ALPHANUMERIC_DIGITS, charset, charsetLength);
+		checksum += (unsigned char)token[0];
+	}
+	seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	printf("CSPRNG tokens:  %10.0f tokens/s\n", (seconds > 0.0) ? TOOL_BENCH_TOKENS / seconds : 0.0);
+
+	start = clock();
+	for (int i = 0; i < TOOL_BENCH_BYTES_PER_RUN / TOOL_BENCH_MAX_MESSAGE; i++)
+	{
+		csprngBytes(bytes, sizeof(bytes));
+		checksum += bytes[0];
+	}
+	seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	printf("CSPRNG bytes:   %10.1f MB/s (checksum %u)\n",
+		(seconds > 0.0) ? TOOL_BENCH_BYTES_PER_RUN / seconds / 1e6 : 0.0, checksum);
+	return 0;
+}
+
+///-----------------------------------------------------------
+/// \brief --bench-clock : compares the cost of a timestamp
+///        from QueryPerformanceCounter and from payrange_tsc
+///
+/// @param1 int argc - unused
+/// @param2 char *argv[] - unused
+///
+/// @return int - 0
+///-----------------------------------------------------------
+static int toolBenchClock(int argc, char *argv[])
+{
+	LARGE_INTEGER counter;
+	uint64_t checksum = 0;
+	uint64_t start, elapsed;
+
+	(void)argc;
+	(void)argv;
+	tscInit();
+	printf("Timestamp source: %s at %.3f MHz\n", tscUsesRdtsc() ? "invariant TSC" : "performance counter",
+		(double)tscFrequency() / 1e6);
+
+	start = tscNow();
+	for (int i = 0; i < TOOL_BENCH_CLOCK_READS; i++)
+	{
+		QueryPerformanceCounter(&counter);
+		checksum += (uint64_t)counter.QuadPart;
+	}
+	elapsed = tscToNs(tscNow() - start);
+	printf("QueryPerformanceCounter: %6.1f ns per read\n", (double)elapsed / TOOL_BENCH_CLOCK_READS);
+
+	start = tscNow();
+	for (int i = 0; i < TOOL_BENCH_CLOCK_READS; i++)
+	{
+		checksum += tscNow();
+	}
+	elapsed = tscToNs(tscNow() - start);
+	printf("tscNow:                  %6.1f ns per read\n", (double)elapsed / TOOL_BENCH_CLOCK_READS);
+
+	start = tscNow();
+	for (int i = 0; i < TOOL_BENCH_CLOCK_READS; i++)
+	{
+		checksum += tscNowNs();
+	}
+	elapsed = tscToNs(tscNow() - start);
+	printf("tscNowNs:                %6.1f ns per read (checksum %u)\n", (double)elapsed / TOOL_BENCH_CLOCK_READS,
+		(unsigned int)checksum);
+	return 0;
+}
+
+///-----------------------------------------------------------
+/// \brief --ingest-load [captures] [connections] : sends C
+///        capture requests to a running simulator's gateway
+///        as fast as the connections take them
+///
+/// @param1 int argc - 0 to 2
+/// @param2 char *argv[] - total requests (1000000), connections (4)
+///
+/// @return int - 0 when every request was sent
+///-----------------------------------------------------------
+static int toolIngestLoad(int argc, char *argv[])
+{
+	static ingestRequest_t requests[TOOL_INGEST_CHUNK];
+	SOCKET sockets[TOOL_INGEST_MAX_CONNECTIONS];
+	uint32_t sequence[TOOL_INGEST_MAX_CONNECTIONS];
+	const uint32_t total = (argc > 0) ? (uint32_t)strtoul(argv[0], NULL, 10) : 1000000;
+	int connections = (argc > 1) ? atoi(argv[1]) : 4;
+	struct sockaddr_in address;
+	WSADATA wsaData;
+	uint32_t sent = 0;
+	double seconds;
+	clock_t start;
+	int failed = 0;
+
+	if ((connections < 1) || (connections > TOOL_INGEST_MAX_CONNECTIONS))
+	{
+		printf("--ingest-load supports 1 to %d connections\n", TOOL_INGEST_MAX_CONNECTIONS);
+		return 2;
+	}
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+	{
+		return 1;
+	}
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(INGEST_PORT);
+	for (int i = 0; i < connections; i++)
+	{
+		sockets[i] = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		sequence[i] = 0;
+		if ((sockets[i] == INVALID_SOCKET) || (connect(sockets[i], (struct sockaddr *)&address, sizeof(address)) != 0))
+		{
+			printf("Cannot connect to the gateway on 127.0.0.1:%d, is the simulator running?\n", INGEST_PORT);
+			connections = i + (sockets[i] != INVALID_SOCKET);
+			failed = 1;
+			break;
+		}
+	}
+
+	start = clock();
+	/// Terminal i is source i + 1, source 0 is the local console
+	for (int i = 0; !failed && (sent < total); i = (i + 1) % connections)
+	{
+		uint32_t chunk = ((total - sent) < TOOL_INGEST_CHUNK) ? (total - sent) : TOOL_INGEST_CHUNK;
+		for (uint32_t j = 0; j < chunk; j++)
+		{
+			requests[j].terminalId = (uint32_t)i + 1;
+			requests[j].sequence = sequence[i]++;
+		}
+		if (send(sockets[i], (const char *)requests, (int)(chunk * sizeof(requests[0])), 0) !=
+			(int)(chunk * sizeof(requests[0])))
+		{
+			failed = 1;
+			break;
+		}
+		sent += chunk;
+	}
+	seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	for (int i = 0; i < connections; i++)
+	{
+		closesocket(sockets[i]);
+	}
+	WSACleanup();
+	printf("Sent %u captures over %d connections in %.3f s (%.0f captures/s)\n", (unsigned int)sent, connections,
+		seconds, (seconds > 0.0) ? sent / seconds : 0.0);
+	return failed ? 1 : 0;
+}
+
+/// One --loadgen connection and its receiver thread
+typedef struct
+{
+	SOCKET         socket;
+	HANDLE         thread;
+	hdrHistogram_t histogram;
+	uint64_t       replies;
+	uint64_t       shed;
+	/// Replies that don't match a request that was sent
+	uint64_t       unexpected;
+}toolLoadConnection_t;
+
+/// Requests sent, and 1 for each one answered, by request sequence
+static volatile uint32_t toolLoadSent = 0;
+static uint8_t *toolLoadAnswered = NULL;
+
+///-----------------------------------------------------------
+/// \brief --loadgen receiver thread: records the latency of
+///        every reply from the request's intended send time,
+///        which the request carries as its tag
+///
+/// @param1 LPVOID parameter - toolLoadConnection_t
+///
+/// @return DWORD - 0
+///-----------------------------------------------------------
+static DWORD WINAPI toolLoadReceiver(LPVOID parameter)
+{
+	toolLoadConnection_t *connection = (toolLoadConnection_t *)parameter;
+	uint8_t buffer[TOOL_LOADGEN_BATCH * sizeof(rpcReply_t)];
+	uint32_t buffered = 0;
+
+	for (;;)
+	{
+		const int received = recv(connection->socket, (char *)buffer + buffered, (int)(sizeof(buffer) - buffered), 0);
+		uint32_t consumed = 0;
+		uint64_t now;
+
+		if (received <= 0)
+		{
+			return 0;
+		}
+		now = tscNowNs();
+		buffered += (uint32_t)received;
+		while (buffered - consumed >= sizeof(rpcReply_t))
+		{
+			rpcReply_t reply;
+
+			memcpy(&reply, buffer + consumed, sizeof(reply));
+			consumed += sizeof(reply);
+			if ((reply.sequence >= toolLoadSent) || toolLoadAnswered[reply.sequence])
+			{
+				connection->unexpected++;
+				continue;
+			}
+			toolLoadAnswered[reply.sequence] = 1;
+			connection->replies++;
+			if (reply.status == RPC_SHED)
+			{
+				/// A shed capture was not served, its fast reply is no latency
+				connection->shed++;
+				continue;
+			}
+			hdrRecord(&connection->histogram, (int64_t)(now - reply.tag));
+		}
+		buffered -= consumed;
+		memmove(buffer, buffer + consumed, buffered);
+	}
+}
+
+///-----------------------------------------------------------
+/// \brief --loadgen <rate> <seconds> [lookup %] [connections]
+///        [histogram file] : sends C captures and G lookups
+///        to a running simulator's request gateway on a fixed
+///        schedule, whatever the replies do (open loop), and
+///        reports the latency of each from the time it was
+///        due to be sent, so a stalled system shows up as
+///        latency and not as fewer requests
+///
+/// @param1 int argc - 2 to 5
+/// @param2 char *argv[] - requests per second, duration, share
+///                        of lookups (10), connections (4),
+///                        output (loadgen.hgrm)
+///
+/// @return int - 0 when every request was sent
+///-----------------------------------------------------------
+static int toolLoadGenerator(int argc, char *argv[])
+{
+	static toolLoadConnection_t connections[RPC_MAX_CLIENTS];
+	static rpcRequest_t batches[RPC_MAX_CLIENTS][TOOL_LOADGEN_BATCH];
+	uint32_t batched[RPC_MAX_CLIENTS];
+	const double rate = (argc > 0) ? atof(argv[0]) : 0.0;
+	const double seconds = (argc > 1) ? atof(argv[1]) : 0.0;
+	const uint32_t lookupShare = (argc > 2) ? (uint32_t)atoi(argv[2]) : 10;
+	int connectionCount = (argc > 3) ? atoi(argv[3]) : 4;
+	const char *outputPath = (argc > 4) ? argv[4] : TOOL_LOADGEN_FILE_NAME;
+	const double requests = rate * seconds;
+	uint32_t total;
+	struct sockaddr_in address;
+	hdrHistogram_t histogram;
+	WSADATA wsaData;
+	uint64_t periodNs;
+	uint64_t start, end;
+	uint64_t maxLateNs = 0;
+	uint64_t replies = 0, shed = 0, unexpected = 0, unanswered = 0;
+	FILE *output;
+	int failed = 0;
+
+	if (!(rate > 0.0) || (rate > TOOL_LOADGEN_MAX_RATE) || !(requests >= 1.0) || (requests > (double)UINT32_MAX) ||
+		(lookupShare > 100) || (connectionCount < 1) || (connectionCount > RPC_MAX_CLIENTS))
+	{
+		printf("--loadgen needs a rate up to %.0f/s, a duration of 1 to %u requests, 0 to 100%% lookups and 1 to %d "
+			"connections\n", TOOL_LOADGEN_MAX_RATE, (unsigned int)UINT32_MAX, RPC_MAX_CLIENTS);
+		return 2;
+	}
+	total = (uint32_t)requests;
+	toolLoadAnswered = (uint8_t *)calloc(total, 1);
+	if ((toolLoadAnswered == NULL) || !hdrInit(&histogram, TOOL_LOADGEN_HIGHEST_NS, TOOL_LOADGEN_DIGITS) ||
+		(WSAStartup(MAKEWORD(2, 2), &wsaData) != 0))
+	{
+		return 1;
+	}
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(RPC_PORT);
+	for (int i = 0; i < connectionCount; i++)
+	{
+		toolLoadConnection_t *connection = &connections[i];
+
+		if (!hdrInit(&connection->histogram, TOOL_LOADGEN_HIGHEST_NS, TOOL_LOADGEN_DIGITS))
+		{
+			connectionCount = i;
+			failed = 1;
+			break;
+		}
+		connection->socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if ((connection->socket == INVALID_SOCKET) ||
+			(connect(connection->socket, (struct sockaddr *)&address, sizeof(address)) != 0))
+		{
+			printf("Cannot connect to the request gateway on 127.0.0.1:%d, is the simulator running?\n", RPC_PORT);
+			closesocket(connection->socket);
+			hdrFree(&connection->histogram);
+			connectionCount = i;
+			failed = 1;
+			break;
+		}
+		connection->thread = CreateThread(NULL, 0, toolLoadReceiver, connection, 0, NULL);
+	}
+
+	/// Request i is due at start + i * period, sent or not
+	periodNs = (uint64_t)(1e9 / rate);
+	start = tscNowNs();
+	for (uint32_t next = 0; !failed && (next < total);)
+	{
+		const uint64_t now = tscNowNs();
+		uint64_t due = (now - start) / periodNs + 1;
+		uint32_t count;
+
+		due = (due < total) ? due : total;
+		if (due <= next)
+		{
+			const uint64_t wait = start + next * periodNs - now;
+			/// Sleep(1) sleeps up to a timer period, spin the last stretch
+			if (wait > 2 * 1000 * 1000)
+			{
+				Sleep(1);
+			}
+			continue;
+		}
+		maxLateNs = ((now - (start + next * periodNs)) > maxLateNs) ? (now - (start + next * periodNs)) : maxLateNs;
+		count = (uint32_t)(((due - next) < TOOL_LOADGEN_BATCH) ? (due - next) : TOOL_LOADGEN_BATCH);
+		memset(batched, 0, sizeof(batched));
+		for (uint32_t i = next; i < next + count; i++)
+		{
+			const int target = (int)(i % (uint32_t)connectionCount);
+			rpcRequest_t *request = &batches[target][batched[target]++];
+
+			request->type = (csprngUniform(100) < lookupShare) ? RPC_LOOKUP : RPC_CAPTURE;
+			request->sequence = i;
+			request->code = (int64_t)csprngUniform64(900000000000) + 100000000000;
+			request->tag = start + i * periodNs;
+		}
+		next += count;
+		/// Published before the replies can come back
+		toolLoadSent = next;
+		for (int i = 0; (i < connectionCount) && !failed; i++)
+		{
+			const int length = (int)(batched[i] * sizeof(rpcRequest_t));
+
+			if ((length > 0) && (send(connections[i].socket, (const char *)batches[i], length, 0) != length))
+			{
+				failed = 1;
+			}
+		}
+	}
+
+	/// No more requests; the gateway answers what it has, then closes
+	for (int i = 0; i < connectionCount; i++)
+	{
+		shutdown(connections[i].socket, SD_SEND);
+	}
+	for (int i = 0; i < connectionCount; i++)
+	{
+		WaitForSingleObject(connections[i].thread, TOOL_LOADGEN_DRAIN_MS);
+		closesocket(connections[i].socket);
+		WaitForSingleObject(connections[i].thread, INFINITE);
+		CloseHandle(connections[i].thread);
+		hdrAdd(&histogram, &connections[i].histogram);
+		hdrFree(&connections[i].histogram);
+		replies += connections[i].replies;
+		shed += connections[i].shed;
+		unexpected += connections[i].unexpected;
+	}
+	WSACleanup();
+	/// Unanswered requests waited at least until now, leaving them out would
+	/// hide exactly the tail this tool is for
+	end = tscNowNs();
+	for (uint32_t i = 0; i < toolLoadSent; i++)
+	{
+		if (!toolLoadAnswered[i])
+		{
+			hdrRecord(&histogram, (int64_t)(end - (start + i * periodNs)));
+			unanswered++;
+		}
+	}
+
+	printf("Sent %u of %u requests at %.0f/s over %d connections, at most %.3f ms behind schedule\n",
+		(unsigned int)toolLoadSent, (unsigned int)total, rate, connectionCount, (double)maxLateNs / 1e6);
+	printf("%llu replies, %llu captures shed, %llu unanswered, %llu unexpected\n", (unsigned long long)replies,
+		(unsigned long long)shed, (unsigned long long)unanswered, (unsigned long long)unexpected);
+	printf("Latency from intended send: p50 %.3f ms, p99 %.3f ms, p99.9 %.3f ms, p99.99 %.3f ms, max %.3f ms\n",
+		(double)hdrValueAtPercentile(&histogram, 50.0) / 1e6, (double)hdrValueAtPercentile(&histogram, 99.0) / 1e6,
+		(double)hdrValueAtPercentile(&histogram, 99.9) / 1e6, (double)hdrValueAtPercentile(&histogram, 99.99) / 1e6,
+		(double)histogram.maxValue / 1e6);
+	output = fopen(outputPath, "w");
+	if (output != NULL)
+	{
+		hdrPrintPercentiles(&histogram, output, 1e6);
+		fclose(output);
+		printf("Percentile distribution in ms written to %s\n", outputPath);
+	}
+	hdrFree(&histogram);
+	free(toolLoadAnswered);
+	return failed ? 1 : 0;
+}
+
+///-----------------------------------------------------------
+/// \brief --lookup <codes> <output> [E log] [state file] :
+///        resolves a file of A codes against List F and the E
+///        history
+///
+/// @param1 int argc - 2 to 4
+/// @param2 char *argv[] - codes, output, E log, state file
+///
+/// @return int - 0 on success
+///-----------------------------------------------------------
+static int toolLookup(int argc, char *argv[])
+{
+#if ELOG_ENCRYPT_AT_REST
+	const char *elogPath = (argc > 2) ? argv[2] : ELOG_ENCRYPTED_FILE_NAME;
+#else
+	const char *elogPath = (argc > 2) ? argv[2] : ELOG_FILE_NAME;
+#endif
+	const char *statePath = (argc > 3) ? argv[3] : STATE_FILE_NAME;
+	lookupReport_t report;
+	int success;
+
+	if (argc < 2)
+	{
+		printf("--lookup needs a codes file and an output file\n");
+		return 2;
+	}
+	success = lookupBulk(argv[0], argv[1], elogPath, statePath, &report);
+	lookupPrintReport(&report);
+	return success ? 0 : 1;
+}
+
+///-----------------------------------------------------------
+/// \brief --standby [file] [from line] : receives the E log
+///        shipped by a running simulator until stopped
+///
+/// @param1 int argc - 0 to 2
+/// @param2 char *argv[] - standby log (E.standby.txt), first
+///                        line wanted (after the file's last
+///                        complete block)
+///
+/// @return int - 1 if the standby could not start
+///-----------------------------------------------------------
+static int toolStandby(int argc, char *argv[])
+{
+	const char *path = (argc > 0) ? argv[0] : REPL_STANDBY_FILE_NAME;
+	const int64_t fromLine = (argc > 1) ? (int64_t)strtoul(argv[1], NULL, 10) : -1;
+
+	return replRunStandby(path, fromLine);
+}
+
+///-----------------------------------------------------------
+/// \brief --merge <output> <lane log|@list>... : merges per
+///        lane E logs into one log in D time order. @list is a
+///        file naming one lane log per line, for more lanes
+///        than a command line holds.
+///
+/// @param1 int argc - 2 or more
+/// @param2 char *argv[] - output, lane logs and lists
+///
+/// @return int - 0 on success
+///-----------------------------------------------------------
+static int toolMerge(int argc, char *argv[])
+{
+	static char *lanePaths[MERGE_MAX_LANES + 1];
+	mergeReport_t report;
+	uint32_t laneCount = 0;
+	int failed = 0;
+
+	if (argc < 2)
+	{
+		printf("--merge needs an output file and at least one lane log\n");
+		return 2;
+	}
+	/// One path past the limit is kept, for mergeOpen() to refuse
+	for (int i = 1; !failed && (i < argc) && (laneCount <= MERGE_MAX_LANES); i++)
+	{
+		char path[MAX_PATH];
+		FILE *list;
+
+		if (argv[i][0] != '@')
+		{
+			lanePaths[laneCount++] = _strdup(argv[i]);
+			continue;
+		}
+		list = fopen(argv[i] + 1, "r");
+		if (list == NULL)
+		{
+			printf("Merge: lane list %s could not be opened\n", argv[i] + 1);
+			failed = 1;
+			break;
+		}
+		while ((laneCount <= MERGE_MAX_LANES) && (fgets(path, sizeof(path), list) != NULL))
+		{
+			path[strcspn(path, "\r\n")] = '\0';
+			if (path[0] != '\0')
+			{
+				lanePaths[laneCount++] = _strdup(path);
+			}
+		}
+		fclose(list);
+	}
+	if (!failed)
+	{
+		failed = !mergeLogs((const char *const *)lanePaths, laneCount, argv[0], &report);
+		if (!failed)
+		{
+			mergePrintReport(&report);
+		}
+	}
+	for (uint32_t i = 0; i < laneCount; i++)
+	{
+		free(lanePaths[i]);
+	}
+	return failed ? 1 : 0;
+}
+
+///-----------------------------------------------------------
+/// \brief --gen-dataset <output> <records> [text|enc] [seed]
+///        [threads] [captures/s] [--force] : writes a synthetic
+///        E history of the given size to <output> and its block
+///        table to <output>.blk, sealed like the simulator's
+///        own, for testing the readers, the verifier and the
+///        merge at scale. The same seed gives the same records.
+///        Existing files are only replaced with --force.
+///
+/// @param1 int argc - 2 to 7
+/// @param2 char *argv[] - output, records, format (text), seed
+///                        (random), worker threads (processors
+///                        - 1), simulated capture rate (100),
+///                        --force to overwrite
+///
+/// @return int - 0 on success
+///-----------------------------------------------------------
+static int toolGenerateDataset(int argc, char *argv[])
+{
+	genOptions_t options;
+	genReport_t report;
+	SYSTEM_INFO system;
+	char tablePath[MAX_PATH];
+
+	memset(&options, 0, sizeof(options));
+	if ((argc > 0) && (strcmp(argv[argc - 1], "--force") == 0))
+	{
+		options.overwrite = 1;
+		argc--;
+	}
+	if (argc < 2)
+	{
+		printf("--gen-dataset needs an output file and a record count\n");
+		return 2;
+	}
+	options.logPath = argv[0];
+	if (snprintf(tablePath, sizeof(tablePath), "%s.blk", options.logPath) >= (int)sizeof(tablePath))
+	{
+		printf("--gen-dataset output path too long: %s\n", options.logPath);
+		return 2;
+	}
+	options.tablePath = tablePath;
+	argc--;
+	argv++;
+
+	options.records = strtoull(argv[0], NULL, 10);
+	options.encrypt = (argc > 1) && (strcmp(argv[1], "enc") == 0);
+	if ((argc > 1) && !options.encrypt && (strcmp(argv[1], "text") != 0))
+	{
+		printf("--gen-dataset writes text or enc, not %s\n", argv[1]);
+		return 2;
+	}
+	if (argc > 2)
+	{
+		options.seed = strtoull(argv[2], NULL, 10);
+	}
+	else if (!csprngOsEntropy(&options.seed, sizeof(options.seed)))
+	{
+		return 1;
+	}
+	/// One worker per processor besides the writer, unless given
+	GetSystemInfo(&system);
+	options.threads = (system.dwNumberOfProcessors > 1) ? (uint32_t)system.dwNumberOfProcessors - 1 : 1;
+	if (options.threads > GEN_MAX_THREADS)
+	{
+		options.threads = GEN_MAX_THREADS;
+	}
+	if (argc > 3)
+	{
+		options.threads = (uint32_t)atoi(argv[3]);
+	}
+	options.capturesPerSecond = (argc > 4) ? (uint32_t)atoi(argv[4]) : GEN_DEFAULT_RATE;
+
+	printf("Dataset: %s and %s, seed %" PRIu64 "\n", options.logPath, options.tablePath, options.seed);
+	if (!genDataset(&options, &report))
+	{
+		return 1;
+	}
+	genPrintReport(&report);
+	return 0;
+}
+
+/// All tools, by command-line name
+static const payrangeTool_t payrangeTools[] =
+{
+	{ "--verify", "[E log file...]  verify the Merkle seals and hash chain", toolVerify },
+	{ "--genkey", "[key file]  create a random key for the encrypted E log", toolGenerateKey },
+	{ "--decrypt", "[E.enc] [output]  decrypt an encrypted E log to text", toolDecrypt },
+	{ "--block", "<index>  print one sealed block through the block table", toolReadBlock },
+	{ "--bench-aead", " measure AES-256-GCM and ChaCha20-Poly1305 throughput", toolBenchAead },
+	{ "--bench-rng", " compare rand() and CSPRNG B token generation", toolBenchRng },
+	{ "--bench-clock", " compare QueryPerformanceCounter and TSC timestamp costs", toolBenchClock },
+	{ "--ingest-load", "[captures] [connections]  send C captures to a running simulator", toolIngestLoad },
+	{ "--loadgen", "<rate> <seconds> [lookup %] [connections] [output]  open-loop C and G latency test", toolLoadGenerator },
+	{ "--lookup", "<codes> <output> [E log] [state]  resolve a file of A codes against F and E", toolLookup },
+	{ "--standby", "[file] [from line]  receive the E log shipped by a running simulator", toolStandby },
+	{ "--merge", "<output> <lane log|@list>...  merge per-lane E logs in D time order", toolMerge },
+	{ "--gen-dataset", "<output> <records> [text|enc] [seed] [threads] [captures/s] [--force]  write a synthetic E history", toolGenerateDataset },
+};
+
+///-----------------------------------------------------------
+/// \brief Runs the tool named by argv[1]
+///
+/// @param1 int argc - main() argument count
+/// @param2 char *argv[] - main() arguments
+///
+/// @return int - tool exit code, PAYRANGE_NO_TOOL to run the simulator
+///-----------------------------------------------------------
+int payrangeRunTool(int argc, char *argv[])
+{
+	const int toolCount = (int)(sizeof(payrangeTools) / sizeof(payrangeTools[0]));
+
+	if (argc < 2)
+	{
+		return PAYRANGE_NO_TOOL;
+	}
+	for (int i = 0; i < toolCount; i++)
+	{
+		if (strcmp(argv[1], payrangeTools[i].name) == 0)
+		{
+			return payrangeTools[i].function(argc - 2, argv + 2);
+		}
+	}
+
+	printf("Usage: %s [tool]\n", argv[0]);
+	for (int i = 0; i < toolCount; i++)
+	{
+		printf("  %s %s\n", payrangeTools[i].name, payrangeTools[i].usage);
+	}
+	return 2;
+}
@@ -0,0 +1,19 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_tools.h
+///-----------------------------------------------------------------------------
+///
+/// \brief Offline command-line tools bundled into the PayRange executable
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_TOOLS_H
+#define PAYRANGE_TOOLS_H
+
+/// Returned by payrangeRunTool() when the command line asks for no tool
+#define PAYRANGE_NO_TOOL                ( -1 )
+
+/// Runs the tool named by argv[1] (e.g. "--verify E.txt") instead of the
+/// simulator. Returns the tool exit code, or PAYRANGE_NO_TOOL.
+int payrangeRunTool(int argc, char *argv[]);
+
+#endif /// PAYRANGE_TOOLS_H
@@ -0,0 +1,274 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_tsc.c
+///-----------------------------------------------------------------------------
+///
+/// \brief Cheap timestamps
+///
+/// QueryPerformanceCounter is the monotonic clock of Windows, but depending
+/// on the host it costs anything from an rdtsc to a trip into the kernel.
+/// When the CPU has an invariant TSC (constant rate across P-states and
+/// sleep states, CPUID 0x80000007 EDX bit 8) the counter is read directly
+/// with rdtsc instead. Its rate is measured once against the performance
+/// counter over TSC_CALIBRATION_MS.
+///
+/// Conversions use a precomputed multiplier and shift instead of a 64-bit
+/// division (a library call on x86). The difference is split into 32-bit
+/// halves so the products cannot overflow for centuries of uptime.
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+
+/// Compiler includes
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#include <cpuid.h>
+#endif
+
+/// Kernel includes
+#include <FreeRTOS.h>
+
+#include "payrange_tsc.h"
+
+/// Selected counter, set up by tscInit()
+static volatile int tscInitialized = 0;
+static int tscRdtsc = 0;
+static uint64_t tscHz = 1;
+static uint64_t tscStart = 0;
+static tscScale_t tscNsScale;
+
+///-----------------------------------------------------------
+/// \brief Reads the performance counter
+///
+/// @param N/A
+///
+/// @return uint64_t - counter value
+///-----------------------------------------------------------
+static uint64_t tscPerformanceCounter(void)
+{
+	LARGE_INTEGER counter;
+
+	QueryPerformanceCounter(&counter);
+	return (uint64_t)counter.QuadPart;
+}
+
+///-----------------------------------------------------------
+/// \brief Checks CPUID for an invariant TSC
+///
+/// @param N/A
+///
+/// @return int - 1 if the TSC runs at a constant rate
+///-----------------------------------------------------------
+static int tscIsInvariant(void)
+{
+	unsigned int regs[4];
+
+#if defined(_MSC_VER)
+	int msvcRegs[4];
+	__cpuid(msvcRegs, (int)0x80000000);
+	regs[0] = (unsigned int)msvcRegs[0];
+	if (regs[0] < 0x80000007)
+	{
+		return 0;
+	}
+	__cpuid(msvcRegs, (int)0x80000007);
+	regs[3] = (unsigned int)msvcRegs[3];
+#else
+	__cpuid(0x80000000, regs[0], regs[1], regs[2], regs[3]);
+	if (regs[0] < 0x80000007)
+	{
+		return 0;
+	}
+	__cpuid(0x80000007, regs[0], regs[1], regs[2], regs[3]);
+#endif
+	return (regs[3] >> 8) & 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Builds a counter to unit conversion for a counter
+///        running at frequency
+///
+/// @param1 tscScale_t *scale - output
+/// @param2 uint64_t frequency - counter increments per second
+/// @param3 uint64_t unitsPerSecond - wanted unit
+///
+/// @return N/A
+///-----------------------------------------------------------
+static void tscBuildScale(tscScale_t *scale, uint64_t frequency, uint64_t unitsPerSecond)
+{
+	/// Long division of unitsPerSecond * 2^shift by frequency, one bit of
+	/// shift at a time, for as long as the multiplier stays within 32 bits
+	/// (the partial products in tscScale() must fit in 64 bits)
+	uint64_t multiplier = unitsPerSecond / frequency;
+	uint64_t rest = unitsPerSecond % frequency;
+	uint32_t shift = 0;
+
+	while (shift < 63)
+	{
+		uint64_t next;
+		rest <<= 1;
+		next = multiplier << 1;
+		if (rest >= frequency)
+		{
+			rest -= frequency;
+			next |= 1;
+		}
+		if (next > 0xFFFFFFFFu)
+		{
+			break;
+		}
+		multiplier = next;
+		shift++;
+	}
+	scale->multiplier = multiplier;
+	scale->shift = shift;
+}
+
+///-----------------------------------------------------------
+/// \brief Picks the counter and calibrates it
+///
+/// @param N/A
+///
+/// @return N/A
+///-----------------------------------------------------------
+void tscInit(void)
+{
+	LARGE_INTEGER frequency;
+	uint64_t counterHz;
+
+	if (tscInitialized)
+	{
+		return;
+	}
+	counterHz = QueryPerformanceFrequency(&frequency) ? (uint64_t)frequency.QuadPart : 1;
+
+	if (tscIsInvariant() && (counterHz > 1))
+	{
+		const uint64_t window = counterHz * TSC_CALIBRATION_MS / 1000;
+		uint64_t counterStart, counterEnd, cyclesStart, cyclesEnd;
+
+		/// Both readings are taken back to back at each end of the window
+		counterStart = tscPerformanceCounter();
+		cyclesStart = __rdtsc();
+		do
+		{
+			counterEnd = tscPerformanceCounter();
+		} while ((counterEnd - counterStart) < window);
+		cyclesEnd = __rdtsc();
+
+		tscHz = (cyclesEnd - cyclesStart) * counterHz / (counterEnd - counterStart);
+		tscRdtsc = (tscHz > 0);
+	}
+	if (!tscRdtsc)
+	{
+		tscHz = counterHz;
+	}
+
+	tscBuildScale(&tscNsScale, tscHz, 1000000000);
+	tscStart = tscRdtsc ? __rdtsc() : tscPerformanceCounter();
+	tscInitialized = 1;
+}
+
+///-----------------------------------------------------------
+/// \brief Reads the selected counter
+///
+/// @param N/A
+///
+/// @return uint64_t - counter value
+///-----------------------------------------------------------
+uint64_t tscNow(void)
+{
+	if (!tscInitialized)
+	{
+		tscInit();
+	}
+	return tscRdtsc ? __rdtsc() : tscPerformanceCounter();
+}
+
+///-----------------------------------------------------------
+/// \brief Returns the counter rate
+///
+/// @param N/A
+///
+/// @return uint64_t - increments per second
+///-----------------------------------------------------------
+uint64_t tscFrequency(void)
+{
+	tscInit();
+	return tscHz;
+}
+
+///-----------------------------------------------------------
+/// \brief Tells which counter is in use
+///
+/// @param N/A
+///
+/// @return int - 1 for the TSC, 0 for the performance counter
+///-----------------------------------------------------------
+int tscUsesRdtsc(void)
+{
+	tscInit();
+	return tscRdtsc;
+}
+
+///-----------------------------------------------------------
+/// \brief Returns the time since tscInit()
+///
+/// @param N/A
+///
+/// @return uint64_t - nanoseconds
+///-----------------------------------------------------------
+uint64_t tscNowNs(void)
+{
+	const uint64_t now = tscNow();
+	return tscScale(now - tscStart, &tscNsScale);
+}
+
+///-----------------------------------------------------------
+/// \brief Converts a counter difference to nanoseconds
+///
+/// @param1 uint64_t ticks - counter difference
+///
+/// @return uint64_t - nanoseconds
+///-----------------------------------------------------------
+uint64_t tscToNs(uint64_t ticks)
+{
+	tscInit();
+	return tscScale(ticks, &tscNsScale);
+}
+
+///-----------------------------------------------------------
+/// \brief Builds the conversion to an arbitrary unit
+///
+/// @param1 tscScale_t *scale - output
+/// @param2 uint64_t unitsPerSecond - e.g. 100000 for 10 us
+///
+/// @return N/A
+///-----------------------------------------------------------
+void tscMakeScale(tscScale_t *scale, uint64_t unitsPerSecond)
+{
+	tscInit();
+	tscBuildScale(scale, tscHz, unitsPerSecond);
+}
+
+///-----------------------------------------------------------
+/// \brief Converts a counter difference: ticks * multiplier
+///        >> shift, in 32-bit halves
+///
+/// @param1 uint64_t ticks - counter difference
+/// @param2 const tscScale_t *scale - conversion
+///
+/// @return uint64_t - converted value
+///-----------------------------------------------------------
+uint64_t tscScale(uint64_t ticks, const tscScale_t *scale)
+{
+	const uint64_t high = (ticks >> 32) * scale->multiplier;
+	const uint64_t low = (ticks & 0xFFFFFFFFu) * scale->multiplier;
+
+	if (scale->shift >= 32)
+	{
+		return (high >> (scale->shift - 32)) + (low >> scale->shift);
+	}
+	return (high << (32 - scale->shift)) + (low >> scale->shift);
+}
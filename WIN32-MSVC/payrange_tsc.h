@@ -0,0 +1,45 @@
+///-----------------------------------------------------------------------------
+/// \file payrange_tsc.h
+///-----------------------------------------------------------------------------
+///
+/// \brief Cheap timestamps: the invariant TSC calibrated against the
+///        performance counter, with the performance counter as fallback
+///
+/// \n <b> Owner: </b> aleksey.vlasov@gmail.com
+///-----------------------------------------------------------------------------
+#ifndef PAYRANGE_TSC_H
+#define PAYRANGE_TSC_H
+
+/// Standard includes
+#include <stdint.h>
+
+/// Timestamp configurable defines
+/// Calibration window; longer is more accurate, it is spent once at start-up
+#define TSC_CALIBRATION_MS              ( 20 )
+
+/// Counter to unit conversion: units = counter * multiplier >> shift
+typedef struct
+{
+	uint64_t multiplier;
+	uint32_t shift;
+}tscScale_t;
+
+/// Picks the counter and calibrates it; later calls do nothing. Any of the
+/// other functions calls it on first use.
+void tscInit(void);
+/// Raw counter: TSC cycles, or performance counter ticks without a usable TSC
+uint64_t tscNow(void);
+/// Counter increments per second
+uint64_t tscFrequency(void);
+/// 1 if tscNow() reads the invariant TSC
+int tscUsesRdtsc(void);
+/// Nanoseconds since tscInit()
+uint64_t tscNowNs(void);
+/// Converts a counter difference to nanoseconds
+uint64_t tscToNs(uint64_t ticks);
+/// Builds the conversion of counter differences to unitsPerSecond units
+void tscMakeScale(tscScale_t *scale, uint64_t unitsPerSecond);
+/// Converts a counter difference with a scale from tscMakeScale()
+uint64_t tscScale(uint64_t ticks, const tscScale_t *scale);
+
+#endif /// PAYRANGE_TSC_H